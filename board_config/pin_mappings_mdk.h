@@ -37,6 +37,9 @@ extern "C" {
 #define SPI2_MISO_PIN            16
 #define SPI2_CLK_PIN             13
 
+/* ADXL372 INT1, wakes the MCU up on impacts */
+#define ADXL372_INT1_PIN         14
+
 /*******************************
  * @brief I2C pin mappings
  *******************************/
@@ -45,6 +48,9 @@ extern "C" {
 #define I2C1_SDA                 20
 #define I2C1_SCL                 19
 
+/* VCNL4040 INT, wakes the MCU up when the helmet is put on or taken off */
+#define VCNL4040_INT_PIN          4
+
 #ifdef __cplusplus
 }
 #endif
@@ -8,6 +8,7 @@
 #include <string.h>
 #include "adxl372.h"
 #include "adxl372_regs.h"
+#include "sensorconv.h"
 #include "spi.h"
 
 /**
@@ -31,7 +32,13 @@ typedef struct
 {
     adxl372_state_t state;
     const adxl372_cfg_t* cfg;
-    adxl372_val_raw_t offsets[ADXL372_AXES];
+    sensorconv_cal_t cal; /*!< Calibration applied to every reading */
+    bool cal_matrix_en;   /*!< If false, only the calibration bias is applied */
+    adxl372_mode_t mode;  /*!< Current mode of operation */
+    adxl372_instant_on_thresh_t instant_on_thresh; /*!< Impact threshold in instant-on mode */
+    bool peak_en;         /*!< Peak-detect FIFO running */
+    bool onset_en;        /*!< FIFO keeping readings from an impact */
+    uint8_t status;       /*!< Status register at the last reading */
 } adxl_372_t;
 
 /**
@@ -98,13 +105,17 @@ static sysret_t read_reg(reg_addr_t reg_addr, void* rx, size_t rxn)
  * @brief Configure LPF bandwidth
  * 
  * @param bandwidth 
+ * @param looped - if true, activity and inactivity detection run looped
  * @return sysret_t - Driver status
  */
-static sysret_t configure_bandwidth(adxl372_bandwidth_t bandwidth)
+static sysret_t configure_bandwidth(adxl372_bandwidth_t bandwidth, bool looped)
 {
-    if(bandwidth < ADXL372_BW_DISABLE)
+    if(bandwidth < ADXL372_BW_DISABLE || looped)
     {
-        uint8_t tx = bandwidth & ADXL372_BANDWIDTH_MASK;
+        uint8_t tx = (bandwidth < ADXL372_BW_DISABLE) ? (bandwidth & ADXL372_BANDWIDTH_MASK) : 0U;
+
+        if(looped)
+            tx |= ADXL372_MEASURE_LOOPED_MASK;
 
         return write_reg(ADXL372_MEASURE_ADDR, &tx, 1U);
     }
@@ -112,6 +123,30 @@ static sysret_t configure_bandwidth(adxl372_bandwidth_t bandwidth)
     return RET_OK;
 }
 
+/**
+ * @notapi
+ * @brief Set the same threshold on every axis
+ * 
+ * @param addr   - Address of the X axis H register
+ * @param thresh - Threshold, 100 mg/LSB
+ * @param enable - if true, the axis takes part in detection
+ * @return sysret_t - Driver status
+ */
+static sysret_t configure_thresh(reg_addr_t addr, uint16_t thresh, bool enable)
+{
+    uint8_t tx[ADXL372_AXES*2U];
+
+    thresh = (thresh > ADXL372_THRESH_MAX) ? ADXL372_THRESH_MAX : thresh;
+
+    for(size_t axis = 0U ; axis < ADXL372_AXES ; axis++)
+    {
+        tx[2U*axis]      = (uint8_t)(thresh >> 3U);
+        tx[2U*axis + 1U] = (uint8_t)(thresh << ADXL372_THRESH_L_SHIFT) | (enable ? ADXL372_THRESH_L_EN_MASK : 0U);
+    }
+
+    return write_reg(addr, tx, sizeof(tx));
+}
+
 /**
  * @brief Configure driver to run at ODR specified
  * 
@@ -136,6 +171,9 @@ static sysret_t configure_mode(adxl372_mode_t mode, bool lpf_disable)
 {
     uint8_t tx = mode & ADXL372_POWER_CTL_MODE_MASK;
 
+    if(mode == ADXL372_MODE_INSTANT_ON && adxl372.instant_on_thresh == ADXL372_INSTANT_ON_THRESH_HIGH)
+        tx |= ADXL372_POWER_CTL_INSTANT_ON_THRESH_MASK;
+
     if(lpf_disable)
         tx |= ADXL372_POWER_CTL_LPF_MASK;
 
@@ -155,6 +193,116 @@ static sysret_t reset_dev(void)
     return write_reg(ADXL372_POWER_CTL_ADDR, &tx, 1U);
 }
 
+/**
+ * @notapi
+ * @brief Read acceleration output, calibrated
+ *
+ * @param readings - Buffer to store data
+ * @param wait     - if true, wait for data ready first
+ * @return sysret_t - Error status if something goes wrong
+ */
+static sysret_t read_data(adxl372_val_raw_t readings[ADXL372_AXES], bool wait)
+{
+    sysret_t ret = RET_DRV_UNINIT;
+
+    if(adxl372.state == ADXL372_STATE_ACTIVE && adxl372.mode == ADXL372_MODE_STANDBY)
+    {
+        /* data ready never comes */
+        ret = NRF_ERROR_INVALID_STATE;
+    }
+    else if(adxl372.state == ADXL372_STATE_ACTIVE)
+    {
+        uint8_t status = 0U;
+
+        /* wait for data ready, status is read either way for adxl372_awake() */
+        do
+        {
+            if((ret = read_reg(ADXL372_STATUS_ADDR, &status, 1U)) != RET_OK)
+                return ret;
+        } while(wait && !(status & ADXL372_STATUS_DATA_RDY_MASK));
+
+        adxl372.status = status;
+
+        if((ret = read_reg(ADXL372_XDATA_H_ADDR, readings, ADXL372_AXES*2)) != RET_OK)
+            return ret;
+
+        /* convert big-endian 12-bit data to 16-bit integers, trim offset */
+        sensorconv_adxl372(readings, 1U, adxl372.cal.bias);
+
+        /* correct scale and misalignment */
+        if(adxl372.cal_matrix_en)
+            sensorconv_calibrate(readings, 1U, &adxl372.cal);
+
+        ret = RET_OK;
+    }
+
+    return ret;
+}
+
+/**
+ * @notapi
+ * @brief Read XYZ sets out of the FIFO, calibrated
+ *
+ * @param sets  - Buffer to store sets
+ * @param max   - Max number of sets to read
+ * @param count - Number of sets read
+ * @return sysret_t - Error status if something goes wrong
+ */
+static sysret_t fifo_read(adxl372_val_raw_t sets[][ADXL372_AXES], size_t max, size_t* count)
+{
+    /* read_reg() takes 31 bytes at most */
+    const size_t chunk_max = 5U;
+    sysret_t ret;
+    uint8_t entries[2U];
+    size_t available;
+
+    *count = 0U;
+
+    ret = read_reg(ADXL372_FIFO_ENTRIES2_ADDR, entries, sizeof(entries));
+    SYSRET_CHECK(ret);
+
+    /* the part writes all three axes of a set at once */
+    available = ((((size_t)entries[0] & ADXL372_FIFO_ENTRIES2_MASK) << 8U) | entries[1]) / ADXL372_AXES;
+    available = (available < max) ? available : max;
+
+    while(*count < available)
+    {
+        size_t n = available - *count;
+        n = (n < chunk_max) ? n : chunk_max;
+
+        ret = read_reg(ADXL372_FIFO_DATA_ADDR, sets[*count], n*ADXL372_AXES*2U);
+        SYSRET_CHECK(ret);
+
+        /* same 12-bit left-justified format as the data registers */
+        sensorconv_adxl372(sets[*count], n, adxl372.cal.bias);
+
+        if(adxl372.cal_matrix_en)
+            sensorconv_calibrate(sets[*count], n, &adxl372.cal);
+
+        *count += n;
+    }
+
+    return RET_OK;
+}
+
+/**
+ * @notapi
+ * @brief Set the FIFO mode, only taken in standby
+ *
+ * @param ctl     - FIFO control register value, format and mode
+ * @param entries - Watermark in entries, 9 bits
+ * @return sysret_t - Error status if something goes wrong
+ */
+static sysret_t configure_fifo(uint8_t ctl, uint16_t entries)
+{
+    uint8_t tx[2U];
+
+    tx[0] = (uint8_t)entries;
+    tx[1] = ctl | ((uint8_t)(entries >> 8U) & ADXL372_FIFO_CTL_SAMPLES_MASK);
+
+    return write_reg(ADXL372_FIFO_SAMPLES_ADDR, tx, 2U);
+}
+
 /******************************
  * API
  ******************************/
@@ -184,12 +332,13 @@ sysret_t adxl372_init(const adxl372_cfg_t* cfg)
             return ret;
 
         adxl372.cfg = cfg;
-        memset(adxl372.offsets, 0, sizeof(adxl372_val_raw_t)*ADXL372_AXES);
+        sensorconv_cal_identity(&adxl372.cal);
+        adxl372.cal_matrix_en = false;
 
         /**
          * configure registers
          */
-        if((ret = configure_bandwidth(cfg->bandwidth)) != RET_OK)
+        if((ret = configure_bandwidth(cfg->bandwidth, false)) != RET_OK)
             return ret;
 
         if((ret = configure_odr(cfg->odr)) != RET_OK)
@@ -199,6 +348,8 @@ sysret_t adxl372_init(const adxl372_cfg_t* cfg)
         if(ret != RET_OK)
             return ret;
 
+        adxl372.mode = cfg->mode;
+
         /**
          * update driver state
          */
@@ -216,38 +367,296 @@ sysret_t adxl372_init(const adxl372_cfg_t* cfg)
  * @return sysret_t - Error status if something goes wrong 
  */
 sysret_t adxl372_read_raw(adxl372_val_raw_t readings[ADXL372_AXES])
+{
+    return read_data(readings, true);
+}
+
+/**
+ * @brief Read the last acceleration output without waiting for new data
+ * 
+ * @param readings - Buffer to store data
+ * @return sysret_t - Error status if something goes wrong
+ */
+sysret_t adxl372_read_latest(adxl372_val_raw_t readings[ADXL372_AXES])
+{
+    return read_data(readings, false);
+}
+
+/**
+ * @brief Change mode of operation, e.g. to standby to save power
+ * 
+ * @param mode - Mode of operation
+ * @return sysret_t - Driver status
+ */
+sysret_t adxl372_set_mode(adxl372_mode_t mode)
 {
     sysret_t ret = RET_DRV_UNINIT;
 
     if(adxl372.state == ADXL372_STATE_ACTIVE)
     {
-        uint8_t buf[ADXL372_AXES*2U] = {0U};
-        uint8_t status = 0U;
+        if(mode == adxl372.mode)
+            return RET_OK;
 
-        /* wait for data ready */
-        do
-        {
-            if((ret = read_reg(ADXL372_STATUS_ADDR, &status, 1U)) != RET_OK)
-                return ret;
-        } while(!(status & ADXL372_STATUS_DATA_RDY_MASK));
+        ret = configure_mode(mode, adxl372.cfg->bandwidth == ADXL372_BW_DISABLE);
 
-        if((ret = read_reg(ADXL372_XDATA_H_ADDR, buf, ADXL372_AXES*2)) != RET_OK)
-            return ret;
+        if(ret == RET_OK)
+            adxl372.mode = mode;
+    }
 
-        for(size_t i = 0U ; i < ADXL372_AXES*2 ; i+=2U)
-        {
-            /* format data, since it was received in big-endian format (ARM is little endian) */
-            readings[i/2U] = (buf[i] << 8U) | (buf[i+1] & 0xF0U);
-            /* convert from 12-bit to 16-bit integer */
-            readings[i/2U] /= 16;
-            /* trim offset */
-            readings[i/2U] -= adxl372.offsets[i/2U];
-        }
+    return ret;
+}
 
-        ret = RET_OK;
+/**
+ * @brief Wait for an impact in instant-on mode, signalled on INT1
+ * 
+ * @param thresh - Impact threshold
+ * @return sysret_t - Driver status
+ */
+sysret_t adxl372_arm_impact(adxl372_instant_on_thresh_t thresh)
+{
+    sysret_t ret;
+    uint8_t tx;
+    uint8_t status[2U];
+
+    if(adxl372.state != ADXL372_STATE_ACTIVE)
+        return RET_DRV_UNINIT;
+
+    /* the threshold only takes effect on entering instant-on, go through standby */
+    ret = adxl372_set_mode(ADXL372_MODE_STANDBY);
+    SYSRET_CHECK(ret);
+
+    adxl372.instant_on_thresh = thresh;
+
+    /* keep the start of the impact, however late the host reads it */
+    if(!adxl372.peak_en)
+    {
+        ret = configure_fifo(ADXL372_FIFO_CTL_FORMAT_XYZ | ADXL372_FIFO_CTL_MODE_OLDEST,
+                             ADXL372_FIFO_ONSET_MAX * ADXL372_AXES);
+        SYSRET_CHECK(ret);
+
+        adxl372.onset_en = true;
     }
 
-    return ret;
+    /* an impact wakes the part up into full bandwidth measurement */
+    tx = ADXL372_INT1_MAP_AWAKE_MASK | ADXL372_INT1_MAP_ACT_MASK;
+    ret = write_reg(ADXL372_INT1_MAP_ADDR, &tx, 1U);
+    SYSRET_CHECK(ret);
+
+    /* clear anything latched before arming */
+    ret = read_reg(ADXL372_STATUS_ADDR, status, sizeof(status));
+    SYSRET_CHECK(ret);
+
+    return adxl372_set_mode(ADXL372_MODE_INSTANT_ON);
+}
+
+/**
+ * @brief Check for an impact since @ref adxl372_arm_impact(), clears INT1
+ * 
+ * @param impact - Set if an impact was detected, the part is then in
+ *                 full bandwidth measurement mode
+ * @return sysret_t - Driver status
+ */
+sysret_t adxl372_check_impact(bool* impact)
+{
+    sysret_t ret;
+    uint8_t status[2U] = {0U};
+
+    *impact = false;
+
+    if(adxl372.state != ADXL372_STATE_ACTIVE)
+        return RET_DRV_UNINIT;
+
+    /* STATUS and STATUS2 are contiguous, reading them clears INT1 */
+    ret = read_reg(ADXL372_STATUS_ADDR, status, sizeof(status));
+    SYSRET_CHECK(ret);
+
+    *impact = (status[0] & ADXL372_STATUS_AWAKE_MASK) ||
+              (status[1] & ADXL372_STATUS2_ACTIVITY_MASK);
+
+    if(*impact && adxl372.mode == ADXL372_MODE_INSTANT_ON)
+        adxl372.mode = ADXL372_MODE_FULLBAND;
+
+    return RET_OK;
+}
+
+/**
+ * @brief Stop signalling impacts on INT1
+ * 
+ * @return sysret_t - Driver status
+ */
+sysret_t adxl372_disarm_impact(void)
+{
+    uint8_t tx = 0U;
+
+    if(adxl372.state != ADXL372_STATE_ACTIVE)
+        return RET_DRV_UNINIT;
+
+    return write_reg(ADXL372_INT1_MAP_ADDR, &tx, 1U);
+}
+
+/**
+ * @brief Read the readings kept in the FIFO since the part woke up on an
+ *        impact, oldest first, calibrated like readings from
+ *        @ref adxl372_read_raw()
+ *
+ * @param readings - Buffer to store readings
+ * @param max      - Max number of readings to read
+ * @param count    - Number of readings read
+ * @return sysret_t - Driver status
+ */
+sysret_t adxl372_onset_read(adxl372_val_raw_t readings[][ADXL372_AXES], size_t max, size_t* count)
+{
+    *count = 0U;
+
+    if(adxl372.state != ADXL372_STATE_ACTIVE)
+        return RET_DRV_UNINIT;
+    else if(!adxl372.onset_en)
+        return NRF_ERROR_INVALID_STATE;
+
+    return fifo_read(readings, max, count);
+}
+
+/**
+ * @brief Stop keeping impact readings, the FIFO is bypassed again
+ *
+ * @return sysret_t - Driver status
+ */
+sysret_t adxl372_onset_stop(void)
+{
+    sysret_t ret;
+    adxl372_mode_t mode = adxl372.mode;
+
+    if(adxl372.state != ADXL372_STATE_ACTIVE)
+        return RET_DRV_UNINIT;
+    else if(!adxl372.onset_en)
+        return RET_OK;
+
+    ret = adxl372_set_mode(ADXL372_MODE_STANDBY);
+    SYSRET_CHECK(ret);
+
+    ret = configure_fifo(0U, 0U);
+    SYSRET_CHECK(ret);
+
+    adxl372.onset_en = false;
+
+    return adxl372_set_mode(mode);
+}
+
+/**
+ * @brief Store only the peak acceleration of each impact in the FIFO
+ *
+ * @param cfg - Activity detection configuration
+ * @return sysret_t - Driver status
+ */
+sysret_t adxl372_peak_start(const adxl372_peak_cfg_t* cfg)
+{
+    sysret_t ret;
+    adxl372_mode_t mode = adxl372.mode;
+    uint8_t tx[2U];
+
+    if(adxl372.state != ADXL372_STATE_ACTIVE)
+        return RET_DRV_UNINIT;
+
+    /* detection and FIFO settings are only taken in standby */
+    ret = adxl372_set_mode(ADXL372_MODE_STANDBY);
+    SYSRET_CHECK(ret);
+
+    ret = configure_thresh(ADXL372_THRESH_ACT_X_H_ADDR, cfg->act_thresh, true);
+    SYSRET_CHECK(ret);
+
+    ret = write_reg(ADXL372_TIME_ACT_ADDR, (void*)&cfg->act_time, 1U);
+    SYSRET_CHECK(ret);
+
+    ret = configure_thresh(ADXL372_THRESH_INACT_X_H_ADDR, cfg->inact_thresh, true);
+    SYSRET_CHECK(ret);
+
+    tx[0] = (uint8_t)(cfg->inact_time >> 8U);
+    tx[1] = (uint8_t)cfg->inact_time;
+    ret = write_reg(ADXL372_TIME_INACT_H_ADDR, tx, 2U);
+    SYSRET_CHECK(ret);
+
+    /* an impact ends with inactivity, which re-arms activity detection */
+    ret = configure_bandwidth(adxl372.cfg->bandwidth, true);
+    SYSRET_CHECK(ret);
+
+    /* watermark isn't used, peaks are polled */
+    ret = configure_fifo(ADXL372_FIFO_CTL_FORMAT_PEAK | ADXL372_FIFO_CTL_MODE_STREAM, ADXL372_AXES);
+    SYSRET_CHECK(ret);
+
+    adxl372.peak_en = true;
+    adxl372.onset_en = false;
+    adxl372.status = 0U;
+
+    return adxl372_set_mode((mode == ADXL372_MODE_STANDBY) ? ADXL372_MODE_FULLBAND : mode);
+}
+
+/**
+ * @brief Read impact peaks out of the FIFO, calibrated like readings
+ *        from @ref adxl372_read_raw()
+ *
+ * @param peaks - Buffer to store peaks, one per impact
+ * @param max   - Max number of peaks to read
+ * @param count - Number of peaks read
+ * @return sysret_t - Driver status
+ */
+sysret_t adxl372_peak_read(adxl372_val_raw_t peaks[][ADXL372_AXES], size_t max, size_t* count)
+{
+    *count = 0U;
+
+    if(adxl372.state != ADXL372_STATE_ACTIVE)
+        return RET_DRV_UNINIT;
+    else if(!adxl372.peak_en)
+        return NRF_ERROR_INVALID_STATE;
+
+    return fifo_read(peaks, max, count);
+}
+
+/**
+ * @brief Stop peak detection, the FIFO is bypassed again
+ *
+ * @return sysret_t - Driver status
+ */
+sysret_t adxl372_peak_stop(void)
+{
+    sysret_t ret;
+    adxl372_mode_t mode = adxl372.mode;
+    uint8_t tx = 0U;
+
+    if(adxl372.state != ADXL372_STATE_ACTIVE)
+        return RET_DRV_UNINIT;
+    else if(!adxl372.peak_en)
+        return RET_OK;
+
+    ret = adxl372_set_mode(ADXL372_MODE_STANDBY);
+    SYSRET_CHECK(ret);
+
+    ret = write_reg(ADXL372_FIFO_CTL_ADDR, &tx, 1U);
+    SYSRET_CHECK(ret);
+
+    ret = configure_thresh(ADXL372_THRESH_ACT_X_H_ADDR, 0U, false);
+    SYSRET_CHECK(ret);
+
+    ret = configure_thresh(ADXL372_THRESH_INACT_X_H_ADDR, 0U, false);
+    SYSRET_CHECK(ret);
+
+    ret = configure_bandwidth(adxl372.cfg->bandwidth, false);
+    SYSRET_CHECK(ret);
+
+    adxl372.peak_en = false;
+    adxl372.status = 0U;
+
+    return adxl372_set_mode(mode);
+}
+
+/**
+ * @brief Whether an impact was in progress at the last reading from
+ *        @ref adxl372_read_raw(), needs peak detection to be running
+ *
+ * @return true if the part was awake, between activity and inactivity
+ */
+bool adxl372_awake(void)
+{
+    return adxl372.peak_en && (adxl372.status & ADXL372_STATUS_AWAKE_MASK);
 }
 
 /**
@@ -293,7 +702,7 @@ sysret_t adxl372_calibrate(adxl372_val_raw_t setpoint[ADXL372_AXES])
 
     if(adxl372.state == ADXL372_STATE_ACTIVE)
     {
-        adxl372_val_raw_t axes[ADXL372_AXES] = {0};
+        int32_t axes[ADXL372_AXES] = {0};
 
         /* get datapoints */
         for(size_t i = 0 ; i < NUM_CAL_AVG_N ; i++)
@@ -309,16 +718,56 @@ sysret_t adxl372_calibrate(adxl372_val_raw_t setpoint[ADXL372_AXES])
             axes[ADXL372_Z] += vals[ADXL372_Z];
         }
 
-        /* get average, write offset to register */
+        /* get average, correct residual offset, keep the bias within what the
+           conversion kernels can apply */
         for(size_t i = 0 ; i < ADXL372_AXES ; i++)
         {
-            axes[i] /= NUM_CAL_AVG_N;
+            int32_t bias = adxl372.cal.bias[i] + axes[i] / (int32_t)NUM_CAL_AVG_N - setpoint[i];
+
+            if(bias > SENSORCONV_ADXL372_BIAS_LIMIT)
+                bias = SENSORCONV_ADXL372_BIAS_LIMIT;
+            else if(bias < -SENSORCONV_ADXL372_BIAS_LIMIT)
+                bias = -SENSORCONV_ADXL372_BIAS_LIMIT;
 
-            adxl372.offsets[i] = axes[i] - setpoint[i];
+            adxl372.cal.bias[i] = (int16_t)bias;
         }
 
         ret = RET_OK;
     }
 
     return ret;
-}
\ No newline at end of file
+}
+
+/**
+ * @brief Set calibration applied to every reading
+ *
+ * @param cal - Calibration, if NULL the calibration is cleared
+ * @return sysret_t - Driver status
+ */
+sysret_t adxl372_set_calibration(const sensorconv_cal_t* cal)
+{
+    sensorconv_cal_t identity;
+    sensorconv_cal_identity(&identity);
+
+    if(cal == NULL)
+        cal = &identity;
+    else if(!sensorconv_adxl372_cal_valid(cal))
+        return NRF_ERROR_INVALID_PARAM;
+
+    adxl372.cal = *cal;
+
+    /* skip the matrix multiply entirely if it wouldn't do anything */
+    adxl372.cal_matrix_en = memcmp(adxl372.cal.q, identity.q, sizeof(identity.q)) != 0;
+
+    return RET_OK;
+}
+
+/**
+ * @brief Get calibration currently applied to readings
+ *
+ * @param cal - Calibration will be saved here
+ */
+void adxl372_get_calibration(sensorconv_cal_t* cal)
+{
+    *cal = adxl372.cal;
+}
@@ -7,9 +7,11 @@
 #ifndef ADXL372_H
 #define ADXL372_H
 
+#include <stdbool.h>
 #include "nrf.h"
 #include "retcodes.h"
 #include "arm_math.h"
+#include "sensorconv.h"
 
 /**
  * @brief Configurable operational data rates of ADXL372
@@ -48,6 +50,15 @@ typedef enum
     ADXL372_MODE_FULLBAND     /*!< Full bandwidth measurement mode */
 } adxl372_mode_t;
 
+/**
+ * @brief Impact thresholds of instant-on mode, the part only has two
+ */
+typedef enum
+{
+    ADXL372_INSTANT_ON_THRESH_LOW = 0, /*!< Impacts over ~10-15 g */
+    ADXL372_INSTANT_ON_THRESH_HIGH     /*!< Impacts over ~30-40 g */
+} adxl372_instant_on_thresh_t;
+
 /**
  * @brief ADXL372 Driver error definitions
  */
@@ -74,6 +85,31 @@ typedef enum
  */
 typedef int16_t adxl372_val_raw_t;
 
+/**
+ * @brief Activity detection of peak-detect FIFO mode, an impact starts
+ *        when any axis goes over the activity threshold for act_time and
+ *        ends when every axis stays under the inactivity threshold for
+ *        inact_time
+ */
+typedef struct
+{
+    uint16_t act_thresh;   /*!< Activity threshold, 100 mg/LSB, 11 bits */
+    uint8_t  act_time;     /*!< Activity time, 3.3 ms/LSB at 6400 Hz ODR, 6.6 ms/LSB below */
+    uint16_t inact_thresh; /*!< Inactivity threshold, 100 mg/LSB, 11 bits */
+    uint16_t inact_time;   /*!< Inactivity time, 13 ms/LSB at 6400 Hz ODR, 26 ms/LSB below */
+} adxl372_peak_cfg_t;
+
+/**
+ * @brief Max number of impact peaks the FIFO holds
+ */
+#define ADXL372_FIFO_PEAKS_MAX (512U / ADXL372_AXES)
+
+/**
+ * @brief Max number of readings kept in the FIFO from the wake on an
+ *        impact, ~26 ms at 6400 Hz ODR
+ */
+#define ADXL372_FIFO_ONSET_MAX (512U / ADXL372_AXES)
+
 /**
  * @brief Configurations for ADXL372 Driver
  */
@@ -103,9 +139,121 @@ sysret_t adxl372_init(const adxl372_cfg_t* cfg);
  * 
  * @param readings - Buffer to store data
  * @return adxl372_err_t - Error status if something goes wrong 
+ * @retval NRF_ERROR_INVALID_STATE if in standby, see @ref adxl372_set_mode()
  */
 sysret_t adxl372_read_raw(adxl372_val_raw_t readings[ADXL372_AXES]);
 
+/**
+ * @brief Read the last acceleration output without waiting for new data,
+ *        calibrated like @ref adxl372_read_raw()
+ * 
+ * Safe to call from an interrupt, as long as SPI transfers started
+ * elsewhere hold it off, see @ref spi_set_guard_irq().
+ * 
+ * @param readings - Buffer to store data
+ * @return sysret_t - Error status if something goes wrong
+ * @retval NRF_ERROR_INVALID_STATE if in standby, see @ref adxl372_set_mode()
+ */
+sysret_t adxl372_read_latest(adxl372_val_raw_t readings[ADXL372_AXES]);
+
+/**
+ * @brief Change mode of operation, e.g. to standby to save power
+ * 
+ * @param mode - Mode of operation
+ * @return sysret_t - Driver status
+ */
+sysret_t adxl372_set_mode(adxl372_mode_t mode);
+
+/**
+ * @brief Wait for an impact in instant-on mode, signalled on INT1
+ *
+ * The part draws ~1.4 uA until the threshold is crossed, it then switches
+ * to full bandwidth measurement by itself. The first
+ * @ref ADXL372_FIFO_ONSET_MAX readings after it wakes are kept in the FIFO,
+ * so the start of the impact can be read with @ref adxl372_onset_read()
+ * however late the host gets to it.
+ * 
+ * @param thresh - Impact threshold
+ * @return sysret_t - Driver status
+ */
+sysret_t adxl372_arm_impact(adxl372_instant_on_thresh_t thresh);
+
+/**
+ * @brief Check for an impact since @ref adxl372_arm_impact(), clears INT1
+ * 
+ * @param impact - Set if an impact was detected, the part is then in
+ *                 full bandwidth measurement mode
+ * @return sysret_t - Driver status
+ */
+sysret_t adxl372_check_impact(bool* impact);
+
+/**
+ * @brief Stop signalling impacts on INT1, readings from the impact stay in
+ *        the FIFO until @ref adxl372_onset_stop()
+ * 
+ * @return sysret_t - Driver status
+ */
+sysret_t adxl372_disarm_impact(void);
+
+/**
+ * @brief Read the readings kept in the FIFO since the part woke up on an
+ *        impact, oldest first, calibrated like readings from
+ *        @ref adxl372_read_raw()
+ *
+ * @param readings - Buffer to store readings
+ * @param max      - Max number of readings to read
+ * @param count    - Number of readings read
+ * @return sysret_t - Driver status
+ * @retval NRF_ERROR_INVALID_STATE if not armed since the last
+ *         @ref adxl372_onset_stop()
+ */
+sysret_t adxl372_onset_read(adxl372_val_raw_t readings[][ADXL372_AXES], size_t max, size_t* count);
+
+/**
+ * @brief Stop keeping impact readings, the FIFO is bypassed again
+ *
+ * @return sysret_t - Driver status
+ */
+sysret_t adxl372_onset_stop(void);
+
+/**
+ * @brief Store only the peak acceleration of each impact in the FIFO
+ *
+ * Activity detection runs looped, so impacts keep being recorded without
+ * the host acknowledging them. Only works in full bandwidth measurement.
+ *
+ * @param cfg - Activity detection configuration
+ * @return sysret_t - Driver status
+ */
+sysret_t adxl372_peak_start(const adxl372_peak_cfg_t* cfg);
+
+/**
+ * @brief Read impact peaks out of the FIFO, calibrated like readings
+ *        from @ref adxl372_read_raw()
+ *
+ * @param peaks - Buffer to store peaks, one per impact
+ * @param max   - Max number of peaks to read
+ * @param count - Number of peaks read
+ * @return sysret_t - Driver status
+ */
+sysret_t adxl372_peak_read(adxl372_val_raw_t peaks[][ADXL372_AXES], size_t max, size_t* count);
+
+/**
+ * @brief Stop peak detection, the FIFO is bypassed again
+ *
+ * @return sysret_t - Driver status
+ */
+sysret_t adxl372_peak_stop(void);
+
+/**
+ * @brief Whether an impact was in progress at the last reading from
+ *        @ref adxl372_read_raw() or @ref adxl372_read_latest(), needs
+ *        peak detection to be running
+ *
+ * @return true if the part was awake, between activity and inactivity
+ */
+bool adxl372_awake(void);
+
 /**
  * @brief Get status of ADXL372 driver
  * 
@@ -124,6 +272,25 @@ sysret_t adxl372_test(void);
  */
 sysret_t adxl372_calibrate(adxl372_val_raw_t setpoint[ADXL372_AXES]);
 
+/**
+ * @brief Set calibration applied to every reading
+ *
+ * Readings returned by @ref adxl372_read_raw() are corrected with
+ * Q * (x - bias), see @ref sensorconv_cal_t
+ *
+ * @param cal - Calibration, if NULL the calibration is cleared
+ * @return sysret_t - Driver status
+ * @retval NRF_ERROR_INVALID_PARAM if the calibration matrix is out of range
+ */
+sysret_t adxl372_set_calibration(const sensorconv_cal_t* cal);
+
+/**
+ * @brief Get calibration currently applied to readings
+ *
+ * @param cal - Calibration will be saved here
+ */
+void adxl372_get_calibration(sensorconv_cal_t* cal);
+
 #ifdef __cplusplus
 }
 #endif
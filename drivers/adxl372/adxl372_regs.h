@@ -18,6 +18,13 @@
 
 #define ADXL372_STATUS_ADDR            0x04U /*!< Address of Status register [READ-ONLY] */
 #define ADXL372_STATUS_DATA_RDY_MASK   0x01U /*!< Mask for DATA RDY bit in Status register */
+#define ADXL372_STATUS_AWAKE_MASK      0x40U /*!< Mask for AWAKE bit in Status register */
+
+#define ADXL372_STATUS2_ADDR           0x05U /*!< Address of Status2 register, follows Status [READ-ONLY] */
+#define ADXL372_STATUS2_ACTIVITY_MASK  0x20U /*!< Mask for ACTIVITY bit in Status2 register */
+
+#define ADXL372_FIFO_ENTRIES2_ADDR     0x06U /*!< Address of FIFO entries MSBs register, followed by the LSBs [READ-ONLY] */
+#define ADXL372_FIFO_ENTRIES2_MASK     0x03U /*!< Mask for FIFO entries MSBs */
 
 #define ADXL372_XDATA_H_ADDR           0x08U /*!< Address of X Data H Register [READ-ONLY] */
 #define ADXL372_XDATA_L_ADDR           0x09U /*!< Address of X Data L Register [READ-ONLY] */
@@ -26,13 +33,35 @@
 #define ADXL372_ZDATA_H_ADDR           0x0CU /*!< Address of Z Data H Register [READ-ONLY] */
 #define ADXL372_ZDATA_L_ADDR           0x0DU /*!< Address of Z Data L Register [READ-ONLY] */
 
+#define ADXL372_THRESH_ACT_X_H_ADDR    0x23U /*!< Address of first activity threshold register, X/Y/Z H and L pairs follow [READ/WRITE] */
+#define ADXL372_TIME_ACT_ADDR          0x29U /*!< Address of activity timer register [READ/WRITE] */
+#define ADXL372_THRESH_INACT_X_H_ADDR  0x2AU /*!< Address of first inactivity threshold register, X/Y/Z H and L pairs follow [READ/WRITE] */
+#define ADXL372_TIME_INACT_H_ADDR      0x30U /*!< Address of inactivity timer MSB register, followed by the LSB [READ/WRITE] */
+#define ADXL372_THRESH_MAX             0x7FFU /*!< Thresholds are 11 bits */
+#define ADXL372_THRESH_L_SHIFT         5U    /*!< Threshold bits [2:0] sit in bits [7:5] of the L register */
+#define ADXL372_THRESH_L_EN_MASK       0x01U /*!< Mask for the per-axis enable bit in threshold L registers */
+
+#define ADXL372_FIFO_SAMPLES_ADDR      0x39U /*!< Address of FIFO watermark LSBs register [READ/WRITE] */
+#define ADXL372_FIFO_CTL_ADDR          0x3AU /*!< Address of FIFO control register [READ/WRITE] */
+#define ADXL372_FIFO_CTL_FORMAT_PEAK   0x38U /*!< FIFO_FORMAT bits for XYZ peak acceleration */
+#define ADXL372_FIFO_CTL_FORMAT_XYZ    0x00U /*!< FIFO_FORMAT bits for XYZ acceleration */
+#define ADXL372_FIFO_CTL_MODE_STREAM   0x02U /*!< FIFO_MODE bits for stream mode */
+#define ADXL372_FIFO_CTL_MODE_OLDEST   0x06U /*!< FIFO_MODE bits for oldest saved mode, stops once full */
+#define ADXL372_FIFO_CTL_SAMPLES_MASK  0x01U /*!< Mask for FIFO watermark MSB in FIFO control register */
+
+#define ADXL372_INT1_MAP_ADDR          0x3BU /*!< Address of INT1 function map register [READ/WRITE] */
+#define ADXL372_INT1_MAP_ACT_MASK      0x20U /*!< Mask for ACT_INT1 bit in INT1 map register */
+#define ADXL372_INT1_MAP_AWAKE_MASK    0x40U /*!< Mask for AWAKE_INT1 bit in INT1 map register */
+
 #define ADXL372_TIMING_ADDR            0x3DU /*!< Address of Timing Register [R/W] */
 #define ADXL372_TIMING_ODR_MASK        0xE0U /*!< Mask for ODR bits in Timing register */
 
 #define ADXL372_MEASURE_ADDR           0x3EU /*!< Address of Measure register [READ?WROTE] */
 #define ADXL372_BANDWIDTH_MASK         0x07U /*!< Bandwidth mask in Measure register */
+#define ADXL372_MEASURE_LOOPED_MASK    0x20U /*!< LINKLOOP bits for looped activity/inactivity detection */
 
 #define ADXL372_POWER_CTL_ADDR         0x3FU /*!< Address of Power Control Register [READ/WRITE] */
+#define ADXL372_POWER_CTL_INSTANT_ON_THRESH_MASK 0x20U /*!< Mask for INSTANT_ON_THRESH bit in Power Control Register */
 #define ADXL372_POWER_CTL_LPF_MASK     0x08U /*!< Mask for LPF_DISABLE bit in Power Control Register */
 #define ADXL372_POWER_CTL_HPF_MASK     0x04U /*!< Mask for HPF_DISABLE bit in Power Control Register */
 #define ADXL372_POWER_CTL_MODE_MASK    0x03U /*!< Mask for MODE bits in Power Control Register */
@@ -40,4 +69,6 @@
 #define ADXL372_RESET_ADDR             0x41U /*!< Address to Reset register to reset the device [READ/WRITE] */
 #define ADXL372_RESET_VAL              0x52U /*!< Value to write to Reset register */
 
+#define ADXL372_FIFO_DATA_ADDR         0x42U /*!< Address of FIFO data register, doesn't auto-increment [READ-ONLY] */
+
 #endif /* ADXL372_REG_H */
\ No newline at end of file
@@ -9,41 +9,91 @@
 #include "custom_board.h"
 #include "nrf_drv_twi.h"
 
+/**
+ * @brief Transaction manager, owns the TWI instance
+ */
+NRF_TWI_MNGR_DEF(i2c_mngr, I2C_QUEUE_SIZE, I2C1_PERIPH);
+
 /**
  * @brief I2C configurations
  */
-static const nrf_drv_twi_t i2c_handler = NRF_DRV_TWI_INSTANCE(I2C1_PERIPH);
 static nrf_drv_twi_config_t i2c_conf = NRF_DRV_TWI_DEFAULT_CONFIG;
 
+/******************************
+ * Helper functions
+ ******************************/
+
+/**
+ * @notapi
+ * @brief Fill in the transfers of a transmit followed by a receive
+ *
+ * @param transfers - Room for two transfers
+ * @return uint8_t Number of transfers filled in
+ */
+static uint8_t build_access(nrf_twi_mngr_transfer_t* transfers, i2c_addr_t slave_addr, uint8_t* txbuf, size_t txn, uint8_t* rxbuf, size_t rxn)
+{
+    uint8_t n = 0U;
+    bool repeated_start = rxbuf && (rxn > 0); /* set repeated start condition on transmit if read requested */
+
+    if(txbuf && (txn > 0))
+    {
+        transfers[n++] = (nrf_twi_mngr_transfer_t)NRF_TWI_MNGR_WRITE(
+            slave_addr,
+            txbuf,
+            (uint8_t)txn,
+            repeated_start ? NRF_TWI_MNGR_NO_STOP : 0U);
+    }
+
+    if(repeated_start)
+    {
+        transfers[n++] = (nrf_twi_mngr_transfer_t)NRF_TWI_MNGR_READ(
+            slave_addr,
+            rxbuf,
+            (uint8_t)rxn,
+            0U);
+    }
+
+    return n;
+}
+
+/**
+ * @notapi
+ * @brief Background transaction done, runs in the TWI interrupt
+ */
+static void xfer_done(ret_code_t result, void* p_user_data)
+{
+    i2c_xfer_t* xfer = (i2c_xfer_t*)p_user_data;
+
+    xfer->busy = false;
+
+    if(xfer->callback)
+        xfer->callback((result == NRF_SUCCESS) ? RET_OK : RET_SERIAL_ERR, xfer->p_ctx);
+}
+
+/******************************
+ * API
+ ******************************/
+
 /**
  * @brief Initialize I2C driver
- * 
+ *
  * @return sysret_t Driver status, RET_OK if all's well
  */
 sysret_t i2c_init(void)
 {
-    sysret_t ret = RET_ERR;
-
     i2c_conf.frequency = NRF_DRV_TWI_FREQ_400K;
     i2c_conf.scl = I2C1_SCL;
     i2c_conf.sda = I2C1_SDA;
 
-    ret = nrf_drv_twi_init(&i2c_handler, &i2c_conf, NULL, NULL);
-    if(ret != RET_OK)
-        return ret;
-
-    nrf_drv_twi_enable(&i2c_handler);
-    if(ret != RET_OK)
-        return ret;
-
-    return ret;
+    return nrf_twi_mngr_init(&i2c_mngr, &i2c_conf);
 }
 
 /**
  * @brief Perform an I2C transfer, transmit followed by a receive
- * 
+ *
  * If txn is > 0, a transmit occurs. If rxn is > 0, a receive occurs.
- * 
+ * Waits for background transactions scheduled before it.
+ *
  * @param slave_addr - slave device address
  * @param txbuf      - transmit buffer
  * @param txn        - number of bytes to transmit
@@ -53,38 +103,95 @@ sysret_t i2c_init(void)
  */
 sysret_t i2c_transceive(i2c_addr_t slave_addr, uint8_t* txbuf, size_t txn, uint8_t* rxbuf, size_t rxn)
 {
-    sysret_t ret = RET_ERR;
-    bool repeated_start = rxbuf && (rxn > 0); /* set repeated start condition on transmit if read requested */
+    nrf_twi_mngr_transfer_t transfers[2U];
+    uint8_t n = build_access(transfers, slave_addr, txbuf, txn, rxbuf, rxn);
 
-    /**
-     * attempt transmit
-     **/
-    if(txbuf && (txn > 0))
-    {
-        ret = nrf_drv_twi_tx(
-            &i2c_handler,
-            slave_addr,
-            (uint8_t const*)txbuf,
-            (uint8_t)txn,
-            repeated_start);
+    if(n == 0U)
+        return RET_OK;
 
-        if(ret != RET_OK)
-            return ret;
-    }
+    return nrf_twi_mngr_perform(&i2c_mngr, NULL, transfers, n, NULL);
+}
 
-    /**
-     * attempt receive
-     **/
-    if(rxbuf && (rxn > 0))
-    {
-        ret = nrf_drv_twi_rx(&i2c_handler,
-            slave_addr,
-            (uint8_t*)rxbuf,
-            (uint8_t)rxn);
+/**
+ * @brief Clear a background transaction and set its completion callback
+ *
+ * @param xfer     - Transaction
+ * @param callback - Completion callback
+ * @param p_ctx    - Passed to the callback
+ */
+void i2c_xfer_init(i2c_xfer_t* xfer, i2c_callback_t callback, void* p_ctx)
+{
+    xfer->transaction.callback = xfer_done;
+    xfer->transaction.p_user_data = xfer;
+    xfer->transaction.p_transfers = xfer->transfers;
+    xfer->transaction.number_of_transfers = 0U;
+    xfer->transaction.p_required_twi_cfg = NULL;
+    xfer->callback = callback;
+    xfer->p_ctx = p_ctx;
+    xfer->busy = false;
+}
 
-        if(ret != RET_OK)
-            return ret;
-    }
+/**
+ * @brief Add a transmit followed by a receive to a background transaction
+ *
+ * Same as @ref i2c_transceive(), the buffers must stay alive until the
+ * callback runs.
+ *
+ * @param xfer       - Transaction
+ * @param slave_addr - slave device address
+ * @param txbuf      - transmit buffer
+ * @param txn        - number of bytes to transmit
+ * @param rxbuf      - receive buffer
+ * @param rxn        - number of bytes to receive
+ * @return sysret_t Driver status, RET_ERR if the transaction is full
+ */
+sysret_t i2c_xfer_add(i2c_xfer_t* xfer, i2c_addr_t slave_addr, uint8_t* txbuf, size_t txn, uint8_t* rxbuf, size_t rxn)
+{
+    uint8_t n = xfer->transaction.number_of_transfers;
+
+    if(xfer->busy || n > (I2C_XFER_MAX_ACCESSES - 1U) * 2U)
+        return RET_ERR;
+
+    n += build_access(&xfer->transfers[n], slave_addr, txbuf, txn, rxbuf, rxn);
+    xfer->transaction.number_of_transfers = n;
 
     return RET_OK;
-}
\ No newline at end of file
+}
+
+/**
+ * @brief Start a background transaction once the bus is free, returns
+ *        right away
+ *
+ * @param xfer - Transaction
+ * @return sysret_t Driver status, NRF_ERROR_BUSY if the transaction is
+ *         still running, NRF_ERROR_NO_MEM if the queue is full
+ */
+sysret_t i2c_schedule(i2c_xfer_t* xfer)
+{
+    sysret_t ret;
+
+    if(xfer->busy)
+        return NRF_ERROR_BUSY;
+
+    if(xfer->transaction.number_of_transfers == 0U)
+        return RET_ERR;
+
+    xfer->busy = true;
+
+    ret = nrf_twi_mngr_schedule(&i2c_mngr, &xfer->transaction);
+
+    if(ret != RET_OK)
+        xfer->busy = false;
+
+    return ret;
+}
+
+/**
+ * @brief Check if the bus is free
+ *
+ * @return true if no transaction is running or waiting
+ */
+bool i2c_idle(void)
+{
+    return nrf_twi_mngr_is_idle(&i2c_mngr);
+}
@@ -2,6 +2,11 @@
  * @file i2c.h
  * @author UBC Capstone Team 2020/2021
  * @brief I2C driver
+ *
+ * Transactions go through the nRF SDK TWI transaction manager, so
+ * blocking transfers and background ones share the bus in the order they
+ * were started. Background transactions run from the TWI interrupt and
+ * end with a callback, the main loop keeps going in the meantime.
  */
 
 #ifndef I2C_H
@@ -9,29 +14,65 @@
 
 #include <stdint.h>
 #include <stddef.h>
+#include <stdbool.h>
 #include "retcodes.h"
+#include "nrf_twi_mngr.h"
+
+/**
+ * @brief Max number of background transactions waiting for the bus,
+ *        not counting the one running
+ */
+#define I2C_QUEUE_SIZE 4U
+
+/**
+ * @brief Max number of register accesses, see @ref i2c_xfer_add(), in
+ *        one background transaction
+ */
+#define I2C_XFER_MAX_ACCESSES 2U
 
 /**
  * @brief Slave address definition
  */
 typedef uint8_t i2c_addr_t;
 
+/**
+ * @brief Background transaction completion callback, runs in the TWI
+ *        interrupt so it should only save results and post work
+ *
+ * @param result - RET_OK if every transfer went through
+ * @param p_ctx  - Context given to @ref i2c_xfer_init()
+ */
+typedef void (*i2c_callback_t)(sysret_t result, void* p_ctx);
+
+/**
+ * @brief Background transaction, must stay alive until its callback runs
+ */
+typedef struct
+{
+    nrf_twi_mngr_transfer_t    transfers[I2C_XFER_MAX_ACCESSES * 2U]; /*!< Transmit and receive of every access */
+    nrf_twi_mngr_transaction_t transaction;                           /*!< Transaction manager descriptor */
+    i2c_callback_t             callback;                              /*!< Completion callback */
+    void*                      p_ctx;                                 /*!< Completion callback context */
+    volatile bool              busy;                                  /*!< Scheduled and not done yet */
+} i2c_xfer_t;
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
 /**
  * @brief Initialize I2C driver
- * 
+ *
  * @return sysret_t Driver status, RET_OK if all's well
  */
 sysret_t i2c_init(void);
 
 /**
  * @brief Perform an I2C transfer, transmit followed by a receive
- * 
+ *
  * If txn is > 0, a transmit occurs. If rxn is > 0, a receive occurs.
- * 
+ * Waits for background transactions scheduled before it.
+ *
  * @param slave_addr - slave device address
  * @param txbuf      - transmit buffer
  * @param txn        - number of bytes to transmit
@@ -41,8 +82,50 @@ sysret_t i2c_init(void);
  */
 sysret_t i2c_transceive(i2c_addr_t slave_addr, uint8_t* txbuf, size_t txn, uint8_t* rxbuf, size_t rxn);
 
+/**
+ * @brief Clear a background transaction and set its completion callback
+ *
+ * @param xfer     - Transaction
+ * @param callback - Completion callback
+ * @param p_ctx    - Passed to the callback
+ */
+void i2c_xfer_init(i2c_xfer_t* xfer, i2c_callback_t callback, void* p_ctx);
+
+/**
+ * @brief Add a transmit followed by a receive to a background transaction
+ *
+ * Same as @ref i2c_transceive(), the buffers must stay alive until the
+ * callback runs.
+ *
+ * @param xfer       - Transaction
+ * @param slave_addr - slave device address
+ * @param txbuf      - transmit buffer
+ * @param txn        - number of bytes to transmit
+ * @param rxbuf      - receive buffer
+ * @param rxn        - number of bytes to receive
+ * @return sysret_t Driver status, RET_ERR if the transaction is full
+ */
+sysret_t i2c_xfer_add(i2c_xfer_t* xfer, i2c_addr_t slave_addr, uint8_t* txbuf, size_t txn, uint8_t* rxbuf, size_t rxn);
+
+/**
+ * @brief Start a background transaction once the bus is free, returns
+ *        right away
+ *
+ * @param xfer - Transaction
+ * @return sysret_t Driver status, NRF_ERROR_BUSY if the transaction is
+ *         still running, NRF_ERROR_NO_MEM if the queue is full
+ */
+sysret_t i2c_schedule(i2c_xfer_t* xfer);
+
+/**
+ * @brief Check if the bus is free
+ *
+ * @return true if no transaction is running or waiting
+ */
+bool i2c_idle(void);
+
 #ifdef __cplusplus
 }
 #endif
 
-#endif /* I2C_H */
\ No newline at end of file
+#endif /* I2C_H */
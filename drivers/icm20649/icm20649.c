@@ -7,6 +7,7 @@
 #include <string.h>
 #include "icm20649.h"
 #include "icm20649_regs.h"
+#include "sensorconv.h"
 #include "spi.h"
 #include "app_timer.h"
 #include "nrf_assert.h"
@@ -32,7 +33,11 @@ typedef enum
 typedef struct
 {
     icm20649_cfg_t* cfg;
-    icm20649_states_t state; /*!< Driver state */
+    icm20649_states_t state;                       /*!< Driver state */
+    int16_t gyro_offsets[ICM20649_GYRO_AXES];      /*!< Gyroscope offsets in LSB */
+    sensorconv_cal_t accel_cal;                    /*!< Accelerometer calibration */
+    bool accel_cal_matrix_en;                      /*!< If false, only the calibration bias is applied */
+    icm20649_power_t power;                        /*!< Power mode */
 } icm20649_t;
 
 /**
@@ -40,9 +45,39 @@ typedef struct
  */
 static icm20649_t icm20649_handle = {
     NULL,
-    ICM20649_STATE_UNINIT
+    ICM20649_STATE_UNINIT,
+    {0},
+    {
+        .bias = {0},
+        .q    = { SENSORCONV_CAL_ONE, 0, 0, SENSORCONV_CAL_ONE, 0, SENSORCONV_CAL_ONE }
+    },
+    false,
+    ICM20649_POWER_ACTIVE
 };
 
+/**************************************
+ * Averaging configs for calibration
+ **************************************/
+
+#define NUM_CAL_AVG_N 128U /*!< When calibrating, this is the number of data points to read and average */
+
+/**
+ * @brief Accelerometer sensitivity at the lowest full scale (+/- 4g), in LSB/g.
+ *        Sensitivity halves with every step up in full scale.
+ */
+#define ICM20649_ACCEL_SENSITIVITY_4G 8192
+
+/**
+ * @brief Index of each sensor's frame when reading accelerometer
+ *        and gyroscope output registers in a single burst
+ */
+typedef enum
+{
+    ICM20649_FRAME_ACCEL = 0, /*!< ACCEL_XOUT_H..ACCEL_ZOUT_L */
+    ICM20649_FRAME_GYRO,      /*!< GYRO_XOUT_H..GYRO_ZOUT_L */
+    ICM20649_FRAMES
+} icm20649_frame_t;
+
 /**************************************
  * timer objects to detect
  * data ready timeout
@@ -107,24 +142,34 @@ static sysret_t write_reg(reg_addr_t reg_addr, void* tx, size_t txn)
     return spi_transfer(SPI_INSTANCE_0, SPI_DEV_ICM20649, buf, txn+1, NULL, 0);
 }
 
+/**
+ * @brief USER BANK selected, or being selected
+ */
+static volatile icm20649_usr_bank_t current_usr_bank = ICM20649_USR_BANK_MAX;
+
 /**
  * @notapi
  * @brief Select a USER BANK
  * 
+ * The bank is remembered before it's written, so that an interrupt
+ * reading the sensor in between puts back the right one, see
+ * @ref icm20649_read_latest().
+ * 
  * @param usr_bank - USER BANK to select
  */
 static sysret_t set_usr_bank(icm20649_usr_bank_t usr_bank)
 {
     sysret_t ret = RET_OK;
-    static icm20649_usr_bank_t current_usr_bank = ICM20649_USR_BANK_MAX;
 
     if(usr_bank != current_usr_bank)
     {
         uint8_t tx = (uint8_t)usr_bank;
+
+        current_usr_bank = usr_bank;
         ret = write_reg(ICM20649_REG_BANK_SEL_ADDR, &tx, 1U);
 
-        if(ret == RET_OK)
-            current_usr_bank = usr_bank;
+        if(ret != RET_OK)
+            current_usr_bank = ICM20649_USR_BANK_MAX;
     }
 
     return ret;
@@ -134,9 +179,10 @@ static sysret_t set_usr_bank(icm20649_usr_bank_t usr_bank)
  * @notapi
  * @brief Set accelerometer configurations
  * 
- * @param cfg - Config settings
+ * @param cfg    - Config settings
+ * @param cycled - if true, configure for duty-cycled mode
  */
-static sysret_t config_accel(icm20649_cfg_t* cfg)
+static sysret_t config_accel(icm20649_cfg_t* cfg, bool cycled)
 {
     sysret_t ret = RET_ERR;
     uint8_t tx = 0U;
@@ -146,18 +192,26 @@ static sysret_t config_accel(icm20649_cfg_t* cfg)
 
     /* TODO: handle DLPF configs */
 
-    /* set fullscale */
+    /* set fullscale, the sample rate divider only applies through the DLPF path */
     tx = ICM20649_ACCEL_FS_SEL_SET(cfg->accel_fs);
-    return write_reg(ICM20649_ACCEL_CONFIG_ADDR, &tx, 1U);
+    if(cycled)
+        tx |= ICM20649_ACCEL_FCHOICE_MASK;
+    ret = write_reg(ICM20649_ACCEL_CONFIG_ADDR, &tx, 1U);
+    SYSRET_CHECK(ret);
+
+    /* set sample rate divider */
+    tx = cycled ? ICM20649_DUTY_CYCLED_SMPLRT_DIV : 0U;
+    return write_reg(ICM20649_ACCEL_SMPLRT_DIV_2_ADDR, &tx, 1U);
 }
 
 /**
  * @notapi
  * @brief Set gyroscope configurations
  * 
- * @param cfg - Config settings
+ * @param cfg    - Config settings
+ * @param cycled - if true, configure for duty-cycled mode
  */
-static sysret_t config_gyro(icm20649_cfg_t* cfg)
+static sysret_t config_gyro(icm20649_cfg_t* cfg, bool cycled)
 {
     sysret_t ret = RET_ERR;
     uint8_t tx = 0U;
@@ -167,9 +221,16 @@ static sysret_t config_gyro(icm20649_cfg_t* cfg)
 
     /* TODO: handle DLPF configs */
 
-    /* set fullscale */
+    /* set fullscale, the sample rate divider only applies through the DLPF path */
     tx = ICM20649_GYRO_FS_SEL_SET(cfg->gyro_fs);
-    return write_reg(ICM20649_GYRO_CONFIG_1_ADDR, &tx, 1U);
+    if(cycled)
+        tx |= ICM20649_GYRO_FCHOICE_MASK;
+    ret = write_reg(ICM20649_GYRO_CONFIG_1_ADDR, &tx, 1U);
+    SYSRET_CHECK(ret);
+
+    /* set sample rate divider */
+    tx = cycled ? ICM20649_DUTY_CYCLED_SMPLRT_DIV : 0U;
+    return write_reg(ICM20649_GYRO_SMPLRT_DIV_ADDR, &tx, 1U);
 }
 
 /**
@@ -214,6 +275,38 @@ static sysret_t wait_data_rdy(void)
     return ret;
 }
 
+/**
+ * @notapi
+ * @brief Read accelerometer and gyroscope output, USER BANK 0 must be
+ *        selected
+ * 
+ * @param gyro  - Buffer to store raw gyroscope readings
+ * @param accel - Buffer to store raw accelerometer readings
+ * @return sysret_t - Driver status
+ */
+static sysret_t read_frames(int16_t gyro[ICM20649_GYRO_AXES], int16_t accel[ICM20649_ACCEL_AXES])
+{
+    sysret_t ret;
+
+    /* accel and gyro output regs are contiguous, read both in one burst */
+    int16_t frames[ICM20649_FRAMES][SENSORCONV_AXES] __attribute__((aligned(4)));
+    ret = read_reg(ICM20649_ACCEL_XOUT_H_ADDR, frames, sizeof(frames));
+    SYSRET_CHECK(ret);
+
+    /* switch byte order, trim offsets */
+    sensorconv_icm20649(frames[ICM20649_FRAME_ACCEL], 1U, icm20649_handle.accel_cal.bias);
+    sensorconv_icm20649(frames[ICM20649_FRAME_GYRO], 1U, icm20649_handle.gyro_offsets);
+
+    /* correct accelerometer scale and misalignment */
+    if(icm20649_handle.accel_cal_matrix_en)
+        sensorconv_calibrate(frames[ICM20649_FRAME_ACCEL], 1U, &icm20649_handle.accel_cal);
+
+    (void)memcpy(accel, frames[ICM20649_FRAME_ACCEL], sizeof(frames[ICM20649_FRAME_ACCEL]));
+    (void)memcpy(gyro, frames[ICM20649_FRAME_GYRO], sizeof(frames[ICM20649_FRAME_GYRO]));
+
+    return RET_OK;
+}
+
 /**
  * @notapi
  * @brief Check if WHOAMI register returns expected value
@@ -278,11 +371,11 @@ sysret_t icm20649_init(icm20649_cfg_t* cfg)
         SYSRET_CHECK(ret);
 
         /* configure accelerometer */
-        ret = config_accel(cfg);
+        ret = config_accel(cfg, false);
         SYSRET_CHECK(ret);
 
         /* configure gyroscope */
-        ret = config_gyro(cfg);
+        ret = config_gyro(cfg, false);
         SYSRET_CHECK(ret);
 
         /* configure timer to detect read timeout */
@@ -294,6 +387,7 @@ sysret_t icm20649_init(icm20649_cfg_t* cfg)
 
         /* update driver */
         icm20649_handle.state = ICM20649_STATE_RUNNING;
+        icm20649_handle.power = ICM20649_POWER_ACTIVE;
         ret = RET_OK;
     }
 
@@ -312,7 +406,13 @@ sysret_t icm20649_read_raw(int16_t gyro[ICM20649_GYRO_AXES], int16_t accel[ICM20
     ASSERT(gyro && accel);
     sysret_t ret = RET_ERR;
 
-    if(icm20649_handle.state == ICM20649_STATE_RUNNING)
+    if(icm20649_handle.state == ICM20649_STATE_RUNNING &&
+       icm20649_handle.power == ICM20649_POWER_SLEEP)
+    {
+        /* data ready never comes */
+        ret = NRF_ERROR_INVALID_STATE;
+    }
+    else if(icm20649_handle.state == ICM20649_STATE_RUNNING)
     {
         /* wait for data ready */
         ret = wait_data_rdy();
@@ -321,21 +421,7 @@ sysret_t icm20649_read_raw(int16_t gyro[ICM20649_GYRO_AXES], int16_t accel[ICM20
         /* set USR BANK to read from correct regs */
         set_usr_bank(ICM20649_USR_BANK_0);
 
-        /* read from sensor output regs */
-        ret = read_reg(ICM20649_GYRO_XOUT_H_ADDR, gyro, ICM20649_GYRO_AXES*2U);
-        SYSRET_CHECK(ret);
-
-        ret = read_reg(ICM20649_ACCEL_XOUT_H_ADDR, accel, ICM20649_ACCEL_AXES*2U);
-        SYSRET_CHECK(ret);
-
-        /* switch byte order */
-        for(size_t i = 0U ; i < ICM20649_GYRO_AXES ; i++)
-        {
-            gyro[i] = ((gyro[i] & 0x00FFU) << 8U) | ((gyro[i] & 0xFF00U) >> 8U);
-            accel[i] = ((accel[i] & 0x00FFU) << 8U) | ((accel[i] & 0xFF00U) >> 8U);
-        }
-
-        ret = RET_OK;
+        ret = read_frames(gyro, accel);
     }
     else
         ret = RET_DRV_UNINIT;
@@ -343,6 +429,39 @@ sysret_t icm20649_read_raw(int16_t gyro[ICM20649_GYRO_AXES], int16_t accel[ICM20
     return ret;
 }
 
+/**
+ * @brief Read the last gyroscope and accelerometer output without waiting
+ *        for new data
+ * 
+ * @param gyro  - Buffer to store raw gyroscope readings
+ * @param accel - Buffer to store raw accelerometer readings
+ * @return sysret_t - Driver status
+ * @retval NRF_ERROR_INVALID_STATE if asleep, see @ref icm20649_set_power()
+ */
+sysret_t icm20649_read_latest(int16_t gyro[ICM20649_GYRO_AXES], int16_t accel[ICM20649_ACCEL_AXES])
+{
+    ASSERT(gyro && accel);
+    sysret_t ret;
+    icm20649_usr_bank_t prev_usr_bank = current_usr_bank;
+
+    if(icm20649_handle.state != ICM20649_STATE_RUNNING)
+        return RET_DRV_UNINIT;
+
+    if(icm20649_handle.power == ICM20649_POWER_SLEEP)
+        return NRF_ERROR_INVALID_STATE;
+
+    ret = set_usr_bank(ICM20649_USR_BANK_0);
+    SYSRET_CHECK(ret);
+
+    ret = read_frames(gyro, accel);
+
+    /* the code this interrupted may be in the middle of using another bank */
+    if(prev_usr_bank < ICM20649_USR_BANK_MAX)
+        (void)set_usr_bank(prev_usr_bank);
+
+    return ret;
+}
+
 /**
  * @brief Test serial communication and initiate device self-test
  * 
@@ -363,4 +482,169 @@ sysret_t icm20649_test(void)
         ret = RET_OK;
 
     return ret;
+}
+
+/**
+ * @brief Calibrate gyroscope and accelerometer offsets
+ *
+ * @param accel_setpoint - Expected accelerometer values at every axis
+ *                         If NULL then default setpoint is used where device is assumed
+ *                         to be at rest with the Z-axis completely perpendicular to the
+ *                         X-Y plane [0, 0, 1g]
+ * @return sysret_t - Driver status
+ */
+sysret_t icm20649_calibrate(int16_t accel_setpoint[ICM20649_ACCEL_AXES])
+{
+    sysret_t ret = RET_DRV_UNINIT;
+
+    if(icm20649_handle.state == ICM20649_STATE_RUNNING)
+    {
+        int16_t default_setpoint[ICM20649_ACCEL_AXES] =
+        {
+            0, 0, ICM20649_ACCEL_SENSITIVITY_4G >> icm20649_handle.cfg->accel_fs
+        };
+        int32_t gyro_sum[ICM20649_GYRO_AXES] = {0};
+        int32_t accel_sum[ICM20649_ACCEL_AXES] = {0};
+
+        /* if NULL, set setpoint to default */
+        accel_setpoint = (accel_setpoint == NULL) ? default_setpoint : accel_setpoint;
+
+        /* get datapoints */
+        for(size_t i = 0U ; i < NUM_CAL_AVG_N ; i++)
+        {
+            int16_t gyro[ICM20649_GYRO_AXES];
+            int16_t accel[ICM20649_ACCEL_AXES];
+
+            ret = icm20649_read_raw(gyro, accel);
+            SYSRET_CHECK(ret);
+
+            for(size_t axis = 0U ; axis < ICM20649_GYRO_AXES ; axis++)
+            {
+                gyro_sum[axis]  += gyro[axis];
+                accel_sum[axis] += accel[axis];
+            }
+        }
+
+        /* get average, correct residual offsets, gyroscope should read 0 at rest */
+        for(size_t axis = 0U ; axis < ICM20649_GYRO_AXES ; axis++)
+        {
+            icm20649_handle.gyro_offsets[axis]   += (int16_t)(gyro_sum[axis] / (int32_t)NUM_CAL_AVG_N);
+            icm20649_handle.accel_cal.bias[axis]  += (int16_t)(accel_sum[axis] / (int32_t)NUM_CAL_AVG_N - accel_setpoint[axis]);
+        }
+
+        ret = RET_OK;
+    }
+
+    return ret;
+}
+
+/**
+ * @brief Set calibration applied to every accelerometer reading
+ *
+ * @param cal - Calibration, if NULL the calibration is cleared
+ * @return sysret_t - Driver status
+ */
+sysret_t icm20649_set_accel_calibration(const sensorconv_cal_t* cal)
+{
+    sensorconv_cal_t identity;
+    sensorconv_cal_identity(&identity);
+
+    if(cal == NULL)
+        cal = &identity;
+    else if(!sensorconv_cal_valid(cal))
+        return NRF_ERROR_INVALID_PARAM;
+
+    icm20649_handle.accel_cal = *cal;
+
+    /* skip the matrix multiply entirely if it wouldn't do anything */
+    icm20649_handle.accel_cal_matrix_en = memcmp(cal->q, identity.q, sizeof(identity.q)) != 0;
+
+    return RET_OK;
+}
+
+/**
+ * @brief Get calibration currently applied to accelerometer readings
+ *
+ * @param cal - Calibration will be saved here
+ */
+void icm20649_get_accel_calibration(sensorconv_cal_t* cal)
+{
+    *cal = icm20649_handle.accel_cal;
+}
+
+/**
+ * @brief Set offsets subtracted from every gyroscope reading
+ *
+ * @param offsets - Per-axis offsets in LSB
+ */
+void icm20649_set_gyro_offsets(const int16_t offsets[ICM20649_GYRO_AXES])
+{
+    ASSERT(offsets);
+    (void)memcpy(icm20649_handle.gyro_offsets, offsets, sizeof(icm20649_handle.gyro_offsets));
+}
+
+/**
+ * @brief Get offsets currently subtracted from gyroscope readings
+ *
+ * @param offsets - Per-axis offsets in LSB will be saved here
+ */
+void icm20649_get_gyro_offsets(int16_t offsets[ICM20649_GYRO_AXES])
+{
+    ASSERT(offsets);
+    (void)memcpy(offsets, icm20649_handle.gyro_offsets, sizeof(icm20649_handle.gyro_offsets));
+}
+
+/**
+ * @brief Set power mode
+ *
+ * @param power - Power mode
+ * @return sysret_t - Driver status
+ */
+sysret_t icm20649_set_power(icm20649_power_t power)
+{
+    sysret_t ret = RET_DRV_UNINIT;
+    bool cycled = (power == ICM20649_POWER_DUTY_CYCLED);
+    uint8_t tx;
+
+    if(icm20649_handle.state != ICM20649_STATE_RUNNING)
+        return ret;
+
+    if(power == icm20649_handle.power)
+        return RET_OK;
+
+    ret = set_usr_bank(ICM20649_USR_BANK_0);
+    SYSRET_CHECK(ret);
+
+    /* wake up before configuring anything */
+    if(icm20649_handle.power != ICM20649_POWER_ACTIVE)
+    {
+        tx = ICM20649_CLKSEL_SET(0x01U);
+        ret = write_reg(ICM20649_PWR_MGMT_1_ADDR, &tx, 1U);
+        SYSRET_CHECK(ret);
+    }
+
+    ret = config_accel(icm20649_handle.cfg, cycled);
+    SYSRET_CHECK(ret);
+
+    ret = config_gyro(icm20649_handle.cfg, cycled);
+    SYSRET_CHECK(ret);
+
+    ret = set_usr_bank(ICM20649_USR_BANK_0);
+    SYSRET_CHECK(ret);
+
+    tx = cycled ? (ICM20649_ACCEL_CYCLE_MASK | ICM20649_GYRO_CYCLE_MASK) : 0x00U;
+    ret = write_reg(ICM20649_LP_CONFIG_ADDR, &tx, 1U);
+    SYSRET_CHECK(ret);
+
+    tx = ICM20649_CLKSEL_SET(0x01U);
+    if(cycled)
+        tx |= ICM20649_LP_EN_MASK;
+    else if(power == ICM20649_POWER_SLEEP)
+        tx |= ICM20649_SLEEP_MASK;
+    ret = write_reg(ICM20649_PWR_MGMT_1_ADDR, &tx, 1U);
+    SYSRET_CHECK(ret);
+
+    icm20649_handle.power = power;
+
+    return RET_OK;
 }
\ No newline at end of file
@@ -11,6 +11,7 @@
 #include <stdint.h>
 #include "nrf.h"
 #include "retcodes.h"
+#include "sensorconv.h"
 
 /**
  * @brief ICM20649 accelerometer axis indexes
@@ -58,6 +59,21 @@ typedef enum
     ICM20649_GYRO_FS_MAX
 } icm20649_gyro_fs_t;
 
+/**
+ * @brief Power modes
+ */
+typedef enum
+{
+    ICM20649_POWER_ACTIVE = 0,  /*!< Low-noise mode, sensors run continuously */
+    ICM20649_POWER_DUTY_CYCLED, /*!< Sensors duty-cycled at @ref ICM20649_DUTY_CYCLED_SMPLRT_DIV */
+    ICM20649_POWER_SLEEP        /*!< Sleep, sensors are off and can't be read */
+} icm20649_power_t;
+
+/**
+ * @brief Sample rate divider while duty-cycled, ODR = 1125 Hz / (1 + div) ~ 51 Hz
+ */
+#define ICM20649_DUTY_CYCLED_SMPLRT_DIV 21U
+
 /**
  * @brief ICM20649 driver configurations
  */
@@ -92,9 +108,25 @@ sysret_t icm20649_init(icm20649_cfg_t* cfg);
  * @param gyro  - Buffer to store raw gyroscope readings
  * @param accel - Buffer to store raw accelerometer readings
  * @return sysret_t 
+ * @retval NRF_ERROR_INVALID_STATE if asleep, see @ref icm20649_set_power()
  */
 sysret_t icm20649_read_raw(int16_t gyro[ICM20649_GYRO_AXES], int16_t accel[ICM20649_ACCEL_AXES]);
 
+/**
+ * @brief Read the last gyroscope and accelerometer output without waiting
+ *        for new data
+ * 
+ * Safe to call from an interrupt that preempts other driver calls, as long
+ * as their SPI transfers hold it off (see @ref spi_set_guard_irq()). The
+ * USER BANK they were using is put back.
+ * 
+ * @param gyro  - Buffer to store raw gyroscope readings
+ * @param accel - Buffer to store raw accelerometer readings
+ * @return sysret_t - Driver status
+ * @retval NRF_ERROR_INVALID_STATE if asleep, see @ref icm20649_set_power()
+ */
+sysret_t icm20649_read_latest(int16_t gyro[ICM20649_GYRO_AXES], int16_t accel[ICM20649_ACCEL_AXES]);
+
 /**
  * @brief Test serial communication and initiate device self-test
  * 
@@ -104,6 +136,65 @@ sysret_t icm20649_read_raw(int16_t gyro[ICM20649_GYRO_AXES], int16_t accel[ICM20
  */
 sysret_t icm20649_test(void);
 
+/**
+ * @brief Calibrate gyroscope and accelerometer offsets
+ *
+ * Averages readings with the device at rest. Gyroscope offsets are set so
+ * that it reads zero, accelerometer calibration bias is corrected so that
+ * it reads the setpoint.
+ *
+ * @param accel_setpoint - Expected accelerometer values at every axis
+ *                         If NULL then default setpoint is used where device is assumed
+ *                         to be at rest with the Z-axis completely perpendicular to the
+ *                         X-Y plane [0, 0, 1g]
+ * @return sysret_t - Driver status
+ */
+sysret_t icm20649_calibrate(int16_t accel_setpoint[ICM20649_ACCEL_AXES]);
+
+/**
+ * @brief Set calibration applied to every accelerometer reading
+ *
+ * Readings returned by @ref icm20649_read_raw() are corrected with
+ * Q * (x - bias), see @ref sensorconv_cal_t
+ *
+ * @param cal - Calibration, if NULL the calibration is cleared
+ * @return sysret_t - Driver status
+ * @retval NRF_ERROR_INVALID_PARAM if the calibration matrix is out of range
+ */
+sysret_t icm20649_set_accel_calibration(const sensorconv_cal_t* cal);
+
+/**
+ * @brief Get calibration currently applied to accelerometer readings
+ *
+ * @param cal - Calibration will be saved here
+ */
+void icm20649_get_accel_calibration(sensorconv_cal_t* cal);
+
+/**
+ * @brief Set offsets subtracted from every gyroscope reading
+ *
+ * @param offsets - Per-axis offsets in LSB
+ */
+void icm20649_set_gyro_offsets(const int16_t offsets[ICM20649_GYRO_AXES]);
+
+/**
+ * @brief Get offsets currently subtracted from gyroscope readings
+ *
+ * @param offsets - Per-axis offsets in LSB will be saved here
+ */
+void icm20649_get_gyro_offsets(int16_t offsets[ICM20649_GYRO_AXES]);
+
+/**
+ * @brief Set power mode
+ *
+ * Woken up from @ref ICM20649_POWER_SLEEP, the gyroscope takes up to 35 ms
+ * to give valid readings.
+ *
+ * @param power - Power mode
+ * @return sysret_t - Driver status
+ */
+sysret_t icm20649_set_power(icm20649_power_t power);
+
 #ifdef __cplusplus
 }
 #endif
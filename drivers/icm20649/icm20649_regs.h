@@ -34,10 +34,14 @@ typedef enum
 #define ICM20649_USER_CTRL_ADDR       0x03U /*!< USER_CTRL register address */
 
 #define ICM20649_LP_CONFIG_ADDR       0x05U /*!< LP_CONFIG register address */
+#define ICM20649_ACCEL_CYCLE_MASK     0x20U /*!< Set this bit to duty-cycle the accelerometer */
+#define ICM20649_GYRO_CYCLE_MASK      0x10U /*!< Set this bit to duty-cycle the gyroscope */
 
 #define ICM20649_PWR_MGMT_1_ADDR      0x06U /*!< PWR_MGMT_1 register address */
 #define ICM20649_CLKSEL_MASK          0x07U
 #define ICM20649_CLKSEL_SET(clk)      (clk & ICM20649_CLKSEL_MASK)
+#define ICM20649_LP_EN_MASK           0x20U /*!< Set this bit to power down digital circuitry between duty cycles */
+#define ICM20649_SLEEP_MASK           0x40U /*!< Set this bit to put the chip to sleep */
 #define ICM20649_DEVICE_RESET_MASK    0x80U
 
 #define ICM20649_PWR_MGMT_2_ADDR      0x07U /*!< PWM_MGMT_2 register address */
@@ -64,6 +68,8 @@ typedef enum
  * @brief USER BANK 2 REGISTERS
  *************************************/
 
+#define ICM20649_GYRO_SMPLRT_DIV_ADDR 0x00U /*!< GYRO_SMPLRT_DIV register address, ODR = 1125 Hz / (1 + div) */
+
 #define ICM20649_GYRO_CONFIG_1_ADDR   0x01U /*!< GYRO_CONFIG_1 register address */
 #define ICM20649_GYRO_FCHOICE_MASK    0x01U /*!< Set this bit to enable gyro DLPF */
 #define ICM20649_GYRO_FS_SEL_MASK     0x06U
@@ -71,6 +77,9 @@ typedef enum
 #define ICM20649_GYRO_DLPCFG_MASK     0x38U
 #define ICM20649_GYRO_DLPCFG_SET(cfg) ((cfg << 3U) & ICM20649_GYRO_DLPCFG_MASK)
 
+#define ICM20649_ACCEL_SMPLRT_DIV_1_ADDR 0x10U /*!< ACCEL_SMPLRT_DIV_1 register address, divider MSB */
+#define ICM20649_ACCEL_SMPLRT_DIV_2_ADDR 0x11U /*!< ACCEL_SMPLRT_DIV_2 register address, divider LSB, ODR = 1125 Hz / (1 + div) */
+
 #define ICM20649_ACCEL_CONFIG_ADDR      0x14U /*!< ACCEL_CONFIG register address */
 #define ICM20649_ACCEL_FCHOICE_MASK     0x01U
 #define ICM20649_ACCEL_FS_SEL_MASK      0x06U
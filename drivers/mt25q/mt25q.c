@@ -4,11 +4,13 @@
  * @brief MT25Q flash storage driver
  */
 
+#include <stdbool.h>
 #include <string.h>
 #include "mt25q.h"
 #include "mt25q_reg.h"
 #include "spi.h"
 #include "app_timer.h"
+#include "nrf_delay.h"
 #include "nrf_assert.h"
 
 /**
@@ -41,6 +43,7 @@ typedef struct
 {
     mt25q_cfg_t* cfg;    /*!< Driver configurations */
     mt25q_state_t state; /*!< Driver state */
+    bool powered_down;   /*!< In deep power-down, see @ref mt25q_power_down() */
 } mt25q_t;
 
 /**
@@ -48,7 +51,8 @@ typedef struct
  */
 static mt25q_t mt25q = {
     .cfg = NULL,
-    .state = MT25Q_STATE_UNINIT
+    .state = MT25Q_STATE_UNINIT,
+    .powered_down = false
 };
 
 /**************************************
@@ -108,6 +112,34 @@ static sysret_t read_reg(cmd_t command, void* rx, size_t rxn)
     return ret;
 }
 
+/**
+ * @notapi
+ * @brief Release flash from deep power-down, waiting until it takes commands
+ * 
+ * @return sysret_t - Driver status
+ */
+static sysret_t release_power_down(void)
+{
+    sysret_t ret = write_reg(MT25Q_RELEASE_POWER_DOWN_CMD, NULL, 0);
+    SYSRET_CHECK(ret);
+
+    nrf_delay_us(MT25Q_RELEASE_POWER_DOWN_US);
+    mt25q.powered_down = false;
+
+    return RET_OK;
+}
+
+/**
+ * @notapi
+ * @brief Make sure the flash is out of deep power-down before accessing it
+ * 
+ * @return sysret_t - Driver status
+ */
+static inline sysret_t wake(void)
+{
+    return mt25q.powered_down ? release_power_down() : RET_OK;
+}
+
 /**
  * @notapi
  * @brief Enable 4byte address mode to use full 256Mb flash capacity
@@ -207,6 +239,10 @@ sysret_t mt25q_init(mt25q_cfg_t* cfg)
     ASSERT(cfg);
     sysret_t ret = RET_ERR;
 
+    /* flash keeps power across an MCU reset, it may still be powered down */
+    ret = release_power_down();
+    SYSRET_CHECK(ret);
+
     /* Enable 4-Byte addressing mode */
     ret = enable_4byte_addr_mode();
     SYSRET_CHECK(ret);
@@ -243,6 +279,9 @@ sysret_t mt25q_page_program(uint32_t address, uint8_t* buf, size_t n)
 
     sysret_t ret = RET_ERR;
 
+    ret = wake();
+    SYSRET_CHECK(ret);
+
     /* enable write for PROGRAM command */
     ret = write_enable();
     SYSRET_CHECK(ret);
@@ -270,6 +309,10 @@ sysret_t mt25q_page_program(uint32_t address, uint8_t* buf, size_t n)
 sysret_t mt25q_read(uint32_t address, uint8_t* buf, size_t n)
 {
     ASSERT(buf);
+
+    sysret_t ret = wake();
+    SYSRET_CHECK(ret);
+
     return spi_flash_receive(
         SPI_INSTANCE_2, SPI_DEV_MT25Q,
         MT25Q_4B_READ_CMD, address,
@@ -287,6 +330,9 @@ sysret_t mt25q_32kB_subsector_erase(uint32_t address)
 {
     sysret_t ret = RET_ERR;
 
+    ret = wake();
+    SYSRET_CHECK(ret);
+
     /* enable write for ERASE command */
     ret = write_enable();
     SYSRET_CHECK(ret);
@@ -314,6 +360,9 @@ sysret_t mt25q_4kB_subsector_erase(uint32_t address)
 {
     sysret_t ret = RET_ERR;
 
+    ret = wake();
+    SYSRET_CHECK(ret);
+
     /* enable write for ERASE command */
     ret = write_enable();
     SYSRET_CHECK(ret);
@@ -341,6 +390,9 @@ sysret_t mt25q_64kB_sector_erase(uint32_t address)
 {
     sysret_t ret = RET_ERR;
 
+    ret = wake();
+    SYSRET_CHECK(ret);
+
     /* enable write for ERASE command */
     ret = write_enable();
     SYSRET_CHECK(ret);
@@ -366,6 +418,9 @@ sysret_t mt25q_bulk_erase(void)
 {
     sysret_t ret = RET_ERR;
 
+    ret = wake();
+    SYSRET_CHECK(ret);
+
     /* enable write for ERASE command */
     ret = write_enable();
     SYSRET_CHECK(ret);
@@ -389,6 +444,9 @@ sysret_t mt25q_test(void)
 {
     sysret_t ret = RET_ERR;
 
+    ret = wake();
+    SYSRET_CHECK(ret);
+
     /* Check SPI communication */
     ret = check_id();
     SYSRET_CHECK(ret);
@@ -399,5 +457,29 @@ sysret_t mt25q_test(void)
     else
         ret = RET_OK;
 
+    return ret;
+}
+
+/**
+ * @brief Put the flash in deep power-down, it's released automatically
+ *        by the next call to any other function of this driver
+ * 
+ * @return sysret_t - Driver status
+ */
+sysret_t mt25q_power_down(void)
+{
+    sysret_t ret = RET_OK;
+
+    if(mt25q.state == MT25Q_STATE_UNINIT)
+        ret = RET_DRV_UNINIT;
+    else if(!mt25q.powered_down)
+    {
+        /* every write waits for completion, so the command is never ignored */
+        ret = write_reg(MT25Q_DEEP_POWER_DOWN_CMD, NULL, 0);
+
+        if(ret == RET_OK)
+            mt25q.powered_down = true;
+    }
+
     return ret;
 }
\ No newline at end of file
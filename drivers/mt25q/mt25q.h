@@ -118,6 +118,14 @@ sysret_t mt25q_bulk_erase(void);
  */
 sysret_t mt25q_test(void);
 
+/**
+ * @brief Put the flash in deep power-down, it's released automatically
+ *        by the next call to any other function of this driver
+ * 
+ * @return sysret_t - Driver status
+ */
+sysret_t mt25q_power_down(void);
+
 #ifdef __cplusplus
 }
 #endif
@@ -34,4 +34,8 @@
 #define MT25Q_ENTER_4B_ADDR_CMD        0xB7U /*!< Command to enter 4-Byte address mode */
 #define MT25Q_EXIT_4B_ADDR_CMD         0xE9U /*!< Command to exit 4-Byte address mode */
 
+#define MT25Q_DEEP_POWER_DOWN_CMD      0xB9U /*!< Command to enter deep power-down, all other commands are ignored until released */
+#define MT25Q_RELEASE_POWER_DOWN_CMD   0xABU /*!< Command to release from deep power-down */
+#define MT25Q_RELEASE_POWER_DOWN_US    30U   /*!< Max time in us to leave deep power-down (tRDP) */
+
 #endif /* MT25Q_REGS_H */
\ No newline at end of file
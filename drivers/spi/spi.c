@@ -34,6 +34,15 @@ static const uint8_t cs_pins[SPI_DEV_MAX] = {
     SPI0_ICM20649_CS_PIN, SPI2_ADXL372_CS_PIN, SPI2_MT25Q_CS_PIN
 };
 
+/**
+ * @brief Interrupt held off by transfers, see @ref spi_set_guard_irq()
+ */
+static struct
+{
+    bool      en;  /*!< An interrupt is guarded */
+    IRQn_Type irq; /*!< Guarded interrupt */
+} guard = { false, 0 };
+
 /*********************************
  * Helper functions
  *********************************/
@@ -87,6 +96,44 @@ static sysret_t spi2_lock(spi_devs_t dev)
     return ret;
 }
 
+/**
+ * @notapi
+ * @brief Hold the guarded interrupt off, unless running in it
+ *
+ * @return true if it was held off, pass to @ref bus_release()
+ */
+static bool bus_hold(void)
+{
+    uint32_t irq = (uint32_t)guard.irq;
+
+    /* exception numbers are offset from IRQ numbers by the 16 system exceptions */
+    if(!guard.en || __get_IPSR() == irq + 16U)
+        return false;
+
+    /* stopped by its owner, nothing to hold off */
+    if(!(NVIC->ISER[irq >> 5U] & (1UL << (irq & 0x1FU))))
+        return false;
+
+    NVIC_DisableIRQ(guard.irq);
+    __DSB();
+    __ISB();
+
+    return true;
+}
+
+/**
+ * @notapi
+ * @brief Let the guarded interrupt run again, it runs now if it came
+ *        in during the transfer
+ *
+ * @param held - Returned by @ref bus_hold()
+ */
+static void bus_release(bool held)
+{
+    if(held)
+        NVIC_EnableIRQ(guard.irq);
+}
+
 /*********************************
  * helper functions
  *********************************/
@@ -104,6 +151,17 @@ static uint32_t htonl(uint32_t in)
  * API
  *********************************/
 
+/**
+ * @brief Hold an interrupt off while transfers started outside of it run
+ * 
+ * @param irq - Interrupt that uses the SPI busses
+ */
+void spi_set_guard_irq(IRQn_Type irq)
+{
+    guard.irq = irq;
+    guard.en = true;
+}
+
 /**
  * @brief Initialize SPI instances
  * 
@@ -165,6 +223,7 @@ sysret_t spi_transfer(
 
     nrf_drv_spi_t const * const spi = (instance == SPI_INSTANCE_0) ? &(spi0) : &(spi2);
     uint8_t pin = cs_pins[dev];
+    bool held = bus_hold();
 
     /**
      * @note see function doc above to know why we do this...
@@ -172,7 +231,12 @@ sysret_t spi_transfer(
     if(instance == SPI_INSTANCE_2)
     {
         ret = spi2_lock(dev);
-        SYSRET_CHECK(ret);
+
+        if(ret != RET_OK)
+        {
+            bus_release(held);
+            return ret;
+        }
     }
 
     /**
@@ -181,6 +245,7 @@ sysret_t spi_transfer(
     nrf_gpio_pin_clear(pin);
     ret = nrf_drv_spi_transfer(spi, txbuf, txn, rxbuf, rxn);
     nrf_gpio_pin_set(pin);
+    bus_release(held);
 
     return ret;
 }
@@ -209,6 +274,7 @@ sysret_t spi_flash_transmit(
 
     nrf_drv_spi_t const * const spi = (instance == SPI_INSTANCE_0) ? &(spi0) : &(spi2);
     uint8_t pin = cs_pins[dev];
+    bool held = bus_hold();
 
     /**
      * @note see function doc above to know why we do this...
@@ -216,7 +282,12 @@ sysret_t spi_flash_transmit(
     if(instance == SPI_INSTANCE_2)
     {
         ret = spi2_lock(dev);
-        SYSRET_CHECK(ret);
+
+        if(ret != RET_OK)
+        {
+            bus_release(held);
+            return ret;
+        }
     }
 
     /**
@@ -243,6 +314,7 @@ sysret_t spi_flash_transmit(
 
     }
     nrf_gpio_pin_set(pin);
+    bus_release(held);
 
     return ret;
 }
@@ -271,6 +343,7 @@ sysret_t spi_flash_receive(
 
     nrf_drv_spi_t const * const spi = (instance == SPI_INSTANCE_0) ? &(spi0) : &(spi2);
     uint8_t pin = cs_pins[dev];
+    bool held = bus_hold();
 
     /**
      * @note see function doc above to know why we do this...
@@ -278,7 +351,12 @@ sysret_t spi_flash_receive(
     if(instance == SPI_INSTANCE_2)
     {
         ret = spi2_lock(dev);
-        SYSRET_CHECK(ret);
+
+        if(ret != RET_OK)
+        {
+            bus_release(held);
+            return ret;
+        }
     }
 
     /**
@@ -305,6 +383,7 @@ sysret_t spi_flash_receive(
 
     }
     nrf_gpio_pin_set(pin);
+    bus_release(held);
 
     return ret;
 }
\ No newline at end of file
@@ -9,6 +9,7 @@
 
 #include <stddef.h>
 #include "retcodes.h"
+#include "nrf.h"
 
 /**
  * @brief Defines available SPI instances
@@ -35,6 +36,17 @@ typedef enum
 extern "C" {
 #endif
 
+/**
+ * @brief Hold an interrupt off while transfers started outside of it run
+ *
+ * Lets an interrupt use the SPI busses too, e.g. to sample sensors, without
+ * cutting into a transfer the main loop started. The interrupt is left
+ * pending and runs as soon as the transfer is done.
+ *
+ * @param irq - Interrupt that uses the SPI busses
+ */
+void spi_set_guard_irq(IRQn_Type irq);
+
 /**
  * @brief Initialize SPI instances
  * 
@@ -25,17 +25,77 @@ typedef struct
 {
     vcnl4040_cfg_t* cfg;
     vcnl4040_state_t state;
+    bool int_en; /*!< Threshold interrupts enabled */
 } vcnl4040_t;
 
+/**
+ * @brief Background poll, buffers must outlive the transaction
+ */
+static struct
+{
+    i2c_xfer_t xfer;
+    uint8_t flag_addr;
+    uint8_t ps_addr;
+    uint8_t flag_rx[2U];
+    uint8_t ps_rx[2U];
+    vcnl4040_poll_cb_t callback;
+} poll_xfer;
+
 /**
  * @brief VCNL4040 driver singleton
  */
 static vcnl4040_t vcnl4040 =
 {
-    .cfg   = NULL,
-    .state = VCNL4040_STATE_UNINIT
+    .cfg    = NULL,
+    .state  = VCNL4040_STATE_UNINIT,
+    .int_en = false
 };
 
+/**
+ * @notapi
+ * @brief Write CONF1 & CONF2 from configuration
+ * 
+ * @param cfg      - Driver configuration
+ * @param shutdown - if true, sensor is shut down
+ * @return sysret_t Driver status
+ */
+static sysret_t write_conf1_conf2(const vcnl4040_cfg_t* cfg, bool shutdown)
+{
+    uint8_t tx[VCNL4040_TX_NUMBYTES] = {0U};
+    uint8_t conf1, conf2;
+
+    conf1 = VCNL4040_DUTY_SET(cfg->ps_duty) | VCNL4040_IT_SET(cfg->ps_it);
+    conf2 = VCNL4040_OUT_BITS_SET(cfg->ps_out_bits);
+
+    if(shutdown)
+        conf1 |= VCNL4040_PS_SD_MASK;
+
+    if(vcnl4040.int_en)
+        conf2 |= VCNL4040_PS_INT_CLOSE_AWAY;
+
+    tx[VCNL4040_TX_CMD] = VCNL4040_PS_CONF1_CONF2_ADDR;
+    tx[VCNL4040_TX_LSB] = conf1;
+    tx[VCNL4040_TX_MSB] = conf2;
+
+    return i2c_transceive(VCNL4040_SLAVE_ADDR, tx, VCNL4040_TX_NUMBYTES, NULL, 0);
+}
+
+/**
+ * @notapi
+ * @brief Background poll done, runs in the I2C interrupt
+ */
+static void poll_done(sysret_t result, void* p_ctx)
+{
+    vcnl4040_poll_t poll;
+
+    (void)p_ctx;
+
+    poll.int_flags = poll_xfer.flag_rx[VCNL4040_RX_MSB] & VCNL4040_INT_FLAG_PS_MASK;
+    poll.ps = (vcnl4040_data_t)(poll_xfer.ps_rx[VCNL4040_RX_LSB] | (poll_xfer.ps_rx[VCNL4040_RX_MSB] << 8U));
+
+    poll_xfer.callback(result, &poll);
+}
+
 /**
  * @brief Configure and initialize VCNL4040 driver
  * 
@@ -46,7 +106,7 @@ sysret_t vcnl4040_init(vcnl4040_cfg_t* cfg)
 {
     sysret_t ret = RET_ERR;
     uint8_t tx[VCNL4040_TX_NUMBYTES] = {0U};
-    uint8_t conf1, conf2, conf3, ms;
+    uint8_t conf3, ms;
 
     /* check input */
     if(!cfg)
@@ -55,13 +115,7 @@ sysret_t vcnl4040_init(vcnl4040_cfg_t* cfg)
     /**
      * set CONF1 & CONF2
      */
-    conf1 = VCNL4040_DUTY_SET(cfg->ps_duty) | VCNL4040_IT_SET(cfg->ps_it);
-    conf2 = VCNL4040_OUT_BITS_SET(cfg->ps_out_bits);
-    tx[VCNL4040_TX_CMD] = VCNL4040_PS_CONF1_CONF2_ADDR;
-    tx[VCNL4040_TX_LSB] = conf1;
-    tx[VCNL4040_TX_MSB] = conf2;
-
-    ret = i2c_transceive(VCNL4040_SLAVE_ADDR, tx, VCNL4040_TX_NUMBYTES, NULL, 0);
+    ret = write_conf1_conf2(cfg, false);
 
     if(ret != RET_OK)
         return ret;
@@ -120,6 +174,129 @@ sysret_t vcnl4040_read(vcnl4040_data_t* data)
     return RET_OK;
 }
 
+/**
+ * @brief Shut down the proximity sensor or turn it back on
+ * 
+ * @param shutdown - if true, sensor is shut down, readings stop updating
+ * @return sysret_t Driver status
+ */
+sysret_t vcnl4040_shutdown(bool shutdown)
+{
+    /* check state */
+    if(vcnl4040.state != VCNL4040_STATE_RUNNING)
+        return RET_DRV_UNINIT;
+
+    return write_conf1_conf2(vcnl4040.cfg, shutdown);
+}
+
+/**
+ * @brief Set proximity thresholds and interrupt on crossing them
+ * 
+ * @param low  - Away threshold, in PS counts
+ * @param high - Close threshold, in PS counts
+ * @return sysret_t Driver status
+ */
+sysret_t vcnl4040_set_thresholds(uint16_t low, uint16_t high)
+{
+    sysret_t ret;
+    uint8_t tx[VCNL4040_TX_NUMBYTES] = {0U};
+
+    /* check state */
+    if(vcnl4040.state != VCNL4040_STATE_RUNNING)
+        return RET_DRV_UNINIT;
+
+    tx[VCNL4040_TX_CMD] = VCNL4040_PS_THDL_ADDR;
+    tx[VCNL4040_TX_LSB] = (uint8_t)low;
+    tx[VCNL4040_TX_MSB] = (uint8_t)(low >> 8U);
+
+    ret = i2c_transceive(VCNL4040_SLAVE_ADDR, tx, VCNL4040_TX_NUMBYTES, NULL, 0);
+
+    if(ret != RET_OK)
+        return ret;
+
+    tx[VCNL4040_TX_CMD] = VCNL4040_PS_THDH_ADDR;
+    tx[VCNL4040_TX_LSB] = (uint8_t)high;
+    tx[VCNL4040_TX_MSB] = (uint8_t)(high >> 8U);
+
+    ret = i2c_transceive(VCNL4040_SLAVE_ADDR, tx, VCNL4040_TX_NUMBYTES, NULL, 0);
+
+    if(ret != RET_OK)
+        return ret;
+
+    /* interrupts stay enabled across shutdowns */
+    vcnl4040.int_en = true;
+
+    return write_conf1_conf2(vcnl4040.cfg, false);
+}
+
+/**
+ * @brief Read and clear proximity interrupt flags, releases the INT line
+ * 
+ * @param flags - VCNL4040_INT_* flags raised since the last read
+ * @return sysret_t Driver status
+ */
+sysret_t vcnl4040_get_int_flags(uint8_t* flags)
+{
+    sysret_t ret;
+    uint8_t tx = VCNL4040_INT_FLAG_ADDR;
+    uint8_t rx[2U] = {0U};
+
+    /* check state */
+    if(vcnl4040.state != VCNL4040_STATE_RUNNING)
+        return RET_DRV_UNINIT;
+
+    ret = i2c_transceive(VCNL4040_SLAVE_ADDR, &tx, 1U, rx, 2U);
+
+    if(ret != RET_OK)
+        return ret;
+
+    *flags = rx[VCNL4040_RX_MSB] & VCNL4040_INT_FLAG_PS_MASK;
+
+    return RET_OK;
+}
+
+/**
+ * @brief Read the interrupt flags and proximity in the background,
+ *        returns before the bus transaction is done
+ * 
+ * @param callback - Called with the readings once the transaction is done
+ * @return sysret_t Driver status, NRF_ERROR_BUSY if the last poll isn't
+ *         done yet
+ */
+sysret_t vcnl4040_poll(vcnl4040_poll_cb_t callback)
+{
+    sysret_t ret;
+
+    /* check input */
+    if(!callback)
+        return RET_ERR;
+
+    /* check state */
+    if(vcnl4040.state != VCNL4040_STATE_RUNNING)
+        return RET_DRV_UNINIT;
+
+    if(poll_xfer.xfer.busy)
+        return NRF_ERROR_BUSY;
+
+    /* both registers in one transaction, so one callback */
+    i2c_xfer_init(&poll_xfer.xfer, poll_done, NULL);
+    poll_xfer.flag_addr = VCNL4040_INT_FLAG_ADDR;
+    poll_xfer.ps_addr = VCNL4040_PS_DATA_ADDR;
+    poll_xfer.callback = callback;
+
+    ret = i2c_xfer_add(&poll_xfer.xfer, VCNL4040_SLAVE_ADDR, &poll_xfer.flag_addr, 1U, poll_xfer.flag_rx, 2U);
+
+    if(ret != RET_OK)
+        return ret;
+
+    ret = i2c_xfer_add(&poll_xfer.xfer, VCNL4040_SLAVE_ADDR, &poll_xfer.ps_addr, 1U, poll_xfer.ps_rx, 2U);
+
+    if(ret != RET_OK)
+        return ret;
+
+    return i2c_schedule(&poll_xfer.xfer);
+}
+
 /**
  * @brief Get driver state and test serial communication
  * 
@@ -72,6 +72,29 @@ typedef enum
     VCNL4040_LED_CURRENT_200mA     /*!< LED current 200 mA */
 } vcnl4040_led_current_t;
 
+/**
+ * @brief Proximity interrupt flags, see @ref vcnl4040_get_int_flags()
+ */
+#define VCNL4040_INT_AWAY  0x01U /*!< Reading went under the low threshold */
+#define VCNL4040_INT_CLOSE 0x02U /*!< Reading went over the high threshold */
+
+/**
+ * @brief Result of a background poll, see @ref vcnl4040_poll()
+ */
+typedef struct
+{
+    vcnl4040_data_t ps;        /*!< Proximity reading */
+    uint8_t         int_flags; /*!< VCNL4040_INT_* flags raised since the last read */
+} vcnl4040_poll_t;
+
+/**
+ * @brief Background poll completion callback, runs in the I2C interrupt
+ *
+ * @param result - Driver status
+ * @param poll   - Readings, only valid if result is RET_OK
+ */
+typedef void (*vcnl4040_poll_cb_t)(sysret_t result, const vcnl4040_poll_t* poll);
+
 /**
  * @brief VCNL4040 driver configuration
  */
@@ -105,6 +128,47 @@ sysret_t vcnl4040_init(vcnl4040_cfg_t* cfg);
  */
 sysret_t vcnl4040_read(vcnl4040_data_t* data);
 
+/**
+ * @brief Shut down the proximity sensor or turn it back on
+ * 
+ * @param shutdown - if true, sensor is shut down, readings stop updating
+ * @return sysret_t Driver status
+ */
+sysret_t vcnl4040_shutdown(bool shutdown);
+
+/**
+ * @brief Set proximity thresholds and interrupt on crossing them
+ *
+ * The INT line goes low when the reading goes over the high threshold
+ * (close) or under the low one (away), until the flags are read.
+ * 
+ * @param low  - Away threshold, in PS counts
+ * @param high - Close threshold, in PS counts
+ * @return sysret_t Driver status
+ */
+sysret_t vcnl4040_set_thresholds(uint16_t low, uint16_t high);
+
+/**
+ * @brief Read and clear proximity interrupt flags, releases the INT line
+ * 
+ * @param flags - VCNL4040_INT_* flags raised since the last read
+ * @return sysret_t Driver status
+ */
+sysret_t vcnl4040_get_int_flags(uint8_t* flags);
+
+/**
+ * @brief Read the interrupt flags and proximity in the background,
+ *        returns before the bus transaction is done
+ *
+ * Reading the flags clears them and releases the INT line, same as
+ * @ref vcnl4040_get_int_flags().
+ *
+ * @param callback - Called with the readings once the transaction is done
+ * @return sysret_t Driver status, NRF_ERROR_BUSY if the last poll isn't
+ *         done yet
+ */
+sysret_t vcnl4040_poll(vcnl4040_poll_cb_t callback);
+
 /**
  * @brief Get driver state and test serial communication
  * 
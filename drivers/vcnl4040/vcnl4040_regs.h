@@ -35,6 +35,8 @@
 #define VCNL4040_IT_SET(it)           ((it << 1) & VCNL4040_IT_MASK) /*!< set PS integration time */
 #define VCNL4040_OUT_BITS_MASK        0x08U /*!< PS output bits mask */
 #define VCNL4040_OUT_BITS_SET(bits)   ((bits << 3) & VCNL4040_OUT_BITS_MASK) /*!< set PS output bits */
+#define VCNL4040_PS_SD_MASK           0x01U /*!< PS shutdown, set to power off the proximity sensor */
+#define VCNL4040_PS_INT_CLOSE_AWAY    0x03U /*!< PS interrupt on both closing and away events, in CONF2 */
 
 /**
  * CONF3 and MS register address and bit definitions
@@ -47,11 +49,23 @@
 #define VCNL4040_LED_I_MASK           0x07U /*!< PS LED_I bits mask */
 #define VCNL4040_LED_I_SET(curr)      (curr & VCNL4040_LED_I_MASK) /*!< set LED current setting */
 
+/**
+ * PS interrupt threshold register addresses, 2 bytes each, LSB first
+ */
+#define VCNL4040_PS_THDL_ADDR         0x06U /*!< VCNL4040 PS low (away) threshold register address */
+#define VCNL4040_PS_THDH_ADDR         0x07U /*!< VCNL4040 PS high (close) threshold register address */
+
 /**
  * PS data output register address
  */
 #define VCNL4040_PS_DATA_ADDR         0x08U /*!< VCNL4040 PS Data output register address */
 
+/**
+ * Interrupt flag register address, flags are in the MSB and cleared on read
+ */
+#define VCNL4040_INT_FLAG_ADDR        0x0BU /*!< VCNL4040 interrupt flag register address */
+#define VCNL4040_INT_FLAG_PS_MASK     0x03U /*!< PS away and close flags */
+
 /**
  * Device ID register address
  */
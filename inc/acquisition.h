@@ -0,0 +1,160 @@
+/**
+ * @file acquisition.h
+ * @author UBC Capstone Team 2020/2021
+ * @brief Sensor acquisition pipeline
+ *
+ * Every sensor is sampled on each sampling clock tick, see sampleclock.h,
+ * in a software interrupt that runs above everything else in the
+ * application, so a slow flash write, configuration save or shell command
+ * can't delay it. Samples are handed on as fixed-size frames through a
+ * lock-free single producer, single consumer ring.
+ *
+ * The rest of the pipeline is three stages joined by queues:
+ * - filter, collects frames into a batch. Once the batch is full each
+ *   channel is run through its CFC filter and the batch is decimated.
+ *   Rows to log go to the storage queue, every filtered sample goes to the
+ *   stream queue.
+ * - store, writes the storage queue to the datalog.
+ * - stream, feeds the stream queue to the live stream, see telemetry.h.
+ *
+ * In the superloop build the state machine runs the filter stage, which
+ * runs the other two after every batch. In the FreeRTOS build each stage
+ * has its own task, see rtos.h.
+ *
+ * SPI transfers started outside the sampling interrupt hold it off until
+ * they're done, see spi_set_guard_irq(). A tick that comes in while the
+ * previous sample is still held off is missed, a frame or row that doesn't
+ * fit in the ring or a queue is dropped, all are counted. The latency from
+ * each tick to the sensors being read is tracked too, its spread is the
+ * sampling jitter.
+ *
+ * In continuous datalogging the high-g accelerometer can be logged as
+ * impact peaks instead, see configs_high_g_log_t. The ADXL372 keeps the
+ * peak of every impact in its FIFO, which is drained into peak rows once
+ * per batch. Optionally every sample taken during an impact is logged too,
+ * at full rate regardless of decimation. Trigger mode captures are always
+ * logged in full.
+ */
+
+#ifndef ACQUISITION_H
+#define ACQUISITION_H
+
+#include "retcodes.h"
+#include "configs.h"
+#include "cfcfilter.h"
+
+/**
+ * @brief Number of samples buffered per channel before filtering
+ */
+#define ACQUISITION_BATCH_SIZE CFCFILTER_MAX_BLOCK_SIZE
+
+/**
+ * @brief Number of frames the ring holds, how far the filter stage can
+ *        fall behind sampling (~20 ms at the highest rate, ~300 ms at the
+ *        lowest)
+ */
+#define ACQUISITION_RING_SIZE 128U
+
+/**
+ * @brief Number of rows the storage and stream queues each hold, two
+ *        batches
+ */
+#define ACQUISITION_QUEUE_SIZE (ACQUISITION_BATCH_SIZE * 2U)
+
+/**
+ * @brief Pipeline counters since acquisition started
+ */
+typedef struct
+{
+    uint32_t samples;        /*!< Frames put in the ring */
+    uint32_t missed;         /*!< Ticks that came in while the last sample was still held off */
+    uint32_t dropped;        /*!< Frames dropped because the ring was full */
+    uint32_t ring_hwm;       /*!< Most frames waiting in the ring for the filter stage */
+    uint32_t batches;        /*!< Batches filtered */
+    uint32_t unlogged;       /*!< Rows dropped because the storage queue was full */
+    uint32_t unstreamed;     /*!< Samples dropped because the stream queue was full */
+    uint32_t log_hwm;        /*!< Most rows waiting in the storage queue */
+    uint32_t stream_hwm;     /*!< Most samples waiting in the stream queue */
+    uint32_t latency_max_us; /*!< Longest time from a tick to the sensors being read */
+    uint32_t jitter_us;      /*!< Longest minus shortest time from a tick to the sensors being read */
+} acquisition_stats_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Configure channel filters and start a new acquisition session
+ *
+ * In trigger mode, the readings the ADXL372 kept from the start of the
+ * impact are logged first.
+ *
+ * @param configs     - Device configurations to acquire data with
+ * @param sample_rate - Rate at which @ref acquisition_trigger() will be called, in Hz
+ * @return sysret_t Module status
+ */
+sysret_t acquisition_start(configs_t* configs, float sample_rate);
+
+/**
+ * @brief Sample all sensors in the sampling interrupt, safe to call from
+ *        interrupts
+ */
+void acquisition_trigger(void);
+
+/**
+ * @brief Filter stage, take every frame out of the ring, filter and
+ *        decimate each batch once it's full and queue it for the other
+ *        stages
+ */
+void acquisition_filter(void);
+
+/**
+ * @brief Store stage, write every queued row to the datalog
+ */
+void acquisition_store(void);
+
+/**
+ * @brief Stream stage, feed every queued sample to the live stream
+ */
+void acquisition_stream(void);
+
+/**
+ * @brief Run the pipeline stages and get the first failure since the last
+ *        call, meant to be called by the state machine
+ *
+ * In the superloop build this runs the filter stage, the state machine is
+ * kicked whenever a frame is put in the ring. In the FreeRTOS build the
+ * stages run in their own tasks, the state machine is kicked when one of
+ * them fails.
+ *
+ * @return sysret_t Module status, the first failure
+ */
+sysret_t acquisition_process(void);
+
+/**
+ * @brief Stop sampling, run whatever is left in the ring, batch and
+ *        queues through every stage, then stop acquisition
+ *
+ * @return sysret_t Module status
+ */
+sysret_t acquisition_stop(void);
+
+/**
+ * @brief Get pipeline counters
+ *
+ * @param stats - Counters will be saved here
+ */
+void acquisition_get_stats(acquisition_stats_t* stats);
+
+/**
+ * @brief Decimation factor in use by the current session
+ *
+ * @return uint32_t Decimation factor
+ */
+uint32_t acquisition_get_decimation(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* ACQUISITION_H */
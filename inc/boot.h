@@ -0,0 +1,119 @@
+/**
+ * @file boot.h
+ * @author UBC Capstone Team 2020/2021
+ * @brief Staged startup, times the boot and resumes datalogging after a reset
+ *
+ * Startup is split in two stages, see main.c:
+ * - capture, everything sampling and datalogging need: sensors, flash,
+ *   the sampling clock and the state machine. Runs straight from reset,
+ *   each device is polled by ID until it answers instead of waiting out
+ *   a fixed power-on delay.
+ * - link, the shell and the BLE stack. Posted to the event loop once the
+ *   capture stage is done, so it runs after the state machine's first pass.
+ *
+ * Datalogging enable is kept in RAM that isn't cleared on a reset, a device
+ * that was logging when it reset (watchdog, fault, brown-out) picks logging
+ * up again on its first state machine pass without waiting for the app. It
+ * isn't kept through a power cycle, and the bootloader may overwrite it, in
+ * which case the device comes up idle as usual. Whether the helmet was on
+ * is kept with it, so logging doesn't wait on the first proximity reading.
+ *
+ * Times are counted on the app_timer counter from boot_init(), which wraps
+ * after 512 s.
+ */
+
+#ifndef BOOT_H
+#define BOOT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "retcodes.h"
+
+/**
+ * @brief Longest a device gets to answer after power-on, in ms
+ */
+#define BOOT_READY_TIMEOUT_MS 100U
+
+/**
+ * @brief Time between ID reads while a device powers on, in us
+ */
+#define BOOT_READY_POLL_US 250U
+
+/**
+ * @brief Points in the boot that get timed
+ */
+typedef enum
+{
+    BOOT_MARK_CAPTURE_READY = 0, /*!< Capture stage done */
+    BOOT_MARK_FIRST_SAMPLE,      /*!< First frame sampled since boot */
+    BOOT_MARK_LINK_READY,        /*!< Link stage done */
+    BOOT_MARK_FIRST_ROW,         /*!< First row logged since boot */
+    BOOT_MARKS                   /*!< Number of marks */
+} boot_mark_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Start timing the boot, call right after app_timer_init()
+ *
+ * @return sysret_t Module status
+ */
+sysret_t boot_init(void);
+
+/**
+ * @brief Poll a device until it answers or BOOT_READY_TIMEOUT_MS runs out
+ *
+ * @param test - Device test, reads the device ID. An uninitialized driver
+ *               counts as ready.
+ * @return sysret_t RET_OK once the device answers, the last test status
+ *         otherwise
+ */
+sysret_t boot_wait_ready(sysret_t (*test)(void));
+
+/**
+ * @brief Record the time of a mark, only the first call counts. Safe to
+ *        call from interrupts.
+ *
+ * @param mark - Mark
+ */
+void boot_mark(boot_mark_t mark);
+
+/**
+ * @brief Get the time of a mark
+ *
+ * @param mark - Mark
+ * @param ms   - Time since boot in ms
+ * @return true if the mark was reached
+ */
+bool boot_elapsed_ms(boot_mark_t mark, uint32_t* ms);
+
+/**
+ * @brief Check if datalogging was enabled when the device last reset
+ *
+ * @return true if datalogging should pick up again
+ */
+bool boot_datalog_resume(void);
+
+/**
+ * @brief Check if the helmet was on when the device last reset while
+ *        datalogging was enabled
+ *
+ * @return true if the helmet was on
+ */
+bool boot_wear_resume(void);
+
+/**
+ * @brief Keep datalogging enable and the helmet being on across a reset
+ *
+ * @param enabled - Datalogging enabled
+ * @param worn    - Helmet on, only kept with datalogging enabled
+ */
+void boot_datalog_retain(bool enabled, bool worn);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* BOOT_H */
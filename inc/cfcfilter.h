@@ -0,0 +1,105 @@
+/**
+ * @file cfcfilter.h
+ * @author UBC Capstone Team 2020/2021
+ * @brief SAE J211 Channel Frequency Class (CFC) filtering stage
+ *
+ * Each channel is filtered by a cascade of two identical J211 2-pole
+ * Butterworth biquads (CMSIS DF2T), which gives the 4-pole magnitude
+ * response of the J211 reference filter. J211 specifies the filter to be
+ * run forwards and backwards (phaseless) on recorded data; on the device
+ * the data is filtered as it's acquired, so the output carries the phase
+ * delay of a causal filter.
+ */
+
+#ifndef CFCFILTER_H
+#define CFCFILTER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "retcodes.h"
+
+/**
+ * @brief Selectable SAE J211 channel frequency classes
+ */
+typedef enum
+{
+    CFCFILTER_BYPASS = 0, /*!< No filtering */
+    CFCFILTER_CFC60,      /*!< CFC 60   (-3dB at 100 Hz) */
+    CFCFILTER_CFC180,     /*!< CFC 180  (-3dB at 300 Hz) */
+    CFCFILTER_CFC600,     /*!< CFC 600  (-3dB at 1000 Hz) */
+    CFCFILTER_CFC1000,    /*!< CFC 1000 (-3dB at 1650 Hz) */
+    CFCFILTER_CLASS_MAX   /*!< not an option */
+} cfcfilter_class_t;
+
+/**
+ * @brief Filtered channels
+ */
+typedef enum
+{
+    CFCFILTER_HIGH_G_X = 0,
+    CFCFILTER_HIGH_G_Y,
+    CFCFILTER_HIGH_G_Z,
+    CFCFILTER_LOW_G_X,
+    CFCFILTER_LOW_G_Y,
+    CFCFILTER_LOW_G_Z,
+    CFCFILTER_GYRO_X,
+    CFCFILTER_GYRO_Y,
+    CFCFILTER_GYRO_Z,
+    CFCFILTER_CHANNELS /*!< Number of channels */
+} cfcfilter_channel_t;
+
+/**
+ * @brief Max number of samples per channel that can be filtered in one call
+ */
+#define CFCFILTER_MAX_BLOCK_SIZE 64U
+
+/**
+ * @brief Filter class names for logging
+ */
+extern char* cfcfilter_class_strings[CFCFILTER_CLASS_MAX];
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Configure a channel's filter and reset its state
+ *
+ * @param channel     - Channel to configure
+ * @param cfc         - Channel frequency class
+ * @param sample_rate - Channel sampling rate in Hz
+ * @return sysret_t Module status
+ * @retval NRF_ERROR_INVALID_PARAM if the class can't be realized at the sampling rate
+ */
+sysret_t cfcfilter_configure(cfcfilter_channel_t channel, cfcfilter_class_t cfc, float sample_rate);
+
+/**
+ * @brief Reset filter state of every channel, keeping their configurations
+ */
+void cfcfilter_reset(void);
+
+/**
+ * @brief Filter a block of samples of a single channel in place
+ *
+ * @param channel - Channel the samples belong to
+ * @param data    - Samples to filter
+ * @param n       - Number of samples, at most @ref CFCFILTER_MAX_BLOCK_SIZE
+ */
+void cfcfilter_process(cfcfilter_channel_t channel, int16_t* data, size_t n);
+
+/**
+ * @brief Largest decimation factor that keeps a filtered channel alias-free
+ *
+ * Follows the J211 recommendation of sampling at least 10x the CFC.
+ *
+ * @param cfc         - Channel frequency class
+ * @param sample_rate - Channel sampling rate in Hz
+ * @return uint32_t Decimation factor, 1 if the channel can't be decimated
+ */
+uint32_t cfcfilter_max_decimation(cfcfilter_class_t cfc, float sample_rate);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CFCFILTER_H */
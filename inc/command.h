@@ -0,0 +1,169 @@
+/**
+ * @file command.h
+ * @author UBC Capstone Team 2020/2021
+ * @brief Batched TLV command protocol
+ *
+ * Lets the app send several operations in one write to the RX
+ * characteristic, as a REQ_BATCH request (see statemachine.c):
+ *
+ *     u8 REQ_BATCH | u8 version | TLV | TLV | ...
+ *
+ * where every TLV is a u8 @ref command_tlv_t, a u8 length and that many
+ * value bytes, little-endian. A batch is checked in full before anything
+ * is applied, so either every operation in it takes effect or none does.
+ * One @ref command_response_header_t comes back on the Device
+ * Configurations characteristic, followed by a status TLV if asked for.
+ */
+
+#ifndef COMMAND_H
+#define COMMAND_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+#include "retcodes.h"
+#include "configs.h"
+#include "datetime.h"
+
+/**
+ * @brief Version of the batch format understood by the firmware
+ */
+#define COMMAND_VERSION 1U
+
+/**
+ * @brief Index of failed TLV in a response when no TLV failed
+ */
+#define COMMAND_NO_TLV 0xFFU
+
+/**
+ * @brief TLV types
+ */
+typedef enum
+{
+    COMMAND_TLV_SET_FIELD = 1, /*!< u8 command_field_t, then the field's value */
+    COMMAND_TLV_SET_DATETIME,  /*!< datetime_t */
+    COMMAND_TLV_START_DATALOG, /*!< no value */
+    COMMAND_TLV_STOP_DATALOG,  /*!< no value */
+    COMMAND_TLV_GET_STATUS,    /*!< no value, reply with a status TLV */
+    COMMAND_TLV_STATUS         /*!< command_status_t, response only */
+} command_tlv_t;
+
+/**
+ * @brief Configuration fields that can be set, see @ref configs_t
+ */
+typedef enum
+{
+    COMMAND_FIELD_DATALOG_MODE = 1,   /*!< u8 configs_datalog_mode_t */
+    COMMAND_FIELD_TRIGGER_ON,         /*!< u8 configs_trigger_on_t */
+    COMMAND_FIELD_TRIGGER_AXIS,       /*!< u8 configs_trigger_axis_t */
+    COMMAND_FIELD_THRESHOLD_RESULTANT,/*!< i16 */
+    COMMAND_FIELD_THRESHOLD_X,        /*!< i16 */
+    COMMAND_FIELD_THRESHOLD_Y,        /*!< i16 */
+    COMMAND_FIELD_THRESHOLD_Z,        /*!< i16 */
+    COMMAND_FIELD_GYRO_SAMPLE_RATE,   /*!< u8 configs_gyro_sample_rate_t */
+    COMMAND_FIELD_LOW_G_SAMPLE_RATE,  /*!< u8 configs_low_g_accel_sample_rate_t */
+    COMMAND_FIELD_HIGH_G_SAMPLE_RATE, /*!< u8 configs_high_g_accel_sample_rate_t */
+    COMMAND_FIELD_HIGH_G_CFC,         /*!< u8 cfcfilter_class_t */
+    COMMAND_FIELD_LOW_G_CFC,          /*!< u8 cfcfilter_class_t */
+    COMMAND_FIELD_GYRO_CFC,           /*!< u8 cfcfilter_class_t */
+    COMMAND_FIELD_DECIMATION,         /*!< u8 */
+    COMMAND_FIELD_HIGH_G_LOG,         /*!< u8 configs_high_g_log_t */
+    COMMAND_FIELDS_END                /*!< Not a field */
+} command_field_t;
+
+/**
+ * @brief Result of a batch
+ */
+typedef enum
+{
+    COMMAND_OK = 0,       /*!< Every operation applied */
+    COMMAND_BAD_VERSION,  /*!< Batch format not understood, nothing applied */
+    COMMAND_BAD_TLV,      /*!< Unknown TLV or wrong length, nothing applied */
+    COMMAND_BAD_VALUE,    /*!< Value out of range, nothing applied */
+    COMMAND_SAVE_FAILED,  /*!< Applied, but configurations couldn't be saved */
+    COMMAND_BUSY          /*!< Previous batch not applied yet, nothing applied */
+} command_result_t;
+
+/**
+ * @brief Start of every batch response
+ */
+typedef struct __attribute__((__packed__))
+{
+    uint8_t request; /*!< Request code of the batch */
+    uint8_t version; /*!< COMMAND_VERSION */
+    uint8_t result;  /*!< command_result_t */
+    uint8_t failed;  /*!< Index of the TLV that failed, COMMAND_NO_TLV if none */
+} command_response_header_t;
+
+/**
+ * @brief Value of a status TLV
+ */
+typedef struct __attribute__((__packed__))
+{
+    uint8_t    state;         /*!< statemachine_state_t */
+    uint8_t    datalog_en;    /*!< Datalogging enabled */
+    uint8_t    session_count; /*!< Sessions in datalog */
+    uint32_t   datalog_size;  /*!< Size of saved datalog, 0 if none */
+    datetime_t datetime;      /*!< Current device time */
+} command_status_t;
+
+/**
+ * @brief Operations of a parsed batch, ready to be applied
+ */
+typedef struct
+{
+    configs_t  configs;        /*!< Configurations with every field set */
+    bool       configs_set;    /*!< At least one field was set */
+    bool       datetime_set;   /*!< datetime is valid */
+    datetime_t datetime;       /*!< Time to set */
+    bool       start_datalog;  /*!< Start datalogging */
+    bool       stop_datalog;   /*!< Stop datalogging, applied after start */
+    bool       get_status;     /*!< Reply with a status TLV */
+} command_batch_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Check a batch and work out what it does, without applying anything
+ *
+ * @param data    - Batch bytes, after the request code
+ * @param size    - Size of batch
+ * @param configs - Configurations the fields are set on top of
+ * @param batch   - Operations will be saved here
+ * @param failed  - Index of the TLV that failed will be saved here,
+ *                  COMMAND_NO_TLV if none
+ * @return command_result_t COMMAND_OK if the batch can be applied
+ */
+command_result_t command_parse(
+    const uint8_t* data,
+    size_t size,
+    const configs_t* configs,
+    command_batch_t* batch,
+    uint8_t* failed);
+
+/**
+ * @brief Build a batch response
+ *
+ * @param request - Request code of the batch
+ * @param result  - Result of the batch
+ * @param failed  - Index of the TLV that failed
+ * @param status  - Status to append as a TLV, NULL for none
+ * @param buf     - Response will be saved here
+ * @param size    - Size of buf
+ * @return uint16_t Size of response, 0 if buf is too small
+ */
+uint16_t command_response(
+    uint8_t request,
+    command_result_t result,
+    uint8_t failed,
+    const command_status_t* status,
+    uint8_t* buf,
+    size_t size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* COMMAND_H */
@@ -10,6 +10,7 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include "mt25q.h"
+#include "sensorconv.h"
 
 /**
  * @brief Datalog mode options
@@ -82,6 +83,17 @@ typedef enum
     CONFIGS_HIGH_G_ACCEL_SAMPLE_RATE_MAX /*!< not an option */
 } configs_high_g_accel_sample_rate_t;
 
+/**
+ * @brief High G accelerometer logging options
+ */
+typedef enum
+{
+    CONFIGS_HIGH_G_LOG_SAMPLES = 0, /*!< Every sample */
+    CONFIGS_HIGH_G_LOG_PEAKS,       /*!< Only the peak of each impact */
+    CONFIGS_HIGH_G_LOG_PEAKS_EVENTS,/*!< Peak of each impact, plus every sample during impacts */
+    CONFIGS_HIGH_G_LOG_MAX /*!< not an option */
+} configs_high_g_log_t;
+
 /**
  * @brief Configuration option strings for logging
  */
@@ -91,6 +103,7 @@ extern char* configs_trigger_axis_strings[CONFIGS_TRIGGER_AXIS_MAX];
 extern char* configs_gyro_sample_rate_strings[CONFIGS_GYRO_SAMPLE_RATE_MAX];
 extern char* configs_low_g_accel_sample_rate_strings[CONFIGS_LOW_G_ACCEL_SAMPLE_RATE_MAX];
 extern char* configs_high_g_accel_sample_rate_strings[CONFIGS_HIGH_G_ACCEL_SAMPLE_RATE_MAX];
+extern char* configs_high_g_log_strings[CONFIGS_HIGH_G_LOG_MAX];
 extern size_t configs_sample_rate_ticks[CONFIGS_HIGH_G_ACCEL_SAMPLE_RATE_MAX];
 
 /**
@@ -107,6 +120,23 @@ extern size_t configs_sample_rate_ticks[CONFIGS_HIGH_G_ACCEL_SAMPLE_RATE_MAX];
  */
 #define CONFIGS_FRAME_SIZE (FLASH_PAGE_SIZE)
 
+/**
+ * @brief Layout of the metadata in a configurations frame, bumped whenever
+ *        a field is added or moved. Frames saved with an older layout are
+ *        migrated when read, see configs_get().
+ *
+ * - 1: original firmware, frame has no layout word
+ * - 2: filter classes, decimation and high-g logging appended to configs_t,
+ *      calibration, gyroscope bias, session index and download marker after
+ *      the datalog configurations
+ */
+#define CONFIGS_LAYOUT_VERSION 2U
+
+/**
+ * @brief Size of configs_t in layout 1
+ */
+#define CONFIGS_LAYOUT_1_CONFIGS_SIZE 19U
+
 /**
  * @brief Device configurations
  */
@@ -124,8 +154,47 @@ typedef struct __attribute__((__packed__))
     uint8_t  gyro_sampling_rate;
     uint8_t  low_g_sampling_rate;
     uint8_t  high_g_sampling_rate;
+    uint8_t  high_g_cfc;           /*!< High G accelerometer filter class, see cfcfilter_class_t */
+    uint8_t  low_g_cfc;            /*!< Low G accelerometer filter class, see cfcfilter_class_t */
+    uint8_t  gyro_cfc;             /*!< Gyroscope filter class, see cfcfilter_class_t */
+    uint8_t  decimation;           /*!< Log every Nth filtered sample, 0 or 1 logs every sample */
+    uint8_t  high_g_log;           /*!< High G accelerometer logging, see configs_high_g_log_t */
 } configs_t;
 
+/**
+ * @brief Expected magic number of a calibration blob
+ */
+#define CONFIGS_CALIBRATION_MAGIC 0xCA1BU
+
+/**
+ * @brief Accelerometer calibrations, as sent by the app or
+ *        emitted by the host calibration tool.
+ *
+ * The CRC is CRC-16/CCITT (0xFFFF seed) over every preceding byte,
+ * all fields are little-endian.
+ */
+typedef struct __attribute__((__packed__))
+{
+    uint16_t         magic;  /*!< Must be CONFIGS_CALIBRATION_MAGIC */
+    sensorconv_cal_t high_g; /*!< ADXL372 calibration */
+    sensorconv_cal_t low_g;  /*!< ICM20649 accelerometer calibration */
+    uint16_t         crc;    /*!< CRC over all of the above */
+} configs_calibration_t;
+
+/**
+ * @brief Max number of datalogging sessions indexed in metadata
+ */
+#define CONFIGS_MAX_SESSIONS 8U
+
+/**
+ * @brief Location of a datalogging session within the datalog
+ */
+typedef struct __attribute__((__packed__))
+{
+    uint32_t offset; /*!< Byte offset of first row from start of datalog */
+    uint32_t size;   /*!< Size of session in bytes */
+} configs_session_t;
+
 /**
  * @brief Definition of a configurations frame
  */
@@ -143,7 +212,24 @@ typedef union
         uint32_t  datalog_header;      /*!< If equal to DEADBEEF, datalog exists */
         uint32_t  datalog_size;        /*!< Size of saved datalog file */
         configs_t datalog_configs;     /*!< Device configurations during datalog */
+
+        /* Calibration metadata */
+        configs_calibration_t calibration; /*!< Accelerometer calibrations */
+        uint32_t  gyro_bias_header;    /*!< If equal to DEADBEEF, gyro_bias is valid */
+        int16_t   gyro_bias[3];        /*!< Gyroscope bias estimate in LSB, see gyrobias.h */
+
+        /* Datalog session index, sessions appended in order */
+        uint8_t           session_count;                  /*!< Number of valid entries in sessions */
+        configs_session_t sessions[CONFIGS_MAX_SESSIONS]; /*!< Sessions in datalog, oldest first */
+
+        /* Download-related metadata */
+        uint32_t  downloaded_size;     /*!< datalog_size at the last complete download, sessions from here on are new */
     } device_metadata;
+    struct __attribute__((__packed__))
+    {
+        uint8_t  metadata[CONFIGS_FRAME_SIZE - sizeof(uint32_t)]; /*!< device_metadata, must fit */
+        uint32_t layout;                                          /*!< CONFIGS_LAYOUT_VERSION the frame was saved with */
+    } frame;
     uint8_t  configs_bytes[CONFIGS_FRAME_SIZE];
 } metadata_t;
 
@@ -159,6 +245,9 @@ extern "C" {
 /**
  * @brief Attempt to get configurations from persistent memory
  * 
+ * Frames saved with an older layout are migrated and saved back, frames
+ * with a layout this firmware doesn't know are discarded.
+ *
  * @param configs Configurations will be saved here
  * @return sysret_t Driver status
  * @retval RET_ERR if persistent memory doesn't contain configurations
@@ -174,6 +263,23 @@ sysret_t configs_get(metadata_t* configs);
  */
 sysret_t configs_save(metadata_t* configs);
 
+/**
+ * @brief Check magic number, CRC and matrix ranges of a calibration blob
+ *
+ * @param calibration Calibration blob to check
+ * @return sysret_t
+ * @retval RET_OK if the blob can be applied
+ * @retval NRF_ERROR_INVALID_DATA otherwise
+ */
+sysret_t configs_calibration_check(const configs_calibration_t* calibration);
+
+/**
+ * @brief Fill in magic number and CRC of a calibration blob
+ *
+ * @param calibration Calibration blob to seal
+ */
+void configs_calibration_seal(configs_calibration_t* calibration);
+
 #ifdef __cplusplus
 }
 #endif
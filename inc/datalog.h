@@ -8,15 +8,24 @@
 #ifndef DATALOG_H
 #define DATALOG_H
 
+#include <stdbool.h>
 #include "retcodes.h"
 #include "configs.h"
 #include "datetime.h"
+#include "mt25q.h"
 
+#define DATALOG_BASE_FLASH_ADDR        FLASH_4KB_SUBSECTOR_SIZE /*!< Starting address of datalog in flash */
+#define DATALOG_END_FLASH_ADDR         FLASH_CAPACITY           /*!< Datalog runs to the end of flash */
+#define DATALOG_MAX_SIZE               (DATALOG_END_FLASH_ADDR - DATALOG_BASE_FLASH_ADDR) /*!< Max datalog size in bytes */
 #define DATALOG_ROW_MAX_SIZE           30U   /*!< Max datalog row size in bytes */
 #define DATALOG_DATETIME_AVAILABLE     0x08U /*!< Datalog row datetime presence mask */
 #define DATALOG_GYRO_AVAILABLE         0x04U /*!< Datalog row gyroscope data presence mask */
 #define DATALOG_LOW_G_ACCEL_AVAILABLE  0x02U /*!< Datalog row low-g accelerometer data presence mask */
 #define DATALOG_HIGH_G_ACCEL_AVAILABLE 0x01U /*!< Datalog row high-g accelerometer data presence mask */
+#define DATALOG_HIGH_G_PEAK            0x10U /*!< Datalog row high-g accelerometer data is the peak of an impact, not a sample */
+#define DATALOG_SESSION_START          0x20U /*!< Datalog row header of the marker before a session's first row, followed by the u32 offset of the marker */
+#define DATALOG_SESSION_START_SIZE     5U    /*!< Session start marker size in bytes */
+#define DATALOG_FILLER                 0x00U /*!< Datalog byte voided after a reset in the middle of a row, skipped */
 
 /**
  * @brief Datalogger state
@@ -30,13 +39,23 @@ typedef enum
 /**
  * @brief Start datalogging session.
  * 
- * @note This erases preexisting datalogs to make space
- *       for new ones
- * @param dev_metadata Update device metadata to reflect erasing preexisting datalog
+ * @note The session is appended after the saved datalog, see
+ *       @ref configs_session_t
+ * @param dev_metadata Device metadata describing the saved datalog
  * @return sysret_t
  */
 sysret_t datalog_start(metadata_t* dev_metadata);
 
+/**
+ * @brief Recover rows logged after the saved end of the datalog, left by a
+ *        reset in the middle of a session, as a session of their own
+ *
+ * @param dev_metadata Device metadata describing the saved datalog, saved
+ *                     to flash if rows were recovered
+ * @return sysret_t RET_OK if nothing needed recovering or the rows were saved
+ */
+sysret_t datalog_recover(metadata_t* dev_metadata);
+
 /**
  * @brief Log data to flash
  * 
@@ -56,6 +75,17 @@ sysret_t datalog_log(
     int16_t low_g_accel[3U],
     int16_t high_g_accel[3U]);
 
+/**
+ * @brief Log the peak acceleration of an impact to flash
+ * 
+ * Logged as a high-g row flagged with DATALOG_HIGH_G_PEAK.
+ * 
+ * @param dt Datetime, NULL if not available
+ * @param peak High-G Accelerometer peak on each axis
+ * @return sysret_t 
+ */
+sysret_t datalog_log_peak(datetime_t* dt, int16_t peak[3U]);
+
 /**
  * @brief Stop datalogging, save datalog information to flash
  * 
@@ -65,11 +95,22 @@ sysret_t datalog_log(
 sysret_t datalog_stop(metadata_t* dev_metadata);
 
 /**
- * @brief Erase current datalog information from flash
+ * @brief Erase the datalog from flash once it has all been downloaded,
+ *        the session index starts over
  * 
  * @param dev_metadata Update device metadata before saving to flash
- * @return sysret_t 
+ * @return sysret_t NRF_ERROR_INVALID_STATE if part of the datalog hasn't
+ *         been downloaded
  */
 sysret_t datalog_erase(metadata_t* dev_metadata);
 
+/**
+ * @brief Size of a datalog row given its header
+ *
+ * @param row_header First byte of the row
+ * @return size_t Row size in bytes including the header,
+ *         0 if the header isn't valid (e.g. erased flash)
+ */
+size_t datalog_row_size(uint8_t row_header);
+
 #endif /* DATALOG_H */
\ No newline at end of file
@@ -54,6 +54,7 @@ sysret_t datetime_init(void);
 sysret_t datetime_set(datetime_t* datetime_in);
 sysret_t datetime_reset(void);
 sysret_t datetime_get(datetime_t* datetime_out);
+sysret_t datetime_get_elapsed(uint32_t* sec_out);
 sysret_t datetime_test(void);
 
 #ifdef __cplusplus
@@ -0,0 +1,209 @@
+/**
+ * @file download.h
+ * @author UBC Capstone Team 2020/2021
+ * @brief Datalog download engine
+ *
+ * Streams the datalog from flash to the mobile app over BLE notifications.
+ * Flash is read ahead into a spare buffer while the SoftDevice is busy
+ * sending, and packets are queued until the SoftDevice TX queue is full.
+ * Each call to @ref download_process() does a bounded amount of work so the
+ * main loop keeps running during a download.
+ *
+ * Any part of the datalog can be requested, see @ref download_request_t.
+ * Packets start with a @ref download_packet_header_t giving their
+ * sequence number and position in the datalog, so after a dropped
+ * connection the app can request only the pieces it's missing. A raw
+ * request, the original whole-datalog download, sends bare datalog bytes
+ * instead.
+ *
+ * Notifications aren't acknowledged by the phone's BLE stack. An app that
+ * sets DOWNLOAD_REQUEST_WINDOWED gets the range split into fixed-size
+ * chunks sent over a sliding window. Each packet then ends with a CRC16
+ * over the header and payload, and the app periodically writes an ACK (see
+ * @ref download_ack()) saying which chunks arrived. Only chunks missing
+ * from an ACK, or every unacknowledged chunk once ACKs stop coming, are
+ * sent again. Without it packets are sent once, and the download is done
+ * when the SoftDevice has sent them all.
+ *
+ * If the app asks for it, each chunk is compressed on its own with LZSS
+ * (see lzss.h), so a lost chunk never stops the rest from being decoded.
+ */
+
+#ifndef DOWNLOAD_H
+#define DOWNLOAD_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "retcodes.h"
+#include "configs.h"
+#include "mt25q.h"
+
+/**
+ * @brief Size of each flash read-ahead buffer in bytes
+ */
+#define DOWNLOAD_PREFETCH_SIZE (4U * FLASH_PAGE_SIZE)
+
+/**
+ * @brief Max chunks sent but not yet acknowledged
+ *
+ * Sized to cover the time it takes an ACK to come back, around 150 ms
+ * with phone stack latency, at the fastest rate the link manages. Equal
+ * to the width of the ACK bitmap.
+ */
+#define DOWNLOAD_WINDOW_CHUNKS 64U
+
+/**
+ * @brief Time without the window moving before unacknowledged chunks are sent again
+ */
+#define DOWNLOAD_ACK_TIMEOUT_MS 500U
+
+/**
+ * @brief Timeouts in a row without the window moving before the download is aborted
+ */
+#define DOWNLOAD_MAX_TIMEOUTS 10U
+
+/**
+ * @brief Size of the CRC16 at the end of every windowed download packet
+ */
+#define DOWNLOAD_PACKET_CRC_SIZE sizeof(uint16_t)
+
+/**
+ * @brief Request flag, the app can decompress packets
+ */
+#define DOWNLOAD_REQUEST_COMPRESS 0x01U
+
+/**
+ * @brief Request flag, the app acknowledges chunks and checks their CRC,
+ *        see @ref download_ack()
+ */
+#define DOWNLOAD_REQUEST_WINDOWED 0x02U
+
+/**
+ * @brief Packet flag, the payload is an LZSS block, see lzss.h
+ */
+#define DOWNLOAD_PACKET_COMPRESSED 0x01U
+
+/**
+ * @brief Size of a block in block-addressed requests
+ */
+#define DOWNLOAD_BLOCK_SIZE FLASH_4KB_SUBSECTOR_SIZE
+
+/**
+ * @brief Header at the start of every download packet, little-endian
+ *
+ * The payload follows, then in windowed downloads a CRC-16/CCITT (0xFFFF
+ * seed) over the header and payload. Uncompressed payloads are the same
+ * size except the last.
+ */
+typedef struct __attribute__((__packed__))
+{
+    uint16_t seq;    /*!< Chunk number within the download, starting at 0 */
+    uint32_t offset; /*!< Byte offset of the first payload byte, once decompressed, from start of datalog */
+    uint8_t  flags;  /*!< DOWNLOAD_PACKET_COMPRESSED if the payload is compressed */
+} download_packet_header_t;
+
+/**
+ * @brief Part of the datalog to download
+ *
+ * If @p skip_rows or @p rows is nonzero, the range is walked row by row
+ * before streaming starts, so that whole rows are sent. Session start
+ * markers and filler are sent but not counted as rows.
+ */
+typedef struct
+{
+    uint32_t offset;    /*!< Byte offset from start of datalog */
+    uint32_t length;    /*!< Bytes to send, 0 for everything after offset */
+    uint32_t skip_rows; /*!< Rows after offset to skip */
+    uint32_t rows;      /*!< Rows to send after the skipped ones, 0 for all */
+    uint8_t  flags;     /*!< DOWNLOAD_REQUEST_* flags */
+    bool     raw;       /*!< Bare datalog bytes with no packet header, flags must be 0 */
+} download_request_t;
+
+/**
+ * @brief Download progress and throughput
+ */
+typedef struct
+{
+    bool     active;            /*!< Download in progress */
+    uint32_t total_bytes;       /*!< Size of range being downloaded, once rows are located */
+    uint32_t queued_bytes;      /*!< Bytes of datalog handed to the SoftDevice, not counting retransmissions */
+    uint32_t sent_bytes;        /*!< Payload bytes those took once compressed */
+    uint32_t queued_packets;    /*!< Packets handed to the SoftDevice */
+    uint32_t completed_packets; /*!< Packets the SoftDevice finished sending */
+    uint32_t acked_chunks;      /*!< Chunks the app has acknowledged in order, windowed downloads only */
+    uint32_t resent_packets;    /*!< Packets sent again after being lost */
+    uint32_t elapsed_ms;        /*!< Time since download started, or total time once done */
+    uint32_t kbps;              /*!< Datalog throughput in KB/s, after decompression */
+} download_stats_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Start downloading part of the saved datalog
+ *
+ * @param metadata - Device metadata describing the saved datalog
+ * @param request  - Part of the datalog to send, NULL for all of it
+ * @return sysret_t Module status
+ * @retval RET_ERR if there is no saved datalog
+ * @retval NRF_ERROR_INVALID_PARAM if the request is past the end of the datalog
+ */
+sysret_t download_start(const metadata_t* metadata, const download_request_t* request);
+
+/**
+ * @brief Fill in a request for a datalogging session
+ *
+ * @param metadata - Device metadata describing the saved datalog
+ * @param session  - Session index, 0 is the oldest
+ * @param request  - Request will be saved here, rows are left at 0
+ * @return sysret_t Module status
+ * @retval NRF_ERROR_NOT_FOUND if there is no such session
+ */
+sysret_t download_session_request(const metadata_t* metadata, uint8_t session, download_request_t* request);
+
+/**
+ * @brief Queue more of the datalog, meant to be called in the main loop
+ *        until @ref download_is_active() returns false
+ *
+ * @return sysret_t Module status
+ * @retval RET_OK while the download is progressing or has finished
+ * @retval Error code of the failure otherwise, download is aborted
+ */
+sysret_t download_process(void);
+
+/**
+ * @brief Handle an ACK written by the app, safe to call from the BLE event handler
+ *
+ * The ACK is only saved here, it's acted on in @ref download_process().
+ *
+ * @param seq    - Next chunk expected, every chunk before it has arrived
+ * @param bitmap - Bit i set if chunk seq + i has arrived. Chunks
+ *                 missing below the last one that arrived are sent again
+ */
+void download_ack(uint16_t seq, uint64_t bitmap);
+
+/**
+ * @brief Stop the download in progress
+ */
+void download_abort(void);
+
+/**
+ * @brief Whether a download is in progress
+ *
+ * @return true if downloading
+ */
+bool download_is_active(void);
+
+/**
+ * @brief Get progress and throughput of the current or last download
+ *
+ * @param stats - Stats will be saved here
+ */
+void download_get_stats(download_stats_t* stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* DOWNLOAD_H */
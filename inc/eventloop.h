@@ -0,0 +1,104 @@
+/**
+ * @file eventloop.h
+ * @author UBC Capstone Team 2020/2021
+ * @brief Event-driven main loop
+ *
+ * Timer, BLE and peripheral event handlers post work items, which run one
+ * after the other in the main loop through app_scheduler. Once there's no
+ * work left the CPU sleeps until the next interrupt. In the FreeRTOS build
+ * the main loop is the system task, see rtos.h, which waits for work to be
+ * posted while other tasks run, time spent waiting counts as asleep.
+ *
+ * Every work item is queued at most once, posting it again before it
+ * has run does nothing, so a fast event source can't flood the queue.
+ */
+
+#ifndef EVENTLOOP_H
+#define EVENTLOOP_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "retcodes.h"
+
+/**
+ * @brief Max number of work items queued at once
+ */
+#define EVENTLOOP_QUEUE_SIZE 16U
+
+/**
+ * @brief Work item
+ */
+typedef struct
+{
+    void (*handler)(void);  /*!< Work to do */
+    volatile bool pending;  /*!< Queued and not run yet */
+} eventloop_work_t;
+
+/**
+ * @brief Define a work item
+ *
+ * @param name    - Name of work item
+ * @param handler - Function doing the work
+ */
+#define EVENTLOOP_WORK_DEF(name, handler) \
+    static eventloop_work_t name = { handler, false }
+
+/**
+ * @brief Wake-to-work latency and sleep statistics
+ */
+typedef struct
+{
+    uint32_t events;          /*!< Work items run */
+    uint32_t dropped;         /*!< Work items that didn't fit in the queue */
+    uint32_t latency_avg_us;  /*!< Mean time from posting to running a work item */
+    uint32_t latency_max_us;  /*!< Longest time from posting to running a work item */
+    uint32_t wakeups;         /*!< Times the CPU woke up from sleep */
+    uint32_t elapsed_ms;      /*!< Time since statistics were reset */
+    uint32_t asleep_ms;       /*!< Time spent asleep since statistics were reset */
+} eventloop_stats_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Initialize the scheduler queue and power management
+ *
+ * @return sysret_t Module status
+ */
+sysret_t eventloop_init(void);
+
+/**
+ * @brief Queue a work item to run in the main loop, safe to call from
+ *        interrupts
+ *
+ * @param work - Work item, see @ref EVENTLOOP_WORK_DEF
+ */
+void eventloop_post(eventloop_work_t* work);
+
+/**
+ * @brief Run every queued work item, then sleep until the next interrupt
+ *        if there's nothing left to do, meant to be called in the main loop
+ *
+ * In the FreeRTOS build this runs in the system task and waits for work to
+ * be posted instead, the idle task does the sleeping.
+ */
+void eventloop_process(void);
+
+/**
+ * @brief Get wake-to-work latency and sleep statistics
+ *
+ * @param out - Statistics will be saved here
+ */
+void eventloop_get_stats(eventloop_stats_t* out);
+
+/**
+ * @brief Reset statistics, e.g. before measuring a specific workload
+ */
+void eventloop_reset_stats(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* EVENTLOOP_H */
@@ -0,0 +1,133 @@
+/**
+ * @file gyrobias.h
+ * @author UBC Capstone Team 2020/2021
+ * @brief Online gyroscope bias estimation
+ *
+ * The ICM20649 is sampled in the background at a low rate. Whenever both
+ * the gyroscope and accelerometer variance over a sliding window fall below
+ * their thresholds the device is considered still, and the window mean of
+ * the gyroscope (what's left of the bias after the current offsets) is
+ * folded into the bias estimate with an exponential moving average.
+ *
+ * The estimate is written to the ICM20649 driver gyroscope offsets, so it's
+ * applied in the conversion path of every reading. While held, e.g. for a
+ * datalog session, the offsets stay fixed and the estimate keeps tracking
+ * the bias until it's released.
+ */
+
+#ifndef GYROBIAS_H
+#define GYROBIAS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "retcodes.h"
+
+/**
+ * @brief Background sampling period in ms
+ */
+#define GYROBIAS_SAMPLE_PERIOD_MS 20U
+
+/**
+ * @brief Number of samples in the stillness detection window
+ */
+#define GYROBIAS_WINDOW_SIZE 64U
+
+/**
+ * @brief Stillness thresholds, variance in LSB^2
+ */
+#define GYROBIAS_GYRO_VAR_THRESHOLD  64  /*!< ~0.5 dps RMS at +/- 2000 dps */
+#define GYROBIAS_ACCEL_VAR_THRESHOLD 100 /*!< ~10 mg RMS at +/- 30g */
+
+/**
+ * @brief Estimate update weight is 1 / 2^GYROBIAS_EMA_SHIFT
+ */
+#define GYROBIAS_EMA_SHIFT 3U
+
+/**
+ * @brief Minimum time between saving the estimate to flash, in seconds
+ */
+#define GYROBIAS_PERSIST_PERIOD_S 600U
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Initialize the estimator and start background sampling
+ *
+ * @param saved - Previously saved bias in LSB to start from, or NULL to
+ *                start from the driver's current offsets
+ * @return sysret_t Module status
+ */
+sysret_t gyrobias_init(const int16_t saved[3]);
+
+/**
+ * @brief Sample the ICM20649 if it's time to and update the estimate,
+ *        run in the main loop by the background sampling timer
+ */
+void gyrobias_process(void);
+
+/**
+ * @brief Feed a single reading to the estimator
+ *
+ * @param gyro  - Gyroscope reading, with the current offsets already removed
+ * @param accel - Accelerometer reading
+ */
+void gyrobias_update(const int16_t gyro[3], const int16_t accel[3]);
+
+/**
+ * @brief Whether the last full window was still
+ *
+ * @return true if the device is still
+ */
+bool gyrobias_is_still(void);
+
+/**
+ * @brief Get the current bias estimate
+ *
+ * @param bias - Bias in LSB will be saved here
+ */
+void gyrobias_get(int16_t bias[3]);
+
+/**
+ * @brief Whether the estimate has changed since it was last saved and
+ *        @ref GYROBIAS_PERSIST_PERIOD_S has passed
+ *
+ * @return true if the estimate should be saved
+ */
+bool gyrobias_persist_due(void);
+
+/**
+ * @brief Mark the current estimate as saved
+ */
+void gyrobias_persisted(void);
+
+/**
+ * @brief Keep the driver's offsets fixed, e.g. for a datalog session,
+ *        the estimate is still updated
+ */
+void gyrobias_hold(void);
+
+/**
+ * @brief Write the estimate made while held to the driver and let it
+ *        follow the estimate again
+ */
+void gyrobias_release(void);
+
+/**
+ * @brief Stop background sampling, e.g. while the ICM20649 is asleep
+ */
+void gyrobias_suspend(void);
+
+/**
+ * @brief Restart background sampling
+ *
+ * @return sysret_t Module status
+ */
+sysret_t gyrobias_resume(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* GYROBIAS_H */
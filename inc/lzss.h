@@ -0,0 +1,83 @@
+/**
+ * @file lzss.h
+ * @author UBC Capstone Team 2020/2021
+ * @brief Small LZSS compressor for datalog transfers
+ *
+ * Every compressed block stands on its own, back-references only reach
+ * into the block's own input. The format is byte-aligned so it's cheap to
+ * decode on a phone:
+ *
+ *  - A control byte, then up to 8 tokens. Bit i of the control byte,
+ *    LSB first, says whether token i is a literal (0) or a match (1)
+ *  - A literal is one byte, copied as is
+ *  - A match is a little-endian u16, bits 0-9 are distance - 1
+ *    (1 to @ref LZSS_MAX_INPUT bytes back) and bits 10-15 are
+ *    length - @ref LZSS_MIN_MATCH
+ *
+ * The block ends with the input, unused control bits are ignored.
+ *
+ * Plain C with no SDK dependencies so host tools can build it as is. The
+ * firmware only compresses, @ref lzss_decompress() is left out unless
+ * LZSS_DECOMPRESS is defined, as scripts/cpp does for its checks.
+ */
+
+#ifndef LZSS_H
+#define LZSS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Most input a block can hold, also how far back matches reach
+ */
+#define LZSS_MAX_INPUT 1024U
+
+/**
+ * @brief Shortest match worth encoding
+ */
+#define LZSS_MIN_MATCH 3U
+
+/**
+ * @brief Longest match that can be encoded
+ */
+#define LZSS_MAX_MATCH (LZSS_MIN_MATCH + 63U)
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Compress as much input as fits in the output
+ *
+ * Compressing the first @p consumed bytes again with the same @p dst_cap
+ * gives the same output. Not reentrant, the match table is static.
+ *
+ * @param src      - Input bytes
+ * @param src_len  - Input size, at most @ref LZSS_MAX_INPUT is used
+ * @param dst      - Compressed block will be saved here
+ * @param dst_cap  - Size of @p dst
+ * @param consumed - Number of input bytes in the block will be saved here
+ * @return size_t Size of compressed block
+ */
+size_t lzss_compress(const uint8_t* src, size_t src_len, uint8_t* dst, size_t dst_cap, size_t* consumed);
+
+#ifdef LZSS_DECOMPRESS
+
+/**
+ * @brief Decompress a block
+ *
+ * @param src     - Compressed block
+ * @param src_len - Size of compressed block
+ * @param dst     - Decompressed bytes will be saved here
+ * @param dst_cap - Size of @p dst
+ * @return size_t Decompressed size, 0 if the block is corrupt or doesn't fit
+ */
+size_t lzss_decompress(const uint8_t* src, size_t src_len, uint8_t* dst, size_t dst_cap);
+
+#endif /* LZSS_DECOMPRESS */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* LZSS_H */
@@ -7,6 +7,7 @@
 #ifndef NETWORK_H
 #define NETWORK_H
 
+#include <stdbool.h>
 #include "retcodes.h"
 #include "ble_gatts.h"
 
@@ -26,8 +27,66 @@ typedef struct
     ble_gatts_char_handles_t tx_char_handles; /*!< Characteristic handle to be refered to later on */
     ble_gatts_char_handles_t rx_char_handles; /*!< Characteristic handle to be refered to later on */
     ble_gatts_char_handles_t dev_conf_char_handles; /*!< Characteristic handle to be refered to later on */
+    ble_gatts_char_handles_t telemetry_char_handles; /*!< Characteristic handle to be refered to later on */
 } ble_simpl_service_t;
 
+/**
+ * @brief Connection parameters profiles
+ */
+typedef enum
+{
+    NETWORK_CONN_PROFILE_IDLE = 0, /*!< Long interval with slave latency, for when little data is exchanged */
+    NETWORK_CONN_PROFILE_BULK,     /*!< Shortest interval, for file transfers and firmware updates */
+    NETWORK_CONN_PROFILES_NUM      /*!< Number of profiles */
+} network_conn_profile_t;
+
+/**
+ * @brief Negotiated parameters of the current connection
+ */
+typedef struct
+{
+    bool     connected;        /*!< A central is connected */
+    uint16_t att_mtu;          /*!< Effective ATT_MTU in bytes */
+    uint8_t  data_length;      /*!< Effective link layer payload size in bytes (DLE) */
+    uint8_t  tx_phy;           /*!< TX PHY, see BLE_GAP_PHYS */
+    uint8_t  rx_phy;           /*!< RX PHY, see BLE_GAP_PHYS */
+    uint16_t conn_interval;    /*!< Connection interval in 1.25 ms units */
+    uint16_t slave_latency;    /*!< Slave latency in connection events */
+    uint16_t conn_sup_timeout; /*!< Supervision timeout in 10 ms units */
+    bool     conn_evt_ext;     /*!< Connection events extended while there's data to send */
+    network_conn_profile_t conn_profile; /*!< Profile requested from the central */
+} network_link_info_t;
+
+/**
+ * @brief Version of @ref network_adv_status_t
+ */
+#define NETWORK_ADV_STATUS_VERSION 1U
+
+/**
+ * @brief Device status flags of @ref network_adv_status_t
+ */
+#define NETWORK_ADV_STATUS_LOGGING       0x01U /*!< Datalogging enabled */
+#define NETWORK_ADV_STATUS_CLOCK_UNSET   0x02U /*!< Datetime hasn't been set since boot */
+#define NETWORK_ADV_STATUS_STORAGE_FULL  0x04U /*!< No room left for the datalog */
+#define NETWORK_ADV_STATUS_DATALOG_ERROR 0x08U /*!< Rows failed to be logged this session */
+#define NETWORK_ADV_STATUS_WORN          0x10U /*!< Helmet is being worn */
+
+/**
+ * @brief Device status broadcast as manufacturer specific data in the
+ *        scan response, so devices can be checked on without connecting
+ *
+ * All fields are little-endian.
+ */
+typedef struct __attribute__((__packed__))
+{
+    uint8_t  version;        /*!< NETWORK_ADV_STATUS_VERSION */
+    uint8_t  flags;          /*!< NETWORK_ADV_STATUS_* flags */
+    uint8_t  sessions;       /*!< Datalogging sessions saved */
+    uint16_t new_sessions;   /*!< Datalogging sessions saved since the last complete download */
+    uint8_t  flash_fill;     /*!< Datalog storage used, in percent */
+    uint16_t clock_sync_age; /*!< Minutes since datetime was set, 0xFFFF if unset or longer */
+} network_adv_status_t;
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -50,23 +109,110 @@ sysret_t network_init(void);
 sysret_t network_set_dev_conf_char_response(uint8_t* buf, uint16_t* len);
 
 /**
- * @brief Transmit logdata file packet to mobile app.
- * 
- * @note Size of packet depends on ATT_MTU size (see @ref NRF_SDH_BLE_GATT_MAX_MTU_SIZE) minus ATT header bytes.
- *       Max size is therefore @ref NETWORK_BLE_MAX_ATT_PAYLOAD_SIZE
+ * @brief Queue logdata file packet for transmission to mobile app.
+ *
+ * @note Packets are copied by the SoftDevice, so @p buf can be reused as soon
+ *       as this returns. Keep calling until NRF_ERROR_RESOURCES to keep
+ *       the SoftDevice TX queue full, see @ref network_file_packets_completed().
+ *
+ * @note Size of packet depends on negotiated ATT_MTU size minus ATT header bytes,
+ *       see @ref network_file_packet_max_size()
  *
  * @param buf File packet bytes
- * @param len Size of packet in bytes, max is @ref NETWORK_BLE_MAX_ATT_PAYLOAD_SIZE
- * @return sysret_t 
+ * @param len Size of packet in bytes, max is @ref network_file_packet_max_size()
+ * @return sysret_t
+ * @retval NRF_ERROR_RESOURCES if the TX queue is full, try again after
+ *         some packets complete
  */
 sysret_t network_transmit_file_packet(uint8_t* buf, uint16_t len);
 
+/**
+ * @brief Queue a telemetry packet for transmission to mobile app
+ *
+ * @note Shares the SoftDevice TX queue with file packets, max size is
+ *       @ref network_file_packet_max_size()
+ *
+ * @param buf Telemetry packet bytes
+ * @param len Size of packet in bytes
+ * @return sysret_t
+ * @retval NRF_ERROR_INVALID_STATE if the app isn't subscribed
+ * @retval NRF_ERROR_RESOURCES if the TX queue is full
+ */
+sysret_t network_transmit_telemetry(uint8_t* buf, uint16_t len);
+
+/**
+ * @brief Whether the app has subscribed to telemetry notifications
+ *
+ * @return true if telemetry packets will be sent
+ */
+bool network_telemetry_subscribed(void);
+
+/**
+ * @brief Number of file packets the SoftDevice has finished sending since boot
+ *
+ * @return uint32_t Completed packet count, wraps around
+ */
+uint32_t network_file_packets_completed(void);
+
+/**
+ * @brief Largest file packet that fits in a single notification
+ *        on the current connection
+ *
+ * @return uint16_t Max packet size in bytes, 0 if not connected
+ */
+uint16_t network_file_packet_max_size(void);
+
 /**
  * @brief Process BLE CLI
  * @note  This function is meant to only be called in shell.c
  */
 void network_cli_process(void);
 
+/**
+ * @brief Ask for the fastest link the central supports, meant for bulk
+ *        transfers such as datalog downloads
+ *
+ * When enabled, connection events are extended for as long as there is
+ * data queued, and 2M PHY and the max data length are requested if not
+ * already in use. Results are reported as the central responds, see
+ * @ref network_get_link_info().
+ *
+ * @param enable - true to request high throughput, false to stop extending
+ *                 connection events
+ * @return sysret_t Module status
+ */
+sysret_t network_high_throughput_request(bool enable);
+
+/**
+ * @brief Switch connection parameters profile
+ *
+ * The profile becomes the preferred parameters for new connections, and
+ * the central is asked to switch if one is connected. Results are reported
+ * as the central responds, see @ref network_get_link_info().
+ *
+ * @param profile - Profile to switch to
+ * @return sysret_t Module status
+ */
+sysret_t network_set_conn_profile(network_conn_profile_t profile);
+
+/**
+ * @brief Get negotiated parameters of the current connection
+ *
+ * @param info - Link information will be saved here
+ */
+void network_get_link_info(network_link_info_t* info);
+
+/**
+ * @brief Update device status broadcast in the scan response
+ *
+ * @note Takes effect without restarting advertising, and is kept when
+ *       advertising restarts after a disconnection.
+ *
+ * @param status - Device status
+ * @return sysret_t Driver status
+ */
+sysret_t network_set_adv_status(const network_adv_status_t* status);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,130 @@
+/**
+ * @file power.h
+ * @author UBC Capstone Team 2020/2021
+ * @brief System power manager
+ *
+ * Every peripheral is moved into the lowest power state that still lets
+ * the device do what the current mode needs:
+ *
+ *     mode      ICM20649     ADXL372    MT25Q            VCNL4040
+ *     ACTIVE    low-noise    full band  awake            on
+ *     ARMED     sleep        instant-on deep power-down  on
+ *     TRANSFER  duty-cycled  standby    awake            shutdown
+ *     IDLE      duty-cycled  standby    deep power-down  shutdown
+ *     WATCH     sleep        standby    deep power-down  on
+ *     SLEEP     sleep        standby    deep power-down  shutdown
+ *
+ * The ICM20649 stays duty-cycled outside of ARMED and SLEEP so the
+ * gyroscope bias estimate keeps being refined. In ARMED only the ADXL372
+ * is awake, watching for an impact to start datalogging. The VCNL4040
+ * stays on whenever datalogging is enabled, to tell if the helmet is worn. The MT25Q wakes up by itself on the next
+ * access, so it's put back in deep power-down every time a mode that
+ * doesn't need it is set again.
+ *
+ * Time spent in each mode is tracked, which along with the current drawn
+ * in each mode gives the average current and predicted battery life.
+ */
+
+#ifndef POWER_H
+#define POWER_H
+
+#include <stdint.h>
+#include "retcodes.h"
+
+/**
+ * @brief Power modes
+ */
+typedef enum
+{
+    POWER_MODE_ACTIVE = 0, /*!< Datalogging, everything on */
+    POWER_MODE_ARMED,      /*!< Waiting for an impact to start datalogging */
+    POWER_MODE_TRANSFER,   /*!< Reading or writing flash for the app */
+    POWER_MODE_IDLE,       /*!< Nothing to do, device may still be connected */
+    POWER_MODE_WATCH,      /*!< Datalogging enabled, waiting for the helmet to be worn */
+    POWER_MODE_SLEEP,      /*!< Nothing to do for a while, no connection */
+    POWER_MODES            /*!< Max number of power modes */
+} power_mode_t;
+
+/**
+ * @brief Typical current drawn by the whole device in each mode in uA,
+ *        datasheet figures for the sensors and flash plus the nRF52
+ *        advertising. Replace with figures measured with a power profiler
+ *        for a better battery life prediction.
+ */
+#define POWER_CURRENT_ACTIVE_UA   4500U
+#define POWER_CURRENT_ARMED_UA    145U
+#define POWER_CURRENT_TRANSFER_UA 3000U
+#define POWER_CURRENT_IDLE_UA     1300U
+#define POWER_CURRENT_WATCH_UA    140U
+#define POWER_CURRENT_SLEEP_UA    40U
+
+/**
+ * @brief Capacity of the battery in mAh, used to predict battery life
+ */
+#define POWER_BATTERY_CAPACITY_MAH 500U
+
+/**
+ * @brief Time spent in each mode and what it means for the battery
+ */
+typedef struct
+{
+    power_mode_t mode;                 /*!< Current mode */
+    uint32_t residency_s[POWER_MODES]; /*!< Time spent in each mode since statistics were reset */
+    uint32_t elapsed_s;                /*!< Time since statistics were reset */
+    uint32_t avg_current_ua;           /*!< Average current over elapsed_s */
+    uint32_t battery_life_h;           /*!< Predicted battery life at avg_current_ua */
+} power_stats_t;
+
+/**
+ * @brief Printable names of power modes
+ */
+extern const char* power_mode_strings[POWER_MODES];
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Initialize the power manager, peripherals are left as they are
+ *        until a mode is set
+ *
+ * @return sysret_t Module status
+ */
+sysret_t power_init(void);
+
+/**
+ * @brief Move every peripheral into the state the mode needs
+ *
+ * Time spent in the previous mode is accounted for on every call, so call
+ * at least every few minutes, before the app_timer counter wraps.
+ *
+ * @param mode - Power mode
+ * @return sysret_t Module status, the first peripheral to fail, the
+ *         others are still set
+ */
+sysret_t power_set_mode(power_mode_t mode);
+
+/**
+ * @brief Get current mode
+ *
+ * @return power_mode_t Current mode
+ */
+power_mode_t power_get_mode(void);
+
+/**
+ * @brief Get residency and battery life statistics
+ *
+ * @param stats - Statistics will be saved here
+ */
+void power_get_stats(power_stats_t* stats);
+
+/**
+ * @brief Reset statistics, e.g. at the start of a season
+ */
+void power_reset_stats(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* POWER_H */
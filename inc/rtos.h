@@ -0,0 +1,102 @@
+/**
+ * @file rtos.h
+ * @author UBC Capstone Team 2020/2021
+ * @brief FreeRTOS build of the firmware, built with make RTOS=1
+ *
+ * The superloop runs everything one after the other in the main loop. This
+ * build splits the same modules into tasks instead, highest priority first:
+ * - acquisition, the filter stage of the acquisition pipeline
+ * - storage, the store stage, rows to the datalog
+ * - network, the stream stage, samples to the live stream
+ * - ble, dispatches SoftDevice events to their observers, under the lock
+ *   like every other task since they call into the state machine
+ * - system, the event loop, state machine and every other work item
+ * - shell, the CLI, polled every RTOS_SHELL_POLL_PERIOD_MS
+ *
+ * Sampling itself stays in its interrupt, see acquisition.h, the stages
+ * pass rows through the pipeline queues and wake each other up.
+ *
+ * Drivers and modules aren't reentrant, so tasks hold one shared lock
+ * while they run module code, see rtos_lock(). A task only gets preempted
+ * between rows or work items. The lock is a mutex, a low priority task
+ * holding it is raised to the priority of the task waiting for it.
+ *
+ * The idle task sleeps with the RTOS tick suppressed until the next timer
+ * or interrupt, so the tick doesn't wake the CPU up for nothing.
+ */
+
+#ifndef RTOS_H
+#define RTOS_H
+
+#include <stdint.h>
+#include "retcodes.h"
+
+/**
+ * @brief CLI polling period
+ */
+#define RTOS_SHELL_POLL_PERIOD_MS 20U
+
+/**
+ * @brief Tasks
+ */
+typedef enum
+{
+    RTOS_TASK_SYSTEM = 0,   /*!< Event loop */
+    RTOS_TASK_ACQUISITION,  /*!< Filter stage */
+    RTOS_TASK_STORAGE,      /*!< Store stage */
+    RTOS_TASK_NETWORK,      /*!< Stream stage */
+    RTOS_TASK_SHELL,        /*!< CLI */
+    RTOS_TASK_BLE,          /*!< SoftDevice events */
+    RTOS_TASKS              /*!< Number of tasks */
+} rtos_task_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Start the scheduler, never returns
+ *
+ * The system task runs init first, then starts the other tasks.
+ *
+ * @param init - Initializes every module
+ */
+void rtos_start(void (*init)(void));
+
+/**
+ * @brief Wake a task up, safe to call from interrupts. Does nothing if the
+ *        task isn't running yet.
+ *
+ * @param task - Task to wake
+ */
+void rtos_wake(rtos_task_t task);
+
+/**
+ * @brief Wait until the calling task is woken up with @ref rtos_wake()
+ */
+void rtos_wait(void);
+
+/**
+ * @brief Take the lock around module code, tasks can take it again while
+ *        holding it
+ */
+void rtos_lock(void);
+
+/**
+ * @brief Release the lock, once for every @ref rtos_lock()
+ */
+void rtos_unlock(void);
+
+/**
+ * @brief Get the least stack each task has had left
+ *
+ * @param task - Task
+ * @return uint32_t Bytes never used, 0 if the task isn't running
+ */
+uint32_t rtos_stack_free(rtos_task_t task);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* RTOS_H */
@@ -0,0 +1,65 @@
+/**
+ * @file sampleclock.h
+ * @author UBC Capstone Team 2020/2021
+ * @brief Sampling clock, paces sensor sampling off a hardware timer
+ *
+ * The period is kept in 32768 Hz ticks, same as the configured sample
+ * rates, and run off a 16 MHz TIMER so it doesn't depend on app_timer or
+ * the RTOS tick. The timer clears itself on every tick, so reading it
+ * back from the sampling code gives the latency from the tick to the
+ * sensors being read, which is how sampling jitter is measured.
+ */
+
+#ifndef SAMPLECLOCK_H
+#define SAMPLECLOCK_H
+
+#include <stdint.h>
+#include "retcodes.h"
+
+/**
+ * @brief Frequency the period is given in, in Hz
+ */
+#define SAMPLECLOCK_TICK_FREQ 32768U
+
+/**
+ * @brief Tick handler, runs in the timer interrupt
+ */
+typedef void (*sampleclock_handler_t)(void);
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Initialize the sampling clock, left stopped
+ *
+ * @return sysret_t Module status
+ */
+sysret_t sampleclock_init(void);
+
+/**
+ * @brief Start ticking
+ *
+ * @param ticks   - Period in 32768 Hz ticks
+ * @param handler - Called on every tick
+ * @return sysret_t Module status
+ */
+sysret_t sampleclock_start(uint32_t ticks, sampleclock_handler_t handler);
+
+/**
+ * @brief Stop ticking
+ */
+void sampleclock_stop(void);
+
+/**
+ * @brief Time since the last tick, safe to call from interrupts
+ *
+ * @return uint32_t Time since the last tick in us
+ */
+uint32_t sampleclock_since_tick_us(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SAMPLECLOCK_H */
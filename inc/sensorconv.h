@@ -0,0 +1,175 @@
+/**
+ * @file sensorconv.h
+ * @author UBC Capstone Team 2020/2021
+ * @brief Batch conversion kernels for raw sensor frames
+ *
+ * Converts buffers of big-endian register data (as clocked out of the
+ * sensors over SPI) into host-order int16_t channels in place.
+ *
+ * On Cortex-M4 the kernels use the DSP SIMD instructions to work on two
+ * channels per instruction. Everywhere else (e.g. when compiled on a host
+ * machine) the scalar reference implementations are used instead, which
+ * are bit-exact with the SIMD versions. scripts/cpp/convbench checks that
+ * on the host, `sensor convbench` times both on the device.
+ */
+
+#ifndef SENSORCONV_H
+#define SENSORCONV_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+/**
+ * @brief Number of channels in a single sensor frame (X, Y, Z)
+ */
+#define SENSORCONV_AXES 3U
+
+/**
+ * @brief Size of a single sensor frame in bytes
+ */
+#define SENSORCONV_FRAME_SIZE (SENSORCONV_AXES * sizeof(int16_t))
+
+/**
+ * @brief Fractional bits of the calibration matrix terms (Q2.14)
+ */
+#define SENSORCONV_CAL_FRAC_BITS 14U
+
+/**
+ * @brief 1.0 in calibration matrix fixed point
+ */
+#define SENSORCONV_CAL_ONE (1 << SENSORCONV_CAL_FRAC_BITS)
+
+/**
+ * @brief Largest ADXL372 bias magnitude in LSB. Readings are 12 bits, the
+ *        SIMD kernel scales the bias by 16 to line up with left-justified
+ *        data, so anything wider would overflow 16 bits.
+ */
+#define SENSORCONV_ADXL372_BIAS_LIMIT 2047
+
+/**
+ * @brief Index of each term of the upper-triangular calibration matrix
+ */
+typedef enum
+{
+    SENSORCONV_CAL_Q11 = 0,
+    SENSORCONV_CAL_Q12,
+    SENSORCONV_CAL_Q13,
+    SENSORCONV_CAL_Q22,
+    SENSORCONV_CAL_Q23,
+    SENSORCONV_CAL_Q33,
+    SENSORCONV_CAL_TERMS /*!< Number of matrix terms */
+} sensorconv_cal_term_t;
+
+/**
+ * @brief 9-parameter accelerometer calibration
+ *
+ * Calibrated output is u = Q * (x - bias), where Q is upper-triangular
+ * and holds 3 scale and 3 misalignment terms, same as the model used by
+ * scripts/cpp/accelerometer_calibration.cpp.
+ *
+ * Each row of Q must satisfy |q1| + |q2| + |q3| < 4.0 so the
+ * fixed-point accumulation can't overflow.
+ */
+typedef struct
+{
+    int16_t bias[SENSORCONV_AXES];  /*!< Per-axis bias in LSB */
+    int16_t q[SENSORCONV_CAL_TERMS]; /*!< Matrix terms in Q2.14, see @ref sensorconv_cal_term_t */
+} sensorconv_cal_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Convert ADXL372 frames in place
+ *
+ * Each frame holds X, Y, Z as big-endian 12-bit left-justified values.
+ * After conversion each channel holds the 12-bit reading sign-extended
+ * to 16 bits (100mg/LSB) with its offset subtracted.
+ *
+ * @note For the SIMD path buf must be 4-byte aligned, otherwise the
+ *       scalar reference is used.
+ *
+ * @param buf     - Frames to convert, SENSORCONV_AXES channels per frame
+ * @param frames  - Number of frames in buf
+ * @param offsets - Per-axis offset in LSB, must be within the 12-bit range
+ */
+void sensorconv_adxl372(int16_t* buf, size_t frames, const int16_t offsets[SENSORCONV_AXES]);
+
+/**
+ * @brief Convert ICM20649 frames in place
+ *
+ * Each frame holds X, Y, Z as big-endian 16-bit values. After conversion
+ * each channel holds the reading in host byte order with its offset subtracted.
+ *
+ * @note For the SIMD path buf must be 4-byte aligned, otherwise the
+ *       scalar reference is used.
+ *
+ * @param buf     - Frames to convert, SENSORCONV_AXES channels per frame
+ * @param frames  - Number of frames in buf
+ * @param offsets - Per-axis offset in LSB
+ */
+void sensorconv_icm20649(int16_t* buf, size_t frames, const int16_t offsets[SENSORCONV_AXES]);
+
+/**
+ * @brief Apply the scale and misalignment terms of a calibration in place
+ *
+ * Bias has to be removed beforehand, which the conversion kernels do
+ * when given cal->bias as their offsets. Results are rounded to nearest
+ * and saturated to 16 bits.
+ *
+ * @note For the SIMD path buf must be 4-byte aligned, otherwise the
+ *       scalar reference is used.
+ *
+ * @param buf    - Converted frames, SENSORCONV_AXES channels per frame
+ * @param frames - Number of frames in buf
+ * @param cal    - Calibration to apply
+ */
+void sensorconv_calibrate(int16_t* buf, size_t frames, const sensorconv_cal_t* cal);
+
+/**
+ * @brief Check that a calibration can be applied without overflowing
+ *
+ * @param cal - Calibration to check
+ * @return true if every row of the matrix is within range
+ */
+bool sensorconv_cal_valid(const sensorconv_cal_t* cal);
+
+/**
+ * @brief Check that an ADXL372 calibration can be applied without
+ *        overflowing
+ *
+ * @param cal - Calibration to check
+ * @return true if the matrix is within range and every bias is within
+ *         @ref SENSORCONV_ADXL372_BIAS_LIMIT
+ */
+bool sensorconv_adxl372_cal_valid(const sensorconv_cal_t* cal);
+
+/**
+ * @brief Set a calibration to zero bias and identity matrix
+ *
+ * @param cal - Calibration to reset
+ */
+void sensorconv_cal_identity(sensorconv_cal_t* cal);
+
+/**
+ * @brief Scalar reference implementation of @ref sensorconv_adxl372()
+ */
+void sensorconv_adxl372_ref(int16_t* buf, size_t frames, const int16_t offsets[SENSORCONV_AXES]);
+
+/**
+ * @brief Scalar reference implementation of @ref sensorconv_icm20649()
+ */
+void sensorconv_icm20649_ref(int16_t* buf, size_t frames, const int16_t offsets[SENSORCONV_AXES]);
+
+/**
+ * @brief Scalar reference implementation of @ref sensorconv_calibrate()
+ */
+void sensorconv_calibrate_ref(int16_t* buf, size_t frames, const sensorconv_cal_t* cal);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SENSORCONV_H */
@@ -7,6 +7,7 @@
 #ifndef STATE_MACHINE_H
 #define STATE_MACHINE_H
 
+#include <stdbool.h>
 #include <stddef.h>
 #include "retcodes.h"
 #include "icm20649.h"
@@ -19,6 +20,7 @@ typedef enum
     STATE_UNINIT = 0,       /*!< State machine uninitialized */
     STATE_INIT,             /*!< State machine initialization, transitions to IDLE after */
     STATE_IDLE,             /*!< Idle state */
+    STATE_WAIT_FOR_WEAR,    /*!< Datalogging enabled, waiting for the helmet to be worn */
     STATE_WAIT_FOR_TRIGGER, /*!< Waiting for trigger */
     STATE_DATALOGGING,      /*!< Device is logging data */
     STATE_LOW_POWER,        /*!< Device is in low power mode, some ICs are powered down */
@@ -36,6 +38,7 @@ typedef enum
 typedef struct
 {
     bool log_download_requested;
+    bool log_erase_requested;
     statemachine_states_t state;
 } statemachine_t;
 
@@ -66,7 +69,24 @@ statemachine_states_t statemachine_getstate(void);
 void statemachine_ble_data_handler(uint8_t* data, size_t size);
 
 /**
- * @brief State machine iteration, meant to be called in the main loop
+ * @brief Have the state machine run in the main loop, safe to call from
+ *        interrupts
+ */
+void statemachine_kick(void);
+
+/**
+ * @brief Keep every sensor powered up whatever the state, for commands
+ *        reading them in the background
+ *
+ * Holding has no effect while armed for an impact, the ADXL372 is watching
+ * for it then. Once released, the state's power mode is set again.
+ *
+ * @param hold - if true, keep sensors powered up
+ */
+void statemachine_power_hold(bool hold);
+
+/**
+ * @brief State machine iteration, run in the main loop by @ref statemachine_kick()
  */
 void statemachine_process(void);
 
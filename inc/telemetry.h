@@ -0,0 +1,118 @@
+/**
+ * @file telemetry.h
+ * @author UBC Capstone Team 2020/2021
+ * @brief Live sensor data stream over BLE
+ *
+ * Filtered samples are tapped out of the acquisition pipeline while
+ * datalogging, so the stream never changes what gets sampled or logged.
+ * Records are either every Nth sample or the peak of each channel over a
+ * window of N samples, packed into notifications as large as the ATT_MTU
+ * allows. A packet that doesn't fit in the SoftDevice TX queue is dropped
+ * rather than waited on, the gap in sequence numbers tells the app.
+ */
+
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "retcodes.h"
+#include "cfcfilter.h"
+
+/**
+ * @brief Default record rate in Hz
+ */
+#define TELEMETRY_DEFAULT_RATE_HZ 50U
+
+/**
+ * @brief Telemetry modes
+ */
+typedef enum
+{
+    TELEMETRY_OFF = 0,     /*!< Nothing streamed */
+    TELEMETRY_SAMPLES,     /*!< Every Nth filtered sample */
+    TELEMETRY_PEAKS,       /*!< Largest magnitude of each channel over N samples, sign kept */
+    TELEMETRY_MODES_NUM    /*!< Not a mode */
+} telemetry_mode_t;
+
+/**
+ * @brief Header at the start of every telemetry packet, little-endian
+ *
+ * Records follow, each one int16_t per channel in @ref cfcfilter_channel_t
+ * order. A channel whose sensor failed holds its last good reading.
+ */
+typedef struct __attribute__((__packed__))
+{
+    uint8_t  mode;     /*!< @ref telemetry_mode_t of the records */
+    uint8_t  count;    /*!< Number of records in packet */
+    uint16_t seq;      /*!< Packet number since acquisition started, gaps are dropped packets */
+    uint32_t first;    /*!< Sample number of first record since acquisition started */
+    uint16_t interval; /*!< Samples between records */
+} telemetry_packet_header_t;
+
+/**
+ * @brief A telemetry record
+ */
+typedef struct __attribute__((__packed__))
+{
+    int16_t channels[CFCFILTER_CHANNELS];
+} telemetry_record_t;
+
+/**
+ * @brief Telemetry counters since acquisition started
+ */
+typedef struct
+{
+    telemetry_mode_t mode;    /*!< Mode in use */
+    uint32_t interval;        /*!< Samples between records */
+    uint32_t sent_packets;    /*!< Packets handed to the SoftDevice */
+    uint32_t dropped_packets; /*!< Packets dropped because the TX queue was full */
+} telemetry_stats_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Choose what gets streamed, takes effect on the next acquisition
+ *        session or straight away if one is running
+ *
+ * @param mode    - What to stream
+ * @param rate_hz - Records per second, 0 for @ref TELEMETRY_DEFAULT_RATE_HZ
+ * @return sysret_t Module status
+ * @retval NRF_ERROR_INVALID_PARAM if the mode doesn't exist
+ */
+sysret_t telemetry_configure(telemetry_mode_t mode, uint16_t rate_hz);
+
+/**
+ * @brief Start a new stream, called when acquisition starts
+ *
+ * @param sample_rate - Rate samples are fed in at, in Hz
+ */
+void telemetry_start(float sample_rate);
+
+/**
+ * @brief Feed a filtered sample into the stream
+ *
+ * @param channels - One reading per channel, see @ref cfcfilter_channel_t
+ */
+void telemetry_push(const int16_t channels[CFCFILTER_CHANNELS]);
+
+/**
+ * @brief Send whatever records are waiting and end the stream,
+ *        called when acquisition stops
+ */
+void telemetry_stop(void);
+
+/**
+ * @brief Get telemetry counters
+ *
+ * @param stats - Counters will be saved here
+ */
+void telemetry_get_stats(telemetry_stats_t* stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TELEMETRY_H */
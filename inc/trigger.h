@@ -0,0 +1,83 @@
+/**
+ * @file trigger.h
+ * @author UBC Capstone Team 2020/2021
+ * @brief Impact trigger, the ADXL372 watches for impacts in instant-on
+ *        mode while everything else sleeps
+ *
+ * With ADXL372_INT1_PIN defined in the board pin mappings the ADXL372
+ * INT1 line wakes the MCU up through a low power GPIOTE input. Without it
+ * the ADXL372 status is polled every TRIGGER_POLL_PERIOD_MS instead. Either
+ * way the ADXL372 keeps its first readings after waking in its FIFO, so the
+ * start of the impact is logged even though sampling starts later.
+ */
+
+#ifndef TRIGGER_H
+#define TRIGGER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "retcodes.h"
+
+/**
+ * @brief Status polling period on boards without the INT1 line wired
+ */
+#define TRIGGER_POLL_PERIOD_MS 100U
+
+/**
+ * @brief Trigger thresholds at or above this use the ADXL372 high
+ *        instant-on threshold, in ADXL372 LSB of 100 mg (30 g)
+ */
+#define TRIGGER_HIGH_THRESH_MIN 300U
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Initialize the impact trigger, left disarmed
+ *
+ * @return sysret_t Module status
+ */
+sysret_t trigger_init(void);
+
+/**
+ * @brief Start watching for impacts, the state machine is kicked when
+ *        one happens
+ *
+ * The ADXL372 only has two instant-on thresholds, the one closest to the
+ * configured threshold is used.
+ *
+ * @param threshold - Resultant acceleration threshold, ADXL372 LSB of 100 mg
+ * @return sysret_t Module status
+ */
+sysret_t trigger_arm(uint16_t threshold);
+
+/**
+ * @brief Stop watching for impacts and clear the ADXL372 interrupt
+ *
+ * After an impact, the readings the ADXL372 kept from its start are left
+ * in its FIFO for @ref acquisition_start() to log.
+ *
+ * @return sysret_t Module status
+ */
+sysret_t trigger_disarm(void);
+
+/**
+ * @brief Check if the trigger is armed
+ *
+ * @return true if armed
+ */
+bool trigger_armed(void);
+
+/**
+ * @brief Check if an impact happened since the trigger was armed
+ *
+ * @return true if an impact happened
+ */
+bool trigger_fired(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TRIGGER_H */
@@ -0,0 +1,87 @@
+/**
+ * @file wear.h
+ * @author UBC Capstone Team 2020/2021
+ * @brief Wear detection, the VCNL4040 proximity sensor tells whether the
+ *        helmet is on a head
+ *
+ * The VCNL4040 interrupts when its reading crosses the close or away
+ * threshold, so nothing is read over I2C while the helmet stays on or
+ * off. With VCNL4040_INT_PIN defined in the board pin mappings the INT
+ * line wakes the MCU up through a low power GPIOTE input. Without it the
+ * interrupt flags are polled every WEAR_POLL_PERIOD_MS instead.
+ */
+
+#ifndef WEAR_H
+#define WEAR_H
+
+#include <stdbool.h>
+#include "retcodes.h"
+
+/**
+ * @brief Proximity reading over which the helmet is worn, in PS counts
+ *        with 16-bit output, tune to the helmet liner
+ */
+#define WEAR_PS_CLOSE_THRESH 1500U
+
+/**
+ * @brief Proximity reading under which the helmet is taken off, in PS
+ *        counts, lower than WEAR_PS_CLOSE_THRESH for hysteresis
+ */
+#define WEAR_PS_AWAY_THRESH 1000U
+
+/**
+ * @brief Interrupt flag polling period on boards without the INT line
+ *        wired. Watching starts with a reading after one period, once
+ *        the sensor has had time to power up.
+ */
+#define WEAR_POLL_PERIOD_MS 1000U
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Initialize wear detection, not watching until @ref wear_watch()
+ *
+ * If the VCNL4040 can't be set up, the helmet is always considered worn
+ * so that datalogging still works.
+ *
+ * @return sysret_t Module status
+ */
+sysret_t wear_init(void);
+
+/**
+ * @brief Start or stop watching for the helmet being put on or taken off,
+ *        the state machine is kicked on every change
+ *
+ * The VCNL4040 must be powered while watching, see power.h.
+ *
+ * @param en - if true, start watching
+ * @return sysret_t Module status
+ */
+sysret_t wear_watch(bool en);
+
+/**
+ * @brief Start watching from a known wear state, for a device picking
+ *        datalogging up again after a reset
+ *
+ * The helmet counts as worn or not straight away, instead of after the
+ * first reading. The first reading still corrects it.
+ *
+ * @param worn - if true, the helmet was on when the device reset
+ * @return sysret_t Module status
+ */
+sysret_t wear_watch_from(bool worn);
+
+/**
+ * @brief Check if the helmet is being worn
+ *
+ * @return true if worn
+ */
+bool wear_is_worn(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* WEAR_H */
@@ -5,10 +5,9 @@
  */
 
 #include "nrf.h"
-#include "nrf_delay.h"
 #include "nrf_log.h"
+#include "nrf_log_ctrl.h"
 #include "nrf_gpio.h"
-#include "nrf_delay.h"
 #include "nrf_drv_clock.h"
 #include "app_timer.h"
 #include "datetime.h"
@@ -21,6 +20,16 @@
 #include "mt25q.h"
 #include "network.h"
 #include "statemachine.h"
+#include "eventloop.h"
+#include "power.h"
+#include "trigger.h"
+#include "wear.h"
+#include "sampleclock.h"
+#include "boot.h"
+
+#ifdef FREERTOS
+#include "rtos.h"
+#endif
 
 /**
  * @brief ADXL372 config
@@ -63,6 +72,90 @@ static mt25q_cfg_t mt25q_cfg = {
     .timeout_ms = 100
 };
 
+/**
+ * @brief Boot step, an init function and its name in the boot log
+ */
+typedef struct
+{
+    const char* name;       /*!< Name in the boot log */
+    sysret_t (*init)(void); /*!< Init function */
+} boot_step_t;
+
+/**
+ * @brief Wait for the ADXL372 to answer, then configure it
+ */
+static sysret_t adxl372_setup(void)
+{
+    sysret_t ret = boot_wait_ready(adxl372_test);
+    SYSRET_CHECK(ret);
+
+    return adxl372_init(&adxl372_cfg);
+}
+
+/**
+ * @brief Wait for the ICM20649 to answer, then configure it
+ */
+static sysret_t icm20649_setup(void)
+{
+    sysret_t ret = boot_wait_ready(icm20649_test);
+    SYSRET_CHECK(ret);
+
+    return icm20649_init(&icm20649_cfg);
+}
+
+/**
+ * @brief Wait for the VCNL4040 to answer, then configure it
+ */
+static sysret_t vcnl4040_setup(void)
+{
+    sysret_t ret = boot_wait_ready(vcnl4040_test);
+    SYSRET_CHECK(ret);
+
+    return vcnl4040_init(&vcnl4040_cfg);
+}
+
+/**
+ * @brief Wait for the MT25Q to answer, then configure it
+ */
+static sysret_t mt25q_setup(void)
+{
+    sysret_t ret = boot_wait_ready(mt25q_test);
+    SYSRET_CHECK(ret);
+
+    return mt25q_init(&mt25q_cfg);
+}
+
+/**
+ * @brief Capture stage, everything sampling and datalogging need, in order
+ */
+static const boot_step_t capture_steps[] =
+{
+    { "EVTLOOP ", eventloop_init },
+    { "SPI     ", spi_init },
+    { "I2C     ", i2c_init },
+    { "ADXL372 ", adxl372_setup },
+    { "ICM20649", icm20649_setup },
+    { "VCNL4040", vcnl4040_setup },
+    { "MT25Q   ", mt25q_setup },
+    { "Sampling", sampleclock_init },
+    { "Power   ", power_init },
+    { "Trigger ", trigger_init },
+    { "Wear    ", wear_init },
+    { "Datetime", datetime_init }
+};
+
+/**
+ * @brief Capture stage results, logged once the shell is up
+ */
+static sysret_t capture_status[ARRAY_SIZE(capture_steps)];
+
+static void link_init(void);
+
+/**
+ * @brief Runs @ref link_init() in the main loop
+ */
+EVENTLOOP_WORK_DEF(link_init_work, link_init);
+
 /**
  * @brief Initialize hardware resources used throught the system
  * 
@@ -72,15 +165,61 @@ static sysret_t sys_init(void)
 {
     sysret_t ret = RET_ERR;
 
+    NRF_LOG_INIT(NULL);
+
     if((ret = nrf_drv_clock_init()) == RET_OK)
     {
         nrf_drv_clock_lfclk_request(NULL);
-        ret = app_timer_init();
+
+        if((ret = app_timer_init()) == RET_OK)
+            ret = boot_init();
     }
 
     return ret;
 }
 
+/**
+ * @brief Link stage, the shell and BLE, run by the event loop after the
+ *        state machine's first pass
+ */
+static void link_init(void)
+{
+    uint32_t capture_ms = 0U;
+    uint32_t link_ms = 0U;
+
+    sysret_t shell_status = shell_init();
+    NRF_LOG_INFO("SHELL    - [%s]", retcodes_desc[shell_status]);
+
+    /* the log had nowhere to go before the shell */
+    for(size_t step = 0U ; step < ARRAY_SIZE(capture_steps) ; step++)
+        NRF_LOG_INFO("%s - [%s]", capture_steps[step].name, retcodes_desc[capture_status[step]]);
+
+    NRF_LOG_INFO("Network  - [%s]", retcodes_desc[network_init()]);
+
+    boot_mark(BOOT_MARK_LINK_READY);
+    (void)boot_elapsed_ms(BOOT_MARK_CAPTURE_READY, &capture_ms);
+    (void)boot_elapsed_ms(BOOT_MARK_LINK_READY, &link_ms);
+    NRF_LOG_INFO("Boot     - capture ready [%d ms] | link ready [%d ms] | datalog [%s]",
+        capture_ms, link_ms, boot_datalog_resume() ? "resumed" : "off");
+}
+
+/**
+ * @brief Initialize the capture stage and the state machine, then leave the
+ *        link stage to the event loop
+ */
+static void modules_init(void)
+{
+    /* devices are polled until they answer, no power-on delay */
+    for(size_t step = 0U ; step < ARRAY_SIZE(capture_steps) ; step++)
+        capture_status[step] = capture_steps[step].init();
+
+    /* picks datalogging up on its first pass if the device reset while logging */
+    (void)statemachine_init();
+    boot_mark(BOOT_MARK_CAPTURE_READY);
+
+    eventloop_post(&link_init_work);
+}
+
 /**
  * @brief Main firmware entry point
  * 
@@ -91,33 +230,23 @@ int main(void)
     /* initialize system hardware */
     (void)sys_init();
 
-    /**
-     * Why the delay?
-     * To give enough time for the sensors' power-on sequences
-     */
-    nrf_delay_ms(1000);
-
-    /* initialize system modules */
-    sysret_t shell_status =  shell_init();
-    NRF_LOG_INFO("SHELL    - [%s]", retcodes_desc[shell_status]);
-    NRF_LOG_INFO("SPI      - [%s]", retcodes_desc[spi_init()]);
-    NRF_LOG_INFO("I2C      - [%s]", retcodes_desc[i2c_init()]);
-    NRF_LOG_INFO("ADXL372  - [%s]", retcodes_desc[adxl372_init(&adxl372_cfg)]);
-    NRF_LOG_INFO("ICM20649 - [%s]", retcodes_desc[icm20649_init(&icm20649_cfg)]);
-    NRF_LOG_INFO("VCNL4040 - [%s]", retcodes_desc[vcnl4040_init(&vcnl4040_cfg)]);
-    NRF_LOG_INFO("MT25Q    - [%s]", retcodes_desc[mt25q_init(&mt25q_cfg)]);
-    NRF_LOG_INFO("Datetime - [%s]", retcodes_desc[datetime_init()]);
-    NRF_LOG_INFO("Network  - [%s]", retcodes_desc[network_init()]);
-
-    /* initialize state machine */
-    (void)statemachine_init();
+#ifdef FREERTOS
+    /* modules are initialized by the system task, see rtos.h */
+    rtos_start(modules_init);
+#else
+    modules_init();
 
     while(1)
     {
-        /* infinite loop */
+        /**
+         * Work posted by timer and BLE events runs here, then the CPU
+         * sleeps until the next interrupt. The CLI is polled on every
+         * wakeup, UART input wakes the CPU by itself.
+         */
         shell_process();
-        statemachine_process();
+        eventloop_process();
     }
+#endif
 
     /* we should never get here */
     return 0;
@@ -0,0 +1,61 @@
+/*
+ * Host stand-in for nrf.h, only what src/sensorconv.c needs: portable C
+ * versions of the Cortex-M4 DSP SIMD intrinsics, with the semantics given
+ * in the ARMv7-M Architecture Reference Manual. Lets convbench build the
+ * SIMD kernels on a host machine and check them against the scalar ones.
+ */
+
+#ifndef ARMHOST_NRF_H
+#define ARMHOST_NRF_H
+
+#include <stdint.h>
+
+static inline int32_t armhost_lo(uint32_t x) { return (int16_t)(x & 0xFFFFU); }
+static inline int32_t armhost_hi(uint32_t x) { return (int16_t)(x >> 16U); }
+
+static inline uint32_t armhost_pack(int32_t lo, int32_t hi)
+{
+    return ((uint32_t)lo & 0xFFFFU) | (((uint32_t)hi & 0xFFFFU) << 16U);
+}
+
+static inline uint32_t __REV16(uint32_t x)
+{
+    return ((x & 0x00FF00FFU) << 8U) | ((x & 0xFF00FF00U) >> 8U);
+}
+
+static inline uint32_t __SSUB16(uint32_t a, uint32_t b)
+{
+    return armhost_pack(armhost_lo(a) - armhost_lo(b), armhost_hi(a) - armhost_hi(b));
+}
+
+/* halving operations keep the 17-bit intermediate, shift is arithmetic */
+static inline uint32_t __SHADD16(uint32_t a, uint32_t b)
+{
+    return armhost_pack((armhost_lo(a) + armhost_lo(b)) >> 1, (armhost_hi(a) + armhost_hi(b)) >> 1);
+}
+
+static inline uint32_t __SHSUB16(uint32_t a, uint32_t b)
+{
+    return armhost_pack((armhost_lo(a) - armhost_lo(b)) >> 1, (armhost_hi(a) - armhost_hi(b)) >> 1);
+}
+
+/* products and accumulation wrap at 32 bits like the instructions do */
+static inline uint32_t __SMUAD(uint32_t x, uint32_t y)
+{
+    return (uint32_t)(armhost_lo(x) * armhost_lo(y)) + (uint32_t)(armhost_hi(x) * armhost_hi(y));
+}
+
+static inline uint32_t __SMLAD(uint32_t x, uint32_t y, uint32_t acc)
+{
+    return __SMUAD(x, y) + acc;
+}
+
+static inline int32_t __SSAT(int32_t v, uint32_t bits)
+{
+    const int32_t max = (int32_t)((1UL << (bits - 1U)) - 1U);
+    const int32_t min = -max - 1;
+
+    return (v > max) ? max : (v < min) ? min : v;
+}
+
+#endif /* ARMHOST_NRF_H */
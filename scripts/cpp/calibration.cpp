@@ -0,0 +1,335 @@
+// 9-parameter accelerometer calibration
+
+#include "calibration.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <stdexcept>
+#include <string>
+
+namespace imucal {
+
+namespace {
+
+constexpr int    PARAMS    = TERMS + 3; // 6 matrix terms followed by 3 biases
+constexpr size_t BLOCK     = 256;       // samples per normal equation update
+constexpr int    FRAC_BITS = 14;        // Q2.14, SENSORCONV_CAL_FRAC_BITS
+constexpr double ROW_LIMIT = 4.0;       // sum of |q| per row must stay below this on the device
+constexpr uint16_t BLOB_MAGIC = 0xCA1B; // CONFIGS_CALIBRATION_MAGIC
+
+// Solve A * x = v in place (v becomes x) for symmetric positive definite A
+// with an LDL^T decomposition. Returns false if A is singular.
+bool solve_ldl(double A[PARAMS][PARAMS], double v[PARAMS])
+{
+    double d[PARAMS];
+
+    for (int j = 0; j < PARAMS; j++)
+    {
+        double s = A[j][j];
+        for (int k = 0; k < j; k++)
+            s -= A[j][k] * A[j][k] * d[k];
+
+        if (!(s > 1e-300))
+            return false;
+        d[j] = s;
+
+        for (int i = j + 1; i < PARAMS; i++)
+        {
+            double t = A[i][j];
+            for (int k = 0; k < j; k++)
+                t -= A[i][k] * A[j][k] * d[k];
+            A[i][j] = t / d[j];
+        }
+    }
+
+    // forward substitution, L * y = v
+    for (int i = 0; i < PARAMS; i++)
+        for (int k = 0; k < i; k++)
+            v[i] -= A[i][k] * v[k];
+
+    // D * z = y
+    for (int i = 0; i < PARAMS; i++)
+        v[i] /= d[i];
+
+    // back substitution, L^T * x = z
+    for (int i = PARAMS - 1; i >= 0; i--)
+        for (int k = i + 1; k < PARAMS; k++)
+            v[i] -= A[k][i] * v[k];
+
+    return true;
+}
+
+int16_t to_int16(double v, const char* what)
+{
+    double r = std::round(v);
+    if (r < INT16_MIN || r > INT16_MAX)
+        throw std::range_error(std::string(what) + " out of range");
+    return static_cast<int16_t>(r);
+}
+
+void put16(uint8_t*& p, uint16_t v)
+{
+    *p++ = static_cast<uint8_t>(v);
+    *p++ = static_cast<uint8_t>(v >> 8);
+}
+
+} // namespace
+
+std::vector<uint8_t> select_still(const Channels& gyro, size_t window, double threshold)
+{
+    const size_t n = gyro.size();
+    std::vector<double> mag(n);
+
+    for (size_t i = 0; i < n; i++)
+    {
+        double x = gyro.x[i], y = gyro.y[i], z = gyro.z[i];
+        mag[i] = std::sqrt(x * x + y * y + z * z);
+    }
+
+    window = std::min(window, n);
+    double reference = 0.0;
+    for (size_t i = 0; i < window; i++)
+        reference += mag[i];
+    reference = window ? reference / static_cast<double>(window) : 0.0;
+
+    // everything else is compared to the window, so it has to be at rest
+    for (size_t i = 0; i < window; i++)
+    {
+        if (std::fabs(mag[i] - reference) > threshold)
+            throw std::runtime_error("device moved during the first " + std::to_string(window) +
+                                     " samples, which must be taken at rest");
+    }
+
+    std::vector<uint8_t> still(n);
+    for (size_t i = 0; i < n; i++)
+        still[i] = std::fabs(mag[i] - reference) <= threshold;
+
+    return still;
+}
+
+Samples gather(const Channels& accel, const std::vector<uint8_t>& still, double lsb_per_g)
+{
+    Samples s;
+    const float scale = static_cast<float>(1.0 / lsb_per_g);
+
+    for (size_t i = 0; i < accel.size(); i++)
+    {
+        if (!still[i])
+            continue;
+
+        s.x.push_back(accel.x[i] * scale);
+        s.y.push_back(accel.y[i] * scale);
+        s.z.push_back(accel.z[i] * scale);
+    }
+
+    return s;
+}
+
+Result calibrate(const Samples& samples, const Options& options)
+{
+    Result result;
+    auto& q = result.params.q;
+    auto& b = result.params.b;
+
+    const size_t n = samples.size();
+    const float* px = samples.x.data();
+    const float* py = samples.y.data();
+    const float* pz = samples.z.data();
+
+    // per-block Jacobian rows (one contiguous array per parameter) and residuals
+    std::vector<double> jac(PARAMS * BLOCK);
+    std::vector<double> res(BLOCK);
+
+    while (result.iterations < options.max_iterations)
+    {
+        double M[PARAMS][PARAMS] = {};
+        double V[PARAMS] = {};
+        size_t used = 0;
+        double err2 = 0.0;
+
+        const double q11 = q[Q11], q12 = q[Q12], q13 = q[Q13];
+        const double q22 = q[Q22], q23 = q[Q23], q33 = q[Q33];
+        const double b1 = b[0], b2 = b[1], b3 = b[2];
+
+        for (size_t base = 0; base < n; base += BLOCK)
+        {
+            const size_t len = std::min(BLOCK, n - base);
+            double* J = jac.data();
+            size_t block_used = 0;
+            double block_err2 = 0.0;
+
+            // Jacobian and residual of every sample, outliers get zero weight
+            // so the loop stays branch-free
+#pragma omp simd reduction(+ : block_used, block_err2)
+            for (size_t k = 0; k < len; k++)
+            {
+                const double x1 = px[base + k] - b1;
+                const double x2 = py[base + k] - b2;
+                const double x3 = pz[base + k] - b3;
+
+                const double u1 = q11 * x1 + q12 * x2 + q13 * x3;
+                const double u2 = q22 * x2 + q23 * x3;
+                const double u3 = q33 * x3;
+
+                const double norm2 = u1 * u1 + u2 * u2 + u3 * u3;
+                const double F = 0.5 * (1.0 - norm2);
+                const double w = (std::fabs(F) <= options.outlier) ? 1.0 : 0.0;
+
+                J[0 * BLOCK + k] = w * u1 * x1;
+                J[1 * BLOCK + k] = w * u1 * x2;
+                J[2 * BLOCK + k] = w * u1 * x3;
+                J[3 * BLOCK + k] = w * u2 * x2;
+                J[4 * BLOCK + k] = w * u2 * x3;
+                J[5 * BLOCK + k] = w * u3 * x3;
+                J[6 * BLOCK + k] = -w * (u1 * q11);
+                J[7 * BLOCK + k] = -w * (u1 * q12 + u2 * q22);
+                J[8 * BLOCK + k] = -w * (u1 * q13 + u2 * q23 + u3 * q33);
+                res[k] = w * F;
+
+                const double e = std::sqrt(norm2) - 1.0;
+                block_used += (w != 0.0);
+                block_err2 += w * e * e;
+            }
+
+            // rank update of the normal equations, lower triangle only
+            for (int i = 0; i < PARAMS; i++)
+            {
+                const double* Ji = J + i * BLOCK;
+
+                for (int j = 0; j <= i; j++)
+                {
+                    const double* Jj = J + j * BLOCK;
+                    double s = 0.0;
+#pragma omp simd reduction(+ : s)
+                    for (size_t k = 0; k < len; k++)
+                        s += Ji[k] * Jj[k];
+                    M[i][j] += s;
+                }
+
+                double s = 0.0;
+#pragma omp simd reduction(+ : s)
+                for (size_t k = 0; k < len; k++)
+                    s += Ji[k] * res[k];
+                V[i] += s;
+            }
+
+            used += block_used;
+            err2 += block_err2;
+        }
+
+        result.iterations++;
+        result.used      = used;
+        result.rejected  = n - used;
+        result.rms_error = used ? std::sqrt(err2 / static_cast<double>(used)) : 0.0;
+
+        if (used < PARAMS || !solve_ldl(M, V))
+            throw std::runtime_error("not enough distinct orientations to calibrate");
+
+        double step2 = 0.0;
+        for (int i = 0; i < TERMS; i++)
+        {
+            q[i] += V[i];
+            step2 += V[i] * V[i];
+        }
+        for (int i = 0; i < 3; i++)
+        {
+            b[i] += V[TERMS + i];
+            step2 += V[TERMS + i] * V[TERMS + i];
+        }
+
+        if (step2 < options.tolerance)
+        {
+            result.converged = true;
+            break;
+        }
+    }
+
+    return result;
+}
+
+std::array<double, 3> gyro_bias(const Channels& gyro, const std::vector<uint8_t>& still)
+{
+    std::array<double, 3> sum = {0.0, 0.0, 0.0};
+    size_t count = 0;
+
+    for (size_t i = 0; i < gyro.size(); i++)
+    {
+        if (!still[i])
+            continue;
+
+        sum[0] += gyro.x[i];
+        sum[1] += gyro.y[i];
+        sum[2] += gyro.z[i];
+        count++;
+    }
+
+    for (auto& s : sum)
+        s = count ? s / static_cast<double>(count) : 0.0;
+
+    return sum;
+}
+
+FixedCal to_fixed(const Params& params, double lsb_per_g, int bias_limit)
+{
+    FixedCal cal;
+    const double one = static_cast<double>(1 << FRAC_BITS);
+    const auto& q = params.q;
+
+    for (int i = 0; i < 3; i++)
+    {
+        cal.bias[i] = to_int16(params.b[i] * lsb_per_g, "bias");
+        if (std::abs(cal.bias[i]) > bias_limit)
+            throw std::range_error("bias out of range");
+    }
+
+    for (int i = 0; i < TERMS; i++)
+        cal.q[i] = to_int16(q[i] * one, "matrix term");
+
+    const double rows[3] = {
+        std::fabs(q[Q11]) + std::fabs(q[Q12]) + std::fabs(q[Q13]),
+        std::fabs(q[Q22]) + std::fabs(q[Q23]),
+        std::fabs(q[Q33]),
+    };
+
+    for (double row : rows)
+        if (row >= ROW_LIMIT)
+            throw std::range_error("matrix row out of range");
+
+    return cal;
+}
+
+std::array<uint8_t, BLOB_SIZE> make_blob(const FixedCal& high_g, const FixedCal& low_g)
+{
+    std::array<uint8_t, BLOB_SIZE> blob{};
+    uint8_t* p = blob.data();
+
+    put16(p, BLOB_MAGIC);
+
+    for (const FixedCal* cal : {&high_g, &low_g})
+    {
+        for (int16_t v : cal->bias)
+            put16(p, static_cast<uint16_t>(v));
+        for (int16_t v : cal->q)
+            put16(p, static_cast<uint16_t>(v));
+    }
+
+    put16(p, crc16(blob.data(), BLOB_SIZE - 2));
+    return blob;
+}
+
+uint16_t crc16(const uint8_t* data, size_t size, uint16_t crc)
+{
+    for (size_t i = 0; i < size; i++)
+    {
+        crc  = static_cast<uint16_t>((crc >> 8) | (crc << 8));
+        crc ^= data[i];
+        crc ^= (crc & 0xFF) >> 4;
+        crc ^= static_cast<uint16_t>((crc << 8) << 4);
+        crc ^= static_cast<uint16_t>(((crc & 0xFF) << 4) << 1);
+    }
+
+    return crc;
+}
+
+} // namespace imucal
@@ -0,0 +1,102 @@
+// 9-parameter accelerometer calibration
+//
+// Based on 'An Algorithm for the In-Field Calibration of a MEMS IMU' by
+// Umar Qureshi and Farid Golnaraghi, same model as accelerometer_calibration.cpp:
+//
+//   u = Q * (x - b)
+//
+// where x is the raw reading in g, b the per-axis bias and Q an upper
+// triangular matrix holding 3 scale and 3 misalignment terms. Parameters
+// are estimated with Gauss-Newton so that |u| = 1g for every sample taken
+// with the device at rest.
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "datalog.hpp"
+
+namespace imucal {
+
+// Index of each term of Q, same order as sensorconv_cal_term_t in inc/sensorconv.h
+enum Term { Q11 = 0, Q12, Q13, Q22, Q23, Q33, TERMS };
+
+// Calibration parameters in floating point, bias in g
+struct Params
+{
+    std::array<double, TERMS> q = {1.0, 0.0, 0.0, 1.0, 0.0, 1.0};
+    std::array<double, 3> b     = {0.0, 0.0, 0.0};
+};
+
+struct Options
+{
+    double outlier        = 0.5;   // samples with |0.5 * (1 - |u|^2)| above this are ignored
+    int    max_iterations = 100;   // give up after this many Gauss-Newton iterations
+    double tolerance      = 1e-14; // converged once the squared step is below this
+};
+
+struct Result
+{
+    Params params;
+    int    iterations = 0;
+    size_t used       = 0;     // samples used in the last iteration
+    size_t rejected   = 0;     // samples rejected as outliers in the last iteration
+    double rms_error  = 0.0;   // RMS of |u| - 1g over used samples, in g
+    bool   converged  = false;
+};
+
+// Accelerometer samples in g, structure-of-arrays
+struct Samples
+{
+    std::vector<float> x, y, z;
+    size_t size() const { return x.size(); }
+};
+
+// Mark samples taken with the device at rest.
+//
+// A sample is still when its gyroscope magnitude is within threshold (LSB)
+// of the average magnitude of the first window samples, which must be taken
+// at rest. Throws if any of them is further than threshold from the average.
+std::vector<uint8_t> select_still(const Channels& gyro, size_t window, double threshold);
+
+// Gather still samples of an accelerometer, converted from LSB to g
+Samples gather(const Channels& accel, const std::vector<uint8_t>& still, double lsb_per_g);
+
+// Estimate calibration parameters.
+//
+// Every iteration makes a single pass over the samples, accumulating the
+// normal equations block by block so the inner loops vectorize.
+Result calibrate(const Samples& samples, const Options& options = Options());
+
+// Average of each gyroscope axis over still samples, in LSB
+std::array<double, 3> gyro_bias(const Channels& gyro, const std::vector<uint8_t>& still);
+
+// Fixed-point calibration as loaded by the firmware, see sensorconv_cal_t
+struct FixedCal
+{
+    std::array<int16_t, 3>     bias = {0, 0, 0}; // LSB
+    std::array<int16_t, TERMS> q    = {1 << 14, 0, 0, 1 << 14, 0, 1 << 14}; // Q2.14
+};
+
+// Largest high-g (ADXL372) bias magnitude the device accepts, in LSB
+// (SENSORCONV_ADXL372_BIAS_LIMIT)
+constexpr int HIGH_G_BIAS_LIMIT = 2047;
+
+// Convert to firmware fixed point. Throws std::range_error if the
+// parameters can't be represented or would overflow on the device. The
+// bias must also be within +/- bias_limit LSB.
+FixedCal to_fixed(const Params& params, double lsb_per_g, int bias_limit = INT16_MAX);
+
+// Size of the calibration blob, see configs_calibration_t in inc/configs.h
+constexpr size_t BLOB_SIZE = 40;
+
+// Build the calibration blob sent with REQ_SET_CALIBRATION
+std::array<uint8_t, BLOB_SIZE> make_blob(const FixedCal& high_g, const FixedCal& low_g);
+
+// CRC-16/CCITT with 0xFFFF seed, same as the nRF5 SDK crc16_compute()
+uint16_t crc16(const uint8_t* data, size_t size, uint16_t crc = 0xFFFF);
+
+} // namespace imucal
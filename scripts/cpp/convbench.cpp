@@ -0,0 +1,243 @@
+// Check the sensor frame conversion kernels and time them on the host
+//
+// Builds the firmware's own src/sensorconv.c with its Cortex-M4 SIMD path
+// enabled, the DSP intrinsics coming from armhost/nrf.h. Every kernel is
+// run against its scalar reference and against the straightforward
+// implementations below on every register value, odd frame counts,
+// unaligned buffers and random calibrations, and must match bit for bit.
+//
+// Timings are for the host and only compare the two paths there. Cycle
+// counts on the device come from the `sensor convbench` shell command.
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+
+extern "C" {
+#include "../../inc/sensorconv.h"
+}
+
+namespace {
+
+using Kernel = void (*)(int16_t*, size_t, const int16_t*);
+
+constexpr size_t AXES         = SENSORCONV_AXES;
+constexpr size_t BENCH_FRAMES = 4096;
+constexpr int    BENCH_RUNS   = 2000;
+constexpr int    CAL_TRIALS   = 20000;
+
+// What the ADXL372 datasheet says a reading is: 12 bits, left-justified, big-endian
+int16_t adxl372_expected(uint16_t reg, int16_t offset)
+{
+    int16_t raw = static_cast<int16_t>(reg & 0xFFF0U);
+    return static_cast<int16_t>((raw >> 4) - offset);
+}
+
+// ICM20649 readings are plain big-endian 16-bit values
+int16_t icm20649_expected(uint16_t reg, int16_t offset)
+{
+    return static_cast<int16_t>(static_cast<int16_t>(reg) - offset);
+}
+
+int16_t saturate(int64_t v)
+{
+    return static_cast<int16_t>(v > INT16_MAX ? INT16_MAX : v < INT16_MIN ? INT16_MIN : v);
+}
+
+// u = Q * x in Q2.14, rounded to nearest, saturated
+void calibrate_expected(int16_t* frame, const sensorconv_cal_t& cal)
+{
+    const int16_t* q = cal.q;
+    const int64_t x = frame[0], y = frame[1], z = frame[2];
+    const int64_t half = 1 << (SENSORCONV_CAL_FRAC_BITS - 1);
+
+    frame[0] = saturate((q[SENSORCONV_CAL_Q11] * x + q[SENSORCONV_CAL_Q12] * y + q[SENSORCONV_CAL_Q13] * z + half) >> SENSORCONV_CAL_FRAC_BITS);
+    frame[1] = saturate((q[SENSORCONV_CAL_Q22] * y + q[SENSORCONV_CAL_Q23] * z + half) >> SENSORCONV_CAL_FRAC_BITS);
+    frame[2] = saturate((q[SENSORCONV_CAL_Q33] * z + half) >> SENSORCONV_CAL_FRAC_BITS);
+}
+
+// Raw register data as clocked out over SPI, big-endian
+std::vector<int16_t> to_registers(const std::vector<uint16_t>& regs)
+{
+    std::vector<int16_t> buf(regs.size());
+    auto* bytes = reinterpret_cast<uint8_t*>(buf.data());
+
+    for (size_t i = 0; i < regs.size(); i++)
+    {
+        bytes[2 * i]     = static_cast<uint8_t>(regs[i] >> 8);
+        bytes[2 * i + 1] = static_cast<uint8_t>(regs[i]);
+    }
+
+    return buf;
+}
+
+// Every register value on every axis, padded to whole frames plus an odd one
+std::vector<uint16_t> every_register()
+{
+    std::vector<uint16_t> regs;
+
+    for (uint32_t v = 0; v <= UINT16_MAX; v++)
+        regs.push_back(static_cast<uint16_t>(v));
+
+    while (regs.size() % (2 * AXES) != AXES)
+        regs.push_back(static_cast<uint16_t>(regs.size()));
+
+    return regs;
+}
+
+// Run a conversion kernel at a given byte misalignment
+std::vector<int16_t> run(Kernel kernel, const std::vector<int16_t>& in, size_t shift, const int16_t* offsets)
+{
+    std::vector<int16_t> storage(in.size() + 2);
+    int16_t* buf = storage.data() + shift;
+
+    std::memcpy(buf, in.data(), in.size() * sizeof(int16_t));
+    kernel(buf, in.size() / AXES, offsets);
+
+    return std::vector<int16_t>(buf, buf + in.size());
+}
+
+bool check_conversion(const char* name, Kernel kernel, Kernel reference, int16_t (*expected)(uint16_t, int16_t),
+                      const std::vector<std::vector<int16_t>>& offset_sets)
+{
+    const std::vector<uint16_t> regs = every_register();
+    const std::vector<int16_t> in = to_registers(regs);
+
+    for (const auto& offsets : offset_sets)
+    {
+        std::vector<int16_t> want(regs.size());
+        for (size_t i = 0; i < regs.size(); i++)
+            want[i] = expected(regs[i], offsets[i % AXES]);
+
+        // shift 1 leaves the buffer 2-byte aligned, which takes the scalar path
+        for (size_t shift : {0, 1})
+        {
+            if (run(kernel, in, shift, offsets.data()) != want || run(reference, in, shift, offsets.data()) != want)
+            {
+                std::printf("%s: MISMATCH with offsets [ %d %d %d ]%s\n", name, offsets[0], offsets[1], offsets[2],
+                            shift ? " (unaligned)" : "");
+                return false;
+            }
+        }
+    }
+
+    std::printf("%s: BIT-EXACT on every register value, %zu offset sets\n", name, offset_sets.size());
+    return true;
+}
+
+sensorconv_cal_t random_cal(std::mt19937& rng)
+{
+    std::uniform_int_distribution<int> term(-SENSORCONV_CAL_ONE, SENSORCONV_CAL_ONE);
+    std::uniform_int_distribution<int> scale(SENSORCONV_CAL_ONE / 2, 2 * SENSORCONV_CAL_ONE);
+    sensorconv_cal_t cal;
+
+    do
+    {
+        std::memset(&cal, 0, sizeof(cal));
+        cal.q[SENSORCONV_CAL_Q11] = static_cast<int16_t>(scale(rng));
+        cal.q[SENSORCONV_CAL_Q12] = static_cast<int16_t>(term(rng) / 8);
+        cal.q[SENSORCONV_CAL_Q13] = static_cast<int16_t>(term(rng) / 8);
+        cal.q[SENSORCONV_CAL_Q22] = static_cast<int16_t>(scale(rng));
+        cal.q[SENSORCONV_CAL_Q23] = static_cast<int16_t>(term(rng) / 8);
+        cal.q[SENSORCONV_CAL_Q33] = static_cast<int16_t>(scale(rng));
+    } while (!sensorconv_cal_valid(&cal));
+
+    return cal;
+}
+
+bool check_calibration()
+{
+    std::mt19937 rng(0xCA1B);
+    std::uniform_int_distribution<int> sample(INT16_MIN, INT16_MAX);
+    std::vector<int16_t> frames(2 * AXES * 16 + AXES);
+
+    for (int trial = 0; trial < CAL_TRIALS; trial++)
+    {
+        sensorconv_cal_t cal = random_cal(rng);
+
+        // mostly random samples, with full scale ones to hit saturation
+        for (size_t i = 0; i < frames.size(); i++)
+            frames[i] = (i % 7 == 0) ? (rng() & 1 ? INT16_MAX : INT16_MIN) : static_cast<int16_t>(sample(rng));
+
+        std::vector<int16_t> want = frames;
+        for (size_t f = 0; f < want.size(); f += AXES)
+            calibrate_expected(&want[f], cal);
+
+        std::vector<int16_t> simd = frames, ref = frames;
+        sensorconv_calibrate(simd.data(), simd.size() / AXES, &cal);
+        sensorconv_calibrate_ref(ref.data(), ref.size() / AXES, &cal);
+
+        if (simd != want || ref != want)
+        {
+            std::printf("calibrate: MISMATCH on trial %d\n", trial);
+            return false;
+        }
+    }
+
+    std::printf("calibrate: BIT-EXACT on %d random calibrations\n", CAL_TRIALS);
+    return true;
+}
+
+template <typename Fn>
+double ns_per_frame(Fn convert)
+{
+    std::mt19937 rng(0xACE1);
+    std::vector<int16_t> input(BENCH_FRAMES * AXES), buf(input.size());
+    for (auto& v : input)
+        v = static_cast<int16_t>(rng());
+
+    auto start = std::chrono::steady_clock::now();
+    for (int run = 0; run < BENCH_RUNS; run++)
+    {
+        std::memcpy(buf.data(), input.data(), buf.size() * sizeof(int16_t));
+        convert(buf.data());
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start;
+
+    return std::chrono::duration<double, std::nano>(elapsed).count() / (double(BENCH_FRAMES) * BENCH_RUNS);
+}
+
+void bench(const char* name, double ref_ns, double simd_ns)
+{
+    std::printf("%s: reference [%.2f ns/frame] | SIMD [%.2f ns/frame] | speedup [x%.2f]\n",
+                name, ref_ns, simd_ns, simd_ns > 0.0 ? ref_ns / simd_ns : 0.0);
+}
+
+} // namespace
+
+int main()
+{
+    const int16_t limit = SENSORCONV_ADXL372_BIAS_LIMIT;
+    const std::vector<std::vector<int16_t>> adxl372_offsets = {
+        {0, 0, 0}, {-3, 7, 10}, {1, -1, 0}, {limit, -limit, limit}, {-limit, limit, -limit},
+    };
+    const std::vector<std::vector<int16_t>> icm20649_offsets = {
+        {0, 0, 0}, {-3, 7, 10}, {1, -1, 0}, {INT16_MAX, INT16_MIN, 8192}, {INT16_MIN, INT16_MAX, -8192},
+    };
+
+    bool ok = check_conversion("ADXL372 ", sensorconv_adxl372, sensorconv_adxl372_ref, adxl372_expected, adxl372_offsets);
+    ok = check_conversion("ICM20649", sensorconv_icm20649, sensorconv_icm20649_ref, icm20649_expected, icm20649_offsets) && ok;
+    ok = check_calibration() && ok;
+
+    const int16_t offsets[AXES] = {-3, 7, 10};
+    sensorconv_cal_t cal;
+    sensorconv_cal_identity(&cal);
+    cal.q[SENSORCONV_CAL_Q12] = SENSORCONV_CAL_ONE / 64;
+    cal.q[SENSORCONV_CAL_Q23] = -SENSORCONV_CAL_ONE / 64;
+
+    std::printf("\nConverting %zu frames per run, host timings:\n", BENCH_FRAMES);
+    bench("ADXL372  ",
+          ns_per_frame([&](int16_t* b) { sensorconv_adxl372_ref(b, BENCH_FRAMES, offsets); }),
+          ns_per_frame([&](int16_t* b) { sensorconv_adxl372(b, BENCH_FRAMES, offsets); }));
+    bench("ICM20649 ",
+          ns_per_frame([&](int16_t* b) { sensorconv_icm20649_ref(b, BENCH_FRAMES, offsets); }),
+          ns_per_frame([&](int16_t* b) { sensorconv_icm20649(b, BENCH_FRAMES, offsets); }));
+    bench("calibrate",
+          ns_per_frame([&](int16_t* b) { sensorconv_calibrate_ref(b, BENCH_FRAMES, &cal); }),
+          ns_per_frame([&](int16_t* b) { sensorconv_calibrate(b, BENCH_FRAMES, &cal); }));
+
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
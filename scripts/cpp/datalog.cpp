@@ -0,0 +1,114 @@
+// Reader for raw datalog dumps, as written to flash by src/datalog.c
+
+#include "datalog.hpp"
+
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+
+namespace imucal {
+
+namespace {
+
+constexpr size_t DATETIME_SIZE      = 11;
+constexpr size_t AXES_SIZE          = 6;
+constexpr size_t SESSION_START_SIZE = 5;
+
+constexpr uint8_t VALID_HEADER_BITS = DATALOG_DATETIME_AVAILABLE | DATALOG_GYRO_AVAILABLE |
+                                      DATALOG_LOW_G_ACCEL_AVAILABLE | DATALOG_HIGH_G_ACCEL_AVAILABLE |
+                                      DATALOG_HIGH_G_PEAK;
+constexpr uint8_t PEAK_HEADER_BITS  = DATALOG_HIGH_G_PEAK | DATALOG_HIGH_G_ACCEL_AVAILABLE;
+
+void read_axes(const uint8_t* p, int16_t out[3])
+{
+    for (int i = 0; i < 3; i++)
+        out[i] = static_cast<int16_t>(p[2 * i] | (p[2 * i + 1] << 8));
+}
+
+} // namespace
+
+Datalog parse_datalog(const uint8_t* data, size_t size)
+{
+    Datalog log;
+    size_t i = 0;
+
+    while (i < size)
+    {
+        uint8_t header = data[i];
+
+        if (header == DATALOG_FILLER)
+        {
+            i++;
+            continue;
+        }
+
+        if (header == DATALOG_SESSION_START)
+        {
+            if (i + SESSION_START_SIZE > size)
+                throw std::runtime_error("truncated session marker at offset " + std::to_string(i));
+
+            log.sessions++;
+            i += SESSION_START_SIZE;
+            continue;
+        }
+
+        // erased flash or garbage, end of datalog
+        if ((header & ~VALID_HEADER_BITS) != 0)
+            break;
+
+        if ((header & DATALOG_HIGH_G_PEAK) && (header & ~DATALOG_DATETIME_AVAILABLE) != PEAK_HEADER_BITS)
+            break;
+
+        size_t row_size = 1;
+        if (header & DATALOG_DATETIME_AVAILABLE)     row_size += DATETIME_SIZE;
+        if (header & DATALOG_GYRO_AVAILABLE)         row_size += AXES_SIZE;
+        if (header & DATALOG_LOW_G_ACCEL_AVAILABLE)  row_size += AXES_SIZE;
+        if (header & DATALOG_HIGH_G_ACCEL_AVAILABLE) row_size += AXES_SIZE;
+
+        if (i + row_size > size)
+            throw std::runtime_error("truncated datalog row at offset " + std::to_string(i));
+
+        const uint8_t* p = data + i + 1;
+        int16_t gyro[3], low_g[3], high_g[3];
+
+        if (header & DATALOG_DATETIME_AVAILABLE)     { p += DATETIME_SIZE; }
+        if (header & DATALOG_GYRO_AVAILABLE)         { read_axes(p, gyro);   p += AXES_SIZE; }
+        if (header & DATALOG_LOW_G_ACCEL_AVAILABLE)  { read_axes(p, low_g);  p += AXES_SIZE; }
+        if (header & DATALOG_HIGH_G_ACCEL_AVAILABLE) { read_axes(p, high_g); p += AXES_SIZE; }
+
+        constexpr uint8_t sensors = DATALOG_GYRO_AVAILABLE | DATALOG_LOW_G_ACCEL_AVAILABLE |
+                                    DATALOG_HIGH_G_ACCEL_AVAILABLE;
+
+        if (header & DATALOG_HIGH_G_PEAK)
+        {
+            log.high_g_peaks.push(high_g);
+        }
+        else if ((header & sensors) == sensors)
+        {
+            log.gyro.push(gyro);
+            log.low_g.push(low_g);
+            log.high_g.push(high_g);
+        }
+        else
+        {
+            log.rows_skipped++;
+        }
+
+        log.rows_total++;
+        i += row_size;
+    }
+
+    return log;
+}
+
+Datalog read_datalog(const std::string& path)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file)
+        throw std::runtime_error("unable to open " + path);
+
+    std::vector<uint8_t> bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    return parse_datalog(bytes.data(), bytes.size());
+}
+
+} // namespace imucal
@@ -0,0 +1,73 @@
+// Reader for raw datalog dumps, as written to flash by src/datalog.c
+//
+// A dump is the datalog region of flash, starting at the first datalog row.
+// Each row is a 1 byte header followed by whichever fields the header flags:
+//
+//   0x08 datetime      11 bytes (u16 year, u8 month, day, hr, min, sec, u32 usec)
+//   0x04 gyroscope      6 bytes (i16 x, y, z)
+//   0x02 low-g accel    6 bytes (i16 x, y, z)
+//   0x01 high-g accel   6 bytes (i16 x, y, z)
+//
+// 0x10 flags a high-g row as the peak of an impact rather than a sample,
+// it's only ever set with 0x01 and optionally 0x08.
+//
+// A header of exactly 0x20 is the marker before a session's first row,
+// followed by the u32 offset of the marker. 0x00 is a single filler byte,
+// left where a reset cut a row short. Neither is counted as a row.
+//
+// Everything is little-endian. Reading stops at the first invalid header,
+// which is where the erased (0xFF) part of flash starts.
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace imucal {
+
+// Row header presence masks, keep in sync with inc/datalog.h
+constexpr uint8_t DATALOG_DATETIME_AVAILABLE     = 0x08;
+constexpr uint8_t DATALOG_GYRO_AVAILABLE         = 0x04;
+constexpr uint8_t DATALOG_LOW_G_ACCEL_AVAILABLE  = 0x02;
+constexpr uint8_t DATALOG_HIGH_G_ACCEL_AVAILABLE = 0x01;
+constexpr uint8_t DATALOG_HIGH_G_PEAK            = 0x10;
+constexpr uint8_t DATALOG_SESSION_START          = 0x20;
+constexpr uint8_t DATALOG_FILLER                 = 0x00;
+
+// Sensor channels of a datalog, structure-of-arrays so that each
+// channel can be streamed through contiguously.
+struct Channels
+{
+    std::vector<int16_t> x, y, z;
+
+    size_t size() const { return x.size(); }
+    void push(const int16_t v[3])
+    {
+        x.push_back(v[0]);
+        y.push_back(v[1]);
+        z.push_back(v[2]);
+    }
+};
+
+// Rows of a datalog that carry gyroscope and both accelerometers.
+// Rows missing any of them are skipped, since stillness can't be
+// determined without the gyroscope.
+struct Datalog
+{
+    Channels gyro;
+    Channels low_g;
+    Channels high_g;
+    Channels high_g_peaks;   // peak of every impact, in peak-detect logging
+    size_t rows_total   = 0; // every valid row in the dump
+    size_t rows_skipped = 0; // rows missing a sensor
+    size_t sessions     = 0; // session start markers
+};
+
+// Parse a dump already in memory. Throws std::runtime_error if a row is truncated.
+Datalog parse_datalog(const uint8_t* data, size_t size);
+
+// Read and parse a dump file. Throws std::runtime_error on I/O or parse errors.
+Datalog read_datalog(const std::string& path);
+
+} // namespace imucal
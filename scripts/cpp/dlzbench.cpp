@@ -0,0 +1,196 @@
+// Measure how much download compression saves on recorded datalogs
+//
+// Splits each dump into packets exactly like src/download.c does with
+// DOWNLOAD_REQUEST_COMPRESS and DOWNLOAD_REQUEST_WINDOWED set, using the
+// firmware's own src/lzss.c, and
+// checks every packet decompresses back to the original bytes. Reports the
+// compression ratio and, given the throughput of an uncompressed download
+// on the same link (see `datalog download`), the effective throughput.
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#define LZSS_DECOMPRESS
+extern "C" {
+#include "../../inc/lzss.h"
+}
+
+namespace {
+
+// Download packet overhead, keep in sync with inc/download.h
+constexpr size_t PACKET_HEADER_SIZE = 7; // u16 seq, u32 offset, u8 flags
+constexpr size_t PACKET_CRC_SIZE    = 2; // windowed downloads only
+constexpr size_t ATT_HEADER_SIZE    = 3;
+
+struct Config
+{
+    size_t att_mtu  = 247;  // negotiated ATT_MTU, see `ble link`
+    double raw_kbps = 0.0;  // uncompressed download throughput, 0 to skip
+    std::vector<std::string> dumps;
+};
+
+struct Totals
+{
+    size_t raw = 0, payload = 0, packets = 0, compressed = 0;
+};
+
+void usage(const char* name)
+{
+    std::fprintf(stderr,
+        "usage: %s [options] <dump> [<dump> ...]\n"
+        "  --mtu <n>   ATT_MTU of the link (default: 247)\n"
+        "  --kbps <n>  KB/s of an uncompressed download on the same link\n",
+        name);
+}
+
+bool parse_args(int argc, char** argv, Config& cfg)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+
+        if (arg == "--mtu" && has_value)            cfg.att_mtu = std::strtoul(argv[++i], nullptr, 10);
+        else if (arg == "--kbps" && has_value)      cfg.raw_kbps = std::atof(argv[++i]);
+        else if (!arg.empty() && arg[0] == '-')     return false;
+        else                                        cfg.dumps.push_back(arg);
+    }
+
+    return !cfg.dumps.empty() && cfg.att_mtu > ATT_HEADER_SIZE + PACKET_HEADER_SIZE + PACKET_CRC_SIZE;
+}
+
+// Size of the datalog in a dump, up to the first invalid row header
+// (erased flash). Row layout as in datalog.hpp.
+size_t datalog_size(const std::vector<uint8_t>& dump)
+{
+    size_t pos = 0;
+
+    while (pos < dump.size())
+    {
+        uint8_t header = dump[pos];
+
+        if (header == 0 || (header & ~0x1F) != 0)
+            break;
+
+        // peaks (0x10) are only ever high-g rows
+        if ((header & 0x10) && (header & ~0x08) != 0x11)
+            break;
+
+        size_t size = 1 + ((header & 0x08) ? 11 : 0);
+        for (uint8_t mask = 0x01; mask <= 0x04; mask <<= 1)
+            size += (header & mask) ? 6 : 0;
+
+        if (pos + size > dump.size())
+            break;
+
+        pos += size;
+    }
+
+    return pos;
+}
+
+// Packetize like download.c: compress as much as a block takes into one
+// payload, fall back to raw if that doesn't make it smaller.
+bool packetize(const uint8_t* data, size_t size, size_t payload_cap, Totals& t)
+{
+    std::vector<uint8_t> payload(payload_cap), check(LZSS_MAX_INPUT);
+    size_t pos = 0;
+
+    while (pos < size)
+    {
+        size_t used = 0;
+        size_t n = lzss_compress(data + pos, size - pos, payload.data(), payload_cap, &used);
+
+        if (n < used)
+        {
+            if (lzss_decompress(payload.data(), n, check.data(), check.size()) != used ||
+                !std::equal(check.begin(), check.begin() + used, data + pos))
+            {
+                std::fprintf(stderr, "round trip failed at offset %zu\n", pos);
+                return false;
+            }
+
+            t.compressed++;
+        }
+        else
+        {
+            used = std::min(size - pos, payload_cap);
+            n = used;
+        }
+
+        pos += used;
+        t.raw += used;
+        t.payload += n;
+        t.packets++;
+    }
+
+    return true;
+}
+
+void print(const char* name, const Totals& t, const Config& cfg)
+{
+    double ratio = t.payload ? double(t.raw) / double(t.payload) : 1.0;
+
+    std::printf("%-24s %10zu B -> %10zu B | ratio %.2f | %zu packets, %zu compressed",
+        name, t.raw, t.payload, ratio, t.packets, t.compressed);
+
+    if (cfg.raw_kbps > 0.0)
+        std::printf(" | ~%.1f KB/s", cfg.raw_kbps * ratio);
+
+    std::printf("\n");
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    Config cfg;
+
+    if (!parse_args(argc, argv, cfg))
+    {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    size_t payload_cap = cfg.att_mtu - ATT_HEADER_SIZE - PACKET_HEADER_SIZE - PACKET_CRC_SIZE;
+    Totals all;
+    int status = EXIT_SUCCESS;
+
+    for (const auto& path : cfg.dumps)
+    {
+        std::ifstream file(path, std::ios::binary);
+        std::vector<uint8_t> dump((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+        Totals t;
+
+        if (!file.good() && !file.eof())
+        {
+            std::fprintf(stderr, "%s: can't read\n", path.c_str());
+            status = EXIT_FAILURE;
+            continue;
+        }
+
+        if (!packetize(dump.data(), datalog_size(dump), payload_cap, t))
+        {
+            std::fprintf(stderr, "%s: compression check failed\n", path.c_str());
+            status = EXIT_FAILURE;
+            continue;
+        }
+
+        print(path.c_str(), t, cfg);
+
+        all.raw += t.raw;
+        all.payload += t.payload;
+        all.packets += t.packets;
+        all.compressed += t.compressed;
+    }
+
+    if (cfg.dumps.size() > 1)
+        print("total", all, cfg);
+
+    return status;
+}
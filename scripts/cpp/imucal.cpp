@@ -0,0 +1,196 @@
+// Calibrate accelerometers of one or more devices from their datalog dumps
+//
+// Each dump should be captured with the device placed in several static
+// orientations, starting at rest. For every dump whose fits all converge a
+// calibration blob is written next to it (<dump>.cal), ready to be sent to
+// the device with REQ_SET_CALIBRATION. Dumps are processed in parallel.
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "calibration.hpp"
+#include "datalog.hpp"
+
+namespace {
+
+struct Config
+{
+    unsigned jobs        = std::thread::hardware_concurrency();
+    size_t   window      = 2000;   // samples at the start of a dump known to be at rest
+    double   threshold   = 50.0;   // gyroscope magnitude deviation allowed at rest, in LSB
+    double   low_g_lsb   = 1024.0; // ICM20649 at +/- 30g
+    double   high_g_lsb  = 10.0;   // ADXL372, 100mg/LSB
+    bool     high_g      = true;   // calibrate the high-g accelerometer too
+    imucal::Options options;
+    std::vector<std::string> dumps;
+};
+
+struct Report
+{
+    bool ok = false;
+    bool fitted = false; // fits ran, results are worth printing even if not ok
+    std::string error;
+    size_t rows = 0, still = 0;
+    imucal::Result low_g, high_g;
+    std::array<double, 3> gyro_bias{};
+};
+
+void usage(const char* name)
+{
+    std::fprintf(stderr,
+        "usage: %s [options] <dump> [<dump> ...]\n"
+        "  -j <n>            worker threads (default: number of cores)\n"
+        "  --window <n>      samples at start of dump assumed at rest (default: 2000)\n"
+        "  --threshold <lsb> gyroscope deviation still considered at rest (default: 50)\n"
+        "  --low-g-lsb <n>   ICM20649 accelerometer LSB per g (default: 1024)\n"
+        "  --high-g-lsb <n>  ADXL372 LSB per g (default: 10)\n"
+        "  --no-high-g       don't calibrate ADXL372, leave it at identity\n",
+        name);
+}
+
+bool parse_args(int argc, char** argv, Config& cfg)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+
+        if (arg == "-j" && has_value)                   cfg.jobs = static_cast<unsigned>(std::atoi(argv[++i]));
+        else if (arg == "--window" && has_value)        cfg.window = std::strtoul(argv[++i], nullptr, 10);
+        else if (arg == "--threshold" && has_value)     cfg.threshold = std::atof(argv[++i]);
+        else if (arg == "--low-g-lsb" && has_value)     cfg.low_g_lsb = std::atof(argv[++i]);
+        else if (arg == "--high-g-lsb" && has_value)    cfg.high_g_lsb = std::atof(argv[++i]);
+        else if (arg == "--no-high-g")                  cfg.high_g = false;
+        else if (!arg.empty() && arg[0] == '-')         return false;
+        else                                            cfg.dumps.push_back(arg);
+    }
+
+    if (cfg.jobs == 0)
+        cfg.jobs = 1;
+
+    return !cfg.dumps.empty() && cfg.low_g_lsb > 0.0 && cfg.high_g_lsb > 0.0;
+}
+
+Report process(const std::string& path, const Config& cfg)
+{
+    Report report;
+
+    try
+    {
+        imucal::Datalog log = imucal::read_datalog(path);
+        std::vector<uint8_t> still = imucal::select_still(log.gyro, cfg.window, cfg.threshold);
+
+        report.rows = log.gyro.size();
+        for (uint8_t s : still)
+            report.still += s;
+
+        imucal::FixedCal low_g, high_g;
+
+        report.low_g = imucal::calibrate(imucal::gather(log.low_g, still, cfg.low_g_lsb), cfg.options);
+        low_g = imucal::to_fixed(report.low_g.params, cfg.low_g_lsb);
+
+        if (cfg.high_g)
+        {
+            report.high_g = imucal::calibrate(imucal::gather(log.high_g, still, cfg.high_g_lsb), cfg.options);
+            high_g = imucal::to_fixed(report.high_g.params, cfg.high_g_lsb, imucal::HIGH_G_BIAS_LIMIT);
+        }
+
+        report.gyro_bias = imucal::gyro_bias(log.gyro, still);
+        report.fitted = true;
+
+        // a blob from a fit that didn't converge would be applied all the same
+        if (!report.low_g.converged || (cfg.high_g && !report.high_g.converged))
+            throw std::runtime_error("not every fit converged, " + path + ".cal not written");
+
+        auto blob = imucal::make_blob(high_g, low_g);
+        std::ofstream out(path + ".cal", std::ios::binary);
+        out.write(reinterpret_cast<const char*>(blob.data()), static_cast<std::streamsize>(blob.size()));
+        if (!out)
+            throw std::runtime_error("unable to write " + path + ".cal");
+
+        report.ok = true;
+    }
+    catch (const std::exception& e)
+    {
+        report.error = e.what();
+    }
+
+    return report;
+}
+
+void print_result(const char* name, const imucal::Result& r)
+{
+    const auto& q = r.params.q;
+    const auto& b = r.params.b;
+
+    std::printf("  %s: %s after %d iterations, %zu used, %zu rejected, rms %.5f g\n",
+                name, r.converged ? "converged" : "NOT converged", r.iterations, r.used, r.rejected, r.rms_error);
+    std::printf("    Q = [ %9.6f %9.6f %9.6f ]\n"
+                "        [           %9.6f %9.6f ]\n"
+                "        [                     %9.6f ]\n"
+                "    b = [ %9.6f %9.6f %9.6f ] g\n",
+                q[imucal::Q11], q[imucal::Q12], q[imucal::Q13], q[imucal::Q22], q[imucal::Q23], q[imucal::Q33],
+                b[0], b[1], b[2]);
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    Config cfg;
+
+    if (!parse_args(argc, argv, cfg))
+    {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    std::vector<Report> reports(cfg.dumps.size());
+    std::atomic<size_t> next{0};
+    std::vector<std::thread> workers;
+
+    for (unsigned i = 0; i < std::min<size_t>(cfg.jobs, cfg.dumps.size()); i++)
+    {
+        workers.emplace_back([&] {
+            for (size_t d = next++; d < cfg.dumps.size(); d = next++)
+                reports[d] = process(cfg.dumps[d], cfg);
+        });
+    }
+
+    for (auto& w : workers)
+        w.join();
+
+    int failures = 0;
+
+    for (size_t d = 0; d < cfg.dumps.size(); d++)
+    {
+        const Report& r = reports[d];
+        std::printf("%s\n", cfg.dumps[d].c_str());
+
+        if (r.fitted)
+        {
+            std::printf("  %zu rows, %zu at rest\n", r.rows, r.still);
+            print_result("low-g", r.low_g);
+            if (cfg.high_g)
+                print_result("high-g", r.high_g);
+            std::printf("  gyro bias = [ %.1f %.1f %.1f ] LSB\n", r.gyro_bias[0], r.gyro_bias[1], r.gyro_bias[2]);
+        }
+
+        if (!r.ok)
+        {
+            std::printf("  FAILED: %s\n", r.error.c_str());
+            failures++;
+            continue;
+        }
+
+        std::printf("  wrote %s.cal\n", cfg.dumps[d].c_str());
+    }
+
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
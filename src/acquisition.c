@@ -0,0 +1,747 @@
+/**
+ * @file acquisition.c
+ * @author UBC Capstone Team 2020/2021
+ * @brief Sensor acquisition pipeline
+ */
+
+#include <string.h>
+#include "acquisition.h"
+#include "datalog.h"
+#include "datetime.h"
+#include "telemetry.h"
+#include "statemachine.h"
+#include "adxl372.h"
+#include "icm20649.h"
+#include "spi.h"
+#include "sampleclock.h"
+#include "boot.h"
+#include "nrf_atfifo.h"
+#include "nrf_queue.h"
+#include "app_util_platform.h"
+#include "nrf_assert.h"
+#include "nrf_log.h"
+
+#ifdef FREERTOS
+#include "rtos.h"
+#endif
+
+/**
+ * @brief Impact activity threshold in peak mode when no resultant
+ *        threshold is configured, 100 mg/LSB (5 g)
+ */
+#define PEAK_ACT_THRESH_DEFAULT 50U
+
+/**
+ * @brief Time over the threshold to start an impact, ~3-7 ms
+ */
+#define PEAK_ACT_TIME 1U
+
+/**
+ * @brief Time under half the threshold to end an impact, ~50-100 ms
+ */
+#define PEAK_INACT_TIME 4U
+
+/**
+ * @brief Peaks read out of the ADXL372 FIFO at once
+ */
+#define PEAK_READ_SIZE 8U
+
+/**
+ * @brief Impact start readings read out of the ADXL372 FIFO at once
+ */
+#define ONSET_READ_SIZE 8U
+
+/**
+ * @brief Sampling interrupt, a software interrupt nothing else uses
+ */
+#define SAMPLE_IRQn       SWI3_EGU3_IRQn
+#define SAMPLE_IRQHandler SWI3_EGU3_IRQHandler
+
+/**
+ * @brief Sampling interrupt priority, above app_timer, the peripheral
+ *        drivers and the main loop. SoftDevice calls aren't allowed at
+ *        this priority, nothing in the sampling path makes any.
+ */
+#define SAMPLE_IRQ_PRIORITY APP_IRQ_PRIORITY_MID
+
+/**
+ * @brief Channel groups, one per sensor, that share a filter class
+ */
+typedef enum
+{
+    GROUP_HIGH_G = 0,
+    GROUP_LOW_G,
+    GROUP_GYRO,
+    GROUPS_NUM /*!< Number of groups */
+} acquisition_group_t;
+
+/**
+ * @brief First filter channel of each group, axes follow in X, Y, Z order
+ */
+static const cfcfilter_channel_t group_channels[GROUPS_NUM] =
+{
+    CFCFILTER_HIGH_G_X, CFCFILTER_LOW_G_X, CFCFILTER_GYRO_X
+};
+
+/**
+ * @brief Datalog row presence mask of each group
+ */
+static const uint8_t group_masks[GROUPS_NUM] =
+{
+    DATALOG_HIGH_G_ACCEL_AVAILABLE, DATALOG_LOW_G_ACCEL_AVAILABLE, DATALOG_GYRO_AVAILABLE
+};
+
+/**
+ * @brief Every sensor sampled at one tick, handed from the sampling
+ *        interrupt to the filter stage
+ */
+typedef struct
+{
+    int16_t    channels[CFCFILTER_CHANNELS]; /*!< Sensor readings */
+    datetime_t dt;                           /*!< Time of sample */
+    uint8_t    available;                    /*!< Datalog row presence mask */
+    bool       impact;                       /*!< Sample taken during an impact */
+} acquisition_frame_t;
+
+/**
+ * @brief Frames waiting for the filter stage, the sampling interrupt is
+ *        the only producer and the filter stage the only consumer
+ */
+NRF_ATFIFO_DEF(frame_ring, acquisition_frame_t, ACQUISITION_RING_SIZE);
+
+/**
+ * @brief Row handed from the filter stage to the store stage
+ */
+typedef struct
+{
+    int16_t    channels[CFCFILTER_CHANNELS]; /*!< Filtered sample, a peak is in the high-g channels */
+    datetime_t dt;                           /*!< Time of sample */
+    uint8_t    mask;                         /*!< Datalog row presence mask */
+    bool       peak;                         /*!< Impact peak rather than a sample */
+} acquisition_row_t;
+
+/**
+ * @brief Rows waiting for the store stage
+ */
+NRF_QUEUE_DEF(acquisition_row_t, acquisition_log_queue, ACQUISITION_QUEUE_SIZE, NRF_QUEUE_MODE_NO_OVERFLOW);
+
+/**
+ * @brief Filtered samples waiting for the stream stage
+ */
+NRF_QUEUE_DEF(telemetry_record_t, acquisition_stream_queue, ACQUISITION_QUEUE_SIZE, NRF_QUEUE_MODE_NO_OVERFLOW);
+
+/**
+ * @brief Sampling interrupt state
+ */
+static struct
+{
+    volatile bool en;                 /*!< Frames are wanted */
+    int16_t last[CFCFILTER_CHANNELS]; /*!< Last good reading of each channel */
+} sampler;
+
+/**
+ * @brief Samples waiting to be filtered and logged, stored per channel
+ *        so that each channel can be filtered as one contiguous block
+ */
+static struct
+{
+    int16_t    channels[CFCFILTER_CHANNELS][ACQUISITION_BATCH_SIZE]; /*!< Sensor readings */
+    datetime_t dt[ACQUISITION_BATCH_SIZE];                           /*!< Time of each sample */
+    uint8_t    available[ACQUISITION_BATCH_SIZE];                    /*!< Datalog row presence mask of each sample */
+    bool       impact[ACQUISITION_BATCH_SIZE];                       /*!< Sample taken during an impact */
+    size_t     count;                                                /*!< Number of samples in batch */
+} batch;
+
+/**
+ * @brief Pipeline counters, each written by one context only
+ */
+static struct
+{
+    volatile uint32_t samples;     /*!< Sampling interrupt */
+    volatile uint32_t missed;      /*!< Whoever calls acquisition_trigger() */
+    volatile uint32_t dropped;     /*!< Sampling interrupt */
+    volatile uint32_t ring_hwm;    /*!< Sampling interrupt */
+    volatile uint32_t latency_min; /*!< Sampling interrupt, in us */
+    volatile uint32_t latency_max; /*!< Sampling interrupt, in us */
+    volatile uint32_t consumed;    /*!< Filter stage, frames taken out of the ring */
+    volatile uint32_t batches;     /*!< Filter stage */
+    volatile uint32_t unlogged;    /*!< Filter stage */
+    volatile uint32_t unstreamed;  /*!< Filter stage */
+} counters;
+
+/**
+ * @brief First failure of any stage since acquisition_process() last ran
+ */
+static volatile sysret_t status = RET_OK;
+
+/**
+ * @brief Acquisition session state
+ */
+static bool     running    = false;
+static uint32_t decimation = 1U;
+static uint32_t phase      = 0U; /*!< Samples since last logged row, kept across batches */
+static configs_high_g_log_t high_g_log = CONFIGS_HIGH_G_LOG_SAMPLES; /*!< High-g logging in use */
+
+/******************************
+ * Helper functions
+ ******************************/
+
+/**
+ * @notapi
+ * @brief Store a sensor reading in a frame, runs in the sampling interrupt
+ *
+ * If the reading failed, the channel's last good value is held so that
+ * the filters see a continuous signal, but the row is logged without it.
+ *
+ * @param frame   - Frame being sampled
+ * @param group   - Channel group the reading belongs to
+ * @param reading - Sensor reading
+ * @param ok      - Whether the sensor was read successfully
+ */
+static void frame_store(acquisition_frame_t* frame, acquisition_group_t group, int16_t reading[3U], bool ok)
+{
+    cfcfilter_channel_t first = group_channels[group];
+
+    for(size_t axis = 0U ; axis < 3U ; axis++)
+    {
+        if(ok)
+            sampler.last[first + axis] = reading[axis];
+
+        frame->channels[first + axis] = sampler.last[first + axis];
+    }
+
+    if(ok)
+        frame->available |= group_masks[group];
+}
+
+/**
+ * @notapi
+ * @brief Keep the first failure of any stage for acquisition_process()
+ *
+ * @param ret - Stage status
+ */
+static void report(sysret_t ret)
+{
+    if(ret == RET_OK || status != RET_OK)
+        return;
+
+    status = ret;
+
+    /* stages may run in their own tasks, let the state machine know */
+    statemachine_kick();
+}
+
+/**
+ * @notapi
+ * @brief Let the filter stage know there are frames in the ring, runs in
+ *        the sampling interrupt
+ */
+static void filter_wake(void)
+{
+#ifdef FREERTOS
+    rtos_wake(RTOS_TASK_ACQUISITION);
+#else
+    statemachine_kick();
+#endif
+}
+
+/**
+ * @notapi
+ * @brief Hand queued rows on, to the storage and network tasks in the
+ *        FreeRTOS build, straight to the datalog and live stream otherwise
+ */
+static void sinks_wake(void)
+{
+#ifdef FREERTOS
+    rtos_wake(RTOS_TASK_STORAGE);
+    rtos_wake(RTOS_TASK_NETWORK);
+#else
+    acquisition_store();
+    acquisition_stream();
+#endif
+}
+
+/**
+ * @notapi
+ * @brief Queue a row for the store stage
+ *
+ * @param row - Row to log
+ */
+static void log_put(const acquisition_row_t* row)
+{
+    if(nrf_queue_push(&acquisition_log_queue, row) != NRF_SUCCESS)
+        counters.unlogged++;
+}
+
+/**
+ * @notapi
+ * @brief Copy a frame taken out of the ring into the batch
+ *
+ * @param frame - Frame from the ring
+ */
+static void batch_add(const acquisition_frame_t* frame)
+{
+    for(size_t ch = 0U ; ch < CFCFILTER_CHANNELS ; ch++)
+        batch.channels[ch][batch.count] = frame->channels[ch];
+
+    batch.dt[batch.count] = frame->dt;
+    batch.available[batch.count] = frame->available;
+    batch.impact[batch.count] = frame->impact;
+    batch.count++;
+}
+
+/**
+ * @notapi
+ * @brief Filter every channel in the batch, then queue every sample for
+ *        the stream stage and the decimated rows for the store stage
+ */
+static void batch_flush(void)
+{
+    for(size_t ch = 0U ; ch < CFCFILTER_CHANNELS ; ch++)
+        cfcfilter_process((cfcfilter_channel_t)ch, batch.channels[ch], batch.count);
+
+    for(size_t i = 0U ; i < batch.count ; i++)
+    {
+        acquisition_row_t row;
+
+        for(size_t ch = 0U ; ch < CFCFILTER_CHANNELS ; ch++)
+            row.channels[ch] = batch.channels[ch][i];
+
+        /* live stream picks its own records out of every filtered sample */
+        if(nrf_queue_push(&acquisition_stream_queue, row.channels) != NRF_SUCCESS)
+            counters.unstreamed++;
+
+        /* impacts are logged at full rate */
+        bool impact = (high_g_log == CONFIGS_HIGH_G_LOG_PEAKS_EVENTS) && batch.impact[i];
+
+        if(phase == 0U || impact)
+        {
+            row.mask = batch.available[i];
+            row.dt = batch.dt[i];
+            row.peak = false;
+
+            /* high-g samples outside of impacts are covered by peaks */
+            if(high_g_log != CONFIGS_HIGH_G_LOG_SAMPLES && !impact)
+                row.mask &= (uint8_t)~DATALOG_HIGH_G_ACCEL_AVAILABLE;
+
+            log_put(&row);
+        }
+
+        phase = (phase + 1U) % decimation;
+    }
+
+    if(batch.count > 0U)
+        counters.batches++;
+
+    batch.count = 0U;
+}
+
+/**
+ * @notapi
+ * @brief Queue every impact peak waiting in the ADXL372 FIFO for the
+ *        store stage
+ *
+ * Peaks are timestamped when read, within a batch of the end of the impact.
+ *
+ * @return sysret_t Status of the first failure, if any
+ */
+static sysret_t peaks_flush(void)
+{
+    sysret_t ret;
+    int16_t peaks[PEAK_READ_SIZE][ADXL372_AXES];
+    size_t count;
+    acquisition_row_t row;
+
+    if(high_g_log == CONFIGS_HIGH_G_LOG_SAMPLES)
+        return RET_OK;
+
+    row.peak = true;
+    row.mask = (datetime_get(&row.dt) == RET_OK) ? DATALOG_DATETIME_AVAILABLE : 0U;
+
+    do
+    {
+        ret = adxl372_peak_read(peaks, PEAK_READ_SIZE, &count);
+        SYSRET_CHECK(ret);
+
+        for(size_t i = 0U ; i < count ; i++)
+        {
+            (void)memcpy(&row.channels[CFCFILTER_HIGH_G_X], peaks[i], sizeof(peaks[i]));
+            log_put(&row);
+        }
+    } while(count == PEAK_READ_SIZE);
+
+    return RET_OK;
+}
+
+/**
+ * @notapi
+ * @brief Log the readings the ADXL372 kept in its FIFO from the start of
+ *        the impact that fired the trigger, before anything is sampled
+ *
+ * Readings are logged unfiltered at the ADXL372 rate, high-g only and
+ * without a datetime, ahead of the first sampled row. The pipeline is
+ * still empty, so they go straight to the datalog.
+ *
+ * @return sysret_t Status of the first failure, if any
+ */
+static sysret_t onset_log(void)
+{
+    sysret_t ret;
+    int16_t readings[ONSET_READ_SIZE][ADXL372_AXES];
+    size_t count;
+    size_t logged = 0U;
+
+    do
+    {
+        ret = adxl372_onset_read(readings, ONSET_READ_SIZE, &count);
+
+        for(size_t i = 0U ; ret == RET_OK && i < count ; i++)
+            ret = datalog_log(NULL, NULL, NULL, readings[i]);
+
+        logged += count;
+    } while(ret == RET_OK && count == ONSET_READ_SIZE && logged < ADXL372_FIFO_ONSET_MAX);
+
+    /* nothing kept when the trigger didn't arm the FIFO */
+    if(ret == NRF_ERROR_INVALID_STATE)
+        ret = RET_OK;
+
+    (void)adxl372_onset_stop();
+
+    return ret;
+}
+
+/**
+ * @notapi
+ * @brief Have the ADXL372 keep the peak of every impact
+ *
+ * @param configs - Device configurations
+ * @return sysret_t Driver status
+ */
+static sysret_t peaks_start(const configs_t* configs)
+{
+    adxl372_peak_cfg_t cfg;
+
+    cfg.act_thresh   = (configs->threshold_resultant > 0) ? (uint16_t)configs->threshold_resultant : PEAK_ACT_THRESH_DEFAULT;
+    cfg.act_time     = PEAK_ACT_TIME;
+    cfg.inact_thresh = cfg.act_thresh / 2U;
+    cfg.inact_time   = PEAK_INACT_TIME;
+
+    return adxl372_peak_start(&cfg);
+}
+
+/******************************
+ * API
+ ******************************/
+
+/**
+ * @brief Configure channel filters and start a new acquisition session
+ *
+ * Filter classes that can't be realized at the sampling rate fall back to
+ * bypass. The requested decimation is limited to what every channel can
+ * take without aliasing, so unfiltered channels are never decimated.
+ *
+ * @param configs     - Device configurations to acquire data with
+ * @param sample_rate - Rate at which @ref acquisition_trigger() will be called, in Hz
+ * @return sysret_t Module status
+ */
+sysret_t acquisition_start(configs_t* configs, float sample_rate)
+{
+    ASSERT(configs);
+
+    uint8_t classes[GROUPS_NUM] = { configs->high_g_cfc, configs->low_g_cfc, configs->gyro_cfc };
+    uint32_t limit = UINT32_MAX;
+
+    for(size_t group = 0U ; group < GROUPS_NUM ; group++)
+    {
+        cfcfilter_class_t cfc = (classes[group] < CFCFILTER_CLASS_MAX) ? (cfcfilter_class_t)classes[group] : CFCFILTER_BYPASS;
+
+        for(size_t axis = 0U ; axis < 3U ; axis++)
+        {
+            if(cfcfilter_configure(group_channels[group] + axis, cfc, sample_rate) != RET_OK)
+            {
+                (void)cfcfilter_configure(group_channels[group] + axis, CFCFILTER_BYPASS, sample_rate);
+                cfc = CFCFILTER_BYPASS;
+            }
+        }
+
+        if(cfc != classes[group])
+            NRF_LOG_WARNING("group %d filter unavailable at this rate, bypassed", group);
+
+        uint32_t max = cfcfilter_max_decimation(cfc, sample_rate);
+        limit = (max < limit) ? max : limit;
+    }
+
+    decimation = (configs->decimation > 1U) ? configs->decimation : 1U;
+
+    if(decimation > limit)
+    {
+        NRF_LOG_WARNING("decimation %d limited to %d", decimation, limit);
+        decimation = limit;
+    }
+
+    /* trigger mode captures are short, they're logged in full */
+    high_g_log = CONFIGS_HIGH_G_LOG_SAMPLES;
+
+    /* start of the impact, from before sampling */
+    if(configs->datalog_mode == CONFIGS_DATALOG_MODE_TRIGGER && onset_log() != RET_OK)
+        NRF_LOG_WARNING("impact start couldn't be logged");
+
+    if(configs->datalog_mode == CONFIGS_DATALOG_MODE_CONTINUOUS &&
+       configs->high_g_log > CONFIGS_HIGH_G_LOG_SAMPLES && configs->high_g_log < CONFIGS_HIGH_G_LOG_MAX)
+    {
+        if(peaks_start(configs) == RET_OK)
+            high_g_log = (configs_high_g_log_t)configs->high_g_log;
+        else
+            NRF_LOG_WARNING("high-g peak detection unavailable, logging every sample");
+    }
+
+    (void)memset(&batch, 0, sizeof(batch));
+    (void)memset(&sampler, 0, sizeof(sampler));
+    (void)memset(&counters, 0, sizeof(counters));
+    counters.latency_min = UINT32_MAX;
+    status = RET_OK;
+    (void)NRF_ATFIFO_INIT(frame_ring);
+    nrf_queue_reset(&acquisition_log_queue);
+    nrf_queue_reset(&acquisition_stream_queue);
+    nrf_queue_max_utilization_reset(&acquisition_log_queue);
+    nrf_queue_max_utilization_reset(&acquisition_stream_queue);
+    phase = 0U;
+    running = true;
+
+    telemetry_start(sample_rate);
+
+    /* SPI transfers outside of sampling hold it off rather than get cut into */
+    spi_set_guard_irq(SAMPLE_IRQn);
+
+    NVIC_SetPriority(SAMPLE_IRQn, SAMPLE_IRQ_PRIORITY);
+    NVIC_ClearPendingIRQ(SAMPLE_IRQn);
+    sampler.en = true;
+    NVIC_EnableIRQ(SAMPLE_IRQn);
+
+    return RET_OK;
+}
+
+/**
+ * @brief Sampling interrupt, reads every sensor into a frame and hands it
+ *        to the filter stage
+ */
+void SAMPLE_IRQHandler(void)
+{
+    acquisition_frame_t frame;
+    int16_t gyro[ICM20649_GYRO_AXES] = {0};
+    int16_t low_g_accel[ICM20649_ACCEL_AXES] = {0};
+    int16_t high_g_accel[ADXL372_AXES] = {0};
+
+    if(!sampler.en)
+        return;
+
+    uint32_t latency = sampleclock_since_tick_us();
+
+    if(latency > counters.latency_max)
+        counters.latency_max = latency;
+
+    if(latency < counters.latency_min)
+        counters.latency_min = latency;
+
+    frame.available = 0U;
+
+    /* get sensor readings, the timer already paces sampling */
+    if(datetime_get(&frame.dt) == RET_OK)
+        frame.available |= DATALOG_DATETIME_AVAILABLE;
+
+    sysret_t icm_ret  = icm20649_read_latest(gyro, low_g_accel);
+    sysret_t adxl_ret = adxl372_read_latest(high_g_accel);
+
+    frame_store(&frame, GROUP_HIGH_G, high_g_accel, adxl_ret == RET_OK);
+    frame_store(&frame, GROUP_LOW_G, low_g_accel, icm_ret == RET_OK);
+    frame_store(&frame, GROUP_GYRO, gyro, icm_ret == RET_OK);
+
+    frame.impact = adxl372_awake();
+
+    if(nrf_atfifo_alloc_put(frame_ring, &frame, sizeof(frame), NULL) != NRF_SUCCESS)
+    {
+        counters.dropped++;
+    }
+    else
+    {
+        uint32_t backlog = ++counters.samples - counters.consumed;
+
+        if(backlog > counters.ring_hwm)
+            counters.ring_hwm = backlog;
+
+        /* only the first frame since boot is recorded */
+        boot_mark(BOOT_MARK_FIRST_SAMPLE);
+    }
+
+    filter_wake();
+}
+
+/**
+ * @brief Sample all sensors in the sampling interrupt, safe to call from
+ *        interrupts
+ */
+void acquisition_trigger(void)
+{
+    /* still pending means it's being held off, this tick is lost */
+    if(NVIC_GetPendingIRQ(SAMPLE_IRQn))
+        counters.missed++;
+    else
+        NVIC_SetPendingIRQ(SAMPLE_IRQn);
+}
+
+/**
+ * @brief Filter stage, take every frame out of the ring, filter and
+ *        decimate each batch once it's full and queue it for the other
+ *        stages
+ */
+void acquisition_filter(void)
+{
+    acquisition_frame_t frame;
+
+    if(!running)
+        return;
+
+    while(nrf_atfifo_get_free(frame_ring, &frame, sizeof(frame), NULL) == NRF_SUCCESS)
+    {
+        counters.consumed++;
+        batch_add(&frame);
+
+        if(batch.count < ACQUISITION_BATCH_SIZE)
+            continue;
+
+        batch_flush();
+        report(peaks_flush());
+        sinks_wake();
+    }
+}
+
+/**
+ * @brief Store stage, write every queued row to the datalog
+ */
+void acquisition_store(void)
+{
+    acquisition_row_t row;
+
+    while(nrf_queue_pop(&acquisition_log_queue, &row) == NRF_SUCCESS)
+    {
+        datetime_t* dt = (row.mask & DATALOG_DATETIME_AVAILABLE) ? &row.dt : NULL;
+
+        if(row.peak)
+        {
+            report(datalog_log_peak(dt, &row.channels[CFCFILTER_HIGH_G_X]));
+            continue;
+        }
+
+        report(datalog_log(
+            dt,
+            (row.mask & DATALOG_GYRO_AVAILABLE)         ? &row.channels[CFCFILTER_GYRO_X] : NULL,
+            (row.mask & DATALOG_LOW_G_ACCEL_AVAILABLE)  ? &row.channels[CFCFILTER_LOW_G_X] : NULL,
+            (row.mask & DATALOG_HIGH_G_ACCEL_AVAILABLE) ? &row.channels[CFCFILTER_HIGH_G_X] : NULL
+        ));
+    }
+}
+
+/**
+ * @brief Stream stage, feed every queued sample to the live stream
+ */
+void acquisition_stream(void)
+{
+    /* records are packed, popped into an aligned copy */
+    int16_t channels[CFCFILTER_CHANNELS];
+
+    while(nrf_queue_pop(&acquisition_stream_queue, channels) == NRF_SUCCESS)
+        telemetry_push(channels);
+}
+
+/**
+ * @brief Run the pipeline stages and get the first failure since the last
+ *        call, meant to be called by the state machine
+ *
+ * @return sysret_t Module status, the first failure
+ */
+sysret_t acquisition_process(void)
+{
+    if(!running)
+        return RET_ERR;
+
+#ifndef FREERTOS
+    acquisition_filter();
+#endif
+
+    sysret_t ret = status;
+    status = RET_OK;
+
+    return ret;
+}
+
+/**
+ * @brief Stop sampling, run whatever is left in the ring, batch and
+ *        queues through every stage, then stop acquisition
+ *
+ * @return sysret_t Module status
+ */
+sysret_t acquisition_stop(void)
+{
+    if(!running)
+        return RET_ERR;
+
+    NVIC_DisableIRQ(SAMPLE_IRQn);
+    NVIC_ClearPendingIRQ(SAMPLE_IRQn);
+    sampler.en = false;
+
+    /* frames still in the ring, then the partial batch, then the queues */
+    acquisition_filter();
+    batch_flush();
+    report(peaks_flush());
+    acquisition_store();
+    acquisition_stream();
+
+    if(high_g_log != CONFIGS_HIGH_G_LOG_SAMPLES)
+        (void)adxl372_peak_stop();
+
+    high_g_log = CONFIGS_HIGH_G_LOG_SAMPLES;
+
+    telemetry_stop();
+    cfcfilter_reset();
+    running = false;
+
+    sysret_t ret = status;
+    status = RET_OK;
+
+    return ret;
+}
+
+/**
+ * @brief Decimation factor in use by the current session
+ *
+ * @return uint32_t Decimation factor
+ */
+uint32_t acquisition_get_decimation(void)
+{
+    return decimation;
+}
+
+/**
+ * @brief Get pipeline counters
+ *
+ * @param stats - Counters will be saved here
+ */
+void acquisition_get_stats(acquisition_stats_t* stats)
+{
+    ASSERT(stats);
+
+    stats->samples  = counters.samples;
+    stats->missed   = counters.missed;
+    stats->dropped  = counters.dropped;
+    stats->ring_hwm = counters.ring_hwm;
+    stats->batches  = counters.batches;
+
+    stats->unlogged   = counters.unlogged;
+    stats->unstreamed = counters.unstreamed;
+    stats->log_hwm    = nrf_queue_max_utilization_get(&acquisition_log_queue);
+    stats->stream_hwm = nrf_queue_max_utilization_get(&acquisition_stream_queue);
+
+    stats->latency_max_us = counters.latency_max;
+    stats->jitter_us = (counters.latency_max >= counters.latency_min) ?
+        counters.latency_max - counters.latency_min : 0U;
+}
@@ -0,0 +1,188 @@
+/**
+ * @file boot.c
+ * @author UBC Capstone Team 2020/2021
+ * @brief Staged startup, times the boot and resumes datalogging after a reset
+ */
+
+#include "boot.h"
+#include "app_timer.h"
+#include "nrf_delay.h"
+#include "nrf_assert.h"
+
+/**
+ * @brief Period of the timer keeping the app_timer counter running
+ */
+#define BOOT_CLOCK_PERIOD_MS 60000U
+
+/**
+ * @brief Value of the retained word while datalogging is enabled
+ */
+#define BOOT_DATALOG_MAGIC 0xDA7A106EU
+
+/**
+ * @brief Value of the retained word while datalogging is enabled and the
+ *        helmet is on
+ */
+#define BOOT_DATALOG_WORN_MAGIC 0xDA7A3EA2U
+
+/**
+ * @brief app_timer only runs its RTC while a timer is active, this one keeps
+ *        it counting from boot so the marks are timed from reset
+ */
+APP_TIMER_DEF(boot_clock_timer);
+
+/**
+ * @brief app_timer counter at boot_init()
+ */
+static uint32_t boot_ticks = 0U;
+
+/**
+ * @brief app_timer counter at each mark
+ */
+static volatile uint32_t mark_ticks[BOOT_MARKS];
+
+/**
+ * @brief Marks reached
+ */
+static volatile bool mark_set[BOOT_MARKS];
+
+/**
+ * @brief Datalogging enable, outside .bss so it survives a reset
+ */
+static volatile uint32_t datalog_retained __attribute__((section(".noinit")));
+
+/******************************
+ * Helper functions
+ ******************************/
+
+/**
+ * @notapi
+ * @brief Nothing to do, the timer only keeps the counter running
+ */
+static void boot_clock_handler(void* p_ctx)
+{
+    (void)p_ctx;
+}
+
+/******************************
+ * API
+ ******************************/
+
+/**
+ * @brief Start timing the boot, call right after app_timer_init()
+ *
+ * @return sysret_t Module status
+ */
+sysret_t boot_init(void)
+{
+    sysret_t ret;
+
+    ret = app_timer_create(&boot_clock_timer, APP_TIMER_MODE_REPEATED, boot_clock_handler);
+    SYSRET_CHECK(ret);
+
+    ret = app_timer_start(boot_clock_timer, APP_TIMER_TICKS(BOOT_CLOCK_PERIOD_MS), NULL);
+    SYSRET_CHECK(ret);
+
+    boot_ticks = app_timer_cnt_get();
+
+    return RET_OK;
+}
+
+/**
+ * @brief Poll a device until it answers or BOOT_READY_TIMEOUT_MS runs out
+ *
+ * @param test - Device test, reads the device ID. An uninitialized driver
+ *               counts as ready.
+ * @return sysret_t RET_OK once the device answers, the last test status
+ *         otherwise
+ */
+sysret_t boot_wait_ready(sysret_t (*test)(void))
+{
+    ASSERT(test);
+
+    sysret_t ret = test();
+
+    /* busy wait, nothing else runs this early */
+    for(uint32_t waited_us = 0U ;
+        ret != RET_OK && ret != RET_DRV_UNINIT && waited_us < BOOT_READY_TIMEOUT_MS * 1000U ;
+        waited_us += BOOT_READY_POLL_US)
+    {
+        nrf_delay_us(BOOT_READY_POLL_US);
+        ret = test();
+    }
+
+    return (ret == RET_DRV_UNINIT) ? RET_OK : ret;
+}
+
+/**
+ * @brief Record the time of a mark, only the first call counts. Safe to
+ *        call from interrupts.
+ *
+ * @param mark - Mark
+ */
+void boot_mark(boot_mark_t mark)
+{
+    ASSERT(mark < BOOT_MARKS);
+
+    if(mark_set[mark])
+        return;
+
+    mark_ticks[mark] = app_timer_cnt_get();
+    mark_set[mark] = true;
+}
+
+/**
+ * @brief Get the time of a mark
+ *
+ * @param mark - Mark
+ * @param ms   - Time since boot in ms
+ * @return true if the mark was reached
+ */
+bool boot_elapsed_ms(boot_mark_t mark, uint32_t* ms)
+{
+    ASSERT(mark < BOOT_MARKS);
+    ASSERT(ms);
+
+    if(!mark_set[mark])
+        return false;
+
+    uint64_t ticks = app_timer_cnt_diff_compute(mark_ticks[mark], boot_ticks);
+    *ms = (uint32_t)((ticks * 1000U) / APP_TIMER_CLOCK_FREQ);
+
+    return true;
+}
+
+/**
+ * @brief Check if datalogging was enabled when the device last reset
+ *
+ * @return true if datalogging should pick up again
+ */
+bool boot_datalog_resume(void)
+{
+    return datalog_retained == BOOT_DATALOG_MAGIC || datalog_retained == BOOT_DATALOG_WORN_MAGIC;
+}
+
+/**
+ * @brief Check if the helmet was on when the device last reset while
+ *        datalogging was enabled
+ *
+ * @return true if the helmet was on
+ */
+bool boot_wear_resume(void)
+{
+    return datalog_retained == BOOT_DATALOG_WORN_MAGIC;
+}
+
+/**
+ * @brief Keep datalogging enable and the helmet being on across a reset
+ *
+ * @param enabled - Datalogging enabled
+ * @param worn    - Helmet on, only kept with datalogging enabled
+ */
+void boot_datalog_retain(bool enabled, bool worn)
+{
+    if(!enabled)
+        datalog_retained = 0U;
+    else
+        datalog_retained = worn ? BOOT_DATALOG_WORN_MAGIC : BOOT_DATALOG_MAGIC;
+}
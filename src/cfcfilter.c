@@ -0,0 +1,185 @@
+/**
+ * @file cfcfilter.c
+ * @author UBC Capstone Team 2020/2021
+ * @brief SAE J211 Channel Frequency Class (CFC) filtering stage
+ */
+
+#include <string.h>
+#include "cfcfilter.h"
+#include "arm_math.h"
+#include "nrf_assert.h"
+
+/**
+ * @brief Two cascaded 2-pole sections give the 4-pole J211 magnitude response
+ */
+#define CFCFILTER_NUM_STAGES 2U
+
+/**
+ * @brief CMSIS biquad sizes
+ */
+#define BIQUAD_COEFFS_PER_STAGE 5U /*!< b0, b1, b2, a1, a2 */
+#define BIQUAD_STATE_PER_STAGE  2U /*!< DF2T needs two state variables per stage */
+
+/**
+ * @brief J211 design frequency constant, wd = 2 * pi * CFC * 2.0775
+ */
+#define CFCFILTER_DESIGN_FACTOR 2.0775f
+
+/**
+ * @brief J211 recommends sampling at least this many times the CFC
+ */
+#define CFCFILTER_MIN_OVERSAMPLING 10U
+
+/**
+ * @brief Square root of 2, Butterworth damping term
+ */
+#define SQRT2 1.41421356237310f
+
+char* cfcfilter_class_strings[CFCFILTER_CLASS_MAX] =
+{
+    "BYPASS", "CFC 60", "CFC 180", "CFC 600", "CFC 1000"
+};
+
+/**
+ * @brief Numeric CFC value of each class
+ */
+static const uint32_t cfc_values[CFCFILTER_CLASS_MAX] =
+{
+    0U, 60U, 180U, 600U, 1000U
+};
+
+/**
+ * @brief Per-channel filter instance
+ */
+typedef struct
+{
+    cfcfilter_class_t cfc;                                                  /*!< Configured class */
+    arm_biquad_cascade_df2T_instance_f32 biquad;                            /*!< CMSIS filter instance */
+    float32_t coeffs[CFCFILTER_NUM_STAGES * BIQUAD_COEFFS_PER_STAGE];      /*!< Filter coefficients */
+    float32_t state[CFCFILTER_NUM_STAGES * BIQUAD_STATE_PER_STAGE];        /*!< Filter state */
+} cfcfilter_t;
+
+/**
+ * @brief Filter instances, all bypassed by default
+ */
+static cfcfilter_t filters[CFCFILTER_CHANNELS];
+
+/**
+ * @brief Scratch buffers for converting samples to and from floating point
+ */
+static float32_t block_in[CFCFILTER_MAX_BLOCK_SIZE];
+static float32_t block_out[CFCFILTER_MAX_BLOCK_SIZE];
+
+/******************************
+ * API
+ ******************************/
+
+/**
+ * @brief Configure a channel's filter and reset its state
+ *
+ * @param channel     - Channel to configure
+ * @param cfc         - Channel frequency class
+ * @param sample_rate - Channel sampling rate in Hz
+ * @return sysret_t Module status
+ * @retval NRF_ERROR_INVALID_PARAM if the class can't be realized at the sampling rate
+ */
+sysret_t cfcfilter_configure(cfcfilter_channel_t channel, cfcfilter_class_t cfc, float sample_rate)
+{
+    ASSERT(channel < CFCFILTER_CHANNELS);
+
+    cfcfilter_t* filter = &filters[channel];
+
+    if(cfc >= CFCFILTER_CLASS_MAX || sample_rate <= 0.0f)
+        return NRF_ERROR_INVALID_PARAM;
+
+    filter->cfc = CFCFILTER_BYPASS;
+
+    if(cfc == CFCFILTER_BYPASS)
+        return RET_OK;
+
+    /**
+     * SAE J211-1 Appendix C 2-pole Butterworth design
+     */
+    float32_t wd = 2.0f * PI * (float32_t)cfc_values[cfc] * CFCFILTER_DESIGN_FACTOR;
+    float32_t half_angle = wd / (2.0f * sample_rate);
+
+    /* prewarped frequency must stay below Nyquist */
+    if(half_angle >= (PI / 2.0f))
+        return NRF_ERROR_INVALID_PARAM;
+
+    float32_t wa = tanf(half_angle);
+    float32_t den = 1.0f + (SQRT2 * wa) + (wa * wa);
+
+    float32_t a0 = (wa * wa) / den;
+    float32_t b1 = (-2.0f * ((wa * wa) - 1.0f)) / den;
+    float32_t b2 = (-1.0f + (SQRT2 * wa) - (wa * wa)) / den;
+
+    /**
+     * CMSIS expects {b0, b1, b2, a1, a2} with feedback terms added,
+     * which is the same sign convention as J211
+     */
+    for(size_t i = 0U ; i < CFCFILTER_NUM_STAGES ; i++)
+    {
+        float32_t* c = &filter->coeffs[i * BIQUAD_COEFFS_PER_STAGE];
+        c[0] = a0;
+        c[1] = 2.0f * a0;
+        c[2] = a0;
+        c[3] = b1;
+        c[4] = b2;
+    }
+
+    (void)memset(filter->state, 0, sizeof(filter->state));
+    arm_biquad_cascade_df2T_init_f32(&filter->biquad, CFCFILTER_NUM_STAGES, filter->coeffs, filter->state);
+
+    filter->cfc = cfc;
+    return RET_OK;
+}
+
+/**
+ * @brief Reset filter state of every channel, keeping their configurations
+ */
+void cfcfilter_reset(void)
+{
+    for(size_t i = 0U ; i < CFCFILTER_CHANNELS ; i++)
+        (void)memset(filters[i].state, 0, sizeof(filters[i].state));
+}
+
+/**
+ * @brief Filter a block of samples of a single channel in place
+ *
+ * @param channel - Channel the samples belong to
+ * @param data    - Samples to filter
+ * @param n       - Number of samples, at most @ref CFCFILTER_MAX_BLOCK_SIZE
+ */
+void cfcfilter_process(cfcfilter_channel_t channel, int16_t* data, size_t n)
+{
+    ASSERT(channel < CFCFILTER_CHANNELS);
+    ASSERT(data);
+    ASSERT(n <= CFCFILTER_MAX_BLOCK_SIZE);
+
+    cfcfilter_t* filter = &filters[channel];
+
+    if(filter->cfc == CFCFILTER_BYPASS || n == 0U)
+        return;
+
+    arm_q15_to_float(data, block_in, n);
+    arm_biquad_cascade_df2T_f32(&filter->biquad, block_in, block_out, n);
+    arm_float_to_q15(block_out, data, n);
+}
+
+/**
+ * @brief Largest decimation factor that keeps a filtered channel alias-free
+ *
+ * @param cfc         - Channel frequency class
+ * @param sample_rate - Channel sampling rate in Hz
+ * @return uint32_t Decimation factor, 1 if the channel can't be decimated
+ */
+uint32_t cfcfilter_max_decimation(cfcfilter_class_t cfc, float sample_rate)
+{
+    if(cfc == CFCFILTER_BYPASS || cfc >= CFCFILTER_CLASS_MAX)
+        return 1U;
+
+    uint32_t factor = (uint32_t)(sample_rate / (float)(CFCFILTER_MIN_OVERSAMPLING * cfc_values[cfc]));
+
+    return (factor > 1U) ? factor : 1U;
+}
@@ -0,0 +1,232 @@
+/**
+ * @file command.c
+ * @author UBC Capstone Team 2020/2021
+ * @brief Batched TLV command protocol
+ */
+
+#include <string.h>
+#include "command.h"
+#include "cfcfilter.h"
+
+/**
+ * @brief Size of a TLV's type and length bytes
+ */
+#define TLV_HEADER_SIZE 2U
+
+/**
+ * @brief Where a settable field lives in configs_t and what it may hold
+ */
+typedef struct
+{
+    uint8_t offset; /*!< Offset in configs_t */
+    uint8_t size;   /*!< Size in bytes */
+    uint8_t max;    /*!< Values must be below this, 0 for any value */
+} command_field_info_t;
+
+/**
+ * @brief Settable fields, indexed by command_field_t
+ */
+static const command_field_info_t fields[COMMAND_FIELDS_END] =
+{
+    [COMMAND_FIELD_DATALOG_MODE]        = { offsetof(configs_t, datalog_mode),         1U, CONFIGS_DATALOG_MODE_MAX },
+    [COMMAND_FIELD_TRIGGER_ON]          = { offsetof(configs_t, trigger_on),           1U, CONFIGS_TRIGGER_ON_MAX },
+    [COMMAND_FIELD_TRIGGER_AXIS]        = { offsetof(configs_t, trigger_axis),         1U, CONFIGS_TRIGGER_AXIS_MAX },
+    [COMMAND_FIELD_THRESHOLD_RESULTANT] = { offsetof(configs_t, threshold_resultant),  2U, 0U },
+    [COMMAND_FIELD_THRESHOLD_X]         = { offsetof(configs_t, threshold_x),          2U, 0U },
+    [COMMAND_FIELD_THRESHOLD_Y]         = { offsetof(configs_t, threshold_y),          2U, 0U },
+    [COMMAND_FIELD_THRESHOLD_Z]         = { offsetof(configs_t, threshold_z),          2U, 0U },
+    [COMMAND_FIELD_GYRO_SAMPLE_RATE]    = { offsetof(configs_t, gyro_sampling_rate),   1U, CONFIGS_GYRO_SAMPLE_RATE_MAX },
+    [COMMAND_FIELD_LOW_G_SAMPLE_RATE]   = { offsetof(configs_t, low_g_sampling_rate),  1U, CONFIGS_LOW_G_ACCEL_SAMPLE_RATE_MAX },
+    [COMMAND_FIELD_HIGH_G_SAMPLE_RATE]  = { offsetof(configs_t, high_g_sampling_rate), 1U, CONFIGS_HIGH_G_ACCEL_SAMPLE_RATE_MAX },
+    [COMMAND_FIELD_HIGH_G_CFC]          = { offsetof(configs_t, high_g_cfc),           1U, CFCFILTER_CLASS_MAX },
+    [COMMAND_FIELD_LOW_G_CFC]           = { offsetof(configs_t, low_g_cfc),            1U, CFCFILTER_CLASS_MAX },
+    [COMMAND_FIELD_GYRO_CFC]            = { offsetof(configs_t, gyro_cfc),             1U, CFCFILTER_CLASS_MAX },
+    [COMMAND_FIELD_DECIMATION]          = { offsetof(configs_t, decimation),           1U, 0U },
+    [COMMAND_FIELD_HIGH_G_LOG]          = { offsetof(configs_t, high_g_log),           1U, CONFIGS_HIGH_G_LOG_MAX },
+};
+
+/******************************
+ * Helper functions
+ ******************************/
+
+/**
+ * @notapi
+ * @brief Set a field on the batch's configurations
+ *
+ * @param batch - Batch being parsed
+ * @param value - TLV value, u8 field ID then the field's value
+ * @param len   - Size of value
+ * @return command_result_t COMMAND_OK if the field was set
+ */
+static command_result_t set_field(command_batch_t* batch, const uint8_t* value, uint8_t len)
+{
+    if(len < 1U || value[0] == 0U || value[0] >= COMMAND_FIELDS_END)
+        return COMMAND_BAD_TLV;
+
+    const command_field_info_t* field = &fields[value[0]];
+
+    if(len != 1U + field->size)
+        return COMMAND_BAD_TLV;
+
+    if(field->max != 0U && value[1] >= field->max)
+        return COMMAND_BAD_VALUE;
+
+    (void)memcpy((uint8_t*)&batch->configs + field->offset, &value[1], field->size);
+    batch->configs_set = true;
+
+    return COMMAND_OK;
+}
+
+/**
+ * @notapi
+ * @brief Check a datetime is within range, time can only be set once it
+ *        is known to be valid
+ */
+static bool datetime_valid(const datetime_t* dt)
+{
+    return dt->month >= 1U && dt->month <= 12U &&
+           dt->day   >= 1U && dt->day   <= 31U &&
+           dt->hr    < 24U && dt->min   < 60U  &&
+           dt->sec   < 60U && dt->usec  < 1000000U;
+}
+
+/**
+ * @notapi
+ * @brief Parse one TLV into the batch
+ */
+static command_result_t parse_tlv(command_batch_t* batch, uint8_t type, const uint8_t* value, uint8_t len)
+{
+    switch(type)
+    {
+        case COMMAND_TLV_SET_FIELD:
+            return set_field(batch, value, len);
+
+        case COMMAND_TLV_SET_DATETIME:
+            if(len != sizeof(datetime_t))
+                return COMMAND_BAD_TLV;
+
+            (void)memcpy(&batch->datetime, value, sizeof(datetime_t));
+
+            if(!datetime_valid(&batch->datetime))
+                return COMMAND_BAD_VALUE;
+
+            batch->datetime_set = true;
+            return COMMAND_OK;
+
+        case COMMAND_TLV_START_DATALOG:
+        case COMMAND_TLV_STOP_DATALOG:
+        case COMMAND_TLV_GET_STATUS:
+            if(len != 0U)
+                return COMMAND_BAD_TLV;
+
+            if(type == COMMAND_TLV_START_DATALOG)
+                batch->start_datalog = true;
+            else if(type == COMMAND_TLV_STOP_DATALOG)
+                batch->stop_datalog = true;
+            else
+                batch->get_status = true;
+
+            return COMMAND_OK;
+
+        default:
+            return COMMAND_BAD_TLV;
+    }
+}
+
+/******************************
+ * API
+ ******************************/
+
+/**
+ * @brief Check a batch and work out what it does, without applying anything
+ *
+ * Every TLV is checked before returning, the first one that fails
+ * rejects the whole batch.
+ *
+ * @param data    - Batch bytes, after the request code
+ * @param size    - Size of batch
+ * @param configs - Configurations the fields are set on top of
+ * @param batch   - Operations will be saved here
+ * @param failed  - Index of the TLV that failed will be saved here,
+ *                  COMMAND_NO_TLV if none
+ * @return command_result_t COMMAND_OK if the batch can be applied
+ */
+command_result_t command_parse(
+    const uint8_t* data,
+    size_t size,
+    const configs_t* configs,
+    command_batch_t* batch,
+    uint8_t* failed)
+{
+    size_t pos = 1U;
+    uint8_t index = 0U;
+
+    (void)memset(batch, 0, sizeof(*batch));
+    batch->configs = *configs;
+    *failed = COMMAND_NO_TLV;
+
+    if(size < 1U || data[0] != COMMAND_VERSION)
+        return COMMAND_BAD_VERSION;
+
+    while(pos < size)
+    {
+        command_result_t result = COMMAND_BAD_TLV;
+
+        if(size - pos >= TLV_HEADER_SIZE && size - pos - TLV_HEADER_SIZE >= data[pos + 1U])
+            result = parse_tlv(batch, data[pos], &data[pos + TLV_HEADER_SIZE], data[pos + 1U]);
+
+        if(result != COMMAND_OK)
+        {
+            *failed = index;
+            return result;
+        }
+
+        pos += TLV_HEADER_SIZE + data[pos + 1U];
+        index++;
+    }
+
+    return COMMAND_OK;
+}
+
+/**
+ * @brief Build a batch response
+ *
+ * @param request - Request code of the batch
+ * @param result  - Result of the batch
+ * @param failed  - Index of the TLV that failed
+ * @param status  - Status to append as a TLV, NULL for none
+ * @param buf     - Response will be saved here
+ * @param size    - Size of buf
+ * @return uint16_t Size of response, 0 if buf is too small
+ */
+uint16_t command_response(
+    uint8_t request,
+    command_result_t result,
+    uint8_t failed,
+    const command_status_t* status,
+    uint8_t* buf,
+    size_t size)
+{
+    command_response_header_t header =
+    {
+        .request = request,
+        .version = COMMAND_VERSION,
+        .result  = (uint8_t)result,
+        .failed  = failed
+    };
+    size_t len = sizeof(header) + ((status != NULL) ? TLV_HEADER_SIZE + sizeof(*status) : 0U);
+
+    if(len > size)
+        return 0U;
+
+    (void)memcpy(buf, &header, sizeof(header));
+
+    if(status != NULL)
+    {
+        buf[sizeof(header)] = COMMAND_TLV_STATUS;
+        buf[sizeof(header) + 1U] = sizeof(*status);
+        (void)memcpy(&buf[sizeof(header) + TLV_HEADER_SIZE], status, sizeof(*status));
+    }
+
+    return (uint16_t)len;
+}
@@ -4,8 +4,24 @@
  * @brief API for getting and setting device configurations
  */
 
+#include <stddef.h>
+#include <string.h>
 #include "configs.h"
 #include "nrf_assert.h"
+#include "app_util.h"
+#include "crc16.h"
+
+/* the layout word must not overlap the metadata */
+STATIC_ASSERT(sizeof(((metadata_t*)0)->device_metadata) <= sizeof(((metadata_t*)0)->frame.metadata));
+
+/**
+ * @brief Size of configs_t in every layout before the current one,
+ *        see CONFIGS_LAYOUT_VERSION
+ */
+static const size_t layout_configs_size[CONFIGS_LAYOUT_VERSION] =
+{
+    [1U] = CONFIGS_LAYOUT_1_CONFIGS_SIZE
+};
 
 metadata_t GLOBAL_CONFIGS =
 {
@@ -42,6 +58,11 @@ char* configs_high_g_accel_sample_rate_strings[CONFIGS_HIGH_G_ACCEL_SAMPLE_RATE_
     "6400 Hz", "3200 Hz", "1600 Hz", "800 Hz", "400 Hz"
 };
 
+char* configs_high_g_log_strings[CONFIGS_HIGH_G_LOG_MAX] =
+{
+    "EVERY SAMPLE", "PEAKS", "PEAKS + IMPACTS"
+};
+
 /**
  * @brief Timer ticks corresponding to High G accelerometer sampling rates.
  * 
@@ -53,9 +74,63 @@ size_t configs_sample_rate_ticks[CONFIGS_HIGH_G_ACCEL_SAMPLE_RATE_MAX] =
     5, 10, 20, 40, 80
 };
 
+/**
+ * @notapi
+ * @brief Move metadata saved with an older layout to where it is now,
+ *        fields the old layout didn't have are left zeroed
+ *
+ * @param configs Frame as read from flash, migrated in place
+ * @return true if migrated, false if the layout is unknown and the frame
+ *         was cleared
+ */
+static bool layout_migrate(metadata_t* configs)
+{
+    metadata_t old = *configs;
+    const uint8_t* src = old.configs_bytes;
+    uint32_t version = old.frame.layout;
+    size_t configs_size;
+
+    /* the original firmware left the word zeroed, or erased */
+    if(version == 0U || version == UINT32_MAX)
+        version = 1U;
+
+    (void)memset(configs, 0, sizeof(metadata_t));
+
+    if(version >= CONFIGS_LAYOUT_VERSION)
+        return false;
+
+    configs_size = layout_configs_size[version];
+
+    (void)memcpy(&configs->device_metadata.current_dev_configs, src, configs_size);
+    src += configs_size;
+
+    (void)memcpy(&configs->device_metadata.datalog_header, src, sizeof(uint32_t));
+    src += sizeof(uint32_t);
+
+    (void)memcpy(&configs->device_metadata.datalog_size, src, sizeof(uint32_t));
+    src += sizeof(uint32_t);
+
+    (void)memcpy(&configs->device_metadata.datalog_configs, src, configs_size);
+
+    if(configs->device_metadata.datalog_header == CONFIGS_FRAME_HEADER &&
+       configs->device_metadata.datalog_size > 0U)
+    {
+        /* no session index yet, the whole datalog is one session */
+        configs_session_t session = { 0U, configs->device_metadata.datalog_size };
+
+        configs->device_metadata.sessions[0] = session;
+        configs->device_metadata.session_count = 1U;
+    }
+
+    return true;
+}
+
 /**
  * @brief Attempt to get configurations from persistent memory
  * 
+ * Frames saved with an older layout are migrated and saved back, frames
+ * with a layout this firmware doesn't know are discarded.
+ *
  * @param configs Configurations will be saved here
  * @return sysret_t Driver status
  * @retval RET_ERR if persistent memory doesn't contain configurations
@@ -70,9 +145,16 @@ sysret_t configs_get(metadata_t* configs)
     SYSRET_CHECK(ret);
 
     if(configs->device_metadata.current_dev_configs.header != CONFIGS_FRAME_HEADER)
-        ret = RET_ERR;
+        return RET_ERR;
 
-    return ret;
+    if(configs->frame.layout == CONFIGS_LAYOUT_VERSION)
+        return RET_OK;
+
+    /* fields have moved since the frame was saved */
+    if(!layout_migrate(configs))
+        return RET_ERR;
+
+    return configs_save(configs);
 }
 
 /**
@@ -90,6 +172,8 @@ sysret_t configs_save(metadata_t* configs)
     bool tmp = configs->device_metadata.current_dev_configs.datalog_en;
     configs->device_metadata.current_dev_configs.datalog_en = false;
 
+    configs->frame.layout = CONFIGS_LAYOUT_VERSION;
+
     /* erase first subsector in flash */
     ret = mt25q_4kB_subsector_erase(0);
     SYSRET_CHECK(ret);
@@ -100,4 +184,50 @@ sysret_t configs_save(metadata_t* configs)
     /* restore prior config */
     configs->device_metadata.current_dev_configs.datalog_en = tmp;
     return ret;
-}
\ No newline at end of file
+}
+
+/**
+ * @brief Check magic number, CRC and matrix ranges of a calibration blob
+ *
+ * @param calibration Calibration blob to check
+ * @return sysret_t
+ * @retval RET_OK if the blob can be applied
+ * @retval NRF_ERROR_INVALID_DATA otherwise
+ */
+sysret_t configs_calibration_check(const configs_calibration_t* calibration)
+{
+    ASSERT(calibration);
+
+    /* copy out of the packed blob before handing the calibrations around */
+    sensorconv_cal_t high_g = calibration->high_g;
+    sensorconv_cal_t low_g  = calibration->low_g;
+
+    uint16_t crc = crc16_compute(
+        (const uint8_t*)calibration,
+        offsetof(configs_calibration_t, crc),
+        NULL);
+
+    if(calibration->magic != CONFIGS_CALIBRATION_MAGIC || calibration->crc != crc)
+        return NRF_ERROR_INVALID_DATA;
+
+    if(!sensorconv_adxl372_cal_valid(&high_g) || !sensorconv_cal_valid(&low_g))
+        return NRF_ERROR_INVALID_DATA;
+
+    return RET_OK;
+}
+
+/**
+ * @brief Fill in magic number and CRC of a calibration blob
+ *
+ * @param calibration Calibration blob to seal
+ */
+void configs_calibration_seal(configs_calibration_t* calibration)
+{
+    ASSERT(calibration);
+
+    calibration->magic = CONFIGS_CALIBRATION_MAGIC;
+    calibration->crc = crc16_compute(
+        (const uint8_t*)calibration,
+        offsetof(configs_calibration_t, crc),
+        NULL);
+}
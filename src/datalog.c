@@ -8,6 +8,7 @@
 #include <string.h>
 #include "datalog.h"
 #include "mt25q.h"
+#include "boot.h"
 #include "nrf_assert.h"
 #include "nrf_log.h"
 
@@ -21,10 +22,21 @@ static datalog_state_t datalogger_state = DATALOG_STOPPED;
  */
 static uint32_t datalog_size = 0U;
 
+/**
+ * @brief Offset of the current session from start of datalog
+ */
+static uint32_t session_offset = 0U;
+
+/**
+ * @brief Datalog size up to which flash has been erased for the current
+ *        session, always on a subsector boundary
+ */
+static uint32_t erased_size = 0U;
+
 /**
  * @brief Starting address of datalog in flash
  */
-static const uint32_t datalog_base_flash_addr = FLASH_4KB_SUBSECTOR_SIZE;
+static const uint32_t datalog_base_flash_addr = DATALOG_BASE_FLASH_ADDR;
 
 /*********************************************************
  * 
@@ -36,20 +48,255 @@ static const uint32_t datalog_base_flash_addr = FLASH_4KB_SUBSECTOR_SIZE;
  * @notapi
  * @brief Erase contents of existing datalog
  * 
+ * @param size Datalog size in bytes, every subsector it touches is erased
+ * @return sysret_t
+ */
+static sysret_t erase_datalog(uint32_t size)
+{
+    sysret_t ret = RET_OK;
+    uint32_t addr = datalog_base_flash_addr;
+    uint32_t end = datalog_base_flash_addr + size;
+
+    while(addr < end)
+    {
+        /* whole sectors where they fit, subsectors around them */
+        if((addr % FLASH_SECTOR_SIZE) == 0U && end - addr >= FLASH_SECTOR_SIZE)
+        {
+            ret = mt25q_64kB_sector_erase(addr);
+            addr += FLASH_SECTOR_SIZE;
+        }
+        else
+        {
+            ret = mt25q_4kB_subsector_erase(addr);
+            addr += FLASH_4KB_SUBSECTOR_SIZE;
+        }
+
+        SYSRET_CHECK(ret);
+    }
+
+    return ret;
+}
+
+/**
+ * @notapi
+ * @brief Erase the subsectors a write up to a new datalog size runs into
+ *
+ * @param new_size Datalog size after the write
+ * @return sysret_t
+ */
+static sysret_t erase_ahead(uint32_t new_size)
+{
+    sysret_t ret = RET_OK;
+
+    while(erased_size < new_size)
+    {
+        ret = mt25q_4kB_subsector_erase(datalog_base_flash_addr + erased_size);
+        SYSRET_CHECK(ret);
+
+        erased_size += FLASH_4KB_SUBSECTOR_SIZE;
+    }
+
+    return ret;
+}
+
+/**
+ * @notapi
+ * @brief Program bytes into the datalog, split where they cross a page
+ * 
+ * @param offset Offset from start of datalog
+ * @param buf Bytes to program
+ * @param size Number of bytes
  * @return sysret_t
  */
-// static sysret_t erase_datalog(void)
-// {
-//     sysret_t ret = RET_ERR;
+static sysret_t program(uint32_t offset, uint8_t* buf, size_t size)
+{
+    sysret_t ret = RET_ERR;
+    uint32_t addr = datalog_base_flash_addr + offset;
+    uint32_t end_addr = addr + size;
+
+    /* determine if flash write needs to be broken up to
+     * prevent wrap-around */
+    uint32_t next_page = NEXT_PAGE_ADDR_FROM_CURR(addr);
+
+    if(next_page < end_addr)
+    {
+        /* write needs to be broken up into two batches to prevent wrap-around */
+        uint32_t extra = end_addr - next_page;
+
+        /* write first chunk... */
+        ret = mt25q_page_program(addr, buf, size - extra);
+        SYSRET_CHECK(ret);
+
+        /* ...then the next */
+        ret = mt25q_page_program(next_page, buf + (size - extra), extra);
+    }
+    else
+    {
+        /* can write row all at once */
+        ret = mt25q_page_program(addr, buf, size);
+    }
+
+    return ret;
+}
+
+/**
+ * @notapi
+ * @brief Check if a row was cut short by a reset while it was programmed.
+ *        Pages are programmed first byte to last, so the last byte of a torn
+ *        row is still erased. A whole row that ends in 0xFF can't be told
+ *        apart from a torn one and is dropped too
+ *
+ * @param row Row, header included
+ * @param size Row size in bytes
+ * @return true if the row may be incomplete
+ */
+static bool row_torn(const uint8_t* row, size_t size)
+{
+    return (row[size - 1U] == 0xFFU);
+}
+
+/**
+ * @notapi
+ * @brief Void whatever a reset left programmed past the recovered end of
+ *        the datalog, by programming it to filler
+ *
+ * Only needed if the end is within a subsector, the next session would be
+ * programmed over it. Subsectors past the end are erased before use.
+ *
+ * @param end Recovered datalog size
+ * @param voided Datalog size past the voided bytes will be saved here
+ * @return sysret_t
+ */
+static sysret_t void_tail(uint32_t end, uint32_t* voided)
+{
+    uint8_t tail[DATALOG_ROW_MAX_SIZE + DATALOG_SESSION_START_SIZE];
+    uint32_t len = FLASH_4KB_SUBSECTOR_SIZE - (end % FLASH_4KB_SUBSECTOR_SIZE);
+    size_t n = 0U;
+
+    *voided = end;
+
+    if((end % FLASH_4KB_SUBSECTOR_SIZE) == 0U)
+        return RET_OK;
+
+    if(len > sizeof(tail))
+        len = sizeof(tail);
+
+    sysret_t ret = mt25q_read(datalog_base_flash_addr + end, tail, len);
+    SYSRET_CHECK(ret);
+
+    for(size_t i = 0U ; i < len ; i++)
+    {
+        if(tail[i] != 0xFFU)
+            n = i + 1U;
+    }
+
+    if(n == 0U)
+        return RET_OK;
+
+    (void)memset(tail, DATALOG_FILLER, n);
+
+    ret = program(end, tail, n);
+    SYSRET_CHECK(ret);
+
+    *voided = end + n;
+
+    return RET_OK;
+}
+
+/**
+ * @notapi
+ * @brief Append bytes to the datalog
+ * 
+ * @param buf Bytes to append
+ * @param size Number of bytes
+ * @return sysret_t RET_ERR if the datalog is full
+ */
+static sysret_t append(uint8_t* buf, size_t size)
+{
+    sysret_t ret = RET_ERR;
+    uint32_t new_size = datalog_size + size;
+
+    if(datalog_base_flash_addr + new_size <= DATALOG_END_FLASH_ADDR)
+    {
+        /* flash is only ever programmed after it's been erased */
+        ret = erase_ahead(new_size);
+        SYSRET_CHECK(ret);
+
+        /* save datalog row to flash */
+        ret = program(datalog_size, buf, size);
+        SYSRET_CHECK(ret);
+
+        datalog_size = new_size;
+    }
+
+    return ret;
+}
+
+/**
+ * @notapi
+ * @brief Append a formatted row to the datalog, after a session start
+ *        marker if it's the first row of the session
+ * 
+ * @param datalog_row Row, header included
+ * @param size Row size in bytes
+ * @return sysret_t RET_ERR if the datalog is full
+ */
+static sysret_t write_row(uint8_t* datalog_row, size_t size)
+{
+    sysret_t ret;
+
+    /* recovery only takes rows behind a marker at the saved end as this session's */
+    if(datalog_size == session_offset)
+    {
+        uint8_t marker[DATALOG_SESSION_START_SIZE] = { DATALOG_SESSION_START };
+        (void)memcpy(&marker[1], &session_offset, sizeof(session_offset));
+
+        ret = append(marker, sizeof(marker));
+        SYSRET_CHECK(ret);
+    }
+
+    ret = append(datalog_row, size);
+    SYSRET_CHECK(ret);
+
+    boot_mark(BOOT_MARK_FIRST_ROW);
+
+    return ret;
+}
+
+/**
+ * @notapi
+ * @brief Add a session to the index and move the end of the saved datalog
+ *        after it, the metadata isn't saved to flash
+ *
+ * @param dev_metadata Device metadata describing the saved datalog
+ * @param offset Offset of the session from start of datalog
+ * @param end New datalog size, the end of the session
+ */
+static void session_save(metadata_t* dev_metadata, uint32_t offset, uint32_t end)
+{
+    uint8_t count = dev_metadata->device_metadata.session_count;
+    configs_session_t session = { offset, end - offset };
 
-//     for(uint32_t i = FLASH_4KB_SUBSECTOR_SIZE ; i < FLASH_CAPACITY ; i += FLASH_4KB_SUBSECTOR_SIZE)
-//     {
-//         ret = mt25q_4kB_subsector_erase(i);
-//         SYSRET_CHECK(ret);
-//     }
+    if(count < CONFIGS_MAX_SESSIONS)
+    {
+        dev_metadata->device_metadata.sessions[count] = session;
+        dev_metadata->device_metadata.session_count = count + 1U;
+    }
+    else
+    {
+        /* index is full, fold into last session */
+        dev_metadata->device_metadata.sessions[CONFIGS_MAX_SESSIONS - 1U].size =
+            end - dev_metadata->device_metadata.sessions[CONFIGS_MAX_SESSIONS - 1U].offset;
+    }
 
-//     return ret;
-// }
+    dev_metadata->device_metadata.datalog_header = CONFIGS_FRAME_HEADER;
+    dev_metadata->device_metadata.datalog_size = end;
+    (void)memcpy(
+        &(dev_metadata->device_metadata.datalog_configs),
+        &(dev_metadata->device_metadata.current_dev_configs),
+        sizeof(configs_t)
+    );
+}
 
 /*********************************************************
  * 
@@ -60,10 +307,10 @@ static const uint32_t datalog_base_flash_addr = FLASH_4KB_SUBSECTOR_SIZE;
 /**
  * @brief Start datalogging session.
  * 
- * @note This erases preexisting datalogs to make space
- *       for new ones
+ * @note The session is appended after the saved datalog, see
+ *       @ref configs_session_t
  *
- * @param dev_metadata Update device metadata to reflect erasing preexisting datalog
+ * @param dev_metadata Device metadata describing the saved datalog
  * @return sysret_t
  */
 sysret_t datalog_start(metadata_t* dev_metadata)
@@ -74,14 +321,144 @@ sysret_t datalog_start(metadata_t* dev_metadata)
     if(datalogger_state != DATALOG_STOPPED)
         return ret;
 
-    /* clear space on flash for new datalogging session */
-    ret = datalog_erase(dev_metadata);
-    SYSRET_CHECK(ret);
+    /* append to saved datalog, if any */
+    if(dev_metadata->device_metadata.datalog_header == CONFIGS_FRAME_HEADER)
+    {
+        datalog_size = dev_metadata->device_metadata.datalog_size;
+    }
+    else
+    {
+        datalog_size = 0U;
+        dev_metadata->device_metadata.session_count = 0U;
+        dev_metadata->device_metadata.downloaded_size = 0U;
+    }
 
-    datalog_size = 0U;
+    /* rest of the last subsector was erased by the session that started it,
+       subsectors after it are erased as rows reach them */
+    session_offset = datalog_size;
+    erased_size = ((datalog_size + FLASH_4KB_SUBSECTOR_SIZE - 1U) / FLASH_4KB_SUBSECTOR_SIZE) * FLASH_4KB_SUBSECTOR_SIZE;
     datalogger_state = DATALOG_START;
 
-    return ret;
+    return RET_OK;
+}
+
+/**
+ * @brief Recover rows logged after the saved end of the datalog
+ *
+ * The saved datalog size only moves on @ref datalog_stop(), so a reset in
+ * the middle of a session leaves rows programmed past it. A new session
+ * would be programmed over them, corrupting both. The rows are walked from
+ * the session start marker at the saved end up to the first erased (or
+ * otherwise invalid) row header or another marker, and saved as a session
+ * of their own. Without a marker there, whatever follows the saved end
+ * belongs to an older session and is left alone.
+ *
+ * A last row whose last byte is still erased was cut short by the reset.
+ * It's voided with filler and kept out of the session, along with the
+ * marker if no row is left, so the next session isn't programmed over it.
+ *
+ * @param dev_metadata Device metadata describing the saved datalog, saved
+ *                     to flash if rows were recovered
+ * @return sysret_t RET_OK if nothing needed recovering or the rows were saved
+ */
+sysret_t datalog_recover(metadata_t* dev_metadata)
+{
+    ASSERT(dev_metadata);
+
+    uint8_t chunk[FLASH_PAGE_SIZE];
+    uint32_t chunk_start = 0U;
+    uint32_t chunk_len = 0U;
+    uint32_t start = 0U;
+    uint32_t end;
+    uint32_t last = 0U;
+    uint32_t voided;
+    bool last_torn = false;
+
+    if(datalogger_state != DATALOG_STOPPED)
+        return RET_ERR;
+
+    if(dev_metadata->device_metadata.datalog_header == CONFIGS_FRAME_HEADER)
+        start = dev_metadata->device_metadata.datalog_size;
+
+    end = start;
+
+    while(end < DATALOG_MAX_SIZE)
+    {
+        /* read a page at a time, again from the row if it straddles two */
+        if(end < chunk_start || end >= chunk_start + chunk_len)
+        {
+            chunk_start = end;
+            chunk_len = DATALOG_MAX_SIZE - end;
+
+            if(chunk_len > sizeof(chunk))
+                chunk_len = sizeof(chunk);
+
+            sysret_t ret = mt25q_read(datalog_base_flash_addr + chunk_start, chunk, chunk_len);
+            SYSRET_CHECK(ret);
+        }
+
+        const uint8_t* row = &chunk[end - chunk_start];
+        size_t row_size = datalog_row_size(row[0]);
+
+        if(row_size == 0U || end + row_size > DATALOG_MAX_SIZE)
+            break;
+
+        if(end + row_size > chunk_start + chunk_len)
+        {
+            /* row continues in the next page, read from its start */
+            chunk_len = 0U;
+            continue;
+        }
+
+        if(end == start)
+        {
+            uint32_t offset;
+            (void)memcpy(&offset, &row[1], sizeof(offset));
+
+            /* nothing was logged after the saved end, or not by the last session */
+            if(row[0] != DATALOG_SESSION_START || offset != start)
+                break;
+        }
+        else if(row[0] == DATALOG_SESSION_START || row[0] == DATALOG_FILLER)
+        {
+            break;
+        }
+
+        last = end;
+        last_torn = row_torn(row, row_size);
+        end += row_size;
+    }
+
+    if(last_torn)
+        end = last;
+
+    /* a marker with no rows behind it goes too */
+    if(end == start + DATALOG_SESSION_START_SIZE)
+        end = start;
+
+    sysret_t ret = void_tail(end, &voided);
+    SYSRET_CHECK(ret);
+
+    if(voided == start)
+        return RET_OK;
+
+    NRF_LOG_DEBUG("DATALOG RECOVERED %d BYTES, VOIDED %d", end - start, voided - end);
+
+    /* nothing was saved before, the index starts with the recovered session */
+    if(dev_metadata->device_metadata.datalog_header != CONFIGS_FRAME_HEADER)
+    {
+        dev_metadata->device_metadata.session_count = 0U;
+        dev_metadata->device_metadata.downloaded_size = 0U;
+    }
+
+    if(end > start)
+        session_save(dev_metadata, start, end);
+
+    /* voided bytes are in no session, the next one starts after them */
+    dev_metadata->device_metadata.datalog_header = CONFIGS_FRAME_HEADER;
+    dev_metadata->device_metadata.datalog_size = voided;
+
+    return configs_save(dev_metadata);
 }
 
 /**
@@ -146,52 +523,39 @@ sysret_t datalog_log(
     datalog_row[0] = row_header;
 
     if(i > 1)
-    {
-        uint32_t new_size = datalog_size + i;
-        uint32_t end_addr = datalog_base_flash_addr + new_size;
+        ret = write_row(datalog_row, i);
 
-        if(end_addr < FLASH_CAPACITY)
-        {
-            /* save datalog row to flash */
-
-            /* determine if flash write needs to be broken up to
-             * prevent wrap-around */
-            uint32_t next_page = NEXT_PAGE_ADDR_FROM_CURR(datalog_base_flash_addr + datalog_size);
-
-            if(next_page < end_addr)
-            {
-                /* write needs to be broken up into two batches to prevent wrap-around */
-                uint32_t extra = end_addr - next_page;
-
-                /* write first chunk... */
-                ret = mt25q_page_program(
-                    datalog_base_flash_addr + datalog_size,
-                    datalog_row,
-                    i - extra);
-                SYSRET_CHECK(ret);
-
-                /* ...then the next */
-                ret = mt25q_page_program(
-                    datalog_base_flash_addr + datalog_size + (i - extra),
-                    datalog_row + (i - extra),
-                    extra);
-                SYSRET_CHECK(ret);
-            }
-            else
-            {
-                /* can write row all at once */
-                ret = mt25q_page_program(
-                    datalog_base_flash_addr + datalog_size,
-                    datalog_row,
-                    i);
-                SYSRET_CHECK(ret);
-            }
-
-            datalog_size = new_size;
-        }
+    return ret;
+}
+
+/**
+ * @brief Log the peak acceleration of an impact to flash
+ * 
+ * @param dt Datetime, NULL if not available
+ * @param peak High-G Accelerometer peak on each axis
+ * @return sysret_t 
+ */
+sysret_t datalog_log_peak(datetime_t* dt, int16_t peak[3U])
+{
+    uint8_t datalog_row[DATALOG_ROW_MAX_SIZE] = {0U};
+    size_t i = 1U; /* row indexer, start at index 1 to skip row header */
+
+    if(datalogger_state != DATALOG_START)
+        return RET_ERR;
+
+    datalog_row[0] = DATALOG_HIGH_G_PEAK | DATALOG_HIGH_G_ACCEL_AVAILABLE;
+
+    if(dt != NULL)
+    {
+        (void)memcpy(datalog_row + i, dt, sizeof(datetime_t));
+        i += sizeof(datetime_t);
+        datalog_row[0] |= DATALOG_DATETIME_AVAILABLE;
     }
 
-    return ret;
+    (void)memcpy(datalog_row + i, peak, sizeof(int16_t)*3U);
+    i += sizeof(int16_t)*3U;
+
+    return write_row(datalog_row, i);
 }
 
 /**
@@ -209,18 +573,12 @@ sysret_t datalog_stop(metadata_t* dev_metadata)
         return ret;
 
     ret = RET_OK;
+    datalogger_state = DATALOG_STOPPED;
 
     /* update metadata if data was logged */
-    if(datalog_size > 0)
+    if(datalog_size > session_offset)
     {
-        dev_metadata->device_metadata.datalog_header = CONFIGS_FRAME_HEADER;
-        dev_metadata->device_metadata.datalog_size = datalog_size;
-        (void)memcpy(
-            &(dev_metadata->device_metadata.datalog_configs),
-            &(dev_metadata->device_metadata.current_dev_configs),
-            sizeof(configs_t)
-        );
-
+        session_save(dev_metadata, session_offset, datalog_size);
         ret = configs_save(dev_metadata);
     }
 
@@ -228,30 +586,85 @@ sysret_t datalog_stop(metadata_t* dev_metadata)
 }
 
 /**
- * @brief Erase current datalog information from flash
+ * @brief Erase the datalog from flash once it has all been downloaded,
+ *        the session index starts over
  * 
  * @param dev_metadata Update device metadata before saving to flash
- * @return sysret_t 
+ * @return sysret_t NRF_ERROR_INVALID_STATE if part of the datalog hasn't
+ *         been downloaded
  */
 sysret_t datalog_erase(metadata_t* dev_metadata)
 {
     ASSERT(dev_metadata);
-#if 0
     sysret_t ret = RET_ERR;
+    uint32_t size = 0U;
 
     if(datalogger_state != DATALOG_STOPPED)
         return ret;
 
-    /* update metadata */
+    if(dev_metadata->device_metadata.datalog_header == CONFIGS_FRAME_HEADER)
+        size = dev_metadata->device_metadata.datalog_size;
+
+    /* sessions the app doesn't have yet are kept */
+    if(size > dev_metadata->device_metadata.downloaded_size)
+        return NRF_ERROR_INVALID_STATE;
+
+    /* update metadata first, a reset while erasing leaves an empty datalog */
     dev_metadata->device_metadata.datalog_header = 0U;
     dev_metadata->device_metadata.datalog_size = 0U;
+    dev_metadata->device_metadata.session_count = 0U;
+    dev_metadata->device_metadata.downloaded_size = 0U;
     ret = configs_save(dev_metadata);
     SYSRET_CHECK(ret);
 
     /* erase contents of preexisting datalog */
-    ret = erase_datalog();
+    ret = erase_datalog(size);
 
     return ret;
-#endif
-    return RET_OK;
-}
\ No newline at end of file
+}
+
+/**
+ * @brief Size of a datalog row given its header
+ *
+ * @param row_header First byte of the row
+ * @return size_t Row size in bytes including the header, 1 for filler,
+ *         0 if the header isn't valid (e.g. erased flash)
+ */
+size_t datalog_row_size(uint8_t row_header)
+{
+    const uint8_t axes_masks[] =
+    {
+        DATALOG_GYRO_AVAILABLE, DATALOG_LOW_G_ACCEL_AVAILABLE, DATALOG_HIGH_G_ACCEL_AVAILABLE
+    };
+    const uint8_t all_masks = DATALOG_DATETIME_AVAILABLE | DATALOG_GYRO_AVAILABLE |
+                              DATALOG_LOW_G_ACCEL_AVAILABLE | DATALOG_HIGH_G_ACCEL_AVAILABLE |
+                              DATALOG_HIGH_G_PEAK;
+    size_t size = 1U;
+
+    /* voided bytes are skipped one at a time */
+    if(row_header == DATALOG_FILLER)
+        return 1U;
+
+    if(row_header == DATALOG_SESSION_START)
+        return DATALOG_SESSION_START_SIZE;
+
+    if((row_header & ~all_masks) != 0U)
+        return 0U;
+
+    /* peaks are only ever high-g data */
+    if((row_header & DATALOG_HIGH_G_PEAK) &&
+       (row_header & ~DATALOG_DATETIME_AVAILABLE) != (DATALOG_HIGH_G_PEAK | DATALOG_HIGH_G_ACCEL_AVAILABLE))
+        return 0U;
+
+    if(row_header & DATALOG_DATETIME_AVAILABLE)
+        size += sizeof(datetime_t);
+
+    for(size_t i = 0U ; i < sizeof(axes_masks) ; i++)
+    {
+        if(row_header & axes_masks[i])
+            size += sizeof(int16_t) * 3U;
+    }
+
+    return size;
+}
+
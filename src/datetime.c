@@ -228,6 +228,28 @@ sysret_t datetime_get(datetime_t* datetime_out)
     return ret;
 }
 
+/**
+ * @brief Get time elapsed since datetime was set
+ * 
+ * @param sec_out pointer to store number of seconds
+ * @return sysret_t Error code, RET_ERR if datetime hasn't been set
+ */
+sysret_t datetime_get_elapsed(uint32_t* sec_out)
+{
+    ASSERT(sec_out != NULL);
+
+    if(datetime_state != DATETIME_SET)
+        return RET_ERR;
+
+    uint32_t rtc_counter = nrf_rtc_counter_get(rtc.p_reg);
+    /* in floating point, the tick count outgrows 32 bits after a few weeks */
+    float32_t ticks = (float32_t)OVRFLW_MULTIPLIER * (float32_t)overflow_counter + (float32_t)rtc_counter;
+
+    *sec_out = (uint32_t)(ticks * rtc_period / 1000000.0f);
+
+    return RET_OK;
+}
+
 /**
  * @brief Get status of Datetime module
  * 
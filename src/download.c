@@ -0,0 +1,813 @@
+/**
+ * @file download.c
+ * @author UBC Capstone Team 2020/2021
+ * @brief Datalog download engine
+ */
+
+#include <string.h>
+#include "download.h"
+#include "datalog.h"
+#include "network.h"
+#include "app_timer.h"
+#include "app_util_platform.h"
+#include "crc16.h"
+#include "lzss.h"
+#include "nrf_assert.h"
+#include "nrf_log.h"
+
+/**
+ * @brief Number of read-ahead buffers, one being sent while the other is filled
+ */
+#define DOWNLOAD_BUFFERS 2U
+
+/**
+ * @brief Download session state
+ */
+static struct
+{
+    uint8_t  buf[DOWNLOAD_BUFFERS][DOWNLOAD_PREFETCH_SIZE]; /*!< Flash read-ahead buffers */
+    size_t   len[DOWNLOAD_BUFFERS];                         /*!< Bytes held in each buffer, 0 if empty */
+    size_t   pos;                                           /*!< Send position in current buffer */
+    uint8_t  cur;                                           /*!< Buffer being sent */
+    uint32_t addr;                                          /*!< Next flash address to read ahead */
+    uint32_t end;                                           /*!< Flash address past the end of the range */
+
+    /* walking rows before streaming, see download_request_t */
+    bool     seeking;                                       /*!< Still locating the rows to send */
+    bool     start_found;                                   /*!< First row to send has been located */
+    uint32_t start;                                         /*!< Flash address of first row to send */
+    uint32_t skip_rows;                                     /*!< Rows left to skip */
+    uint32_t send_rows;                                     /*!< Rows left to measure after start */
+    size_t   row_left;                                      /*!< Bytes left in the row being walked */
+
+    /* sliding window, bit i of each mask is chunk base + i */
+    uint16_t chunk_size;                                    /*!< Max payload size of a chunk */
+    uint16_t overhead;                                      /*!< Bytes of every packet on top of its payload */
+    bool     compress;                                      /*!< App can decompress chunks */
+    bool     windowed;                                      /*!< App acknowledges chunks, packets end with a CRC */
+    bool     raw;                                           /*!< Packets are bare datalog bytes */
+    uint32_t sent;                                          /*!< Bytes of the range in chunks sent so far */
+    uint32_t next;                                          /*!< Next chunk never sent */
+    uint32_t base;                                          /*!< Oldest chunk not acknowledged */
+    uint64_t acked;                                         /*!< Chunks acknowledged out of order */
+    uint64_t resend;                                        /*!< Chunks to send again */
+    uint64_t resent;                                        /*!< Chunks sent again since the last timeout */
+    uint64_t progress_ticks;                                /*!< Elapsed time when the window last moved */
+    uint8_t  timeouts;                                      /*!< Timeouts since the window last moved */
+
+    /* chunks in the window, indexed by chunk % DOWNLOAD_WINDOW_CHUNKS,
+     * kept so that lost ones can be read and encoded again */
+    uint32_t chunk_offset[DOWNLOAD_WINDOW_CHUNKS];          /*!< Offset of each chunk from start of range */
+    uint16_t chunk_len[DOWNLOAD_WINDOW_CHUNKS];             /*!< Bytes of the range in each chunk */
+    uint64_t chunk_compressed;                              /*!< Chunks sent compressed */
+    uint8_t  scratch[LZSS_MAX_INPUT];                       /*!< Bytes of the range being encoded */
+
+    uint32_t completed_base;                                /*!< Network completion count at start */
+    uint32_t last_ticks;                                    /*!< Timer count when elapsed time was last updated */
+    uint64_t elapsed_ticks;                                 /*!< Time since download started */
+    download_stats_t stats;
+} dl;
+
+/**
+ * @brief Latest ACK from the app, written in the BLE event handler
+ */
+static volatile struct
+{
+    bool     pending;
+    uint16_t seq;
+    uint64_t bitmap;
+} ack;
+
+/******************************
+ * Helper functions
+ ******************************/
+
+/**
+ * @notapi
+ * @brief Read the next chunk of the range into an empty buffer
+ *
+ * @param slot - Buffer to fill
+ * @return sysret_t Flash read status
+ */
+static sysret_t prefetch(uint8_t slot)
+{
+    size_t n = dl.end - dl.addr;
+
+    if(n > DOWNLOAD_PREFETCH_SIZE)
+        n = DOWNLOAD_PREFETCH_SIZE;
+
+    sysret_t ret = mt25q_read(dl.addr, dl.buf[slot], n);
+    SYSRET_CHECK(ret);
+
+    dl.len[slot] = n;
+    dl.addr += n;
+
+    return RET_OK;
+}
+
+/**
+ * @notapi
+ * @brief Mask of the first n chunks in the window
+ */
+static uint64_t window_mask(uint32_t n)
+{
+    return (n >= DOWNLOAD_WINDOW_CHUNKS) ? UINT64_MAX : ((1ULL << n) - 1U);
+}
+
+/**
+ * @notapi
+ * @brief Fix the chunk size and read ahead the first buffer
+ *
+ * @return sysret_t Module status
+ * @retval RET_ERR if disconnected
+ */
+static sysret_t stream_start(void)
+{
+    uint16_t max_size = network_file_packet_max_size();
+
+    if(max_size <= dl.overhead)
+        return RET_ERR;
+
+    dl.addr = dl.start;
+    dl.stats.total_bytes = dl.end - dl.start;
+    dl.chunk_size = max_size - dl.overhead;
+    dl.progress_ticks = dl.elapsed_ticks;
+
+    return prefetch(dl.cur);
+}
+
+/**
+ * @notapi
+ * @brief Copy the next bytes out of the read-ahead buffers, without taking them
+ *
+ * @param dst - Bytes will be saved here
+ * @param n   - Max number of bytes
+ * @return size_t Number of bytes copied, less than n if the read-ahead isn't ready
+ */
+static size_t stream_peek(uint8_t* dst, size_t n)
+{
+    size_t first = dl.len[dl.cur] - dl.pos;
+    size_t second = dl.len[dl.cur ^ 1U];
+
+    if(first > n)
+        first = n;
+
+    if(second > n - first)
+        second = n - first;
+
+    (void)memcpy(dst, &dl.buf[dl.cur][dl.pos], first);
+    (void)memcpy(dst + first, dl.buf[dl.cur ^ 1U], second);
+
+    return first + second;
+}
+
+/**
+ * @notapi
+ * @brief Take bytes out of the read-ahead buffers once they've been sent,
+ *        switching to the spare buffer so the other one can be refilled
+ *
+ * @param n - Number of bytes, at most what @ref stream_peek() returned
+ */
+static void stream_skip(size_t n)
+{
+    for(;;)
+    {
+        if(dl.pos == dl.len[dl.cur] && dl.len[dl.cur ^ 1U] != 0U)
+        {
+            dl.len[dl.cur] = 0U;
+            dl.cur ^= 1U;
+            dl.pos = 0U;
+        }
+
+        if(n == 0U)
+            break;
+
+        size_t step = dl.len[dl.cur] - dl.pos;
+        if(step > n)
+            step = n;
+
+        dl.pos += step;
+        n -= step;
+    }
+}
+
+/**
+ * @notapi
+ * @brief Encode part of the range into a packet payload, compressed if the
+ *        app asked for it and it makes the chunk smaller
+ *
+ * Encoding the bytes a chunk used again gives the same payload, so lost
+ * chunks don't need to be kept in RAM.
+ *
+ * @param raw      - Bytes of the range
+ * @param raw_len  - Number of bytes available
+ * @param payload  - Payload will be saved here, at least chunk_size bytes
+ * @param used     - Number of bytes of the range in the payload will be saved here
+ * @param compress - Try to compress
+ * @param flags    - Packet flags will be saved here, see DOWNLOAD_PACKET_COMPRESSED
+ * @return uint16_t Payload size
+ */
+static uint16_t encode(const uint8_t* raw, size_t raw_len, uint8_t* payload, size_t* used, bool compress, uint8_t* flags)
+{
+    size_t n = 0U;
+
+    *flags = 0U;
+
+    if(compress)
+    {
+        n = lzss_compress(raw, raw_len, payload, dl.chunk_size, used);
+
+        if(n < *used)
+        {
+            *flags = DOWNLOAD_PACKET_COMPRESSED;
+            return (uint16_t)n;
+        }
+    }
+
+    /* incompressible, send as is */
+    n = (raw_len < dl.chunk_size) ? raw_len : dl.chunk_size;
+    (void)memcpy(payload, raw, n);
+    *used = n;
+
+    return (uint16_t)n;
+}
+
+/**
+ * @notapi
+ * @brief Send one chunk, taking it out of the read-ahead buffers if new or
+ *        reading it straight from flash if it's being sent again
+ *
+ * @param chunk  - Chunk to send
+ * @param packet - Space to build the packet in
+ * @return sysret_t Module status
+ * @retval NRF_ERROR_BUSY if a new chunk isn't read ahead yet
+ * @retval NRF_ERROR_RESOURCES if the SoftDevice TX queue is full
+ */
+static sysret_t send_chunk(uint32_t chunk, uint8_t* packet)
+{
+    sysret_t ret = RET_OK;
+    uint8_t* payload = dl.raw ? packet : packet + sizeof(download_packet_header_t);
+    size_t slot = chunk % DOWNLOAD_WINDOW_CHUNKS;
+    bool is_new = (chunk >= dl.next);
+    bool compress = dl.compress;
+    uint32_t offset = dl.sent;
+    size_t raw_len = 0U;
+    size_t used = 0U;
+    uint8_t flags = 0U;
+
+    if(is_new)
+    {
+        /* compress as much as a block takes, or fill one payload */
+        size_t want = compress ? LZSS_MAX_INPUT : dl.chunk_size;
+
+        if(want > dl.stats.total_bytes - offset)
+            want = dl.stats.total_bytes - offset;
+
+        raw_len = stream_peek(dl.scratch, want);
+
+        if(raw_len < want)
+            return NRF_ERROR_BUSY;
+    }
+    else
+    {
+        offset = dl.chunk_offset[slot];
+        raw_len = dl.chunk_len[slot];
+        compress = ((dl.chunk_compressed >> slot) & 1U) != 0U;
+
+        ret = mt25q_read(dl.start + offset, dl.scratch, raw_len);
+        SYSRET_CHECK(ret);
+    }
+
+    uint16_t n = encode(dl.scratch, raw_len, payload, &used, compress, &flags);
+
+    if(!dl.raw)
+    {
+        download_packet_header_t header =
+        {
+            .seq    = (uint16_t)chunk,
+            .offset = dl.start + offset - DATALOG_BASE_FLASH_ADDR,
+            .flags  = flags
+        };
+
+        (void)memcpy(packet, &header, sizeof(header));
+    }
+
+    if(dl.windowed)
+    {
+        uint16_t crc = crc16_compute(packet, sizeof(download_packet_header_t) + n, NULL);
+        (void)memcpy(payload + n, &crc, sizeof(crc));
+    }
+
+    ret = network_transmit_file_packet(packet, (uint16_t)(n + dl.overhead));
+
+    if(ret == RET_OK && is_new)
+    {
+        dl.chunk_offset[slot] = offset;
+        dl.chunk_len[slot] = (uint16_t)used;
+
+        if(flags & DOWNLOAD_PACKET_COMPRESSED)
+            dl.chunk_compressed |= (1ULL << slot);
+        else
+            dl.chunk_compressed &= ~(1ULL << slot);
+
+        dl.sent += used;
+        dl.stats.queued_bytes += used;
+        dl.stats.sent_bytes += n;
+        stream_skip(used);
+    }
+
+    return ret;
+}
+
+/**
+ * @notapi
+ * @brief Move the window along with the latest ACK from the app
+ *
+ * Notifications arrive in order, so a chunk missing below one that
+ * arrived was lost and is sent again straight away. Chunks already sent
+ * again wait for the timeout instead, since later chunks may arrive first.
+ */
+static void process_ack(void)
+{
+    uint16_t seq;
+    uint64_t bitmap;
+    bool pending;
+
+    CRITICAL_REGION_ENTER();
+    pending = ack.pending;
+    seq = ack.seq;
+    bitmap = ack.bitmap;
+    ack.pending = false;
+    CRITICAL_REGION_EXIT();
+
+    if(!pending)
+        return;
+
+    /* extend the 16-bit sequence number around the window */
+    uint32_t acked = dl.base + (uint16_t)(seq - (uint16_t)dl.base);
+
+    /* stale, or acknowledging chunks never sent */
+    if(acked > dl.next)
+        return;
+
+    uint32_t shift = acked - dl.base;
+    uint64_t outstanding = window_mask(dl.next - acked);
+
+    if(shift >= DOWNLOAD_WINDOW_CHUNKS)
+    {
+        dl.acked = dl.resend = dl.resent = 0U;
+    }
+    else
+    {
+        dl.acked >>= shift;
+        dl.resend >>= shift;
+        dl.resent >>= shift;
+    }
+
+    dl.base = acked;
+    dl.acked |= bitmap & outstanding;
+
+    /* slide over chunks already acknowledged out of order */
+    while((dl.acked & 1U) != 0U)
+    {
+        dl.acked >>= 1;
+        dl.resend >>= 1;
+        dl.resent >>= 1;
+        dl.base++;
+        shift++;
+    }
+
+    outstanding = window_mask(dl.next - dl.base);
+
+    if(shift > 0U)
+    {
+        dl.progress_ticks = dl.elapsed_ticks;
+        dl.timeouts = 0U;
+    }
+
+    /* every chunk below the last one that arrived */
+    uint64_t below = 0U;
+    for(uint64_t m = dl.acked; m != 0U; m >>= 1)
+        below = (below << 1) | 1U;
+    below >>= 1;
+
+    dl.resend |= below & outstanding & ~dl.acked & ~dl.resent;
+    dl.resend &= ~dl.acked;
+    dl.stats.acked_chunks = dl.base;
+}
+
+/**
+ * @notapi
+ * @brief Send every unacknowledged chunk again if ACKs have stopped coming
+ *
+ * @return sysret_t Module status
+ * @retval NRF_ERROR_TIMEOUT if the app has stopped responding
+ */
+static sysret_t check_timeout(void)
+{
+    uint64_t timeout = ((uint64_t)DOWNLOAD_ACK_TIMEOUT_MS * APP_TIMER_CLOCK_FREQ) / 1000U;
+
+    if(dl.base == dl.next)
+    {
+        /* nothing in flight */
+        dl.progress_ticks = dl.elapsed_ticks;
+        return RET_OK;
+    }
+
+    if(dl.elapsed_ticks - dl.progress_ticks < timeout)
+        return RET_OK;
+
+    if(++dl.timeouts > DOWNLOAD_MAX_TIMEOUTS)
+        return NRF_ERROR_TIMEOUT;
+
+    NRF_LOG_DEBUG("DOWNLOAD TIMEOUT | chunk %u", dl.base);
+
+    dl.resend = window_mask(dl.next - dl.base) & ~dl.acked;
+    dl.resent = 0U;
+    dl.progress_ticks = dl.elapsed_ticks;
+
+    return RET_OK;
+}
+
+/**
+ * @notapi
+ * @brief Walk one buffer's worth of rows towards the ones requested
+ *
+ * Once done, the range is narrowed down to the requested rows and the first
+ * buffer is read ahead so streaming can start.
+ *
+ * @return sysret_t Flash read status
+ */
+static sysret_t seek(void)
+{
+    size_t n = dl.end - dl.addr;
+    size_t i = 0U;
+    bool done = (n == 0U);
+
+    if(n > DOWNLOAD_PREFETCH_SIZE)
+        n = DOWNLOAD_PREFETCH_SIZE;
+
+    sysret_t ret = mt25q_read(dl.addr, dl.buf[0], n);
+    SYSRET_CHECK(ret);
+
+    while(i < n && !done)
+    {
+        if(dl.row_left == 0U)
+        {
+            /* at a row boundary */
+            uint32_t row_addr = dl.addr + i;
+            size_t size = datalog_row_size(dl.buf[0][i]);
+
+            if(!dl.start_found && dl.skip_rows == 0U)
+            {
+                dl.start = row_addr;
+                dl.start_found = true;
+            }
+
+            if((dl.start_found && dl.send_rows == 0U) || size == 0U)
+            {
+                /* got all rows requested, or no more rows in datalog */
+                dl.end = row_addr;
+                done = true;
+                break;
+            }
+
+            /* session markers and filler aren't counted as rows */
+            if(dl.buf[0][i] != DATALOG_SESSION_START && dl.buf[0][i] != DATALOG_FILLER)
+            {
+                if(dl.start_found)
+                    dl.send_rows--;
+                else
+                    dl.skip_rows--;
+            }
+
+            dl.row_left = size;
+        }
+
+        size_t step = (dl.row_left < (n - i)) ? dl.row_left : (n - i);
+        i += step;
+        dl.row_left -= step;
+    }
+
+    if(!done)
+    {
+        dl.addr += n;
+        return RET_OK;
+    }
+
+    /* range ended before every row requested was skipped */
+    if(!dl.start_found)
+        dl.start = dl.end;
+
+    dl.seeking = false;
+
+    return stream_start();
+}
+
+/**
+ * @notapi
+ * @brief Update elapsed time and throughput
+ *
+ * The app timer counter wraps after a few minutes at full resolution, so
+ * elapsed time is accumulated on every call rather than taken as a single
+ * difference.
+ */
+static void update_stats(void)
+{
+    uint32_t now = app_timer_cnt_get();
+
+    dl.elapsed_ticks += app_timer_cnt_diff_compute(now, dl.last_ticks);
+    dl.last_ticks = now;
+
+    dl.stats.completed_packets = network_file_packets_completed() - dl.completed_base;
+    dl.stats.elapsed_ms = (uint32_t)((dl.elapsed_ticks * 1000U) / APP_TIMER_CLOCK_FREQ);
+
+    if(dl.elapsed_ticks > 0U)
+    {
+        dl.stats.kbps = (uint32_t)(((uint64_t)dl.stats.queued_bytes * APP_TIMER_CLOCK_FREQ) /
+                                   (dl.elapsed_ticks * 1024U));
+    }
+}
+
+/**
+ * @notapi
+ * @brief End the download session
+ *
+ * @param reason - Why the session ended, RET_OK on success
+ */
+static void finish(sysret_t reason)
+{
+    update_stats();
+    dl.stats.active = false;
+
+    (void)network_high_throughput_request(false);
+
+    NRF_LOG_INFO(
+        "DOWNLOAD %s | %u bytes | %u sent | %u ms | %u KB/s",
+        (reason == RET_OK) ? "DONE" : "FAILED",
+        dl.stats.queued_bytes, dl.stats.sent_bytes, dl.stats.elapsed_ms, dl.stats.kbps);
+}
+
+/******************************
+ * API
+ ******************************/
+
+/**
+ * @brief Start downloading part of the saved datalog
+ *
+ * @param metadata - Device metadata describing the saved datalog
+ * @param request  - Part of the datalog to send, NULL for all of it
+ * @return sysret_t Module status
+ * @retval RET_ERR if there is no saved datalog
+ * @retval NRF_ERROR_INVALID_PARAM if the request is past the end of the datalog
+ */
+sysret_t download_start(const metadata_t* metadata, const download_request_t* request)
+{
+    ASSERT(metadata);
+
+    const download_request_t everything = { 0U, 0U, 0U, 0U, 0U, false };
+    uint32_t size = metadata->device_metadata.datalog_size;
+
+    if(metadata->device_metadata.datalog_header != CONFIGS_FRAME_HEADER)
+        return RET_ERR;
+
+    if(request == NULL)
+        request = &everything;
+
+    if(request->offset > size)
+        return NRF_ERROR_INVALID_PARAM;
+
+    (void)memset(&dl, 0, sizeof(dl));
+
+    dl.start = DATALOG_BASE_FLASH_ADDR + request->offset;
+    dl.addr  = dl.start;
+    dl.end   = DATALOG_BASE_FLASH_ADDR + size;
+
+    dl.compress = (request->flags & DOWNLOAD_REQUEST_COMPRESS) != 0U;
+    dl.windowed = (request->flags & DOWNLOAD_REQUEST_WINDOWED) != 0U;
+    dl.raw      = request->raw && request->flags == 0U;
+
+    if(!dl.raw)
+        dl.overhead += sizeof(download_packet_header_t);
+
+    if(dl.windowed)
+        dl.overhead += DOWNLOAD_PACKET_CRC_SIZE;
+
+    if(request->length != 0U && request->length < size - request->offset)
+        dl.end = dl.addr + request->length;
+
+    ack.pending = false;
+
+    dl.completed_base = network_file_packets_completed();
+    dl.last_ticks     = app_timer_cnt_get();
+    dl.stats.active   = true;
+
+    /* failing to get a faster link only slows the download down */
+    (void)network_high_throughput_request(true);
+
+    if(request->skip_rows != 0U || request->rows != 0U)
+    {
+        /* rows are located a buffer at a time in download_process() */
+        dl.seeking   = true;
+        dl.skip_rows = request->skip_rows;
+        dl.send_rows = (request->rows != 0U) ? request->rows : UINT32_MAX;
+        return RET_OK;
+    }
+
+    /* have the first packets ready to go */
+    sysret_t ret = stream_start();
+
+    if(ret != RET_OK)
+        finish(ret);
+
+    return ret;
+}
+
+/**
+ * @brief Fill in a request for a datalogging session
+ *
+ * @param metadata - Device metadata describing the saved datalog
+ * @param session  - Session index, 0 is the oldest
+ * @param request  - Request will be saved here, rows are left at 0
+ * @return sysret_t Module status
+ * @retval NRF_ERROR_NOT_FOUND if there is no such session
+ */
+sysret_t download_session_request(const metadata_t* metadata, uint8_t session, download_request_t* request)
+{
+    ASSERT(metadata);
+    ASSERT(request);
+
+    if(metadata->device_metadata.datalog_header != CONFIGS_FRAME_HEADER ||
+       session >= metadata->device_metadata.session_count ||
+       session >= CONFIGS_MAX_SESSIONS)
+    {
+        return NRF_ERROR_NOT_FOUND;
+    }
+
+    (void)memset(request, 0, sizeof(*request));
+    request->offset = metadata->device_metadata.sessions[session].offset;
+    request->length = metadata->device_metadata.sessions[session].size;
+
+    return RET_OK;
+}
+
+/**
+ * @brief Queue more of the datalog, meant to be called in the main loop
+ *        until @ref download_is_active() returns false
+ *
+ * Lost chunks are sent first, then new chunks until the window is full or
+ * the SoftDevice runs out of TX buffers. Without DOWNLOAD_REQUEST_WINDOWED
+ * nothing is ever lost or in the window, chunks are only limited by the
+ * TX buffers. Afterwards, at most one flash read
+ * refills the spare read-ahead buffer while the queued packets go out.
+ *
+ * @return sysret_t Module status
+ * @retval RET_OK while the download is progressing or has finished
+ * @retval Error code of the failure otherwise, download is aborted
+ */
+sysret_t download_process(void)
+{
+    sysret_t ret = RET_OK;
+    uint8_t packet[NETWORK_BLE_MAX_ATT_PAYLOAD_SIZE];
+
+    if(!dl.stats.active)
+        return RET_OK;
+
+    uint16_t max_size = network_file_packet_max_size();
+
+    if(max_size < dl.chunk_size + dl.overhead || max_size <= dl.overhead)
+    {
+        /* disconnected */
+        finish(RET_ERR);
+        return RET_ERR;
+    }
+
+    if(dl.seeking)
+    {
+        ret = seek();
+
+        if(ret != RET_OK)
+            finish(ret);
+
+        return ret;
+    }
+
+    update_stats();
+
+    if(dl.windowed)
+    {
+        process_ack();
+        ret = check_timeout();
+    }
+
+    /* send lost chunks again, oldest first */
+    for(uint32_t i = 0U ; ret == RET_OK && dl.resend != 0U ; i++)
+    {
+        uint64_t bit = 1ULL << i;
+
+        if((dl.resend & bit) == 0U)
+            continue;
+
+        ret = send_chunk(dl.base + i, packet);
+
+        if(ret == RET_OK)
+        {
+            dl.resend &= ~bit;
+            dl.resent |= bit;
+            dl.stats.queued_packets++;
+            dl.stats.resent_packets++;
+        }
+    }
+
+    /* then new chunks */
+    while(ret == RET_OK && dl.sent < dl.stats.total_bytes && dl.next - dl.base < DOWNLOAD_WINDOW_CHUNKS)
+    {
+        ret = send_chunk(dl.next, packet);
+
+        if(ret == RET_OK)
+        {
+            dl.stats.queued_packets++;
+            dl.next++;
+
+            /* nothing comes back to wait for */
+            if(!dl.windowed)
+                dl.base = dl.next;
+        }
+    }
+
+    /* TX queue full, read-ahead not ready or window full,
+     * come back once some packets complete */
+    if(ret == NRF_ERROR_RESOURCES || ret == NRF_ERROR_BUSY)
+        ret = RET_OK;
+
+    /* refill the spare buffer while the SoftDevice is busy sending,
+     * new chunks move on to it on the next call */
+    if(ret == RET_OK && dl.addr < dl.end && dl.len[dl.cur ^ 1U] == 0U)
+        ret = prefetch(dl.cur ^ 1U);
+
+    if(ret != RET_OK)
+    {
+        finish(ret);
+        return ret;
+    }
+
+    if(dl.sent >= dl.stats.total_bytes && dl.base == dl.next &&
+       (dl.windowed || dl.stats.completed_packets >= dl.stats.queued_packets))
+    {
+        /* every chunk acknowledged, or sent if the app doesn't acknowledge */
+        finish(RET_OK);
+    }
+
+    return RET_OK;
+}
+
+/**
+ * @brief Handle an ACK written by the app, safe to call from the BLE event handler
+ *
+ * The ACK is only saved here, it's acted on in @ref download_process().
+ *
+ * @param seq    - Next chunk expected, every chunk before it has arrived
+ * @param bitmap - Bit i set if chunk seq + i has arrived. Chunks
+ *                 missing below the last one that arrived are sent again
+ */
+void download_ack(uint16_t seq, uint64_t bitmap)
+{
+    /* the main loop can't interrupt this, only a newer ACK replaces it */
+    ack.seq = seq;
+    ack.bitmap = bitmap;
+    ack.pending = true;
+}
+
+/**
+ * @brief Stop the download in progress
+ */
+void download_abort(void)
+{
+    if(dl.stats.active)
+        finish(RET_ERR);
+}
+
+/**
+ * @brief Whether a download is in progress
+ *
+ * @return true if downloading
+ */
+bool download_is_active(void)
+{
+    return dl.stats.active;
+}
+
+/**
+ * @brief Get progress and throughput of the current or last download
+ *
+ * @param stats - Stats will be saved here
+ */
+void download_get_stats(download_stats_t* stats)
+{
+    ASSERT(stats);
+
+    if(dl.stats.active)
+        update_stats();
+
+    *stats = dl.stats;
+}
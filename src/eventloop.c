@@ -0,0 +1,209 @@
+/**
+ * @file eventloop.c
+ * @author UBC Capstone Team 2020/2021
+ * @brief Event-driven main loop
+ */
+
+#include <string.h>
+#include "eventloop.h"
+#include "app_scheduler.h"
+#include "app_timer.h"
+#include "app_util_platform.h"
+#include "nrf_pwr_mgmt.h"
+#include "nrf_assert.h"
+#include "nrf_log.h"
+#include "nrf_log_ctrl.h"
+
+#ifdef FREERTOS
+#include "rtos.h"
+#endif
+
+/**
+ * @brief Scheduler event, a work item and when it was posted
+ */
+typedef struct
+{
+    eventloop_work_t* work;   /*!< Work item to run */
+    uint32_t          posted; /*!< app_timer ticks when posted */
+} eventloop_event_t;
+
+/**
+ * @brief Statistics, kept in app_timer ticks
+ */
+static struct
+{
+    uint32_t events;
+    uint32_t dropped;
+    uint64_t latency_sum;
+    uint32_t latency_max;
+    uint32_t wakeups;
+    uint64_t elapsed;
+    uint64_t asleep;
+    uint32_t last;   /*!< app_timer ticks when elapsed was last updated */
+} stats;
+
+/******************************
+ * Helper functions
+ ******************************/
+
+/**
+ * @notapi
+ * @brief Convert app_timer ticks to a duration
+ */
+static uint32_t ticks_to_us(uint64_t ticks)
+{
+    return (uint32_t)((ticks * 1000000U) / APP_TIMER_CLOCK_FREQ);
+}
+
+/**
+ * @notapi
+ * @brief Convert app_timer ticks to a duration
+ */
+static uint32_t ticks_to_ms(uint64_t ticks)
+{
+    return (uint32_t)((ticks * 1000U) / APP_TIMER_CLOCK_FREQ);
+}
+
+/**
+ * @notapi
+ * @brief Run a work item taken off the scheduler queue
+ */
+static void event_handler(void* p_event_data, uint16_t event_size)
+{
+    ASSERT(event_size == sizeof(eventloop_event_t));
+
+    eventloop_event_t event;
+    (void)memcpy(&event, p_event_data, sizeof(event));
+
+    uint32_t latency = app_timer_cnt_diff_compute(app_timer_cnt_get(), event.posted);
+
+    stats.events++;
+    stats.latency_sum += latency;
+    stats.latency_max = (latency > stats.latency_max) ? latency : stats.latency_max;
+
+    /* cleared first, so work posted while this runs runs again */
+    event.work->pending = false;
+    event.work->handler();
+}
+
+/******************************
+ * API
+ ******************************/
+
+/**
+ * @brief Initialize the scheduler queue and power management
+ *
+ * @return sysret_t Module status
+ */
+sysret_t eventloop_init(void)
+{
+    APP_SCHED_INIT(sizeof(eventloop_event_t), EVENTLOOP_QUEUE_SIZE);
+
+    eventloop_reset_stats();
+
+    return nrf_pwr_mgmt_init();
+}
+
+/**
+ * @brief Queue a work item to run in the main loop, safe to call from
+ *        interrupts
+ *
+ * @param work - Work item, see @ref EVENTLOOP_WORK_DEF
+ */
+void eventloop_post(eventloop_work_t* work)
+{
+    ASSERT(work);
+
+    bool post = false;
+
+    CRITICAL_REGION_ENTER();
+    if(!work->pending)
+    {
+        work->pending = true;
+        post = true;
+    }
+    CRITICAL_REGION_EXIT();
+
+    if(!post)
+        return;
+
+    eventloop_event_t event = { work, app_timer_cnt_get() };
+
+    if(app_sched_event_put(&event, sizeof(event), event_handler) != NRF_SUCCESS)
+    {
+        work->pending = false;
+        stats.dropped++;
+        return;
+    }
+
+#ifdef FREERTOS
+    rtos_wake(RTOS_TASK_SYSTEM);
+#endif
+}
+
+/**
+ * @brief Run every queued work item, then sleep until the next interrupt
+ *        if there's nothing left to do, meant to be called in the main loop
+ *
+ * In the FreeRTOS build this runs in the system task and waits for work to
+ * be posted instead, the idle task does the sleeping.
+ */
+void eventloop_process(void)
+{
+#ifdef FREERTOS
+    rtos_lock();
+    app_sched_execute();
+    rtos_unlock();
+#else
+    app_sched_execute();
+#endif
+
+    if(NRF_LOG_PROCESS())
+        return;
+
+    uint32_t before = app_timer_cnt_get();
+
+#ifdef FREERTOS
+    rtos_wait();
+#else
+    /* sd_app_evt_wait() under the SoftDevice, returns on any interrupt */
+    nrf_pwr_mgmt_run();
+#endif
+
+    uint32_t after = app_timer_cnt_get();
+
+    stats.wakeups++;
+    stats.asleep  += app_timer_cnt_diff_compute(after, before);
+    stats.elapsed += app_timer_cnt_diff_compute(after, stats.last);
+    stats.last = after;
+}
+
+/**
+ * @brief Get wake-to-work latency and sleep statistics
+ *
+ * @param out - Statistics will be saved here
+ */
+void eventloop_get_stats(eventloop_stats_t* out)
+{
+    ASSERT(out);
+
+    uint32_t now = app_timer_cnt_get();
+    uint64_t elapsed = stats.elapsed + app_timer_cnt_diff_compute(now, stats.last);
+
+    out->events         = stats.events;
+    out->dropped        = stats.dropped;
+    out->latency_avg_us = (stats.events > 0U) ? ticks_to_us(stats.latency_sum / stats.events) : 0U;
+    out->latency_max_us = ticks_to_us(stats.latency_max);
+    out->wakeups        = stats.wakeups;
+    out->elapsed_ms     = ticks_to_ms(elapsed);
+    out->asleep_ms      = ticks_to_ms(stats.asleep);
+}
+
+/**
+ * @brief Reset statistics, e.g. before measuring a specific workload
+ */
+void eventloop_reset_stats(void)
+{
+    (void)memset(&stats, 0, sizeof(stats));
+    stats.last = app_timer_cnt_get();
+}
@@ -0,0 +1,375 @@
+/**
+ * @file gyrobias.c
+ * @author UBC Capstone Team 2020/2021
+ * @brief Online gyroscope bias estimation
+ */
+
+#include <string.h>
+#include "gyrobias.h"
+#include "icm20649.h"
+#include "app_timer.h"
+#include "eventloop.h"
+#include "nrf_log.h"
+
+/**
+ * @brief Number of axes tracked per sensor
+ */
+#define AXES 3U
+
+/**
+ * @brief Fractional bits of the bias estimate
+ */
+#define BIAS_FRAC_BITS 8
+
+/**
+ * @brief Samples between saves of the estimate
+ */
+#define PERSIST_PERIOD_SAMPLES ((GYROBIAS_PERSIST_PERIOD_S * 1000U) / GYROBIAS_SAMPLE_PERIOD_MS)
+
+/**
+ * @brief Sliding window of readings, with running sums so that the
+ *        mean and variance of every axis are updated in constant time
+ */
+typedef struct
+{
+    int16_t samples[GYROBIAS_WINDOW_SIZE][AXES];
+    int32_t sum[AXES];
+    int64_t sum_sq[AXES];
+} window_t;
+
+/**
+ * @brief Estimator state
+ */
+static struct
+{
+    window_t gyro;                 /*!< Gyroscope readings, offsets already removed */
+    window_t accel;                /*!< Accelerometer readings */
+    size_t   head;                 /*!< Next slot to overwrite in both windows */
+    size_t   count;                /*!< Number of readings in the windows */
+    bool     still;                /*!< Last full window was still */
+    int32_t  bias_q8[AXES];        /*!< Bias estimate, Q.8 LSB */
+    int16_t  estimate[AXES];       /*!< Bias estimate, rounded to LSB */
+    int16_t  applied[AXES];        /*!< Offsets last written to the driver */
+    bool     held;                 /*!< Driver offsets are held for a session */
+    int16_t  persisted[AXES];      /*!< Offsets last saved to flash */
+    uint32_t since_persist;        /*!< Samples since the estimate was last saved */
+} estimator;
+
+/**
+ * @brief Background sampling timer handle
+ */
+APP_TIMER_DEF(gyrobias_timer);
+
+/**
+ * @brief Set by @ref gyrobias_timer_handler() on timer alarm
+ */
+static volatile bool sample_due = false;
+
+/**
+ * @brief Runs @ref gyrobias_process() in the main loop
+ */
+EVENTLOOP_WORK_DEF(gyrobias_work, gyrobias_process);
+
+/******************************
+ * Helper functions
+ ******************************/
+
+/**
+ * @notapi
+ * @brief Signify that it's time to sample the ICM20649
+ */
+static void gyrobias_timer_handler(void* p_ctx)
+{
+    (void)p_ctx;
+    sample_due = true;
+    eventloop_post(&gyrobias_work);
+}
+
+/**
+ * @notapi
+ * @brief Replace the oldest reading in a window
+ *
+ * @param win     - Window to update
+ * @param slot    - Slot holding the oldest reading
+ * @param reading - New reading
+ * @param full    - Whether the slot holds a reading to remove first
+ */
+static void window_push(window_t* win, size_t slot, const int16_t reading[AXES], bool full)
+{
+    for(size_t axis = 0U ; axis < AXES ; axis++)
+    {
+        if(full)
+        {
+            int32_t old = win->samples[slot][axis];
+            win->sum[axis]    -= old;
+            win->sum_sq[axis] -= old * old;
+        }
+
+        int32_t val = reading[axis];
+        win->sum[axis]    += val;
+        win->sum_sq[axis] += val * val;
+        win->samples[slot][axis] = reading[axis];
+    }
+}
+
+/**
+ * @notapi
+ * @brief Check variance of every axis of a full window against a threshold
+ *
+ * Compares N * sum(x^2) - sum(x)^2 against threshold * N^2 to avoid division.
+ *
+ * @param win       - Full window to check
+ * @param threshold - Variance threshold in LSB^2
+ * @return true if every axis is below the threshold
+ */
+static bool window_is_quiet(const window_t* win, int64_t threshold)
+{
+    const int64_t n = GYROBIAS_WINDOW_SIZE;
+
+    for(size_t axis = 0U ; axis < AXES ; axis++)
+    {
+        int64_t sum = win->sum[axis];
+        if((n * win->sum_sq[axis]) - (sum * sum) >= threshold * n * n)
+            return false;
+    }
+
+    return true;
+}
+
+/**
+ * @notapi
+ * @brief Drop every reading from the windows
+ */
+static void window_clear(void)
+{
+    (void)memset(&estimator.gyro, 0, sizeof(estimator.gyro));
+    (void)memset(&estimator.accel, 0, sizeof(estimator.accel));
+    estimator.head  = 0U;
+    estimator.count = 0U;
+}
+
+/**
+ * @notapi
+ * @brief Restart the estimate from the driver's offsets if they were
+ *        changed by someone else, e.g. a manual calibration
+ */
+static void resync_with_driver(void)
+{
+    int16_t offsets[AXES];
+    icm20649_get_gyro_offsets(offsets);
+
+    if(memcmp(offsets, estimator.applied, sizeof(offsets)) != 0)
+    {
+        for(size_t axis = 0U ; axis < AXES ; axis++)
+            estimator.bias_q8[axis] = (int32_t)offsets[axis] * (1 << BIAS_FRAC_BITS);
+
+        (void)memcpy(estimator.estimate, offsets, sizeof(offsets));
+        (void)memcpy(estimator.applied, offsets, sizeof(offsets));
+        window_clear();
+    }
+}
+
+/**
+ * @notapi
+ * @brief Write the estimate to the driver
+ */
+static void apply_estimate(void)
+{
+    (void)memcpy(estimator.applied, estimator.estimate, sizeof(estimator.applied));
+    icm20649_set_gyro_offsets(estimator.applied);
+}
+
+/******************************
+ * API
+ ******************************/
+
+/**
+ * @brief Initialize the estimator and start background sampling
+ *
+ * @param saved - Previously saved bias in LSB to start from, or NULL to
+ *                start from the driver's current offsets
+ * @return sysret_t Module status
+ */
+sysret_t gyrobias_init(const int16_t saved[3])
+{
+    sysret_t ret;
+
+    (void)memset(&estimator, 0, sizeof(estimator));
+
+    if(saved)
+        icm20649_set_gyro_offsets(saved);
+
+    icm20649_get_gyro_offsets(estimator.applied);
+    (void)memcpy(estimator.estimate, estimator.applied, sizeof(estimator.estimate));
+    (void)memcpy(estimator.persisted, estimator.applied, sizeof(estimator.persisted));
+
+    for(size_t axis = 0U ; axis < AXES ; axis++)
+        estimator.bias_q8[axis] = (int32_t)estimator.applied[axis] * (1 << BIAS_FRAC_BITS);
+
+    ret = app_timer_create(&gyrobias_timer, APP_TIMER_MODE_REPEATED, gyrobias_timer_handler);
+    SYSRET_CHECK(ret);
+
+    return app_timer_start(gyrobias_timer, APP_TIMER_TICKS(GYROBIAS_SAMPLE_PERIOD_MS), NULL);
+}
+
+/**
+ * @brief Sample the ICM20649 if it's time to and update the estimate,
+ *        run in the main loop by the background sampling timer
+ */
+void gyrobias_process(void)
+{
+    int16_t gyro[ICM20649_GYRO_AXES];
+    int16_t accel[ICM20649_ACCEL_AXES];
+
+    if(!sample_due)
+        return;
+
+    sample_due = false;
+
+    if(estimator.since_persist < PERSIST_PERIOD_SAMPLES)
+        estimator.since_persist++;
+
+    if(icm20649_read_raw(gyro, accel) == RET_OK)
+        gyrobias_update(gyro, accel);
+}
+
+/**
+ * @brief Feed a single reading to the estimator
+ *
+ * Once a full window is still, the window mean plus the driver's offsets
+ * is a measurement of the bias. The estimate is moved a fraction of the
+ * way towards it and the window starts over. Unless the offsets are held
+ * for a session, the new estimate is written to the driver right away.
+ *
+ * @param gyro  - Gyroscope reading, with the current offsets already removed
+ * @param accel - Accelerometer reading
+ */
+void gyrobias_update(const int16_t gyro[3], const int16_t accel[3])
+{
+    resync_with_driver();
+
+    bool full = (estimator.count == GYROBIAS_WINDOW_SIZE);
+
+    window_push(&estimator.gyro, estimator.head, gyro, full);
+    window_push(&estimator.accel, estimator.head, accel, full);
+
+    estimator.head = (estimator.head + 1U) % GYROBIAS_WINDOW_SIZE;
+    if(!full)
+        estimator.count++;
+
+    if(estimator.count < GYROBIAS_WINDOW_SIZE)
+        return;
+
+    /* gyro variance alone can't tell rest from constant rotation */
+    estimator.still = window_is_quiet(&estimator.gyro, GYROBIAS_GYRO_VAR_THRESHOLD) &&
+                      window_is_quiet(&estimator.accel, GYROBIAS_ACCEL_VAR_THRESHOLD);
+
+    if(!estimator.still)
+        return;
+
+    for(size_t axis = 0U ; axis < AXES ; axis++)
+    {
+        /* readings have the driver's offsets removed, which lag the estimate while held */
+        int32_t mean_q8 = (estimator.gyro.sum[axis] * (1 << BIAS_FRAC_BITS)) / (int32_t)GYROBIAS_WINDOW_SIZE;
+        int32_t error_q8 = ((int32_t)estimator.applied[axis] * (1 << BIAS_FRAC_BITS)) + mean_q8 - estimator.bias_q8[axis];
+        int32_t bias_q8 = estimator.bias_q8[axis] + (error_q8 / (1 << GYROBIAS_EMA_SHIFT));
+        int32_t rounded = (bias_q8 + (1 << (BIAS_FRAC_BITS - 1))) >> BIAS_FRAC_BITS;
+
+        if(rounded > INT16_MAX || rounded < INT16_MIN)
+            continue;
+
+        estimator.bias_q8[axis] = bias_q8;
+        estimator.estimate[axis] = (int16_t)rounded;
+    }
+
+    if(!estimator.held)
+        apply_estimate();
+
+    window_clear();
+
+    NRF_LOG_DEBUG("GYRO BIAS = %d %d %d", estimator.estimate[0], estimator.estimate[1], estimator.estimate[2]);
+}
+
+/**
+ * @brief Whether the last full window was still
+ *
+ * @return true if the device is still
+ */
+bool gyrobias_is_still(void)
+{
+    return estimator.still;
+}
+
+/**
+ * @brief Get the current bias estimate
+ *
+ * @param bias - Bias in LSB will be saved here
+ */
+void gyrobias_get(int16_t bias[3])
+{
+    (void)memcpy(bias, estimator.estimate, sizeof(estimator.estimate));
+}
+
+/**
+ * @brief Whether the estimate has changed since it was last saved and
+ *        @ref GYROBIAS_PERSIST_PERIOD_S has passed
+ *
+ * @return true if the estimate should be saved
+ */
+bool gyrobias_persist_due(void)
+{
+    return (estimator.since_persist >= PERSIST_PERIOD_SAMPLES) &&
+           (memcmp(estimator.estimate, estimator.persisted, sizeof(estimator.estimate)) != 0);
+}
+
+/**
+ * @brief Mark the current estimate as saved
+ */
+void gyrobias_persisted(void)
+{
+    (void)memcpy(estimator.persisted, estimator.estimate, sizeof(estimator.persisted));
+    estimator.since_persist = 0U;
+}
+
+/**
+ * @brief Keep the driver's offsets fixed, e.g. for a datalog session,
+ *        the estimate is still updated
+ */
+void gyrobias_hold(void)
+{
+    estimator.held = true;
+}
+
+/**
+ * @brief Write the estimate made while held to the driver and let it
+ *        follow the estimate again
+ */
+void gyrobias_release(void)
+{
+    estimator.held = false;
+
+    /* driver changed by someone else in the meantime, nothing to apply */
+    resync_with_driver();
+    apply_estimate();
+}
+
+/**
+ * @brief Stop background sampling, e.g. while the ICM20649 is asleep
+ */
+void gyrobias_suspend(void)
+{
+    (void)app_timer_stop(gyrobias_timer);
+    sample_due = false;
+}
+
+/**
+ * @brief Restart background sampling, the window starts over since the
+ *        device may have moved in the meantime
+ *
+ * @return sysret_t Module status
+ */
+sysret_t gyrobias_resume(void)
+{
+    window_clear();
+    return app_timer_start(gyrobias_timer, APP_TIMER_TICKS(GYROBIAS_SAMPLE_PERIOD_MS), NULL);
+}
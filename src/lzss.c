@@ -0,0 +1,184 @@
+/**
+ * @file lzss.c
+ * @author UBC Capstone Team 2020/2021
+ * @brief Small LZSS compressor for datalog transfers
+ */
+
+#include <stdbool.h>
+#include <string.h>
+#include "lzss.h"
+
+/**
+ * @brief Number of match table entries, power of 2
+ */
+#define LZSS_HASH_SIZE 512U
+
+/**
+ * @brief Last position + 1 of each hashed 3-byte prefix, 0 if none yet
+ *
+ * Only the latest position is kept. Datalog rows repeat at a fixed period,
+ * so the previous row is almost always the best match anyway.
+ */
+static uint16_t match_table[LZSS_HASH_SIZE];
+
+/******************************
+ * Helper functions
+ ******************************/
+
+/**
+ * @notapi
+ * @brief Hash of the 3 bytes at p
+ */
+static size_t hash(const uint8_t* p)
+{
+    return ((size_t)p[0] * 33U * 33U + (size_t)p[1] * 33U + p[2]) & (LZSS_HASH_SIZE - 1U);
+}
+
+/******************************
+ * API
+ ******************************/
+
+/**
+ * @brief Compress as much input as fits in the output
+ *
+ * Matching is greedy against the last occurrence of each 3-byte prefix.
+ * A control byte is only written along with its first token, so output
+ * that runs out of room ends on a whole token.
+ *
+ * @param src      - Input bytes
+ * @param src_len  - Input size, at most @ref LZSS_MAX_INPUT is used
+ * @param dst      - Compressed block will be saved here
+ * @param dst_cap  - Size of @p dst
+ * @param consumed - Number of input bytes in the block will be saved here
+ * @return size_t Size of compressed block
+ */
+size_t lzss_compress(const uint8_t* src, size_t src_len, uint8_t* dst, size_t dst_cap, size_t* consumed)
+{
+    size_t in = 0U;
+    size_t out = 0U;
+    size_t ctrl = 0U;   /* position of current control byte */
+    uint8_t bit = 8U;   /* next bit in control byte, 8 if a new one is needed */
+
+    if(src_len > LZSS_MAX_INPUT)
+        src_len = LZSS_MAX_INPUT;
+
+    (void)memset(match_table, 0, sizeof(match_table));
+
+    while(in < src_len)
+    {
+        size_t len = 0U;
+        size_t dist = 0U;
+
+        if(src_len - in >= LZSS_MIN_MATCH)
+        {
+            size_t h = hash(&src[in]);
+            size_t cand = match_table[h];
+
+            if(cand != 0U)
+            {
+                size_t max = src_len - in;
+                cand--;
+
+                if(max > LZSS_MAX_MATCH)
+                    max = LZSS_MAX_MATCH;
+
+                while(len < max && src[cand + len] == src[in + len])
+                    len++;
+
+                dist = in - cand;
+            }
+
+            match_table[h] = (uint16_t)(in + 1U);
+        }
+
+        bool match = (len >= LZSS_MIN_MATCH);
+        size_t need = (match ? 2U : 1U) + ((bit == 8U) ? 1U : 0U);
+
+        if(out + need > dst_cap)
+            break;
+
+        if(bit == 8U)
+        {
+            ctrl = out++;
+            dst[ctrl] = 0U;
+            bit = 0U;
+        }
+
+        if(match)
+        {
+            uint16_t token = (uint16_t)((dist - 1U) | ((len - LZSS_MIN_MATCH) << 10));
+
+            dst[ctrl] |= (uint8_t)(1U << bit);
+            dst[out++] = (uint8_t)token;
+            dst[out++] = (uint8_t)(token >> 8);
+
+            /* index the prefixes inside the match too */
+            for(size_t i = in + 1U ; i < in + len && i + LZSS_MIN_MATCH <= src_len ; i++)
+                match_table[hash(&src[i])] = (uint16_t)(i + 1U);
+
+            in += len;
+        }
+        else
+        {
+            dst[out++] = src[in++];
+        }
+
+        bit++;
+    }
+
+    *consumed = in;
+    return out;
+}
+
+#ifdef LZSS_DECOMPRESS
+
+/**
+ * @brief Decompress a block
+ *
+ * @param src     - Compressed block
+ * @param src_len - Size of compressed block
+ * @param dst     - Decompressed bytes will be saved here
+ * @param dst_cap - Size of @p dst
+ * @return size_t Decompressed size, 0 if the block is corrupt or doesn't fit
+ */
+size_t lzss_decompress(const uint8_t* src, size_t src_len, uint8_t* dst, size_t dst_cap)
+{
+    size_t in = 0U;
+    size_t out = 0U;
+
+    while(in < src_len)
+    {
+        uint8_t ctrl = src[in++];
+
+        for(uint8_t bit = 0U ; bit < 8U && in < src_len ; bit++)
+        {
+            if((ctrl & (1U << bit)) == 0U)
+            {
+                if(out >= dst_cap)
+                    return 0U;
+
+                dst[out++] = src[in++];
+                continue;
+            }
+
+            if(in + 2U > src_len)
+                return 0U;
+
+            uint16_t token = (uint16_t)(src[in] | (src[in + 1U] << 8));
+            size_t dist = (token & 0x3FFU) + 1U;
+            size_t len = (token >> 10) + LZSS_MIN_MATCH;
+            in += 2U;
+
+            if(dist > out || out + len > dst_cap)
+                return 0U;
+
+            /* byte by byte, matches can overlap their own output */
+            for(size_t i = 0U ; i < len ; i++, out++)
+                dst[out] = dst[out - dist];
+        }
+    }
+
+    return out;
+}
+
+#endif /* LZSS_DECOMPRESS */
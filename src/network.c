@@ -6,6 +6,7 @@
 
 #include <string.h>
 #include "network.h"
+#include "app_util_platform.h"
 #include "statemachine.h"
 #include "app_timer.h"
 #include "app_error.h"
@@ -34,15 +35,22 @@
 #define APP_BLE_OBSERVER_PRIO           3 /*!< Application's BLE observer priority. You shouldn't need to modify this value. (NOT SURE WHAT THIS IS FOR) */
 #define APP_BLE_CONN_CFG_TAG            1 /*!< A tag identifying the SoftDevice BLE configuration (NOT SURE WHAT THIS IS FOR) */
 
-#define MIN_CONN_INTERVAL               MSEC_TO_UNITS(16, UNIT_1_25_MS) /*!< Minimum acceptable connection interval (0.1 seconds). */
-#define MAX_CONN_INTERVAL               MSEC_TO_UNITS(20, UNIT_1_25_MS) /*!< Maximum acceptable connection interval (0.2 second). */
-#define SLAVE_LATENCY                   0                                /*!< Slave latency. */
+#define IDLE_MIN_CONN_INTERVAL          MSEC_TO_UNITS(100, UNIT_1_25_MS) /*!< Minimum acceptable connection interval while idle (0.1 seconds). */
+#define IDLE_MAX_CONN_INTERVAL          MSEC_TO_UNITS(200, UNIT_1_25_MS) /*!< Maximum acceptable connection interval while idle (0.2 second). */
+#define IDLE_SLAVE_LATENCY              4                                /*!< Connection events that may be skipped while idle, responses within 1 second. */
+#define BULK_MIN_CONN_INTERVAL          BLE_GAP_CP_MIN_CONN_INTVL_MIN    /*!< Minimum acceptable connection interval for bulk transfers (7.5 ms). */
+#define BULK_MAX_CONN_INTERVAL          MSEC_TO_UNITS(15, UNIT_1_25_MS)  /*!< Maximum acceptable connection interval for bulk transfers (15 ms). */
+#define BULK_SLAVE_LATENCY              0                                /*!< Slave latency for bulk transfers. */
 #define CONN_SUP_TIMEOUT                MSEC_TO_UNITS(4000, UNIT_10_MS)  /*!< Connection supervisory timeout (4 seconds). */
 
 #define FIRST_CONN_PARAMS_UPDATE_DELAY  APP_TIMER_TICKS(5000)  /*!< Time from initiating event (connect or start of notification) to first time sd_ble_gap_conn_param_update is called (5 seconds). */
 #define NEXT_CONN_PARAMS_UPDATE_DELAY   APP_TIMER_TICKS(30000) /*!< Time between each call to sd_ble_gap_conn_param_update after the first call (30 seconds). */
+#define LL_DATA_LENGTH_DEFAULT          27U /*!< Link layer payload size before Data Length Extension is negotiated */
+
 #define MAX_CONN_PARAMS_UPDATE_COUNT    3                      /*!< Number of attempts before giving up the connection parameter negotiation. */
 
+#define ADV_STATUS_COMPANY_ID           0xFFFFU /*!< Company identifier of the device status, reserved for use without a Bluetooth SIG assigned ID. */
+
 BLE_NUS_DEF(nus_instance, NRF_SDH_BLE_TOTAL_LINK_COUNT); /*!< BLE NUS service instance. */
 NRF_BLE_GATT_DEF(gatt_instance);                         /*!< GATT module instance */
 BLE_ADVERTISING_DEF(advertising_instance);               /*!< Advertising module instance */
@@ -60,6 +68,21 @@ static ble_uuid_t advertised_uuids[] =
     {BLE_UUID_NUS_SERVICE, BLE_UUID_TYPE_BLE}
 };
 
+/**
+ * @brief Advertising data, kept to encode it again along with every device
+ *        status update
+ */
+static ble_advdata_t adv_config;
+
+/**
+ * @brief Encoded advertising data, double-buffered since the SoftDevice
+ *        only takes new data while advertising in buffers it isn't using
+ */
+static uint8_t            adv_buffers[2][BLE_GAP_ADV_SET_DATA_SIZE_MAX];
+static uint8_t            scan_rsp_buffers[2][BLE_GAP_ADV_SET_DATA_SIZE_MAX];
+static ble_gap_adv_data_t adv_data_sets[2];
+static uint8_t            adv_data_set = 0U; /*!< Set in use, the other one is free */
+
 /**
  * @brief UUIDs!
  */
@@ -73,6 +96,8 @@ static ble_uuid_t advertised_uuids[] =
 #define CUSTOM_RX_CHARACTERISTIC_UUID 0x0003 /*!< Custom 16-bit RX characteristic UUID, based on custom UUID */
 /* 32A20004-ED70-480B-A945-866522F66758 */
 #define DEVCONF_CHARACTERISTIC_UUID   0x0004 /*!< Custom 16-bit RX characteristic UUID, based on custom UUID */
+/* 32A20005-ED70-480B-A945-866522F66758 */
+#define TELEMETRY_CHARACTERISTIC_UUID 0x0005 /*!< Custom 16-bit telemetry characteristic UUID, based on custom UUID */
 
 
 /**
@@ -81,6 +106,7 @@ static ble_uuid_t advertised_uuids[] =
 static ble_uuid_t tx_char_uuid;
 static ble_uuid_t rx_char_uuid;
 static ble_uuid_t dev_conf_char_uuid;
+static ble_uuid_t telemetry_char_uuid;
 
 /**
  * @brief Custom SimpL Service handler
@@ -115,17 +141,176 @@ typedef enum
 static network_state_t network_state = NETWORK_UNINIT;
 
 /**
- * This is set true after a call to @ref network_transmit_file_packet(),
- * indicating that the SoftDev is currently transmitting a notification.
- * 
- * Calls to @ref network_transmit_file_packet() are not allowed while
- * this flag is true.
- * 
- * It is then reset after a @ref BLE_GATTS_EVT_HVN_TX_COMPLETE event,
- * indicating that the transmission is complete, and
- * @ref network_transmit_file_packet() can be called again.
+ * Number of file packet notifications the SoftDevice has finished sending,
+ * matched from @ref BLE_GATTS_EVT_HVN_TX_COMPLETE events by notification_completed().
+ *
+ * Callers queue as many packets as the SoftDevice accepts with
+ * @ref network_transmit_file_packet() and compare against this to know
+ * when they've all gone out.
+ */
+static volatile uint32_t network_tx_completed = 0U;
+
+/**
+ * @brief Most notifications tracked while queued in the SoftDevice
+ */
+#define NOTIFICATIONS_PENDING_MAX 32U
+
+/**
+ * @brief Notifications queued in the SoftDevice and not sent yet, see
+ *        @ref notification_send()
+ */
+static struct
+{
+    uint32_t file;  /*!< Bit set for a file packet, oldest in bit 0 */
+    uint8_t  count; /*!< Notifications queued */
+} notifications_pending;
+
+/**
+ * @brief Whether the app has subscribed to telemetry notifications
+ */
+static volatile bool telemetry_subscribed = false;
+
+/**
+ * @brief Negotiated parameters of the current connection,
+ *        updated as the central responds to requests
+ */
+static network_link_info_t link_info;
+
+/**
+ * @brief Preferred connection parameters of each profile
+ */
+static const ble_gap_conn_params_t conn_profiles[NETWORK_CONN_PROFILES_NUM] =
+{
+    [NETWORK_CONN_PROFILE_IDLE] =
+    {
+        .min_conn_interval = IDLE_MIN_CONN_INTERVAL,
+        .max_conn_interval = IDLE_MAX_CONN_INTERVAL,
+        .slave_latency     = IDLE_SLAVE_LATENCY,
+        .conn_sup_timeout  = CONN_SUP_TIMEOUT
+    },
+    [NETWORK_CONN_PROFILE_BULK] =
+    {
+        .min_conn_interval = BULK_MIN_CONN_INTERVAL,
+        .max_conn_interval = BULK_MAX_CONN_INTERVAL,
+        .slave_latency     = BULK_SLAVE_LATENCY,
+        .conn_sup_timeout  = CONN_SUP_TIMEOUT
+    }
+};
+
+/**
+ * @brief Connection profile in use, and whether it still has to be
+ *        requested because the central was busy negotiating
+ */
+static network_conn_profile_t conn_profile = NETWORK_CONN_PROFILE_IDLE;
+static bool conn_profile_pending = false;
+
+/**
+ * @brief PHYs requested on every connection, 2M for throughput
+ */
+static const ble_gap_phys_t preferred_phys =
+{
+    .tx_phys = BLE_GAP_PHY_2MBPS,
+    .rx_phys = BLE_GAP_PHY_2MBPS
+};
+
+/**
+ * @notapi
+ * @brief Ask the central to switch to the current profile's parameters
+ *
+ * @return sysret_t NRF_ERROR_BUSY if a parameter update is already running,
+ *         the request is retried once it's done
  */
-static bool network_transmission_in_progress = false;
+static sysret_t conn_profile_request(void)
+{
+    ble_gap_conn_params_t params = conn_profiles[conn_profile];
+
+    sysret_t ret = ble_conn_params_change_conn_params(conn_handle, &params);
+    conn_profile_pending = (ret == NRF_ERROR_BUSY);
+
+    return ret;
+}
+
+/**
+ * @notapi
+ * @brief Queue a notification, keeping track of whether it's a file packet
+ *
+ * @ref BLE_GATTS_EVT_HVN_TX_COMPLETE only carries a count, not the
+ * characteristic. The SoftDevice sends notifications in the order they
+ * were queued, and every notification on the link goes through here (the
+ * BLE CLI transport is never started), so completions are matched to
+ * queued notifications in order.
+ *
+ * @param handle - Value handle of the characteristic
+ * @param buf    - Notification bytes
+ * @param len    - Size of notification in bytes
+ * @return sysret_t SoftDevice status
+ * @retval NRF_ERROR_RESOURCES if the TX queue is full
+ */
+static sysret_t notification_send(uint16_t handle, uint8_t* buf, uint16_t* len)
+{
+    bool file = (handle == simpl_service.tx_char_handles.value_handle);
+    bool queued = false;
+    sysret_t ret;
+
+    ble_gatts_hvx_params_t hvx_params =
+    {
+        .handle = handle,
+        .offset = 0,
+        .p_data = buf,
+        .p_len  = len,
+        .type   = BLE_GATT_HVX_NOTIFICATION
+    };
+
+    /* track it first, it can complete before sd_ble_gatts_hvx() returns */
+    CRITICAL_REGION_ENTER();
+    if(notifications_pending.count < NOTIFICATIONS_PENDING_MAX)
+    {
+        if(file)
+            notifications_pending.file |= (1UL << notifications_pending.count);
+        else
+            notifications_pending.file &= ~(1UL << notifications_pending.count);
+
+        notifications_pending.count++;
+        queued = true;
+    }
+    CRITICAL_REGION_EXIT();
+
+    if(!queued)
+        return NRF_ERROR_RESOURCES;
+
+    ret = sd_ble_gatts_hvx(conn_handle, (const ble_gatts_hvx_params_t*)&hvx_params);
+
+    /* not queued, the newest entry is this one */
+    if(ret != NRF_SUCCESS)
+    {
+        CRITICAL_REGION_ENTER();
+        notifications_pending.count--;
+        CRITICAL_REGION_EXIT();
+    }
+
+    return ret;
+}
+
+/**
+ * @notapi
+ * @brief Count the file packets among notifications the SoftDevice has
+ *        finished sending, oldest first
+ *
+ * @param count - Notifications completed
+ */
+static void notification_completed(uint8_t count)
+{
+    CRITICAL_REGION_ENTER();
+    for(uint8_t i = 0U ; i < count && notifications_pending.count > 0U ; i++)
+    {
+        if(notifications_pending.file & 1UL)
+            network_tx_completed++;
+
+        notifications_pending.file >>= 1U;
+        notifications_pending.count--;
+    }
+    CRITICAL_REGION_EXIT();
+}
 
 /************************************************
  * EVENT HANDLERS
@@ -165,7 +350,26 @@ static void ble_event_handler(ble_evt_t const * p_ble_evt, void * p_context)
             /* Set connection handle for custom service */
             simpl_service.conn_handle = p_ble_evt->evt.gap_evt.conn_handle;
 
+            /* link starts out at the defaults, MTU and DLE are negotiated by the GATT module */
+            (void)memset(&link_info, 0, sizeof(link_info));
+            link_info.connected        = true;
+            link_info.att_mtu          = BLE_GATT_ATT_MTU_DEFAULT;
+            link_info.data_length      = LL_DATA_LENGTH_DEFAULT;
+            link_info.tx_phy           = BLE_GAP_PHY_1MBPS;
+            link_info.rx_phy           = BLE_GAP_PHY_1MBPS;
+            link_info.conn_interval    = p_ble_evt->evt.gap_evt.params.connected.conn_params.max_conn_interval;
+            link_info.slave_latency    = p_ble_evt->evt.gap_evt.params.connected.conn_params.slave_latency;
+            link_info.conn_sup_timeout = p_ble_evt->evt.gap_evt.params.connected.conn_params.conn_sup_timeout;
+            link_info.conn_profile     = conn_profile;
+
+            /* ask for 2M PHY straight away, the central may refuse */
+            err = sd_ble_gap_phy_update(conn_handle, &preferred_phys);
+            NRF_LOG_DEBUG("PHY UPDATE REQUEST = 0x%X", err);
+
             network_state = NETWORK_CONNECTED;
+
+            /* wakes the device up if it's in low power mode */
+            statemachine_kick();
             break;
         }
 
@@ -181,8 +385,17 @@ static void ble_event_handler(ble_evt_t const * p_ble_evt, void * p_context)
 
             /* Reset connection handle for custom service */
             simpl_service.conn_handle = BLE_CONN_HANDLE_INVALID;
+            telemetry_subscribed = false;
+
+            /* queued notifications are dropped with the link */
+            (void)memset(&notifications_pending, 0, sizeof(notifications_pending));
+
+            (void)memset(&link_info, 0, sizeof(link_info));
 
             network_state = NETWORK_INIT;
+
+            /* transfers in progress have to stop */
+            statemachine_kick();
             break;
 
         case BLE_GAP_EVT_PHY_UPDATE_REQUEST:
@@ -199,6 +412,39 @@ static void ble_event_handler(ble_evt_t const * p_ble_evt, void * p_context)
             break;
         }
 
+        case BLE_GAP_EVT_PHY_UPDATE:
+        {
+            ble_gap_evt_phy_update_t const* phy = &p_ble_evt->evt.gap_evt.params.phy_update;
+
+            if(phy->status == BLE_HCI_STATUS_CODE_SUCCESS)
+            {
+                link_info.tx_phy = phy->tx_phy;
+                link_info.rx_phy = phy->rx_phy;
+            }
+
+            NRF_LOG_INFO("BLE PHY - status 0x%X | tx %d | rx %d", phy->status, phy->tx_phy, phy->rx_phy);
+            break;
+        }
+
+        case BLE_GAP_EVT_CONN_PARAM_UPDATE:
+        {
+            ble_gap_conn_params_t const* params = &p_ble_evt->evt.gap_evt.params.conn_param_update.conn_params;
+
+            link_info.conn_interval    = params->max_conn_interval;
+            link_info.slave_latency    = params->slave_latency;
+            link_info.conn_sup_timeout = params->conn_sup_timeout;
+
+            NRF_LOG_INFO(
+                "BLE CONN PARAMS - interval %d x 1.25 ms | latency %d | timeout %d x 10 ms",
+                params->max_conn_interval, params->slave_latency, params->conn_sup_timeout);
+
+            /* profile changed while the central was busy, ask again */
+            if(conn_profile_pending)
+                (void)conn_profile_request();
+
+            break;
+        }
+
         case BLE_GATTC_EVT_TIMEOUT:
             /* Disconnect on GATT Client timeout event */
             err = sd_ble_gap_disconnect(p_ble_evt->evt.gattc_evt.conn_handle,
@@ -229,12 +475,48 @@ static void ble_event_handler(ble_evt_t const * p_ble_evt, void * p_context)
                     (uint8_t*)p_ble_evt->evt.gatts_evt.params.write.data,
                     p_ble_evt->evt.gatts_evt.params.write.len);
             }
+            else if(p_ble_evt->evt.gatts_evt.params.write.handle == simpl_service.telemetry_char_handles.cccd_handle &&
+                    p_ble_evt->evt.gatts_evt.params.write.len == 2U)
+            {
+                /* App subscribes or unsubscribes to telemetry */
+                telemetry_subscribed = ble_srv_is_notification_enabled(p_ble_evt->evt.gatts_evt.params.write.data);
+                NRF_LOG_DEBUG("TELEMETRY NOTIFICATIONS %d", telemetry_subscribed);
+            }
 
             break;
 
         case BLE_GATTS_EVT_HVN_TX_COMPLETE:
             // NRF_LOG_DEBUG("BLE_GATTS_EVT_HVN_TX_COMPLETE");
-            network_transmission_in_progress = false;
+            notification_completed(p_ble_evt->evt.gatts_evt.params.hvn_tx_complete.count);
+            break;
+
+        default:
+            break;
+    }
+}
+
+/**
+ * @notapi
+ * @brief GATT module handler, reports ATT_MTU and data length negotiated
+ *        with the central
+ *
+ * @param p_gatt - GATT module instance
+ * @param p_evt  - GATT module event
+ */
+static void gatt_event_handler(nrf_ble_gatt_t* p_gatt, nrf_ble_gatt_evt_t const* p_evt)
+{
+    (void)p_gatt;
+
+    switch(p_evt->evt_id)
+    {
+        case NRF_BLE_GATT_EVT_ATT_MTU_UPDATED:
+            link_info.att_mtu = p_evt->params.att_mtu_effective;
+            NRF_LOG_INFO("BLE ATT_MTU - %d bytes", link_info.att_mtu);
+            break;
+
+        case NRF_BLE_GATT_EVT_DATA_LENGTH_UPDATED:
+            link_info.data_length = p_evt->params.data_length;
+            NRF_LOG_INFO("BLE DATA LENGTH - %d bytes", link_info.data_length);
             break;
 
         default:
@@ -249,20 +531,16 @@ static void ble_event_handler(ble_evt_t const * p_ble_evt, void * p_context)
  * @details This function will be called for all events in the Connection Parameters Module which
  *          are passed to the application.
  * 
- * @note All this function does is to disconnect. This could have been done by simply
- *       setting the disconnect_on_fail config parameter, but instead we use the event
- *       handler mechanism to demonstrate its use.
+ * @note Profiles are only preferences, a central that refuses one keeps the connection
+ *       at whatever parameters it chose rather than being disconnected.
  * 
  * @param p_evt 
  */
 static void on_connect_params_event_handler(ble_conn_params_evt_t* p_evt)
 {
-    ret_code_t err_code;
-
     if (p_evt->evt_type == BLE_CONN_PARAMS_EVT_FAILED)
     {
-        err_code = sd_ble_gap_disconnect(conn_handle, BLE_HCI_CONN_INTERVAL_UNACCEPTABLE);
-        APP_ERROR_CHECK(err_code);
+        NRF_LOG_INFO("BLE CONN PARAMS - central refused profile %d", conn_profile);
     }
 }
 
@@ -362,12 +640,10 @@ static sysret_t gap_params_init(void)
     SYSRET_CHECK(ret);
 
     /**
-     * Set GAP peripheral preferred connection parameters
+     * Set GAP peripheral preferred connection parameters,
+     * connections start out in the idle profile
      */
-    gap_conn_params.min_conn_interval = MIN_CONN_INTERVAL;
-    gap_conn_params.max_conn_interval = MAX_CONN_INTERVAL;
-    gap_conn_params.slave_latency     = SLAVE_LATENCY;
-    gap_conn_params.conn_sup_timeout  = CONN_SUP_TIMEOUT ;
+    gap_conn_params = conn_profiles[conn_profile];
 
     ret = sd_ble_gap_ppcp_set(&gap_conn_params);
     SYSRET_CHECK(ret);
@@ -383,7 +659,7 @@ static sysret_t gap_params_init(void)
  */
 static sysret_t gatt_init(void)
 {
-    return nrf_ble_gatt_init(&gatt_instance, NULL);
+    return nrf_ble_gatt_init(&gatt_instance, gatt_event_handler);
 }
 
 /**
@@ -404,6 +680,8 @@ static sysret_t services_init(void)
     rx_char_uuid.type       = BLE_UUID_TYPE_VENDOR_BEGIN;
     dev_conf_char_uuid.uuid = DEVCONF_CHARACTERISTIC_UUID;
     dev_conf_char_uuid.type = BLE_UUID_TYPE_VENDOR_BEGIN;
+    telemetry_char_uuid.uuid = TELEMETRY_CHARACTERISTIC_UUID;
+    telemetry_char_uuid.type = BLE_UUID_TYPE_VENDOR_BEGIN;
 
     /* Add custom UUIDs to BLE stack */
     ret = sd_ble_uuid_vs_add(&base_uuid, &simpl_service.service_uuid.type);
@@ -491,6 +769,27 @@ static sysret_t services_init(void)
     ret = sd_ble_gatts_characteristic_add(simpl_service.service_handle, &dev_conf_char_md, &dev_conf_attr_val, &simpl_service.dev_conf_char_handles);
     SYSRET_CHECK(ret);
 
+    /* Characteristic # 4 : Telemetry characteristic */
+    ble_gatts_char_md_t telemetry_char_md;
+    memset(&telemetry_char_md, 0, sizeof(telemetry_char_md));
+    telemetry_char_md.char_props.notify = 1; /* live sensor data, see telemetry.h */
+
+    ble_gatts_attr_md_t telemetry_cccd_md;
+    memset(&telemetry_cccd_md, 0, sizeof(telemetry_cccd_md));
+    BLE_GAP_CONN_SEC_MODE_SET_OPEN(&telemetry_cccd_md.read_perm);
+    BLE_GAP_CONN_SEC_MODE_SET_OPEN(&telemetry_cccd_md.write_perm);
+    telemetry_cccd_md.vloc      = BLE_GATTS_VLOC_STACK;
+    telemetry_char_md.p_cccd_md = &telemetry_cccd_md;
+
+    ble_gatts_attr_t telemetry_attr_val;
+    memset(&telemetry_attr_val, 0, sizeof(telemetry_attr_val));
+    telemetry_attr_val.p_uuid    = &telemetry_char_uuid;
+    telemetry_attr_val.p_attr_md = &attr_md;
+    telemetry_attr_val.max_len   = NETWORK_BLE_MAX_ATT_PAYLOAD_SIZE;
+
+    ret = sd_ble_gatts_characteristic_add(simpl_service.service_handle, &telemetry_char_md, &telemetry_attr_val, &simpl_service.telemetry_char_handles);
+    SYSRET_CHECK(ret);
+
     return nrf_cli_ble_uart_service_init();
 }
 
@@ -507,11 +806,13 @@ static sysret_t advertising_init(void)
 
     (void)memset(&init, 0, sizeof(ble_advertising_init_t));
 
-    init.advdata.name_type               = BLE_ADVDATA_FULL_NAME;
-    init.advdata.include_appearance      = true;
-    init.advdata.flags                   = BLE_GAP_ADV_FLAGS_LE_ONLY_GENERAL_DISC_MODE;
-    init.advdata.uuids_complete.uuid_cnt = sizeof(advertised_uuids) / sizeof(advertised_uuids[0]);
-    init.advdata.uuids_complete.p_uuids  = advertised_uuids;
+    adv_config.name_type               = BLE_ADVDATA_FULL_NAME;
+    adv_config.include_appearance      = true;
+    adv_config.flags                   = BLE_GAP_ADV_FLAGS_LE_ONLY_GENERAL_DISC_MODE;
+    adv_config.uuids_complete.uuid_cnt = sizeof(advertised_uuids) / sizeof(advertised_uuids[0]);
+    adv_config.uuids_complete.p_uuids  = advertised_uuids;
+
+    init.advdata = adv_config;
 
     init.config.ble_adv_fast_enabled     = true;
     init.config.ble_adv_fast_interval    = APP_ADV_INTERVAL;
@@ -602,52 +903,181 @@ sysret_t network_init(void)
  */
 sysret_t network_set_dev_conf_char_response(uint8_t* buf, uint16_t* len)
 {
-    ble_gatts_hvx_params_t hvx_params =
-    {
-        .handle = simpl_service.dev_conf_char_handles.value_handle,
-        .offset = 0,
-        .p_data = buf,
-        .p_len  = len,
-        .type   = BLE_GATT_HVX_NOTIFICATION
-    };
-
-    return sd_ble_gatts_hvx(conn_handle, (const ble_gatts_hvx_params_t*)&hvx_params);
+    return notification_send(simpl_service.dev_conf_char_handles.value_handle, buf, len);
 }
 
 /**
- * @brief Transmit logdata file packet to mobile app.
- * 
- * @note Size of packet depends on ATT_MTU size (see @ref NRF_SDH_BLE_GATT_MAX_MTU_SIZE) minus ATT header bytes.
- *       Max size is therefore @ref NETWORK_BLE_MAX_ATT_PAYLOAD_SIZE
+ * @brief Queue logdata file packet for transmission to mobile app.
+ *
+ * @note Packets are copied by the SoftDevice, so @p buf can be reused as soon
+ *       as this returns. Keep calling until NRF_ERROR_RESOURCES to keep
+ *       the SoftDevice TX queue full, see @ref network_file_packets_completed().
+ *
+ * @note Size of packet depends on negotiated ATT_MTU size minus ATT header bytes,
+ *       see @ref network_file_packet_max_size()
  *
  * @param buf File packet bytes
- * @param len Size of packet in bytes, max is @ref NETWORK_BLE_MAX_ATT_PAYLOAD_SIZE
- * @return sysret_t 
+ * @param len Size of packet in bytes, max is @ref network_file_packet_max_size()
+ * @return sysret_t
+ * @retval NRF_ERROR_RESOURCES if the TX queue is full, try again after
+ *         some packets complete
  */
 sysret_t network_transmit_file_packet(uint8_t* buf, uint16_t len)
 {
     ASSERT(buf);
 
+    return notification_send(simpl_service.tx_char_handles.value_handle, buf, &len);
+}
+
+/**
+ * @brief Queue a telemetry packet for transmission to mobile app
+ *
+ * @note Shares the SoftDevice TX queue with file packets, max size is
+ *       @ref network_file_packet_max_size()
+ *
+ * @param buf Telemetry packet bytes
+ * @param len Size of packet in bytes
+ * @return sysret_t
+ * @retval NRF_ERROR_INVALID_STATE if the app isn't subscribed
+ * @retval NRF_ERROR_RESOURCES if the TX queue is full
+ */
+sysret_t network_transmit_telemetry(uint8_t* buf, uint16_t len)
+{
+    ASSERT(buf);
+
+    if(!telemetry_subscribed)
+        return NRF_ERROR_INVALID_STATE;
+
+    return notification_send(simpl_service.telemetry_char_handles.value_handle, buf, &len);
+}
+
+/**
+ * @brief Whether the app has subscribed to telemetry notifications
+ *
+ * @return true if telemetry packets will be sent
+ */
+bool network_telemetry_subscribed(void)
+{
+    return telemetry_subscribed;
+}
+
+/**
+ * @brief Number of file packets the SoftDevice has finished sending since boot
+ *
+ * @return uint32_t Completed packet count, wraps around
+ */
+uint32_t network_file_packets_completed(void)
+{
+    return network_tx_completed;
+}
+
+/**
+ * @brief Largest file packet that fits in a single notification
+ *        on the current connection
+ *
+ * @return uint16_t Max packet size in bytes, 0 if not connected
+ */
+uint16_t network_file_packet_max_size(void)
+{
+    if(conn_handle == BLE_CONN_HANDLE_INVALID)
+        return 0U;
+
+    /* ATT_MTU minus opcode and attribute handle */
+    uint16_t size = nrf_ble_gatt_eff_mtu_get(&gatt_instance, conn_handle) - 3U;
+
+    return (size > NETWORK_BLE_MAX_ATT_PAYLOAD_SIZE) ? NETWORK_BLE_MAX_ATT_PAYLOAD_SIZE : size;
+}
+
+/**
+ * @brief Ask for the fastest link the central supports, meant for bulk
+ *        transfers such as datalog downloads
+ *
+ * When enabled, connection events are extended for as long as there is
+ * data queued, and 2M PHY and the max data length are requested if not
+ * already in use. Results are reported as the central responds, see
+ * @ref network_get_link_info().
+ *
+ * @param enable - true to request high throughput, false to stop extending
+ *                 connection events
+ * @return sysret_t Module status
+ */
+sysret_t network_high_throughput_request(bool enable)
+{
     sysret_t ret;
+    ble_opt_t opt;
 
-    if(network_transmission_in_progress)
-        return RET_ERR;
+    (void)memset(&opt, 0, sizeof(opt));
+    opt.common_opt.conn_evt_ext.enable = enable ? 1U : 0U;
 
-    ble_gatts_hvx_params_t hvx_params =
+    ret = sd_ble_opt_set(BLE_COMMON_OPT_CONN_EVT_EXT, &opt);
+    SYSRET_CHECK(ret);
+
+    link_info.conn_evt_ext = enable;
+
+    if(!enable || conn_handle == BLE_CONN_HANDLE_INVALID)
+        return RET_OK;
+
+    if(link_info.tx_phy != BLE_GAP_PHY_2MBPS || link_info.rx_phy != BLE_GAP_PHY_2MBPS)
     {
-        .handle = simpl_service.tx_char_handles.value_handle,
-        .offset = 0,
-        .p_data = buf,
-        .p_len  = &len,
-        .type   = BLE_GATT_HVX_NOTIFICATION
-    };
+        /* busy means a PHY procedure is already running */
+        ret = sd_ble_gap_phy_update(conn_handle, &preferred_phys);
+        if(ret != RET_OK && ret != NRF_ERROR_BUSY)
+            return ret;
+    }
 
-    ret = sd_ble_gatts_hvx(conn_handle, (const ble_gatts_hvx_params_t*)&hvx_params);
+    if(link_info.data_length < NRF_SDH_BLE_GAP_DATA_LENGTH)
+    {
+        ret = nrf_ble_gatt_data_length_set(&gatt_instance, conn_handle, NRF_SDH_BLE_GAP_DATA_LENGTH);
+        if(ret != RET_OK && ret != NRF_ERROR_BUSY)
+            return ret;
+    }
 
-    if(ret == RET_OK)
-        network_transmission_in_progress = true;
+    return RET_OK;
+}
 
-    return ret;
+/**
+ * @brief Switch connection parameters profile
+ *
+ * The profile becomes the preferred parameters for new connections, and
+ * the central is asked to switch if one is connected. Results are reported
+ * as the central responds, see @ref network_get_link_info().
+ *
+ * @param profile - Profile to switch to
+ * @return sysret_t Module status
+ */
+sysret_t network_set_conn_profile(network_conn_profile_t profile)
+{
+    ASSERT(profile < NETWORK_CONN_PROFILES_NUM);
+
+    sysret_t ret;
+
+    if(profile == conn_profile && !conn_profile_pending)
+        return RET_OK;
+
+    conn_profile = profile;
+    link_info.conn_profile = profile;
+
+    ret = sd_ble_gap_ppcp_set(&conn_profiles[profile]);
+    SYSRET_CHECK(ret);
+
+    if(conn_handle == BLE_CONN_HANDLE_INVALID)
+        return RET_OK;
+
+    ret = conn_profile_request();
+
+    /* busy is retried once the update in progress completes */
+    return (ret == NRF_ERROR_BUSY) ? RET_OK : ret;
+}
+
+/**
+ * @brief Get negotiated parameters of the current connection
+ *
+ * @param info - Link information will be saved here
+ */
+void network_get_link_info(network_link_info_t* info)
+{
+    ASSERT(info);
+    *info = link_info;
 }
 
 /**
@@ -674,4 +1104,55 @@ void network_cli_process(void)
         default:
             break;
     }
-}
\ No newline at end of file
+}
+
+/**
+ * @brief Update device status broadcast in the scan response
+ *
+ * @note Takes effect without restarting advertising, and is kept when
+ *       advertising restarts after a disconnection.
+ *
+ * @param status - Device status
+ * @return sysret_t Driver status
+ */
+sysret_t network_set_adv_status(const network_adv_status_t* status)
+{
+    ASSERT(status);
+
+    sysret_t ret = RET_ERR;
+    uint8_t next = adv_data_set ^ 1U;
+    ble_gap_adv_data_t* set = &adv_data_sets[next];
+    network_adv_status_t status_data = *status;
+
+    ble_advdata_manuf_data_t manuf_data =
+    {
+        .company_identifier = ADV_STATUS_COMPANY_ID,
+        .data =
+        {
+            .size   = sizeof(status_data),
+            .p_data = (uint8_t*)&status_data
+        }
+    };
+
+    ble_advdata_t scan_rsp_config;
+    (void)memset(&scan_rsp_config, 0, sizeof(scan_rsp_config));
+    scan_rsp_config.p_manuf_specific_data = &manuf_data;
+
+    /* encode into the free set, then hand it over */
+    set->adv_data.p_data      = adv_buffers[next];
+    set->adv_data.len         = sizeof(adv_buffers[next]);
+    set->scan_rsp_data.p_data = scan_rsp_buffers[next];
+    set->scan_rsp_data.len    = sizeof(scan_rsp_buffers[next]);
+
+    ret = ble_advdata_encode(&adv_config, set->adv_data.p_data, &set->adv_data.len);
+    SYSRET_CHECK(ret);
+
+    ret = ble_advdata_encode(&scan_rsp_config, set->scan_rsp_data.p_data, &set->scan_rsp_data.len);
+    SYSRET_CHECK(ret);
+
+    ret = ble_advertising_advdata_update(&advertising_instance, set, true);
+    SYSRET_CHECK(ret);
+
+    adv_data_set = next;
+    return RET_OK;
+}
@@ -0,0 +1,212 @@
+/**
+ * @file power.c
+ * @author UBC Capstone Team 2020/2021
+ * @brief System power manager
+ */
+
+#include <stdbool.h>
+#include <string.h>
+#include "power.h"
+#include "adxl372.h"
+#include "icm20649.h"
+#include "mt25q.h"
+#include "vcnl4040.h"
+#include "app_timer.h"
+#include "nrf_assert.h"
+#include "nrf_log.h"
+
+/**
+ * @brief State of every peripheral in a power mode
+ */
+typedef struct
+{
+    icm20649_power_t icm20649;
+    adxl372_mode_t   adxl372;
+    bool             mt25q_down;
+    bool             vcnl4040_down;
+} power_mode_cfg_t;
+
+/**
+ * @brief Peripheral states of each mode, see the table in power.h
+ */
+static const power_mode_cfg_t mode_cfgs[POWER_MODES] =
+{
+    [POWER_MODE_ACTIVE]   = { ICM20649_POWER_ACTIVE,      ADXL372_MODE_FULLBAND,   false, false },
+    [POWER_MODE_ARMED]    = { ICM20649_POWER_SLEEP,       ADXL372_MODE_INSTANT_ON, true,  false },
+    [POWER_MODE_TRANSFER] = { ICM20649_POWER_DUTY_CYCLED, ADXL372_MODE_STANDBY,    false, true  },
+    [POWER_MODE_IDLE]     = { ICM20649_POWER_DUTY_CYCLED, ADXL372_MODE_STANDBY,    true,  true  },
+    [POWER_MODE_WATCH]    = { ICM20649_POWER_SLEEP,       ADXL372_MODE_STANDBY,    true,  false },
+    [POWER_MODE_SLEEP]    = { ICM20649_POWER_SLEEP,       ADXL372_MODE_STANDBY,    true,  true  }
+};
+
+/**
+ * @brief Current drawn in each mode in uA
+ */
+static const uint32_t mode_current_ua[POWER_MODES] =
+{
+    [POWER_MODE_ACTIVE]   = POWER_CURRENT_ACTIVE_UA,
+    [POWER_MODE_ARMED]    = POWER_CURRENT_ARMED_UA,
+    [POWER_MODE_TRANSFER] = POWER_CURRENT_TRANSFER_UA,
+    [POWER_MODE_IDLE]     = POWER_CURRENT_IDLE_UA,
+    [POWER_MODE_WATCH]    = POWER_CURRENT_WATCH_UA,
+    [POWER_MODE_SLEEP]    = POWER_CURRENT_SLEEP_UA
+};
+
+const char* power_mode_strings[POWER_MODES] =
+{
+    "active",
+    "armed",
+    "transfer",
+    "idle",
+    "watch",
+    "sleep"
+};
+
+/**
+ * @brief Power manager state
+ */
+static struct
+{
+    power_mode_t mode;                 /*!< Current mode */
+    bool vcnl4040_down;                /*!< VCNL4040 shut down */
+    uint64_t residency[POWER_MODES];   /*!< app_timer ticks spent in each mode */
+    uint32_t last;                     /*!< app_timer ticks when residency was last updated */
+} power;
+
+/******************************
+ * Helper functions
+ ******************************/
+
+/**
+ * @notapi
+ * @brief Add time since the last update to the current mode
+ */
+static void update_residency(void)
+{
+    uint32_t now = app_timer_cnt_get();
+
+    power.residency[power.mode] += app_timer_cnt_diff_compute(now, power.last);
+    power.last = now;
+}
+
+/**
+ * @notapi
+ * @brief Keep the first error, peripherals are still set after one fails
+ */
+static void keep_first_error(sysret_t* first, sysret_t ret)
+{
+    if(*first == RET_OK)
+        *first = ret;
+}
+
+/******************************
+ * API
+ ******************************/
+
+/**
+ * @brief Initialize the power manager, peripherals are left as they are
+ *        until a mode is set
+ *
+ * @return sysret_t Module status
+ */
+sysret_t power_init(void)
+{
+    (void)memset(&power, 0, sizeof(power));
+    power.mode = POWER_MODE_ACTIVE;
+    power.last = app_timer_cnt_get();
+
+    return RET_OK;
+}
+
+/**
+ * @brief Move every peripheral into the state the mode needs
+ *
+ * Drivers skip changes to the state they're already in, so this is cheap
+ * to call again with the same mode.
+ *
+ * @param mode - Power mode
+ * @return sysret_t Module status, the first peripheral to fail, the
+ *         others are still set
+ */
+sysret_t power_set_mode(power_mode_t mode)
+{
+    ASSERT(mode < POWER_MODES);
+
+    const power_mode_cfg_t* cfg = &mode_cfgs[mode];
+    sysret_t ret = RET_OK;
+
+    update_residency();
+
+    if(mode != power.mode)
+        NRF_LOG_DEBUG("POWER MODE %s -> %s", power_mode_strings[power.mode], power_mode_strings[mode]);
+
+    power.mode = mode;
+
+    keep_first_error(&ret, icm20649_set_power(cfg->icm20649));
+    keep_first_error(&ret, adxl372_set_mode(cfg->adxl372));
+
+    /* flash wakes up by itself on access, so put it back down every time */
+    if(cfg->mt25q_down)
+        keep_first_error(&ret, mt25q_power_down());
+
+    if(cfg->vcnl4040_down != power.vcnl4040_down)
+    {
+        sysret_t vcnl_ret = vcnl4040_shutdown(cfg->vcnl4040_down);
+
+        if(vcnl_ret == RET_OK)
+            power.vcnl4040_down = cfg->vcnl4040_down;
+
+        keep_first_error(&ret, vcnl_ret);
+    }
+
+    return ret;
+}
+
+/**
+ * @brief Get current mode
+ *
+ * @return power_mode_t Current mode
+ */
+power_mode_t power_get_mode(void)
+{
+    return power.mode;
+}
+
+/**
+ * @brief Get residency and battery life statistics
+ *
+ * @param stats - Statistics will be saved here
+ */
+void power_get_stats(power_stats_t* stats)
+{
+    ASSERT(stats);
+
+    uint64_t elapsed = 0U;
+    uint64_t charge = 0U; /* uA * ticks */
+
+    update_residency();
+
+    stats->mode = power.mode;
+
+    for(size_t mode = 0U ; mode < POWER_MODES ; mode++)
+    {
+        elapsed += power.residency[mode];
+        charge  += power.residency[mode] * mode_current_ua[mode];
+        stats->residency_s[mode] = (uint32_t)(power.residency[mode] / APP_TIMER_CLOCK_FREQ);
+    }
+
+    stats->elapsed_s = (uint32_t)(elapsed / APP_TIMER_CLOCK_FREQ);
+    stats->avg_current_ua = (elapsed > 0U) ?
+        (uint32_t)(charge / elapsed) : mode_current_ua[power.mode];
+    stats->battery_life_h = (stats->avg_current_ua > 0U) ?
+        (POWER_BATTERY_CAPACITY_MAH * 1000U) / stats->avg_current_ua : UINT32_MAX;
+}
+
+/**
+ * @brief Reset statistics, e.g. at the start of a season
+ */
+void power_reset_stats(void)
+{
+    (void)memset(power.residency, 0, sizeof(power.residency));
+    power.last = app_timer_cnt_get();
+}
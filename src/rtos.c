@@ -0,0 +1,334 @@
+/**
+ * @file rtos.c
+ * @author UBC Capstone Team 2020/2021
+ * @brief FreeRTOS build of the firmware, built with make RTOS=1
+ */
+
+#include <stdbool.h>
+#include "rtos.h"
+#include "acquisition.h"
+#include "eventloop.h"
+#include "shell.h"
+#include "FreeRTOS.h"
+#include "task.h"
+#include "semphr.h"
+#include "nrf_sdh.h"
+#include "nrf_rtc.h"
+#include "app_timer.h"
+#include "app_error.h"
+#include "nrf_assert.h"
+
+/**
+ * @brief Task definition
+ */
+typedef struct
+{
+    const char*    name;     /*!< Name */
+    TaskFunction_t function; /*!< Body, never returns */
+    uint16_t       stack;    /*!< Stack size in words */
+    UBaseType_t    priority; /*!< Priority, the timer task is above them all */
+} rtos_task_def_t;
+
+static void system_task(void* p_ctx);
+static void acquisition_task(void* p_ctx);
+static void storage_task(void* p_ctx);
+static void network_task(void* p_ctx);
+static void shell_task(void* p_ctx);
+static void ble_task(void* p_ctx);
+
+/**
+ * @brief Every task
+ */
+static const rtos_task_def_t task_defs[RTOS_TASKS] =
+{
+    [RTOS_TASK_SYSTEM]      = { "system",  system_task,      768U, 1U },
+    [RTOS_TASK_ACQUISITION] = { "acq",     acquisition_task, 384U, 4U },
+    [RTOS_TASK_STORAGE]     = { "storage", storage_task,     384U, 3U },
+    [RTOS_TASK_NETWORK]     = { "network", network_task,     256U, 2U },
+    [RTOS_TASK_SHELL]       = { "shell",   shell_task,       512U, 1U },
+    [RTOS_TASK_BLE]         = { "ble",     ble_task,         512U, 2U }
+};
+
+/**
+ * @brief Task handles, NULL until the task is created
+ */
+static TaskHandle_t tasks[RTOS_TASKS];
+
+/**
+ * @brief Lock around module code
+ */
+static SemaphoreHandle_t lock = NULL;
+
+/**
+ * @brief Initializes every module, run by the system task
+ */
+static void (*modules_init)(void) = NULL;
+
+/******************************
+ * Helper functions
+ ******************************/
+
+/**
+ * @notapi
+ * @brief Run a pipeline stage every time the task is woken up
+ */
+static void stage_run(void (*stage)(void))
+{
+    while(true)
+    {
+        rtos_wait();
+
+        rtos_lock();
+        stage();
+        rtos_unlock();
+    }
+}
+
+/**
+ * @notapi
+ * @brief Filter stage, woken up by the sampling interrupt
+ */
+static void acquisition_task(void* p_ctx)
+{
+    (void)p_ctx;
+    stage_run(acquisition_filter);
+}
+
+/**
+ * @notapi
+ * @brief Store stage, woken up by the filter stage
+ */
+static void storage_task(void* p_ctx)
+{
+    (void)p_ctx;
+    stage_run(acquisition_store);
+}
+
+/**
+ * @notapi
+ * @brief Stream stage, woken up by the filter stage
+ */
+static void network_task(void* p_ctx)
+{
+    (void)p_ctx;
+    stage_run(acquisition_stream);
+}
+
+/**
+ * @notapi
+ * @brief Dispatch SoftDevice events to their observers, woken up by the
+ *        SoftDevice event interrupt
+ *
+ * Takes the place of the SDK's SoftDevice task, which dispatches without
+ * the lock while observers call into the state machine and flash.
+ */
+static void ble_task(void* p_ctx)
+{
+    (void)p_ctx;
+
+    /* events may have come in before the task was created */
+    rtos_lock();
+    nrf_sdh_evts_poll();
+    rtos_unlock();
+
+    stage_run(nrf_sdh_evts_poll);
+}
+
+/**
+ * @notapi
+ * @brief Poll the CLI, UART and RTT input don't wake anything up
+ */
+static void shell_task(void* p_ctx)
+{
+    (void)p_ctx;
+
+    while(true)
+    {
+        rtos_lock();
+        shell_process();
+        rtos_unlock();
+
+        vTaskDelay(pdMS_TO_TICKS(RTOS_SHELL_POLL_PERIOD_MS));
+    }
+}
+
+/**
+ * @notapi
+ * @brief Initialize every module, start the other tasks, then run the
+ *        event loop
+ *
+ * Modules are initialized here rather than before the scheduler starts,
+ * driver timeouts run on app_timer, which needs the timer task.
+ */
+static void system_task(void* p_ctx)
+{
+    (void)p_ctx;
+
+    rtos_lock();
+    modules_init();
+
+    for(size_t task = RTOS_TASK_SYSTEM + 1U ; task < RTOS_TASKS ; task++)
+    {
+        const rtos_task_def_t* def = &task_defs[task];
+
+        if(xTaskCreate(def->function, def->name, def->stack, NULL, def->priority, &tasks[task]) != pdPASS)
+            APP_ERROR_HANDLER(NRF_ERROR_NO_MEM);
+    }
+
+    rtos_unlock();
+
+    while(true)
+        eventloop_process();
+}
+
+/******************************
+ * API
+ ******************************/
+
+/**
+ * @brief SoftDevice event interrupt, BLE events are dispatched by the BLE
+ *        task
+ */
+void SD_EVT_IRQHandler(void)
+{
+    rtos_wake(RTOS_TASK_BLE);
+}
+
+/**
+ * @brief Start the scheduler, never returns
+ *
+ * @param init - Initializes every module
+ */
+void rtos_start(void (*init)(void))
+{
+    ASSERT(init);
+
+    const rtos_task_def_t* def = &task_defs[RTOS_TASK_SYSTEM];
+
+    modules_init = init;
+
+    lock = xSemaphoreCreateRecursiveMutex();
+
+    if(lock == NULL || xTaskCreate(def->function, def->name, def->stack, NULL, def->priority, &tasks[RTOS_TASK_SYSTEM]) != pdPASS)
+        APP_ERROR_HANDLER(NRF_ERROR_NO_MEM);
+
+    vTaskStartScheduler();
+
+    /* only gets here if the idle or timer task couldn't be created */
+    APP_ERROR_HANDLER(NRF_ERROR_NO_MEM);
+}
+
+/**
+ * @brief Wake a task up, safe to call from interrupts. Does nothing if the
+ *        task isn't running yet.
+ *
+ * @param task - Task to wake
+ */
+void rtos_wake(rtos_task_t task)
+{
+    ASSERT(task < RTOS_TASKS);
+
+    TaskHandle_t handle = tasks[task];
+
+    if(handle == NULL)
+        return;
+
+    if(__get_IPSR() != 0U)
+    {
+        BaseType_t yield = pdFALSE;
+
+        vTaskNotifyGiveFromISR(handle, &yield);
+        portYIELD_FROM_ISR(yield);
+    }
+    else
+    {
+        (void)xTaskNotifyGive(handle);
+    }
+}
+
+/**
+ * @brief Wait until the calling task is woken up with @ref rtos_wake()
+ */
+void rtos_wait(void)
+{
+    (void)ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+}
+
+/**
+ * @brief Take the lock around module code, tasks can take it again while
+ *        holding it
+ */
+void rtos_lock(void)
+{
+    (void)xSemaphoreTakeRecursive(lock, portMAX_DELAY);
+}
+
+/**
+ * @brief Release the lock, once for every @ref rtos_lock()
+ */
+void rtos_unlock(void)
+{
+    (void)xSemaphoreGiveRecursive(lock);
+}
+
+/**
+ * @brief Get the least stack each task has had left
+ *
+ * @param task - Task
+ * @return uint32_t Bytes never used, 0 if the task isn't running
+ */
+uint32_t rtos_stack_free(rtos_task_t task)
+{
+    ASSERT(task < RTOS_TASKS);
+
+    if(tasks[task] == NULL)
+        return 0U;
+
+    return (uint32_t)uxTaskGetStackHighWaterMark(tasks[task]) * sizeof(StackType_t);
+}
+
+/******************************
+ * FreeRTOS and SDK hooks
+ ******************************/
+
+/**
+ * @brief Stack overflow detected on a context switch
+ */
+void vApplicationStackOverflowHook(TaskHandle_t task, char* name)
+{
+    (void)task;
+    (void)name;
+
+    APP_ERROR_HANDLER(NRF_ERROR_NO_MEM);
+}
+
+/**
+ * @brief FreeRTOS heap ran out
+ */
+void vApplicationMallocFailedHook(void)
+{
+    APP_ERROR_HANDLER(NRF_ERROR_NO_MEM);
+}
+
+/**
+ * @brief app_timer counter, the FreeRTOS app_timer has none
+ *
+ * RTC1 runs the RTOS tick, its counter is scaled up to app_timer ticks so
+ * durations keep being worked out with APP_TIMER_CLOCK_FREQ, at the RTOS
+ * tick resolution.
+ */
+uint32_t app_timer_cnt_get(void)
+{
+    return nrf_rtc_counter_get(portNRF_RTC_REG) * (APP_TIMER_CLOCK_FREQ / configTICK_RATE_HZ);
+}
+
+/**
+ * @brief Ticks between two @ref app_timer_cnt_get() values, the counter
+ *        wraps at 24 bits of RTOS ticks
+ */
+uint32_t app_timer_cnt_diff_compute(uint32_t ticks_to, uint32_t ticks_from)
+{
+    uint32_t scale = APP_TIMER_CLOCK_FREQ / configTICK_RATE_HZ;
+
+    return (((ticks_to / scale) - (ticks_from / scale)) & RTC_COUNTER_COUNTER_Msk) * scale;
+}
@@ -0,0 +1,114 @@
+/**
+ * @file sampleclock.c
+ * @author UBC Capstone Team 2020/2021
+ * @brief Sampling clock, paces sensor sampling off a hardware timer
+ */
+
+#include "sampleclock.h"
+#include "nrf_drv_timer.h"
+#include "app_util.h"
+#include "app_util_platform.h"
+#include "nrf_assert.h"
+
+/**
+ * @brief Timer frequency in Hz
+ */
+#define TIMER_FREQ 16000000U
+
+/**
+ * @brief Timer instance, TIMER0 belongs to the SoftDevice
+ */
+static const nrf_drv_timer_t timer = NRF_DRV_TIMER_INSTANCE(1);
+
+/**
+ * @brief Tick handler, NULL when stopped
+ */
+static volatile sampleclock_handler_t tick_handler = NULL;
+
+/******************************
+ * Helper functions
+ ******************************/
+
+/**
+ * @notapi
+ * @brief Timer event handler, the timer cleared itself on the compare
+ */
+static void timer_handler(nrf_timer_event_t event_type, void* p_ctx)
+{
+    (void)p_ctx;
+
+    sampleclock_handler_t handler = tick_handler;
+
+    if(event_type == NRF_TIMER_EVENT_COMPARE0 && handler)
+        handler();
+}
+
+/******************************
+ * API
+ ******************************/
+
+/**
+ * @brief Initialize the sampling clock, left stopped
+ *
+ * @return sysret_t Module status
+ */
+sysret_t sampleclock_init(void)
+{
+    nrf_drv_timer_config_t cfg = NRF_DRV_TIMER_DEFAULT_CONFIG;
+
+    cfg.frequency = NRF_TIMER_FREQ_16MHz;
+    cfg.mode = NRF_TIMER_MODE_TIMER;
+    cfg.bit_width = NRF_TIMER_BIT_WIDTH_32;
+
+    /* ticks come in ahead of the sampling interrupt they pend */
+    cfg.interrupt_priority = APP_IRQ_PRIORITY_HIGH;
+
+    return nrf_drv_timer_init(&timer, &cfg, timer_handler);
+}
+
+/**
+ * @brief Start ticking
+ *
+ * @param ticks   - Period in 32768 Hz ticks
+ * @param handler - Called on every tick
+ * @return sysret_t Module status
+ */
+sysret_t sampleclock_start(uint32_t ticks, sampleclock_handler_t handler)
+{
+    ASSERT(handler);
+
+    uint32_t cc = (uint32_t)ROUNDED_DIV((uint64_t)ticks * TIMER_FREQ, SAMPLECLOCK_TICK_FREQ);
+
+    if(cc == 0U)
+        return RET_ERR;
+
+    nrf_drv_timer_disable(&timer);
+    tick_handler = handler;
+
+    nrf_drv_timer_extended_compare(&timer, NRF_TIMER_CC_CHANNEL0, cc, NRF_TIMER_SHORT_COMPARE0_CLEAR_MASK, true);
+    nrf_drv_timer_clear(&timer);
+    nrf_drv_timer_enable(&timer);
+
+    return RET_OK;
+}
+
+/**
+ * @brief Stop ticking
+ */
+void sampleclock_stop(void)
+{
+    nrf_drv_timer_disable(&timer);
+    nrf_drv_timer_compare_int_disable(&timer, NRF_TIMER_CC_CHANNEL0);
+    tick_handler = NULL;
+}
+
+/**
+ * @brief Time since the last tick, safe to call from interrupts
+ *
+ * @return uint32_t Time since the last tick in us
+ */
+uint32_t sampleclock_since_tick_us(void)
+{
+    /* CC1 is only ever captured into */
+    return nrf_drv_timer_capture(&timer, NRF_TIMER_CC_CHANNEL1) / (TIMER_FREQ / 1000000U);
+}
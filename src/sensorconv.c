@@ -0,0 +1,339 @@
+/**
+ * @file sensorconv.c
+ * @author UBC Capstone Team 2020/2021
+ * @brief Batch conversion kernels for raw sensor frames
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "sensorconv.h"
+
+#if defined(ARM_MATH_CM4)
+#include "nrf.h"
+#define SENSORCONV_SIMD /*!< Cortex-M4 DSP extension available, use SIMD kernels */
+#endif
+
+/**
+ * @brief ADXL372 readings are 12 bits, left-justified. The lower nibble of
+ *        the low byte holds no data and has to be masked out.
+ */
+#define ADXL372_DATA_MASK    0xF0U
+#define ADXL372_DATA_MASK_X2 0xFFF0FFF0U /*!< Same as above, two channels at once */
+
+/**
+ * @brief Right shift needed to turn 12-bit left-justified values into 16-bit integers
+ */
+#define ADXL372_DATA_SHIFT 4U
+
+/**
+ * @brief Each row of the calibration matrix must sum (in magnitude) below this,
+ *        4.0 in Q2.14, so that Q * x fits in 32 bits
+ */
+#define CAL_ROW_LIMIT (4 * SENSORCONV_CAL_ONE)
+
+/**
+ * @brief Added before the fixed-point shift to round to nearest
+ */
+#define CAL_ROUNDING (1 << (SENSORCONV_CAL_FRAC_BITS - 1U))
+
+/******************************
+ * Helper functions
+ ******************************/
+
+/**
+ * @notapi
+ * @brief Scale a Q2.14 accumulator back to a saturated 16-bit channel
+ *
+ * @param acc - Accumulated matrix row times frame
+ * @return int16_t Rounded, saturated result
+ */
+static int16_t cal_narrow(int32_t acc)
+{
+    acc = (acc + CAL_ROUNDING) >> SENSORCONV_CAL_FRAC_BITS;
+
+#ifdef SENSORCONV_SIMD
+    return (int16_t)__SSAT(acc, 16);
+#else
+    if(acc > INT16_MAX)
+        return INT16_MAX;
+    if(acc < INT16_MIN)
+        return INT16_MIN;
+
+    return (int16_t)acc;
+#endif
+}
+
+#ifdef SENSORCONV_SIMD
+
+/**
+ * @notapi
+ * @brief Pack per-axis offsets into SIMD words
+ *
+ * Two frames are six channels, which is exactly three 32-bit words:
+ *   word 0 = [ X0 | Y0 ], word 1 = [ Z0 | X1 ], word 2 = [ Y1 | Z1 ]
+ * so the offsets are packed the same way to line up with the channels.
+ *
+ * @param offsets - Per-axis offsets
+ * @param scale   - Multiply offsets by this before packing
+ * @param packed  - Packed offsets, one per word of a frame pair
+ */
+static void pack_offsets(const int16_t offsets[SENSORCONV_AXES], int32_t scale, uint32_t packed[SENSORCONV_AXES])
+{
+    uint32_t x = (uint16_t)(offsets[0] * scale);
+    uint32_t y = (uint16_t)(offsets[1] * scale);
+    uint32_t z = (uint16_t)(offsets[2] * scale);
+
+    packed[0] = x | (y << 16U);
+    packed[1] = z | (x << 16U);
+    packed[2] = y | (z << 16U);
+}
+
+#endif /* SENSORCONV_SIMD */
+
+/******************************
+ * API
+ ******************************/
+
+/**
+ * @brief Scalar reference implementation of @ref sensorconv_adxl372()
+ */
+void sensorconv_adxl372_ref(int16_t* buf, size_t frames, const int16_t offsets[SENSORCONV_AXES])
+{
+    uint8_t* bytes = (uint8_t*)buf;
+
+    for(size_t i = 0U ; i < frames*SENSORCONV_AXES ; i++)
+    {
+        /* format data, since it was received in big-endian format (ARM is little endian) */
+        int16_t raw = (int16_t)((bytes[2U*i] << 8U) | (bytes[2U*i + 1U] & ADXL372_DATA_MASK));
+
+        /* convert from 12-bit to 16-bit integer, then trim offset */
+        buf[i] = (int16_t)(raw/16 - offsets[i % SENSORCONV_AXES]);
+    }
+}
+
+/**
+ * @brief Scalar reference implementation of @ref sensorconv_icm20649()
+ */
+void sensorconv_icm20649_ref(int16_t* buf, size_t frames, const int16_t offsets[SENSORCONV_AXES])
+{
+    uint8_t* bytes = (uint8_t*)buf;
+
+    for(size_t i = 0U ; i < frames*SENSORCONV_AXES ; i++)
+    {
+        /* switch byte order, then trim offset */
+        int16_t raw = (int16_t)((bytes[2U*i] << 8U) | bytes[2U*i + 1U]);
+        buf[i] = (int16_t)(raw - offsets[i % SENSORCONV_AXES]);
+    }
+}
+
+/**
+ * @brief Scalar reference implementation of @ref sensorconv_calibrate()
+ */
+void sensorconv_calibrate_ref(int16_t* buf, size_t frames, const sensorconv_cal_t* cal)
+{
+    const int16_t* q = cal->q;
+
+    for(size_t i = 0U ; i < frames ; i++)
+    {
+        int32_t x = buf[0];
+        int32_t y = buf[1];
+        int32_t z = buf[2];
+
+        buf[0] = cal_narrow(q[SENSORCONV_CAL_Q11]*x + q[SENSORCONV_CAL_Q12]*y + q[SENSORCONV_CAL_Q13]*z);
+        buf[1] = cal_narrow(q[SENSORCONV_CAL_Q22]*y + q[SENSORCONV_CAL_Q23]*z);
+        buf[2] = cal_narrow(q[SENSORCONV_CAL_Q33]*z);
+
+        buf += SENSORCONV_AXES;
+    }
+}
+
+/**
+ * @brief Convert ADXL372 frames in place
+ *
+ * @param buf     - Frames to convert, SENSORCONV_AXES channels per frame
+ * @param frames  - Number of frames in buf
+ * @param offsets - Per-axis offset in LSB, must be within the 12-bit range
+ */
+void sensorconv_adxl372(int16_t* buf, size_t frames, const int16_t offsets[SENSORCONV_AXES])
+{
+#ifdef SENSORCONV_SIMD
+    if(((uintptr_t)buf & 0x3U) == 0U)
+    {
+        uint32_t* words = (uint32_t*)buf;
+        uint32_t packed[SENSORCONV_AXES];
+        size_t pairs = frames / 2U;
+
+        /**
+         * Subtracting (16 * offset) before the shift is the same as subtracting
+         * offset after it, since the masked readings are multiples of 16.
+         */
+        pack_offsets(offsets, 1 << ADXL372_DATA_SHIFT, packed);
+
+        for(size_t i = 0U ; i < pairs ; i++)
+        {
+            for(size_t j = 0U ; j < SENSORCONV_AXES ; j++)
+            {
+                uint32_t v = __REV16(words[j]) & ADXL372_DATA_MASK_X2;
+
+                /* (raw - 16*offset) / 16, as four halving operations */
+                v = __SHSUB16(v, packed[j]);
+                v = __SHADD16(v, 0U);
+                v = __SHADD16(v, 0U);
+                v = __SHADD16(v, 0U);
+
+                words[j] = v;
+            }
+
+            words += SENSORCONV_AXES;
+        }
+
+        /* leave any odd frame for the scalar loop below */
+        buf    += pairs * 2U * SENSORCONV_AXES;
+        frames -= pairs * 2U;
+    }
+#endif /* SENSORCONV_SIMD */
+
+    sensorconv_adxl372_ref(buf, frames, offsets);
+}
+
+/**
+ * @brief Convert ICM20649 frames in place
+ *
+ * @param buf     - Frames to convert, SENSORCONV_AXES channels per frame
+ * @param frames  - Number of frames in buf
+ * @param offsets - Per-axis offset in LSB
+ */
+void sensorconv_icm20649(int16_t* buf, size_t frames, const int16_t offsets[SENSORCONV_AXES])
+{
+#ifdef SENSORCONV_SIMD
+    if(((uintptr_t)buf & 0x3U) == 0U)
+    {
+        uint32_t* words = (uint32_t*)buf;
+        uint32_t packed[SENSORCONV_AXES];
+        size_t pairs = frames / 2U;
+
+        pack_offsets(offsets, 1, packed);
+
+        for(size_t i = 0U ; i < pairs ; i++)
+        {
+            for(size_t j = 0U ; j < SENSORCONV_AXES ; j++)
+                words[j] = __SSUB16(__REV16(words[j]), packed[j]);
+
+            words += SENSORCONV_AXES;
+        }
+
+        /* leave any odd frame for the scalar loop below */
+        buf    += pairs * 2U * SENSORCONV_AXES;
+        frames -= pairs * 2U;
+    }
+#endif /* SENSORCONV_SIMD */
+
+    sensorconv_icm20649_ref(buf, frames, offsets);
+}
+
+/**
+ * @brief Apply the scale and misalignment terms of a calibration in place
+ *
+ * @param buf    - Converted frames, SENSORCONV_AXES channels per frame
+ * @param frames - Number of frames in buf
+ * @param cal    - Calibration to apply
+ */
+void sensorconv_calibrate(int16_t* buf, size_t frames, const sensorconv_cal_t* cal)
+{
+#ifdef SENSORCONV_SIMD
+    if(((uintptr_t)buf & 0x3U) == 0U)
+    {
+        uint32_t* words = (uint32_t*)buf;
+        size_t pairs = frames / 2U;
+        const int16_t* q = cal->q;
+
+        /* pair up the terms that multiply [x|y] and [y|z] */
+        uint32_t q11_q12 = (uint16_t)q[SENSORCONV_CAL_Q11] | ((uint32_t)(uint16_t)q[SENSORCONV_CAL_Q12] << 16U);
+        uint32_t q22_q23 = (uint16_t)q[SENSORCONV_CAL_Q22] | ((uint32_t)(uint16_t)q[SENSORCONV_CAL_Q23] << 16U);
+        int32_t  q13     = q[SENSORCONV_CAL_Q13];
+        int32_t  q33     = q[SENSORCONV_CAL_Q33];
+
+        for(size_t i = 0U ; i < pairs ; i++)
+        {
+            /* word 0 = [ X0 | Y0 ], word 1 = [ Z0 | X1 ], word 2 = [ Y1 | Z1 ] */
+            uint32_t w0 = words[0];
+            uint32_t w1 = words[1];
+            uint32_t w2 = words[2];
+
+            int32_t  z0  = (int16_t)w1;
+            uint32_t yz0 = (w0 >> 16U) | (w1 << 16U);
+            int32_t  z1  = (int16_t)(w2 >> 16U);
+            uint32_t xy1 = (w1 >> 16U) | (w2 << 16U);
+
+            int16_t x0 = cal_narrow((int32_t)__SMLAD(w0, q11_q12, (uint32_t)(q13 * z0)));
+            int16_t y0 = cal_narrow((int32_t)__SMUAD(yz0, q22_q23));
+            int16_t c0 = cal_narrow(q33 * z0);
+            int16_t x1 = cal_narrow((int32_t)__SMLAD(xy1, q11_q12, (uint32_t)(q13 * z1)));
+            int16_t y1 = cal_narrow((int32_t)__SMUAD(w2, q22_q23));
+            int16_t c1 = cal_narrow(q33 * z1);
+
+            words[0] = (uint16_t)x0 | ((uint32_t)(uint16_t)y0 << 16U);
+            words[1] = (uint16_t)c0 | ((uint32_t)(uint16_t)x1 << 16U);
+            words[2] = (uint16_t)y1 | ((uint32_t)(uint16_t)c1 << 16U);
+
+            words += SENSORCONV_AXES;
+        }
+
+        /* leave any odd frame for the scalar loop below */
+        buf    += pairs * 2U * SENSORCONV_AXES;
+        frames -= pairs * 2U;
+    }
+#endif /* SENSORCONV_SIMD */
+
+    sensorconv_calibrate_ref(buf, frames, cal);
+}
+
+/**
+ * @brief Check that a calibration can be applied without overflowing
+ *
+ * @param cal - Calibration to check
+ * @return true if every row of the matrix is within range
+ */
+bool sensorconv_cal_valid(const sensorconv_cal_t* cal)
+{
+    const int16_t* q = cal->q;
+
+    int32_t row1 = abs(q[SENSORCONV_CAL_Q11]) + abs(q[SENSORCONV_CAL_Q12]) + abs(q[SENSORCONV_CAL_Q13]);
+    int32_t row2 = abs(q[SENSORCONV_CAL_Q22]) + abs(q[SENSORCONV_CAL_Q23]);
+    int32_t row3 = abs(q[SENSORCONV_CAL_Q33]);
+
+    return (row1 < CAL_ROW_LIMIT) && (row2 < CAL_ROW_LIMIT) && (row3 < CAL_ROW_LIMIT);
+}
+
+/**
+ * @brief Check that an ADXL372 calibration can be applied without
+ *        overflowing
+ *
+ * @param cal - Calibration to check
+ * @return true if the matrix is within range and every bias is within
+ *         @ref SENSORCONV_ADXL372_BIAS_LIMIT
+ */
+bool sensorconv_adxl372_cal_valid(const sensorconv_cal_t* cal)
+{
+    for(size_t i = 0U ; i < SENSORCONV_AXES ; i++)
+    {
+        if(abs(cal->bias[i]) > SENSORCONV_ADXL372_BIAS_LIMIT)
+            return false;
+    }
+
+    return sensorconv_cal_valid(cal);
+}
+
+/**
+ * @brief Set a calibration to zero bias and identity matrix
+ *
+ * @param cal - Calibration to reset
+ */
+void sensorconv_cal_identity(sensorconv_cal_t* cal)
+{
+    (void)memset(cal, 0, sizeof(*cal));
+
+    cal->q[SENSORCONV_CAL_Q11] = SENSORCONV_CAL_ONE;
+    cal->q[SENSORCONV_CAL_Q22] = SENSORCONV_CAL_ONE;
+    cal->q[SENSORCONV_CAL_Q33] = SENSORCONV_CAL_ONE;
+}
@@ -11,15 +11,29 @@
 #include "nrf_cli.h"
 #include "nrf_cli_rtt.h"
 #include "nrf_cli_uart.h"
-#include "nrf_delay.h"
+#include "nrf_pt.h"
+#include "app_timer.h"
 #include "datetime.h"
 #include "adxl372.h"
 #include "icm20649.h"
 #include "vcnl4040.h"
 #include "mt25q.h"
+#include "sensorconv.h"
 #include "network.h"
 #include "configs.h"
+#include "cfcfilter.h"
+#include "gyrobias.h"
+#include "download.h"
+#include "telemetry.h"
 #include "statemachine.h"
+#include "eventloop.h"
+#include "power.h"
+#include "acquisition.h"
+#include "boot.h"
+
+#ifdef FREERTOS
+#include "rtos.h"
+#endif
 
 /**
  * @brief Default delay between sensor stream readouts in ms
@@ -27,6 +41,55 @@
  */
 static uint32_t default_stream_delay_ms = 0U;
 
+/**
+ * @brief Shortest time between background command steps in app_timer ticks
+ */
+#define JOB_STEP_MIN_TICKS APP_TIMER_MIN_TIMEOUT_TICKS
+
+/**
+ * @brief Background command, a protothread stepped from the main loop by
+ *        a timer running at the stream period
+ *
+ * Long-running commands return to the main loop between steps instead of
+ * blocking it, so sampling, the state machine and BLE keep running. One
+ * runs at a time, until it ends or the stop command is entered.
+ */
+typedef struct
+{
+    pt_t pt;                      /*!< Protothread state */
+    char (*thread)(pt_t* pt);     /*!< Command body, NULL when nothing runs */
+    const char* name;             /*!< Command name */
+    nrf_cli_t const* p_cli;       /*!< CLI the command was entered on */
+    uint32_t period;              /*!< Time between stream readouts in app_timer ticks */
+    uint32_t last;                /*!< app_timer counter at the last readout */
+    uint32_t addr;                /*!< Next flash address, storage test only */
+    uint32_t failures;            /*!< Pages read back wrong, storage test only */
+    bool powered;                 /*!< Sensors held powered up, streams only */
+} shell_job_t;
+
+/**
+ * @brief Running background command
+ */
+static shell_job_t job = {0};
+
+/**
+ * @brief Steps the running background command, the main loop would
+ *        otherwise only get to it when something else wakes it up
+ */
+APP_TIMER_DEF(job_timer);
+
+static void job_step(void);
+
+/**
+ * @brief Runs @ref job_step() in the main loop
+ */
+EVENTLOOP_WORK_DEF(job_work, job_step);
+
+/**
+ * @brief CLI started, nothing to process before
+ */
+static bool started = false;
+
 /**
  * @brief The number of arguments that the datetime_set() command expects:
  *        YYYY, MM, DD, HH, MM, SS, sss
@@ -83,6 +146,15 @@ static void hello_cmd(nrf_cli_t const* p_cli, size_t argc, char** argv)
         "\n");
 }
 
+/**
+ * @notapi
+ * @brief Filter class name, classes that were never configured read as bypass
+ */
+static const char* cfc_string(uint8_t cfc)
+{
+    return cfcfilter_class_strings[(cfc < CFCFILTER_CLASS_MAX) ? cfc : CFCFILTER_BYPASS];
+}
+
 /**
  * @notapi
  * @brief Display device configurations
@@ -106,6 +178,11 @@ static void configs_show_cmd(nrf_cli_t const* p_cli, size_t argc, char** argv)
             "        Gyro Sampling Rate : [ %s ]\n"
             " Low G Accel Sampling Rate : [ %s ]\n"
             "High G Accel Sampling Rate : [ %s ]\n"
+            "       High G Accel Filter : [ %s ]\n"
+            "        Low G Accel Filter : [ %s ]\n"
+            "               Gyro Filter : [ %s ]\n"
+            "                Decimation : [ %d ]\n"
+            "      High G Accel Logging : [ %s ]\n"
             "\n",
             configs_datalog_mode_strings            [ GLOBAL_CONFIGS.device_metadata.current_dev_configs.datalog_mode ],
             configs_trigger_on_strings              [ GLOBAL_CONFIGS.device_metadata.current_dev_configs.trigger_on ],
@@ -116,7 +193,13 @@ static void configs_show_cmd(nrf_cli_t const* p_cli, size_t argc, char** argv)
             GLOBAL_CONFIGS.device_metadata.current_dev_configs.threshold_z,
             configs_gyro_sample_rate_strings        [ GLOBAL_CONFIGS.device_metadata.current_dev_configs.gyro_sampling_rate],
             configs_low_g_accel_sample_rate_strings [ GLOBAL_CONFIGS.device_metadata.current_dev_configs.low_g_sampling_rate ],
-            configs_high_g_accel_sample_rate_strings[ GLOBAL_CONFIGS.device_metadata.current_dev_configs.high_g_sampling_rate ]
+            configs_high_g_accel_sample_rate_strings[ GLOBAL_CONFIGS.device_metadata.current_dev_configs.high_g_sampling_rate ],
+            cfc_string(GLOBAL_CONFIGS.device_metadata.current_dev_configs.high_g_cfc),
+            cfc_string(GLOBAL_CONFIGS.device_metadata.current_dev_configs.low_g_cfc),
+            cfc_string(GLOBAL_CONFIGS.device_metadata.current_dev_configs.gyro_cfc),
+            GLOBAL_CONFIGS.device_metadata.current_dev_configs.decimation,
+            configs_high_g_log_strings[(GLOBAL_CONFIGS.device_metadata.current_dev_configs.high_g_log < CONFIGS_HIGH_G_LOG_MAX) ?
+                GLOBAL_CONFIGS.device_metadata.current_dev_configs.high_g_log : CONFIGS_HIGH_G_LOG_SAMPLES]
         );
     }
     else
@@ -136,6 +219,7 @@ static void datalog_enable_cmd(nrf_cli_t const* p_cli, size_t argc, char** argv)
     ASSERT(p_cli);
     ASSERT(p_cli->p_ctx && p_cli->p_iface && p_cli->p_name);
     GLOBAL_CONFIGS.device_metadata.current_dev_configs.datalog_en = true;
+    statemachine_kick();
 }
 
 /**
@@ -147,6 +231,61 @@ static void datalog_disable_cmd(nrf_cli_t const* p_cli, size_t argc, char** argv
     ASSERT(p_cli);
     ASSERT(p_cli->p_ctx && p_cli->p_iface && p_cli->p_name);
     GLOBAL_CONFIGS.device_metadata.current_dev_configs.datalog_en = false;
+    statemachine_kick();
+}
+
+/**
+ * @notapi
+ * @brief Display progress and throughput of the current or last datalog download
+ */
+static void datalog_download_cmd(nrf_cli_t const* p_cli, size_t argc, char** argv)
+{
+    ASSERT(p_cli);
+    ASSERT(p_cli->p_ctx && p_cli->p_iface && p_cli->p_name);
+
+    download_stats_t stats;
+    download_get_stats(&stats);
+
+    nrf_cli_fprintf(p_cli, NRF_CLI_VT100_COLOR_DEFAULT,
+        "status     : %s\n"
+        "bytes      : %u / %u (%u sent)\n"
+        "packets    : %u sent / %u queued\n"
+        "chunks     : %u acked / %u resent\n"
+        "time       : %u ms\n"
+        "throughput : %u KB/s\n",
+        stats.active ? "downloading" : "idle",
+        stats.queued_bytes, stats.total_bytes, stats.sent_bytes,
+        stats.completed_packets, stats.queued_packets,
+        stats.acked_chunks, stats.resent_packets,
+        stats.elapsed_ms,
+        stats.kbps);
+}
+
+/**
+ * @notapi
+ * @brief Display sampling pipeline counters of the current or last session
+ */
+static void datalog_pipeline_cmd(nrf_cli_t const* p_cli, size_t argc, char** argv)
+{
+    ASSERT(p_cli);
+    ASSERT(p_cli->p_ctx && p_cli->p_iface && p_cli->p_name);
+
+    acquisition_stats_t stats;
+    acquisition_get_stats(&stats);
+
+    nrf_cli_fprintf(p_cli, NRF_CLI_VT100_COLOR_DEFAULT,
+        "samples : %u / %u missed / %u dropped\n"
+        "latency : %u us max / %u us jitter\n"
+        "backlog : %u of %u frames max\n"
+        "batches : %u\n"
+        "storage : %u of %u rows max / %u dropped\n"
+        "stream  : %u of %u samples max / %u dropped\n",
+        stats.samples, stats.missed, stats.dropped,
+        stats.latency_max_us, stats.jitter_us,
+        stats.ring_hwm, ACQUISITION_RING_SIZE,
+        stats.batches,
+        stats.log_hwm, ACQUISITION_QUEUE_SIZE, stats.unlogged,
+        stats.stream_hwm, ACQUISITION_QUEUE_SIZE, stats.unstreamed);
 }
 
 /**
@@ -200,6 +339,17 @@ static void datetime_get_cmd(nrf_cli_t const* p_cli, size_t argc, char** argv)
     }
 }
 
+/**
+ * @notapi
+ * @brief Power up every sensor for a command that reads them, they're
+ *        set back for the current state once the state machine runs
+ */
+static void sensors_power_up(void)
+{
+    (void)power_set_mode(POWER_MODE_ACTIVE);
+    statemachine_kick();
+}
+
 /**
  * @notapi
  * @brief Calibrate ADXL372
@@ -209,6 +359,8 @@ static void adxl372_calibrate_cmd(nrf_cli_t const* p_cli, size_t argc, char** ar
     ASSERT(p_cli);
     ASSERT(p_cli->p_ctx && p_cli->p_iface && p_cli->p_name);
 
+    sensors_power_up();
+
     adxl372_err_t ret = adxl372_calibrate(NULL);
 
     nrf_cli_fprintf(p_cli, NRF_CLI_VT100_COLOR_DEFAULT,
@@ -218,22 +370,251 @@ static void adxl372_calibrate_cmd(nrf_cli_t const* p_cli, size_t argc, char** ar
 
 /**
  * @notapi
- * @brief Continuously print out ADXL372 sensor readings
+ * @brief Calibrate ICM20649
  */
-static void adxl372_stream_cmd(nrf_cli_t const* p_cli, size_t argc, char** argv)
+static void icm20649_calibrate_cmd(nrf_cli_t const* p_cli, size_t argc, char** argv)
 {
     ASSERT(p_cli);
     ASSERT(p_cli->p_ctx && p_cli->p_iface && p_cli->p_name);
 
-    uint8_t rx = 0U;
-    uint8_t ctrl_c = 0x03U;
-    uint32_t delay = default_stream_delay_ms;
+    sensors_power_up();
 
-    /* determine if user specified custom delay */
-    if(argc > 1)
-        delay = (uint32_t)atoi(argv[1]);
+    sysret_t ret = icm20649_calibrate(NULL);
+
+    nrf_cli_fprintf(p_cli, NRF_CLI_VT100_COLOR_DEFAULT,
+        "%s\n",
+        ret == RET_OK ? "ICM20649 sensor calibrated" : "ICM20649 sensor calibration failed");
+}
+
+/**
+ * @notapi
+ * @brief Display ICM20649 gyroscope bias estimate and stillness
+ */
+static void icm20649_gyrobias_cmd(nrf_cli_t const* p_cli, size_t argc, char** argv)
+{
+    ASSERT(p_cli);
+    ASSERT(p_cli->p_ctx && p_cli->p_iface && p_cli->p_name);
+
+    int16_t bias[3];
+    gyrobias_get(bias);
+
+    nrf_cli_fprintf(p_cli, NRF_CLI_VT100_COLOR_DEFAULT,
+        "bias  : [ %d %d %d ] LSB\n"
+        "still : %s\n"
+        "saved : %s\n",
+        bias[0], bias[1], bias[2],
+        gyrobias_is_still() ? "yes" : "no",
+        (GLOBAL_CONFIGS.device_metadata.gyro_bias_header == CONFIGS_FRAME_HEADER) ? "yes" : "no");
+}
+
+/**
+ * @notapi
+ * @brief Print a single accelerometer calibration
+ */
+static void calib_print(nrf_cli_t const* p_cli, const char* name, const sensorconv_cal_t* cal)
+{
+    nrf_cli_fprintf(p_cli, NRF_CLI_VT100_COLOR_DEFAULT,
+        "%s\n"
+        "  bias : [ %d %d %d ] LSB\n"
+        "  Q    : [ %d %d %d ]\n"
+        "         [   %d %d ]\n"
+        "         [     %d ] / %d\n",
+        name,
+        cal->bias[0], cal->bias[1], cal->bias[2],
+        cal->q[SENSORCONV_CAL_Q11], cal->q[SENSORCONV_CAL_Q12], cal->q[SENSORCONV_CAL_Q13],
+        cal->q[SENSORCONV_CAL_Q22], cal->q[SENSORCONV_CAL_Q23],
+        cal->q[SENSORCONV_CAL_Q33], SENSORCONV_CAL_ONE);
+}
+
+/**
+ * @notapi
+ * @brief Display accelerometer calibrations in use and whether they're saved
+ */
+static void calib_show_cmd(nrf_cli_t const* p_cli, size_t argc, char** argv)
+{
+    ASSERT(p_cli);
+    ASSERT(p_cli->p_ctx && p_cli->p_iface && p_cli->p_name);
+
+    sensorconv_cal_t high_g;
+    sensorconv_cal_t low_g;
+
+    adxl372_get_calibration(&high_g);
+    icm20649_get_accel_calibration(&low_g);
+
+    nrf_cli_fprintf(p_cli, NRF_CLI_VT100_COLOR_DEFAULT, "\n");
+    calib_print(p_cli, "ADXL372 (High G)", &high_g);
+    calib_print(p_cli, "ICM20649 (Low G)", &low_g);
+
+    nrf_cli_fprintf(p_cli, NRF_CLI_VT100_COLOR_DEFAULT,
+        "\nSaved calibration : [ %s ]\n\n",
+        configs_calibration_check(&GLOBAL_CONFIGS.device_metadata.calibration) == RET_OK ? "VALID" : "NONE");
+}
+
+/**
+ * @notapi
+ * @brief Save accelerometer calibrations in use to flash
+ */
+static void calib_save_cmd(nrf_cli_t const* p_cli, size_t argc, char** argv)
+{
+    ASSERT(p_cli);
+    ASSERT(p_cli->p_ctx && p_cli->p_iface && p_cli->p_name);
+
+    configs_calibration_t calibration;
+    sensorconv_cal_t high_g;
+    sensorconv_cal_t low_g;
+
+    adxl372_get_calibration(&high_g);
+    icm20649_get_accel_calibration(&low_g);
+
+    calibration.high_g = high_g;
+    calibration.low_g  = low_g;
+    configs_calibration_seal(&calibration);
+
+    GLOBAL_CONFIGS.device_metadata.calibration = calibration;
+    sysret_t ret = configs_save(&GLOBAL_CONFIGS);
+
+    nrf_cli_fprintf(p_cli, NRF_CLI_VT100_COLOR_DEFAULT,
+        "Save calibration : [ %s ]\n", retcodes_desc[ret]);
+}
+
+/**
+ * @notapi
+ * @brief Clear accelerometer calibrations, in use and in flash
+ */
+static void calib_clear_cmd(nrf_cli_t const* p_cli, size_t argc, char** argv)
+{
+    ASSERT(p_cli);
+    ASSERT(p_cli->p_ctx && p_cli->p_iface && p_cli->p_name);
+
+    (void)adxl372_set_calibration(NULL);
+    (void)icm20649_set_accel_calibration(NULL);
+
+    (void)memset(&GLOBAL_CONFIGS.device_metadata.calibration, 0, sizeof(configs_calibration_t));
+    sysret_t ret = configs_save(&GLOBAL_CONFIGS);
 
-    while(rx != ctrl_c)
+    nrf_cli_fprintf(p_cli, NRF_CLI_VT100_COLOR_DEFAULT,
+        "Clear calibration : [ %s ]\n", retcodes_desc[ret]);
+}
+
+/**
+ * @notapi
+ * @brief Start a background command
+ *
+ * @param period_ms - Time between stream readouts in ms
+ * @return true if started, false if another one is running
+ */
+static bool job_start(nrf_cli_t const* p_cli, const char* name, char (*thread)(pt_t* pt), uint32_t period_ms)
+{
+    if(job.thread != NULL)
+    {
+        nrf_cli_fprintf(p_cli, NRF_CLI_VT100_COLOR_DEFAULT,
+            "Busy running %s, enter \"stop\" first\n", job.name);
+        return false;
+    }
+
+    PT_INIT(&job.pt);
+    job.name     = name;
+    job.p_cli    = p_cli;
+    job.period   = (uint32_t)(((uint64_t)period_ms * APP_TIMER_CLOCK_FREQ) / 1000U);
+    job.last     = app_timer_cnt_get();
+    job.addr     = 0U;
+    job.failures = 0U;
+    job.powered  = false;
+
+    if(app_timer_start(job_timer, (job.period > JOB_STEP_MIN_TICKS) ? job.period : JOB_STEP_MIN_TICKS, NULL) != NRF_SUCCESS)
+    {
+        nrf_cli_fprintf(p_cli, NRF_CLI_VT100_COLOR_DEFAULT, "Couldn't start %s\n", name);
+        return false;
+    }
+
+    job.thread   = thread;
+
+    nrf_cli_fprintf(p_cli, NRF_CLI_VT100_COLOR_DEFAULT,
+        "Running %s in the background, enter \"stop\" to stop it\n", name);
+
+    return true;
+}
+
+/**
+ * @notapi
+ * @brief Stop the running background command
+ */
+static void job_end(void)
+{
+    (void)app_timer_stop(job_timer);
+    job.thread = NULL;
+
+    /* sensors go back to what the device's state needs */
+    if(job.powered)
+    {
+        job.powered = false;
+        statemachine_power_hold(false);
+    }
+}
+
+/**
+ * @notapi
+ * @brief Keep the sensors powered up until the background command ends
+ */
+static void job_power_up(void)
+{
+    job.powered = true;
+    statemachine_power_hold(true);
+}
+
+/**
+ * @notapi
+ * @brief Run one step of the background command, run in the main loop
+ */
+static void job_step(void)
+{
+    if(job.thread != NULL && !PT_SCHEDULE(job.thread(&job.pt)))
+        job_end();
+}
+
+/**
+ * @notapi
+ * @brief Signify that it's time to step the background command
+ */
+static void job_timer_handler(void* p_ctx)
+{
+    (void)p_ctx;
+    eventloop_post(&job_work);
+}
+
+/**
+ * @notapi
+ * @brief Check if the next stream readout is due
+ */
+static bool job_period_elapsed(void)
+{
+    uint32_t now = app_timer_cnt_get();
+
+    if(app_timer_cnt_diff_compute(now, job.last) < job.period)
+        return false;
+
+    job.last = now;
+    return true;
+}
+
+/**
+ * @notapi
+ * @brief Stream readout delay, from the command argument or the default
+ */
+static uint32_t stream_delay_ms(size_t argc, char** argv)
+{
+    return (argc > 1) ? (uint32_t)atoi(argv[1]) : default_stream_delay_ms;
+}
+
+/**
+ * @notapi
+ * @brief Print out ADXL372 sensor readings until stopped
+ */
+static PT_THREAD(adxl372_stream_thread(pt_t* pt))
+{
+    PT_BEGIN(pt);
+
+    while(true)
     {
         adxl372_val_raw_t readings[ADXL372_AXES] = {0U};
         datetime_t dt;
@@ -242,40 +623,30 @@ static void adxl372_stream_cmd(nrf_cli_t const* p_cli, size_t argc, char** argv)
         (void)adxl372_read_raw(readings);
 
         /* print datetime */
-        nrf_cli_fprintf(p_cli, NRF_CLI_VT100_COLOR_DEFAULT,
+        nrf_cli_fprintf(job.p_cli, NRF_CLI_VT100_COLOR_DEFAULT,
             "%02d:%02d:%02d.%03d\t",
             dt.hr, dt.min, dt.sec, dt.usec/1000U);
 
         /* print sensor values */
-        nrf_cli_fprintf(p_cli, NRF_CLI_VT100_COLOR_DEFAULT,
+        nrf_cli_fprintf(job.p_cli, NRF_CLI_VT100_COLOR_DEFAULT,
             "%d\t%d\t%d\n",
             readings[ADXL372_X]*100, readings[ADXL372_Y]*100, readings[ADXL372_Z]*100);
 
-        if(delay > 0)
-            nrf_delay_ms(delay);
-
-        nrf_drv_uart_rx(&cli_uart_transport_uart, &rx, 1U);
+        PT_YIELD_UNTIL(pt, job_period_elapsed());
     }
+
+    PT_END(pt);
 }
 
 /**
  * @notapi
- * @brief Continuously print out ICM20649 sensor readings
+ * @brief Print out ICM20649 sensor readings until stopped
  */
-static void icm20649_stream_cmd(nrf_cli_t const* p_cli, size_t argc, char** argv)
+static PT_THREAD(icm20649_stream_thread(pt_t* pt))
 {
-    ASSERT(p_cli);
-    ASSERT(p_cli->p_ctx && p_cli->p_iface && p_cli->p_name);
+    PT_BEGIN(pt);
 
-    uint8_t rx = 0U;
-    uint8_t ctrl_c = 0x03U;
-    uint32_t delay = default_stream_delay_ms;
-
-    /* determine if user specified custom delay */
-    if(argc > 1)
-        delay = (uint32_t)atoi(argv[1]);
-
-    while(rx != ctrl_c)
+    while(true)
     {
         int16_t accel[ICM20649_ACCEL_AXES] = {0};
         int16_t gyro[ICM20649_GYRO_AXES] = {0};
@@ -287,64 +658,176 @@ static void icm20649_stream_cmd(nrf_cli_t const* p_cli, size_t argc, char** argv
         if(dt_ret == RET_OK && sensor_ret == RET_OK)
         {
             /* print datetime */
-            nrf_cli_fprintf(p_cli, NRF_CLI_VT100_COLOR_DEFAULT,
+            nrf_cli_fprintf(job.p_cli, NRF_CLI_VT100_COLOR_DEFAULT,
                 "%02d:%02d:%02d.%03d\t",
                 dt.hr, dt.min, dt.sec, dt.usec/1000U);
 
             /* print sensor values */
-            nrf_cli_fprintf(p_cli, NRF_CLI_VT100_COLOR_DEFAULT,
+            nrf_cli_fprintf(job.p_cli, NRF_CLI_VT100_COLOR_DEFAULT,
                 "%d\t%d\t%d\t%d\t%d\t%d\n",
                 accel[ICM20649_ACCEL_X], accel[ICM20649_ACCEL_Y], accel[ICM20649_ACCEL_Z],
                 gyro[ICM20649_GYRO_X], gyro[ICM20649_GYRO_Y], gyro[ICM20649_GYRO_Z]);
         }
         else
-            nrf_cli_fprintf(p_cli, NRF_CLI_VT100_COLOR_DEFAULT,
+            nrf_cli_fprintf(job.p_cli, NRF_CLI_VT100_COLOR_DEFAULT,
                 "Error : datetime [%s] sensor [%s]\n",
                 retcodes_desc[dt_ret], retcodes_desc[sensor_ret]);
 
-        if(delay > 0)
-            nrf_delay_ms(delay);
-
-        nrf_drv_uart_rx(&cli_uart_transport_uart, &rx, 1U);
+        PT_YIELD_UNTIL(pt, job_period_elapsed());
     }
+
+    PT_END(pt);
 }
 
 /**
  * @notapi
- * @brief Continuously print out ICM20649 sensor readings
+ * @brief Print out VCNL4040 sensor readings until stopped
  */
-static void vcnl4040_stream_cmd(nrf_cli_t const* p_cli, size_t argc, char** argv)
+static PT_THREAD(vcnl4040_stream_thread(pt_t* pt))
 {
-    ASSERT(p_cli);
-    ASSERT(p_cli->p_ctx && p_cli->p_iface && p_cli->p_name);
+    PT_BEGIN(pt);
 
-    uint8_t rx = 0U;
-    uint8_t ctrl_c = 0x03U;
-    uint32_t delay = default_stream_delay_ms;
-
-    /* determine if user specified custom delay */
-    if(argc > 1)
-        delay = (uint32_t)atoi(argv[1]);
-
-    while(rx != ctrl_c)
+    while(true)
     {
-        sysret_t ret;
         vcnl4040_data_t data;
-        ret = vcnl4040_read(&data);
+        sysret_t ret = vcnl4040_read(&data);
 
         if(ret == RET_OK)
         {
-            nrf_cli_fprintf(p_cli, NRF_CLI_VT100_COLOR_DEFAULT,
+            nrf_cli_fprintf(job.p_cli, NRF_CLI_VT100_COLOR_DEFAULT,
                 "%d\n", data);
         }
         else
-            nrf_cli_fprintf(p_cli, NRF_CLI_VT100_COLOR_DEFAULT, "error!\n");
+            nrf_cli_fprintf(job.p_cli, NRF_CLI_VT100_COLOR_DEFAULT, "error!\n");
+
+        PT_YIELD_UNTIL(pt, job_period_elapsed());
+    }
+
+    PT_END(pt);
+}
+
+/**
+ * @notapi
+ * @brief Continuously print out ADXL372 sensor readings
+ */
+static void adxl372_stream_cmd(nrf_cli_t const* p_cli, size_t argc, char** argv)
+{
+    ASSERT(p_cli);
+    ASSERT(p_cli->p_ctx && p_cli->p_iface && p_cli->p_name);
+
+    if(!job_start(p_cli, "adxl372 stream", adxl372_stream_thread, stream_delay_ms(argc, argv)))
+        return;
+
+    job_power_up();
+}
+
+/**
+ * @notapi
+ * @brief Continuously print out ICM20649 sensor readings
+ */
+static void icm20649_stream_cmd(nrf_cli_t const* p_cli, size_t argc, char** argv)
+{
+    ASSERT(p_cli);
+    ASSERT(p_cli->p_ctx && p_cli->p_iface && p_cli->p_name);
+
+    if(!job_start(p_cli, "icm20649 stream", icm20649_stream_thread, stream_delay_ms(argc, argv)))
+        return;
+
+    job_power_up();
+}
+
+/**
+ * @notapi
+ * @brief Continuously print out VCNL4040 sensor readings
+ */
+static void vcnl4040_stream_cmd(nrf_cli_t const* p_cli, size_t argc, char** argv)
+{
+    ASSERT(p_cli);
+    ASSERT(p_cli->p_ctx && p_cli->p_iface && p_cli->p_name);
+
+    if(!job_start(p_cli, "vcnl4040 stream", vcnl4040_stream_thread, stream_delay_ms(argc, argv)))
+        return;
+
+    job_power_up();
+}
+
+/**
+ * @brief Number of frames converted per kernel run in @ref sensorconv_bench_cmd()
+ */
+#define SENSORCONV_BENCH_FRAMES 256U
+
+/**
+ * @notapi
+ * @brief Start counting CPU cycles with the DWT cycle counter
+ */
+static void cycle_counter_start(void)
+{
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CYCCNT = 0U;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+}
 
-        if(delay > 0)
-            nrf_delay_ms(delay);
+/**
+ * @notapi
+ * @brief Benchmark a conversion kernel against its scalar reference on the same input
+ *
+ * @return true if both produce bit-exact output
+ */
+static bool sensorconv_bench(
+    nrf_cli_t const* p_cli,
+    const char* name,
+    void (*kernel)(int16_t*, size_t, const int16_t*),
+    void (*reference)(int16_t*, size_t, const int16_t*),
+    const int16_t offsets[SENSORCONV_AXES])
+{
+    static int16_t simd_buf[SENSORCONV_BENCH_FRAMES * SENSORCONV_AXES] __attribute__((aligned(4)));
+    static int16_t ref_buf[SENSORCONV_BENCH_FRAMES * SENSORCONV_AXES] __attribute__((aligned(4)));
+    static uint32_t lfsr = 0xACE1U;
 
-        nrf_drv_uart_rx(&cli_uart_transport_uart, &rx, 1U);
+    /* fill buffers with the same pseudo-random register data */
+    for(size_t i = 0U ; i < SENSORCONV_BENCH_FRAMES * SENSORCONV_AXES ; i++)
+    {
+        lfsr = lfsr * 1664525U + 1013904223U;
+        simd_buf[i] = ref_buf[i] = (int16_t)(lfsr >> 16U);
     }
+
+    cycle_counter_start();
+    reference(ref_buf, SENSORCONV_BENCH_FRAMES, offsets);
+    uint32_t ref_cycles = DWT->CYCCNT;
+
+    cycle_counter_start();
+    kernel(simd_buf, SENSORCONV_BENCH_FRAMES, offsets);
+    uint32_t simd_cycles = DWT->CYCCNT;
+
+    bool exact = (memcmp(simd_buf, ref_buf, sizeof(simd_buf)) == 0);
+
+    /* speedup in hundredths, a kernel too quick to count has none */
+    uint32_t speedup = (simd_cycles > 0U) ? (uint32_t)(((uint64_t)ref_cycles * 100U) / simd_cycles) : 0U;
+
+    nrf_cli_fprintf(p_cli, NRF_CLI_VT100_COLOR_DEFAULT,
+        "%s : reference [%u cycles] | SIMD [%u cycles] | speedup [x%u.%02u] | %s\n",
+        name, ref_cycles, simd_cycles, speedup / 100U, speedup % 100U,
+        exact ? "BIT-EXACT" : "MISMATCH");
+
+    return exact;
+}
+
+/**
+ * @notapi
+ * @brief Benchmark sensor frame conversion kernels, verify they match the scalar reference
+ */
+static void sensorconv_bench_cmd(nrf_cli_t const* p_cli, size_t argc, char** argv)
+{
+    ASSERT(p_cli);
+    ASSERT(p_cli->p_ctx && p_cli->p_iface && p_cli->p_name);
+
+    const int16_t offsets[SENSORCONV_AXES] = {-3, 7, 10};
+
+    nrf_cli_fprintf(p_cli, NRF_CLI_VT100_COLOR_DEFAULT,
+        "\nConverting %u frames per kernel...\n", SENSORCONV_BENCH_FRAMES);
+
+    (void)sensorconv_bench(p_cli, "ADXL372 ", sensorconv_adxl372, sensorconv_adxl372_ref, offsets);
+    (void)sensorconv_bench(p_cli, "ICM20649", sensorconv_icm20649, sensorconv_icm20649_ref, offsets);
 }
 
 /**
@@ -361,6 +844,68 @@ static void storage_erase_cmd(nrf_cli_t const* p_cli, size_t argc, char** argv)
     nrf_cli_fprintf(p_cli, NRF_CLI_VT100_COLOR_DEFAULT, "Storage erase status - [%s]\n", retcodes_desc[ret]);
 }
 
+/**
+ * @brief Value the storage test writes to every page
+ */
+#define STORAGE_PP_TEST_VALUE 0xDEADBEEFU
+
+/**
+ * @notapi
+ * @brief Storage test, one page per step, stops if the device leaves idle
+ *        since datalogging writes to the same flash
+ */
+static PT_THREAD(storage_pp_test_thread(pt_t* pt))
+{
+    PT_BEGIN(pt);
+
+    for( ; job.addr < FLASH_CAPACITY ; job.addr += FLASH_PAGE_SIZE)
+    {
+        uint32_t tx = STORAGE_PP_TEST_VALUE;
+        uint32_t rx = 0U;
+        sysret_t ret;
+
+        if(statemachine_getstate() != STATE_IDLE)
+        {
+            nrf_cli_fprintf(job.p_cli, NRF_CLI_VT100_COLOR_DEFAULT,
+                "Device no longer idle, storage test stopped at page %d\n", job.addr/FLASH_PAGE_SIZE);
+            PT_EXIT(pt);
+        }
+
+        nrf_cli_fprintf(job.p_cli, NRF_CLI_VT100_COLOR_DEFAULT, "Page %d | Addr 0x%08X : ", job.addr/FLASH_PAGE_SIZE, job.addr);
+
+        ret = mt25q_page_program(job.addr, (uint8_t*)&tx, sizeof(tx));
+        if(ret != RET_OK)
+        {
+            nrf_cli_fprintf(job.p_cli, NRF_CLI_VT100_COLOR_DEFAULT, "Write error... - [%s]\n", retcodes_desc[ret]);
+            PT_EXIT(pt);
+        }
+
+        ret = mt25q_read(job.addr, (uint8_t*)&rx, sizeof(rx));
+        if(ret != RET_OK)
+        {
+            nrf_cli_fprintf(job.p_cli, NRF_CLI_VT100_COLOR_DEFAULT, "Read error... - [%s]\n", retcodes_desc[ret]);
+            PT_EXIT(pt);
+        }
+
+        nrf_cli_fprintf(job.p_cli, NRF_CLI_VT100_COLOR_DEFAULT, "Write [0x%08X] | Read [0x%08X] ", STORAGE_PP_TEST_VALUE, rx);
+
+        if(rx != STORAGE_PP_TEST_VALUE)
+        {
+            nrf_cli_fprintf(job.p_cli, NRF_CLI_VT100_COLOR_DEFAULT, "- WRITE/READ FAILED");
+            job.failures++;
+        }
+
+        nrf_cli_fprintf(job.p_cli, NRF_CLI_VT100_COLOR_DEFAULT, "\n");
+
+        PT_YIELD(pt);
+    }
+
+    nrf_cli_fprintf(job.p_cli, NRF_CLI_VT100_COLOR_DEFAULT,
+        "Storage PAGE PROGRAM test done - [%d] pages failed\n", job.failures);
+
+    PT_END(pt);
+}
+
 /**
  * @notapi
  * @brief Storage test - write to every page in external flash storage, read back and verify written value 
@@ -370,48 +915,278 @@ static void storage_pp_test_cmd(nrf_cli_t const* p_cli, size_t argc, char** argv
     ASSERT(p_cli);
     ASSERT(p_cli->p_ctx && p_cli->p_iface && p_cli->p_name);
 
-    uint32_t expected = 0xDEADBEEFU; /* write this to every page in flash */
+    if(statemachine_getstate() != STATE_IDLE)
+    {
+        nrf_cli_fprintf(p_cli, NRF_CLI_VT100_COLOR_DEFAULT,
+            "Storage is in use, the test only runs while the device is idle\n");
+        return;
+    }
 
-    sysret_t ret;
+    if(!job_start(p_cli, "storage pp_test", storage_pp_test_thread, 0U))
+        return;
 
     nrf_cli_fprintf(p_cli, NRF_CLI_VT100_COLOR_DEFAULT,
         "\n"
         "Storage PAGE PROGRAM test\n"
         "- Write 0x%08X to every page in external flash storage...\n"
-        "\n", expected);
+        "\n", STORAGE_PP_TEST_VALUE);
+}
+
+/**
+ * @notapi
+ * @brief Stop the running background command
+ */
+static void stop_cmd(nrf_cli_t const* p_cli, size_t argc, char** argv)
+{
+    ASSERT(p_cli);
+    ASSERT(p_cli->p_ctx && p_cli->p_iface && p_cli->p_name);
 
-    for(size_t i = 0U ; i < FLASH_CAPACITY ; i += FLASH_PAGE_SIZE)
+    if(job.thread == NULL)
     {
-        uint32_t tx = expected;
-        uint32_t rx = 0U;
+        nrf_cli_fprintf(p_cli, NRF_CLI_VT100_COLOR_DEFAULT, "Nothing running\n");
+        return;
+    }
 
-        nrf_cli_fprintf(p_cli, NRF_CLI_VT100_COLOR_DEFAULT, "Page %d | Addr 0x%08X : ", i/FLASH_PAGE_SIZE, i);
+    job_end();
+    nrf_cli_fprintf(p_cli, NRF_CLI_VT100_COLOR_DEFAULT, "Stopped %s\n", job.name);
+}
 
-        ret = mt25q_page_program(i, (uint8_t*)&tx, sizeof(tx));
-        if(ret != RET_OK)
-        {
-            nrf_cli_fprintf(p_cli, NRF_CLI_VT100_COLOR_DEFAULT, "Write error... - [%s]\n", retcodes_desc[ret]);
-            break;
-        }
+/**
+ * @notapi
+ * @brief Display how long after reset each boot stage was reached
+ */
+static void boot_cmd(nrf_cli_t const* p_cli, size_t argc, char** argv)
+{
+    ASSERT(p_cli);
+    ASSERT(p_cli->p_ctx && p_cli->p_iface && p_cli->p_name);
 
-        ret = mt25q_read(i, (uint8_t*)&rx, sizeof(rx));
-        if(ret != RET_OK)
-        {
-            nrf_cli_fprintf(p_cli, NRF_CLI_VT100_COLOR_DEFAULT, "Read error... - [%s]\n", retcodes_desc[ret]);
-            break;
-        }
+    static const char* mark_strings[BOOT_MARKS] =
+    {
+        [BOOT_MARK_CAPTURE_READY] = "Capture ready",
+        [BOOT_MARK_FIRST_SAMPLE]  = " First sample",
+        [BOOT_MARK_LINK_READY]    = "   Link ready",
+        [BOOT_MARK_FIRST_ROW]     = "    First row"
+    };
+
+    nrf_cli_fprintf(p_cli, NRF_CLI_VT100_COLOR_DEFAULT, "\n");
+
+    for(size_t mark = 0U ; mark < BOOT_MARKS ; mark++)
+    {
+        uint32_t ms;
+
+        if(boot_elapsed_ms((boot_mark_t)mark, &ms))
+            nrf_cli_fprintf(p_cli, NRF_CLI_VT100_COLOR_DEFAULT, "%s : [ %d ms ]\n", mark_strings[mark], ms);
+        else
+            nrf_cli_fprintf(p_cli, NRF_CLI_VT100_COLOR_DEFAULT, "%s : [ not yet ]\n", mark_strings[mark]);
+    }
+
+    nrf_cli_fprintf(p_cli, NRF_CLI_VT100_COLOR_DEFAULT, "\n");
+}
+
+/**
+ * @notapi
+ * @brief Name of a BLE PHY
+ */
+static const char* phy_string(uint8_t phy)
+{
+    switch(phy)
+    {
+        case BLE_GAP_PHY_1MBPS:   return "1M";
+        case BLE_GAP_PHY_2MBPS:   return "2M";
+        case BLE_GAP_PHY_CODED:   return "Coded";
+        default:                  return "?";
+    }
+}
+
+/**
+ * @notapi
+ * @brief Display negotiated parameters of the current BLE connection
+ */
+static void ble_link_cmd(nrf_cli_t const* p_cli, size_t argc, char** argv)
+{
+    ASSERT(p_cli);
+    ASSERT(p_cli->p_ctx && p_cli->p_iface && p_cli->p_name);
+
+    network_link_info_t info;
+    network_get_link_info(&info);
+
+    if(!info.connected)
+    {
+        nrf_cli_fprintf(p_cli, NRF_CLI_VT100_COLOR_DEFAULT, "Not connected\n");
+        return;
+    }
+
+    nrf_cli_fprintf(p_cli, NRF_CLI_VT100_COLOR_DEFAULT,
+        "ATT_MTU       : %d bytes\n"
+        "Data length   : %d bytes\n"
+        "PHY           : TX %s | RX %s\n"
+        "Interval      : %d.%02d ms\n"
+        "Slave latency : %d\n"
+        "Sup. timeout  : %d ms\n"
+        "Evt extension : %s\n"
+        "Profile       : %s\n",
+        info.att_mtu,
+        info.data_length,
+        phy_string(info.tx_phy), phy_string(info.rx_phy),
+        (info.conn_interval * 125U) / 100U, (info.conn_interval * 125U) % 100U,
+        info.slave_latency,
+        info.conn_sup_timeout * 10U,
+        info.conn_evt_ext ? "on" : "off",
+        (info.conn_profile == NETWORK_CONN_PROFILE_BULK) ? "bulk" : "idle");
+}
 
-        nrf_cli_fprintf(p_cli, NRF_CLI_VT100_COLOR_DEFAULT, "Write [0x%08X] | Read [0x%08X] ", expected, rx);
+/**
+ * @notapi
+ * @brief Set live telemetry mode and rate, and display stream counters
+ *
+ * Usage: ble telemetry [off|samples|peaks] [rate_hz]
+ */
+static void ble_telemetry_cmd(nrf_cli_t const* p_cli, size_t argc, char** argv)
+{
+    ASSERT(p_cli);
+    ASSERT(p_cli->p_ctx && p_cli->p_iface && p_cli->p_name);
 
-        if(expected != rx)
+    const char* mode_strings[TELEMETRY_MODES_NUM] = { "off", "samples", "peaks" };
+
+    if(nrf_cli_help_requested(p_cli))
+    {
+        nrf_cli_help_print(p_cli, NULL, 0);
+        return;
+    }
+
+    if(argc > 1)
+    {
+        size_t mode = 0U;
+        uint16_t rate_hz = (argc > 2) ? (uint16_t)atoi(argv[2]) : 0U;
+
+        while(mode < TELEMETRY_MODES_NUM && strcmp(argv[1], mode_strings[mode]) != 0)
+            mode++;
+
+        if(telemetry_configure((telemetry_mode_t)mode, rate_hz) != RET_OK)
         {
-            nrf_cli_fprintf(p_cli, NRF_CLI_VT100_COLOR_DEFAULT, "- WRITE/READ FAILED");
+            nrf_cli_fprintf(p_cli, NRF_CLI_VT100_COLOR_RED, "Unknown mode %s\n", argv[1]);
+            return;
         }
+    }
+
+    telemetry_stats_t stats;
+    telemetry_get_stats(&stats);
+
+    nrf_cli_fprintf(p_cli, NRF_CLI_VT100_COLOR_DEFAULT,
+        "mode       : %s\n"
+        "subscribed : %s\n"
+        "interval   : %u samples\n"
+        "packets    : %u sent / %u dropped\n",
+        mode_strings[stats.mode],
+        network_telemetry_subscribed() ? "yes" : "no",
+        stats.interval,
+        stats.sent_packets, stats.dropped_packets);
+}
+
+/**
+ * @notapi
+ * @brief Display wake-to-work latency and sleep residency of the main loop
+ */
+static void eventloop_stats_cmd(nrf_cli_t const* p_cli, size_t argc, char** argv)
+{
+    ASSERT(p_cli);
+    ASSERT(p_cli->p_ctx && p_cli->p_iface && p_cli->p_name);
+
+    eventloop_stats_t stats;
+    eventloop_get_stats(&stats);
+
+    uint32_t asleep_pct = (stats.elapsed_ms > 0U) ?
+        (uint32_t)(((uint64_t)stats.asleep_ms * 100U) / stats.elapsed_ms) : 0U;
+
+    nrf_cli_fprintf(p_cli, NRF_CLI_VT100_COLOR_DEFAULT,
+        "events      : %u run / %u dropped\n"
+        "latency     : %u us avg / %u us max\n"
+        "wakeups     : %u\n"
+        "asleep      : %u ms of %u ms (%u%%)\n",
+        stats.events, stats.dropped,
+        stats.latency_avg_us, stats.latency_max_us,
+        stats.wakeups,
+        stats.asleep_ms, stats.elapsed_ms, asleep_pct);
+}
+
+/**
+ * @notapi
+ * @brief Reset main loop statistics
+ */
+static void eventloop_reset_cmd(nrf_cli_t const* p_cli, size_t argc, char** argv)
+{
+    ASSERT(p_cli);
+    ASSERT(p_cli->p_ctx && p_cli->p_iface && p_cli->p_name);
+
+    eventloop_reset_stats();
+}
+
+#ifdef FREERTOS
 
-        nrf_cli_fprintf(p_cli, NRF_CLI_VT100_COLOR_DEFAULT, "\n");
+/**
+ * @notapi
+ * @brief Display the stack each task has never used
+ */
+static void eventloop_tasks_cmd(nrf_cli_t const* p_cli, size_t argc, char** argv)
+{
+    ASSERT(p_cli);
+    ASSERT(p_cli->p_ctx && p_cli->p_iface && p_cli->p_name);
+
+    static const char* names[RTOS_TASKS] = { "system", "acquisition", "storage", "network", "shell" };
+
+    for(size_t task = 0U ; task < RTOS_TASKS ; task++)
+    {
+        nrf_cli_fprintf(p_cli, NRF_CLI_VT100_COLOR_DEFAULT,
+            "%-12s: %u bytes of stack free\n", names[task], rtos_stack_free((rtos_task_t)task));
     }
 }
 
+#endif /* FREERTOS */
+
+/**
+ * @notapi
+ * @brief Display time spent in each power mode and predicted battery life
+ */
+static void power_stats_cmd(nrf_cli_t const* p_cli, size_t argc, char** argv)
+{
+    ASSERT(p_cli);
+    ASSERT(p_cli->p_ctx && p_cli->p_iface && p_cli->p_name);
+
+    power_stats_t stats;
+    power_get_stats(&stats);
+
+    nrf_cli_fprintf(p_cli, NRF_CLI_VT100_COLOR_DEFAULT,
+        "mode         : %s\n", power_mode_strings[stats.mode]);
+
+    for(size_t mode = 0U ; mode < POWER_MODES ; mode++)
+    {
+        uint32_t pct = (stats.elapsed_s > 0U) ?
+            (uint32_t)(((uint64_t)stats.residency_s[mode] * 100U) / stats.elapsed_s) : 0U;
+
+        nrf_cli_fprintf(p_cli, NRF_CLI_VT100_COLOR_DEFAULT,
+            "  %-10s : %u s (%u%%)\n",
+            power_mode_strings[mode], stats.residency_s[mode], pct);
+    }
+
+    nrf_cli_fprintf(p_cli, NRF_CLI_VT100_COLOR_DEFAULT,
+        "avg current  : %u uA\n"
+        "battery life : %u days (%u mAh)\n",
+        stats.avg_current_ua,
+        stats.battery_life_h / 24U, POWER_BATTERY_CAPACITY_MAH);
+}
+
+/**
+ * @notapi
+ * @brief Reset power mode residency
+ */
+static void power_reset_cmd(nrf_cli_t const* p_cli, size_t argc, char** argv)
+{
+    ASSERT(p_cli);
+    ASSERT(p_cli->p_ctx && p_cli->p_iface && p_cli->p_name);
+
+    power_reset_stats();
+}
+
 /**
  * @notapi
  * @brief Print out status of system peripherals
@@ -450,6 +1225,30 @@ static void sysprop_cmd(nrf_cli_t const* p_cli, size_t argc, char** argv)
  * Register the systest subcommands, pair them to their command names using NRF5's API
  ***************************************************************************************/
 
+NRF_CLI_CREATE_STATIC_SUBCMD_SET(ble_subcmds)
+{
+    NRF_CLI_CMD(link, NULL, "Display negotiated connection parameters", ble_link_cmd),
+    NRF_CLI_CMD(telemetry, NULL, "Set live telemetry [off|samples|peaks] [rate_hz]", ble_telemetry_cmd),
+    NRF_CLI_SUBCMD_SET_END
+};
+
+NRF_CLI_CREATE_STATIC_SUBCMD_SET(eventloop_subcmds)
+{
+    NRF_CLI_CMD(reset, NULL, "Reset main loop statistics", eventloop_reset_cmd),
+    NRF_CLI_CMD(stats, NULL, "Display wake-to-work latency and time asleep", eventloop_stats_cmd),
+#ifdef FREERTOS
+    NRF_CLI_CMD(tasks, NULL, "Display the stack each task has never used", eventloop_tasks_cmd),
+#endif
+    NRF_CLI_SUBCMD_SET_END
+};
+
+NRF_CLI_CREATE_STATIC_SUBCMD_SET(power_subcmds)
+{
+    NRF_CLI_CMD(reset, NULL, "Reset power mode residency", power_reset_cmd),
+    NRF_CLI_CMD(stats, NULL, "Display power mode residency and predicted battery life", power_stats_cmd),
+    NRF_CLI_SUBCMD_SET_END
+};
+
 NRF_CLI_CREATE_STATIC_SUBCMD_SET(configs_subcmds)
 {
     NRF_CLI_CMD(show, NULL, "Display device configurations", configs_show_cmd),
@@ -459,7 +1258,9 @@ NRF_CLI_CREATE_STATIC_SUBCMD_SET(configs_subcmds)
 NRF_CLI_CREATE_STATIC_SUBCMD_SET(datalog_subcmds)
 {
     NRF_CLI_CMD(disable, NULL, "Disable datalogging", datalog_disable_cmd),
+    NRF_CLI_CMD(download, NULL, "Display datalog download progress and throughput", datalog_download_cmd),
     NRF_CLI_CMD(enable, NULL, "Enable datalogging", datalog_enable_cmd),
+    NRF_CLI_CMD(pipeline, NULL, "Display sampling pipeline counters, jitter and stage backlogs", datalog_pipeline_cmd),
     NRF_CLI_SUBCMD_SET_END
 };
 
@@ -484,7 +1285,8 @@ NRF_CLI_CREATE_STATIC_SUBCMD_SET(adxl372_subcmds)
 
 NRF_CLI_CREATE_STATIC_SUBCMD_SET(icm20649_subcmds)
 {
-    NRF_CLI_CMD(calibrate, NULL, "Calibrate ICM20649 sensor", NULL),
+    NRF_CLI_CMD(calibrate, NULL, "Calibrate ICM20649 sensor", icm20649_calibrate_cmd),
+    NRF_CLI_CMD(gyrobias, NULL, "Display online gyroscope bias estimate", icm20649_gyrobias_cmd),
     NRF_CLI_CMD(stream, NULL, "Stream sensor data from ICM20649 sensor", icm20649_stream_cmd),
     NRF_CLI_SUBCMD_SET_END
 };
@@ -495,11 +1297,21 @@ NRF_CLI_CREATE_STATIC_SUBCMD_SET(vcnl4040_subcmds)
     NRF_CLI_SUBCMD_SET_END
 };
 
+NRF_CLI_CREATE_STATIC_SUBCMD_SET(calib_subcmds)
+{
+    NRF_CLI_CMD(clear, NULL, "Clear accelerometer calibrations", calib_clear_cmd),
+    NRF_CLI_CMD(save, NULL, "Save accelerometer calibrations in use to flash", calib_save_cmd),
+    NRF_CLI_CMD(show, NULL, "Display accelerometer calibrations", calib_show_cmd),
+    NRF_CLI_SUBCMD_SET_END
+};
+
 NRF_CLI_CREATE_STATIC_SUBCMD_SET(sensor_subcmds)
 {
     NRF_CLI_CMD(adxl372, &adxl372_subcmds, "ADXL372 subcommands", NULL),
     NRF_CLI_CMD(icm20649, &icm20649_subcmds, "ICM20649 subcommands", NULL),
     NRF_CLI_CMD(vcnl4040, &vcnl4040_subcmds, "VCNL4040 subcommands", NULL),
+    NRF_CLI_CMD(calib, &calib_subcmds, "Accelerometer calibration subcommands", NULL),
+    NRF_CLI_CMD(convbench, NULL, "Benchmark SIMD frame conversion against scalar reference", sensorconv_bench_cmd),
     NRF_CLI_SUBCMD_SET_END
 };
 
@@ -515,10 +1327,15 @@ NRF_CLI_CREATE_STATIC_SUBCMD_SET(storage_subcmds)
  ***************************************************************************************/
 
 NRF_CLI_CMD_REGISTER(hello, NULL, "Test shell interface", hello_cmd);
+NRF_CLI_CMD_REGISTER(ble, &ble_subcmds, "BLE connection information", NULL);
+NRF_CLI_CMD_REGISTER(boot, NULL, "Time from reset to capture, first sample and BLE", boot_cmd);
 NRF_CLI_CMD_REGISTER(configs, &configs_subcmds, "Configurations commands", NULL);
 NRF_CLI_CMD_REGISTER(datalog, &datalog_subcmds, "Enable/Disable datalogging", NULL);
+NRF_CLI_CMD_REGISTER(eventloop, &eventloop_subcmds, "Main loop latency and sleep statistics", NULL);
 NRF_CLI_CMD_REGISTER(datetime, &datetime_subcmds, "Datetime API for setting and getting datetime", NULL);
+NRF_CLI_CMD_REGISTER(power, &power_subcmds, "Power modes and battery life", NULL);
 NRF_CLI_CMD_REGISTER(sensor, &sensor_subcmds, "Sensor values and configurations", NULL);
+NRF_CLI_CMD_REGISTER(stop, NULL, "Stop the running stream or storage test", stop_cmd);
 NRF_CLI_CMD_REGISTER(storage, &storage_subcmds, "Storage properties and testing", NULL);
 NRF_CLI_CMD_REGISTER(sysprop, NULL, "Display status of system peripherals", sysprop_cmd);
 
@@ -526,8 +1343,6 @@ NRF_CLI_CMD_REGISTER(sysprop, NULL, "Display status of system peripherals", sysp
  * Start of API
  ******************/
 
-#include "nrf_log.h"
-
 /**
  * @brief Initialize she CLI for user inputs
  * @return sysret_t - Module status
@@ -536,7 +1351,9 @@ sysret_t shell_init(void)
 {
     sysret_t ret;
 
-    NRF_LOG_INIT(NULL);
+    /* background commands are stepped by their own timer */
+    ret = app_timer_create(&job_timer, APP_TIMER_MODE_REPEATED, job_timer_handler);
+    SYSRET_CHECK(ret);
 
     /**
      * Configure the UART peripheral
@@ -570,6 +1387,8 @@ sysret_t shell_init(void)
     ret = nrf_cli_start(&cli_uart);
     SYSRET_CHECK(ret);
 
+    started = true;
+
     return RET_OK;
 }
 
@@ -578,6 +1397,10 @@ sysret_t shell_init(void)
  */
 void shell_process(void)
 {
+    /* the shell comes up after the capture stage, see boot.h */
+    if(!started)
+        return;
+
     nrf_cli_process(&cli_rtt);
     nrf_cli_process(&cli_uart);
     network_cli_process();
@@ -7,4 +7,22 @@ $(SRC_PATH)/retcodes.c \
 $(SRC_PATH)/network.c  \
 $(SRC_PATH)/statemachine.c \
 $(SRC_PATH)/configs.c \
-$(SRC_PATH)/datalog.c
\ No newline at end of file
+$(SRC_PATH)/datalog.c \
+$(SRC_PATH)/sensorconv.c \
+$(SRC_PATH)/cfcfilter.c \
+$(SRC_PATH)/acquisition.c \
+$(SRC_PATH)/gyrobias.c \
+$(SRC_PATH)/download.c \
+$(SRC_PATH)/telemetry.c \
+$(SRC_PATH)/lzss.c \
+$(SRC_PATH)/command.c \
+$(SRC_PATH)/eventloop.c \
+$(SRC_PATH)/power.c \
+$(SRC_PATH)/trigger.c \
+$(SRC_PATH)/wear.c \
+$(SRC_PATH)/sampleclock.c \
+$(SRC_PATH)/boot.c
+
+# only built by the FreeRTOS build, make RTOS=1
+PROJ_RTOS_SRCS = \
+$(SRC_PATH)/rtos.c
@@ -4,16 +4,29 @@
  * @brief State machine to define device behaviour
  */
 
+#include <string.h>
 #include "nrf_delay.h"
 #include "statemachine.h"
 #include "datetime.h"
 #include "network.h"
 #include "configs.h"
 #include "datalog.h"
+#include "acquisition.h"
+#include "gyrobias.h"
+#include "download.h"
+#include "telemetry.h"
+#include "command.h"
+#include "eventloop.h"
+#include "power.h"
+#include "trigger.h"
+#include "wear.h"
 #include "mt25q.h"
+#include "sampleclock.h"
+#include "boot.h"
 #include "adxl372.h"
 #include "icm20649.h"
 #include "app_timer.h"
+#include "app_util_platform.h"
 #include "nrf_log.h"
 
 /**
@@ -26,7 +39,16 @@ typedef enum
     REQ_SET_DATETIME,
     REQ_START_DATALOG,
     REQ_STOP_DATALOG,
-    REQ_LOG_DOWNLOAD
+    REQ_LOG_DOWNLOAD,         /*!< Downloads may end with a u8 of DOWNLOAD_REQUEST_* flags */
+    REQ_SET_CALIBRATION,
+    REQ_LOG_DOWNLOAD_RANGE,   /*!< u32 offset, u32 length (0 = to end) in bytes */
+    REQ_LOG_DOWNLOAD_BLOCKS,  /*!< u32 first block, u32 count (0 = to end) in DOWNLOAD_BLOCK_SIZE blocks */
+    REQ_LOG_DOWNLOAD_SESSION, /*!< u8 session index */
+    REQ_LOG_DOWNLOAD_RECORDS, /*!< u8 session index, u32 first row, u32 count (0 = to end) */
+    REQ_LOG_DOWNLOAD_ACK,     /*!< u16 next chunk expected, u64 bitmap of chunks received after it */
+    REQ_SET_TELEMETRY,        /*!< u8 telemetry_mode_t, u16 records per second (0 = default) */
+    REQ_BATCH,                /*!< u8 version, then TLVs, see command.h */
+    REQ_LOG_ERASE             /*!< no arguments, refused until the whole datalog has been downloaded */
 } requests_t;
 
 /**
@@ -35,33 +57,472 @@ typedef enum
 static statemachine_t state_machine =
 {
     .log_download_requested = false,
+    .log_erase_requested = false,
     .state = STATE_UNINIT
 };
 
+/**
+ * @brief Part of the datalog requested by the app, served once IDLE
+ */
+static download_request_t download_request;
+
+/**
+ * @brief Requests that save to flash, checked in the BLE event handler and
+ *        applied in @ref statemachine_process(). BLE events may be
+ *        dispatched from an interrupt, which mustn't touch flash while the
+ *        main loop is programming it.
+ */
+static struct
+{
+    volatile bool         batch_pending;       /*!< batch is waiting to be applied */
+    command_batch_t       batch;               /*!< Checked batch */
+    volatile bool         calibration_pending; /*!< calibration is waiting to be saved */
+    configs_calibration_t calibration;         /*!< Checked calibration */
+} deferred;
+
+/**
+ * @brief Runs @ref statemachine_process() in the main loop
+ */
+EVENTLOOP_WORK_DEF(statemachine_work, statemachine_process);
+
+/**************************************
+ * Variables and configurations related
+ * to the datalog sampling clock
+ **************************************/
+
+/**
+ * @notapi
+ * @brief Sample the sensors on every sampling clock tick, the frame is
+ *        handed on once it's ready
+ */
+static void datalog_tick_handler(void)
+{
+    acquisition_trigger();
+}
+
 /**************************************
  * Variables and configurations related
- * to the datalog timer
+ * to impact triggered datalogging
  **************************************/
 
 /**
- * @brief datalog timer handle
+ * @brief Time logged at full rate after an impact in trigger mode
+ */
+#define TRIGGER_CAPTURE_MS 2000U
+
+/**
+ * @brief Impact capture timer handle
  */
-APP_TIMER_DEF(datalog_timer);
+APP_TIMER_DEF(capture_timer);
 
 /**
- * @brief Set by @ref datalog_timer_handler() on timer alarm
+ * @brief Set by @ref capture_timer_handler() once an impact has been captured
  */
-static volatile bool its_time_to_log_data = false;
+static volatile bool capture_done = false;
 
 /**
  * @notapi
- * @brief Signify to state machine that it's time for another
- *        round of datalogging
+ * @brief Signify to state machine that the impact capture is over
  */
-static void datalog_timer_handler(void* p_ctx)
+static void capture_timer_handler(void* p_ctx)
 {
     (void)p_ctx;
-    its_time_to_log_data = true;
+    capture_done = true;
+    statemachine_kick();
+}
+
+/**************************************
+ * Variables and configurations related
+ * to the advertised device status
+ **************************************/
+
+/**
+ * @brief Period of device status updates in the scan response
+ */
+#define ADV_STATUS_PERIOD_MS 10000U
+
+/**
+ * @brief Device status timer handle
+ */
+APP_TIMER_DEF(adv_status_timer);
+
+/**
+ * @brief Set by @ref adv_status_timer_handler() on timer alarm
+ */
+static volatile bool its_time_to_update_status = false;
+
+/**
+ * @brief Set if rows failed to be logged in the current session
+ */
+static bool datalog_error = false;
+
+/**
+ * @brief Set while sensors are kept powered up for a shell command
+ */
+static bool power_held = false;
+
+/**
+ * @brief Set if the helmet was on when the device reset while logging, the
+ *        resumed session doesn't wait for the first proximity reading
+ */
+static bool wear_resumed = false;
+
+/**************************************
+ * Variables and configurations related
+ * to low power mode
+ **************************************/
+
+/**
+ * @brief Time spent IDLE without a connection before going to LOW_POWER,
+ *        in device status periods
+ */
+#define LOW_POWER_IDLE_PERIODS ((5U * 60U * 1000U) / ADV_STATUS_PERIOD_MS)
+
+/**
+ * @brief Device status periods spent IDLE without a connection
+ */
+static uint32_t idle_periods = 0U;
+
+/**
+ * @notapi
+ * @brief Signify to state machine that the advertised device status
+ *        is due for an update
+ */
+static void adv_status_timer_handler(void* p_ctx)
+{
+    (void)p_ctx;
+    its_time_to_update_status = true;
+    statemachine_kick();
+}
+
+/**************************************
+ * Helper functions
+ **************************************/
+
+/**
+ * @notapi
+ * @brief Load accelerometer calibrations from device metadata into the drivers
+ *
+ * @return sysret_t Module status
+ * @retval NRF_ERROR_INVALID_DATA if no valid calibration is stored, drivers
+ *         are left uncalibrated
+ */
+static sysret_t apply_calibration(void)
+{
+    configs_calibration_t* calibration = &GLOBAL_CONFIGS.device_metadata.calibration;
+    sysret_t ret = configs_calibration_check(calibration);
+
+    if(ret == RET_OK)
+    {
+        sensorconv_cal_t high_g = calibration->high_g;
+        sensorconv_cal_t low_g  = calibration->low_g;
+
+        (void)adxl372_set_calibration(&high_g);
+        (void)icm20649_set_accel_calibration(&low_g);
+    }
+    else
+    {
+        (void)adxl372_set_calibration(NULL);
+        (void)icm20649_set_accel_calibration(NULL);
+    }
+
+    return ret;
+}
+
+/**
+ * @notapi
+ * @brief Read a little-endian 32-bit field from a request
+ */
+static uint32_t request_u32(const uint8_t* data)
+{
+    uint32_t val;
+    (void)memcpy(&val, data, sizeof(val));
+    return val;
+}
+
+/**
+ * @notapi
+ * @brief Check size of a download request, which may end with a byte
+ *        of DOWNLOAD_REQUEST_* flags
+ *
+ * @param data     - Request bytes
+ * @param size     - Request size
+ * @param expected - Request size without flags
+ * @param flags    - Flags will be saved here, 0 if there are none
+ * @return true if the size is valid
+ */
+static bool download_request_flags(const uint8_t* data, size_t size, size_t expected, uint8_t* flags)
+{
+    *flags = (size == expected + 1U) ? data[expected] : 0U;
+
+    return (size == expected || size == expected + 1U);
+}
+
+/**
+ * @notapi
+ * @brief Apply a batch that has been checked in full, saving configurations
+ *        at most once
+ *
+ * @param batch - Parsed batch
+ * @return command_result_t COMMAND_OK, or COMMAND_SAVE_FAILED if the
+ *         configurations couldn't be saved
+ */
+static command_result_t apply_batch(const command_batch_t* batch)
+{
+    configs_t* configs = &GLOBAL_CONFIGS.device_metadata.current_dev_configs;
+    command_result_t result = COMMAND_OK;
+
+    if(batch->configs_set)
+    {
+        *configs = batch->configs;
+        configs->header = CONFIGS_FRAME_HEADER;
+
+        sysret_t ret = configs_save(&GLOBAL_CONFIGS);
+        NRF_LOG_DEBUG("CONFIGS_SAVE = %d", ret);
+
+        if(ret != RET_OK)
+            result = COMMAND_SAVE_FAILED;
+    }
+
+    if(batch->datetime_set)
+    {
+        datetime_t dt = batch->datetime;
+
+        (void)datetime_reset();
+        (void)datetime_set(&dt);
+    }
+
+    if(batch->start_datalog)
+        configs->datalog_en = true;
+
+    if(batch->stop_datalog)
+        configs->datalog_en = false;
+
+    return result;
+}
+
+/**
+ * @notapi
+ * @brief Snapshot of device status for a batch response
+ */
+static void batch_status(command_status_t* status)
+{
+    datetime_t dt;
+
+    (void)memset(status, 0, sizeof(*status));
+    status->state = (uint8_t)state_machine.state;
+    status->datalog_en = GLOBAL_CONFIGS.device_metadata.current_dev_configs.datalog_en;
+
+    if(GLOBAL_CONFIGS.device_metadata.datalog_header == CONFIGS_FRAME_HEADER)
+    {
+        uint32_t datalog_size = GLOBAL_CONFIGS.device_metadata.datalog_size;
+
+        status->session_count = GLOBAL_CONFIGS.device_metadata.session_count;
+        (void)memcpy((void*)&status->datalog_size, &datalog_size, sizeof(datalog_size));
+    }
+
+    if(datetime_get(&dt) == RET_OK)
+        (void)memcpy((void*)&status->datetime, &dt, sizeof(dt));
+}
+
+/**
+ * @notapi
+ * @brief Count the datalogging sessions saved since the last complete
+ *        download
+ *
+ * Derived from the session index and the datalog size saved at the last
+ * complete download, so it survives a reset. A session still being logged
+ * isn't counted until it stops. Sessions folded together once the index is
+ * full count as one.
+ *
+ * @return uint16_t Sessions the app hasn't downloaded yet
+ */
+static uint16_t sessions_since_download(void)
+{
+    uint16_t count = 0U;
+
+    if(GLOBAL_CONFIGS.device_metadata.datalog_header != CONFIGS_FRAME_HEADER)
+        return 0U;
+
+    for(size_t i = 0U ; i < GLOBAL_CONFIGS.device_metadata.session_count && i < CONFIGS_MAX_SESSIONS ; i++)
+    {
+        if(GLOBAL_CONFIGS.device_metadata.sessions[i].offset >= GLOBAL_CONFIGS.device_metadata.downloaded_size)
+            count++;
+    }
+
+    return count;
+}
+
+/**
+ * @notapi
+ * @brief Apply a batch saved by the BLE event handler and send its response
+ */
+static void batch_apply_deferred(void)
+{
+    command_batch_t batch;
+    command_status_t status;
+    uint8_t response[sizeof(command_response_header_t) + 2U + sizeof(command_status_t)];
+
+    CRITICAL_REGION_ENTER();
+    batch = deferred.batch;
+    CRITICAL_REGION_EXIT();
+
+    command_result_t result = apply_batch(&batch);
+
+    /* status reflects the batch, so only sent once it's applied */
+    if(batch.get_status)
+        batch_status(&status);
+
+    uint16_t len = command_response(REQ_BATCH, result, COMMAND_NO_TLV, batch.get_status ? &status : NULL,
+        response, sizeof(response));
+    sysret_t ret = network_set_dev_conf_char_response(response, &len);
+    NRF_LOG_DEBUG("ATT_UPDATE = %d", ret);
+
+    /* the handler may take another batch now */
+    deferred.batch_pending = false;
+}
+
+/**
+ * @notapi
+ * @brief Save and apply a calibration checked by the BLE event handler
+ */
+static void calibration_apply_deferred(void)
+{
+    CRITICAL_REGION_ENTER();
+    GLOBAL_CONFIGS.device_metadata.calibration = deferred.calibration;
+    deferred.calibration_pending = false;
+    CRITICAL_REGION_EXIT();
+
+    /* persist, then apply to subsequent readings */
+    sysret_t ret = configs_save(&GLOBAL_CONFIGS);
+    NRF_LOG_DEBUG("CONFIGS_SAVE = %d", ret);
+
+    (void)apply_calibration();
+}
+
+/**
+ * @notapi
+ * @brief Update device status broadcast in the scan response
+ */
+static void update_adv_status(void)
+{
+    network_adv_status_t status = { .version = NETWORK_ADV_STATUS_VERSION };
+    uint32_t clock_age;
+
+    if(GLOBAL_CONFIGS.device_metadata.current_dev_configs.datalog_en)
+        status.flags |= NETWORK_ADV_STATUS_LOGGING;
+
+    if(datalog_error)
+        status.flags |= NETWORK_ADV_STATUS_DATALOG_ERROR;
+
+    if(wear_is_worn())
+        status.flags |= NETWORK_ADV_STATUS_WORN;
+
+    if(GLOBAL_CONFIGS.device_metadata.datalog_header == CONFIGS_FRAME_HEADER)
+    {
+        uint32_t fill = (uint32_t)(((uint64_t)GLOBAL_CONFIGS.device_metadata.datalog_size * 100U) / DATALOG_MAX_SIZE);
+
+        status.sessions   = GLOBAL_CONFIGS.device_metadata.session_count;
+        status.flash_fill = (fill < 100U) ? (uint8_t)fill : 100U;
+
+        if(GLOBAL_CONFIGS.device_metadata.datalog_size + DATALOG_ROW_MAX_SIZE > DATALOG_MAX_SIZE)
+            status.flags |= NETWORK_ADV_STATUS_STORAGE_FULL;
+    }
+
+    status.new_sessions = sessions_since_download();
+
+    if(datetime_get_elapsed(&clock_age) == RET_OK)
+    {
+        clock_age /= 60U;
+        status.clock_sync_age = (clock_age < UINT16_MAX) ? (uint16_t)clock_age : UINT16_MAX;
+    }
+    else
+    {
+        status.flags |= NETWORK_ADV_STATUS_CLOCK_UNSET;
+        status.clock_sync_age = UINT16_MAX;
+    }
+
+    sysret_t ret = network_set_adv_status(&status);
+
+    if(ret != RET_OK)
+    {
+        NRF_LOG_DEBUG("ADV STATUS UPDATE FAILED - 0x%X", ret);
+    }
+}
+
+/**
+ * @notapi
+ * @brief Power mode each state needs
+ */
+static power_mode_t state_power_mode(statemachine_states_t state)
+{
+    switch(state)
+    {
+        case STATE_DATALOGGING:
+            return POWER_MODE_ACTIVE;
+
+        case STATE_WAIT_FOR_TRIGGER:
+            /* only trigger mode waits, continuous mode starts right away */
+            return (GLOBAL_CONFIGS.device_metadata.current_dev_configs.datalog_mode == CONFIGS_DATALOG_MODE_TRIGGER) ?
+                POWER_MODE_ARMED : POWER_MODE_ACTIVE;
+
+        case STATE_FILE_TRANSFER:
+        case STATE_FW_UPDATE:
+            return POWER_MODE_TRANSFER;
+
+        case STATE_WAIT_FOR_WEAR:
+            return POWER_MODE_WATCH;
+
+        case STATE_LOW_POWER:
+            return POWER_MODE_SLEEP;
+
+        default:
+            return POWER_MODE_IDLE;
+    }
+}
+
+/**
+ * @notapi
+ * @brief Power mode to set after a pass, the state's unless sensors are held
+ *        powered up
+ */
+static power_mode_t current_power_mode(void)
+{
+    power_mode_t mode = state_power_mode(state_machine.state);
+
+    return (power_held && mode != POWER_MODE_ARMED) ? POWER_MODE_ACTIVE : mode;
+}
+
+/**
+ * @notapi
+ * @brief Start sampling the sensors at the configured rate
+ */
+static void datalogging_start(void)
+{
+    size_t ticks = configs_sample_rate_ticks[GLOBAL_CONFIGS.device_metadata.current_dev_configs.high_g_sampling_rate];
+
+    /* configure filters for the rate the sensors are sampled at */
+    (void)acquisition_start(
+        &GLOBAL_CONFIGS.device_metadata.current_dev_configs,
+        (float)SAMPLECLOCK_TICK_FREQ / (float)ticks
+    );
+
+    /* start sampling clock */
+    (void)sampleclock_start(ticks, datalog_tick_handler);
+}
+
+/**
+ * @notapi
+ * @brief Stop sampling the sensors
+ */
+static void datalogging_stop(void)
+{
+    sampleclock_stop();
+    (void)app_timer_stop(capture_timer);
+
+    /* log samples still waiting in the ring and filter batch */
+    (void)acquisition_stop();
+    capture_done = false;
 }
 
 /**************************************
@@ -77,9 +538,34 @@ sysret_t statemachine_init(void)
 {
     NRF_LOG_DEBUG("STATE = INIT");
     state_machine.state = STATE_INIT;
+    statemachine_kick();
     return RET_OK;
 }
 
+/**
+ * @brief Have the state machine run in the main loop, safe to call from
+ *        interrupts
+ *
+ * Call after anything the state machine reacts to has changed, it only
+ * runs when asked to.
+ */
+void statemachine_kick(void)
+{
+    eventloop_post(&statemachine_work);
+}
+
+/**
+ * @brief Keep every sensor powered up whatever the state, for commands
+ *        reading them in the background
+ *
+ * @param hold - if true, keep sensors powered up
+ */
+void statemachine_power_hold(bool hold)
+{
+    power_held = hold;
+    (void)power_set_mode(current_power_mode());
+}
+
 /**
  * @brief Return current system state
  * 
@@ -103,6 +589,7 @@ void statemachine_ble_data_handler(uint8_t* data, size_t size)
 
     uint16_t len = 0U;
     uint8_t request = data[0];
+    uint8_t flags = 0U;
     sysret_t ret = RET_ERR;
 
     NRF_LOG_DEBUG("request = %d | size = %d", request, size);
@@ -176,21 +663,205 @@ void statemachine_ble_data_handler(uint8_t* data, size_t size)
         case REQ_LOG_DOWNLOAD:
             NRF_LOG_DEBUG("REQ_LOG_DOWNLOAD");
 
+            if(!download_request_flags(data, size, 1U, &flags))
+                break;
+
+            /* without flags, the bare datalog stream apps have always read */
+            (void)memset(&download_request, 0, sizeof(download_request));
+            download_request.flags = flags;
+            download_request.raw = (flags == 0U);
+            state_machine.log_download_requested = true;
+
+            break;
+
+        case REQ_LOG_DOWNLOAD_RANGE:
+        case REQ_LOG_DOWNLOAD_BLOCKS:
+            NRF_LOG_DEBUG("REQ_LOG_DOWNLOAD_RANGE/BLOCKS");
+
+            if(!download_request_flags(data, size, 1U + 2U * sizeof(uint32_t), &flags))
+                break;
+
+            (void)memset(&download_request, 0, sizeof(download_request));
+            download_request.flags  = flags;
+            download_request.offset = request_u32(&data[1]);
+            download_request.length = request_u32(&data[5]);
+
+            if(request == REQ_LOG_DOWNLOAD_BLOCKS)
+            {
+                if(download_request.offset > UINT32_MAX / DOWNLOAD_BLOCK_SIZE ||
+                   download_request.length > UINT32_MAX / DOWNLOAD_BLOCK_SIZE)
+                {
+                    break;
+                }
+
+                download_request.offset *= DOWNLOAD_BLOCK_SIZE;
+                download_request.length *= DOWNLOAD_BLOCK_SIZE;
+            }
+
             state_machine.log_download_requested = true;
 
             break;
 
+        case REQ_LOG_DOWNLOAD_SESSION:
+        case REQ_LOG_DOWNLOAD_RECORDS:
+            NRF_LOG_DEBUG("REQ_LOG_DOWNLOAD_SESSION/RECORDS");
+
+            if(!download_request_flags(data, size, (request == REQ_LOG_DOWNLOAD_SESSION) ? 2U : 2U + 2U * sizeof(uint32_t), &flags))
+                break;
+
+            if(download_session_request(&GLOBAL_CONFIGS, data[1], &download_request) != RET_OK)
+            {
+                NRF_LOG_DEBUG("NO SUCH SESSION");
+                break;
+            }
+
+            if(request == REQ_LOG_DOWNLOAD_RECORDS)
+            {
+                download_request.skip_rows = request_u32(&data[2]);
+                download_request.rows      = request_u32(&data[6]);
+            }
+
+            download_request.flags = flags;
+
+            state_machine.log_download_requested = true;
+
+            break;
+
+        case REQ_LOG_DOWNLOAD_ACK:
+        {
+            /* sent many times a second during downloads, so not logged */
+            uint16_t ack_seq;
+            uint64_t ack_bitmap;
+
+            if(size != 1U + sizeof(uint16_t) + sizeof(uint64_t))
+                break;
+
+            (void)memcpy(&ack_seq, &data[1], sizeof(ack_seq));
+            (void)memcpy(&ack_bitmap, &data[3], sizeof(ack_bitmap));
+
+            download_ack(ack_seq, ack_bitmap);
+
+            break;
+        }
+
+        case REQ_SET_TELEMETRY:
+        {
+            NRF_LOG_DEBUG("REQ_SET_TELEMETRY");
+
+            uint16_t rate_hz;
+
+            if(size != 2U + sizeof(uint16_t))
+                break;
+
+            (void)memcpy(&rate_hz, &data[2], sizeof(rate_hz));
+
+            ret = telemetry_configure((telemetry_mode_t)data[1], rate_hz);
+            NRF_LOG_DEBUG("TELEMETRY_CONFIGURE = %d", ret);
+
+            break;
+        }
+
+        case REQ_BATCH:
+        {
+            NRF_LOG_DEBUG("REQ_BATCH");
+
+            static command_batch_t batch;
+            uint8_t failed = COMMAND_NO_TLV;
+            uint8_t response[sizeof(command_response_header_t) + 2U];
+            command_result_t result = COMMAND_BUSY;
+
+            /* nothing is applied unless every TLV checks out */
+            if(!deferred.batch_pending)
+            {
+                result = command_parse(&data[1], size - 1U,
+                    &GLOBAL_CONFIGS.device_metadata.current_dev_configs, &batch, &failed);
+            }
+
+            if(result == COMMAND_OK)
+            {
+                /* applied with a single save in statemachine_process(), which responds */
+                deferred.batch = batch;
+                deferred.batch_pending = true;
+                break;
+            }
+
+            len = command_response(request, result, failed, NULL, response, sizeof(response));
+            ret = network_set_dev_conf_char_response(response, &len);
+            NRF_LOG_DEBUG("ATT_UPDATE = %d", ret);
+
+            break;
+        }
+
+        case REQ_LOG_ERASE:
+            NRF_LOG_DEBUG("REQ_LOG_ERASE");
+
+            /* erased once IDLE, flash mustn't be touched from here */
+            state_machine.log_erase_requested = true;
+
+            break;
+
+        case REQ_SET_CALIBRATION:
+        {
+            NRF_LOG_DEBUG("REQ_SET_CALIBRATION");
+
+            configs_calibration_t calibration;
+
+            if(size - 1 != sizeof(calibration))
+                break;
+
+            (void)memcpy(&calibration, &data[1], sizeof(calibration));
+
+            if(configs_calibration_check(&calibration) != RET_OK)
+            {
+                NRF_LOG_DEBUG("CALIBRATION REJECTED");
+                break;
+            }
+
+            /* saved and applied in statemachine_process() */
+            deferred.calibration = calibration;
+            deferred.calibration_pending = true;
+
+            break;
+        }
+
         default:
             break;
     }
+
+    statemachine_kick();
 }
 
 /**
- * @brief State machine iteration, meant to be called in the main loop
+ * @brief State machine iteration, run in the main loop by @ref statemachine_kick()
  */
 void statemachine_process(void)
 {
     sysret_t ret;
+    statemachine_states_t entry_state = state_machine.state;
+
+    if(its_time_to_update_status)
+    {
+        network_link_info_t link;
+        network_get_link_info(&link);
+
+        its_time_to_update_status = false;
+        update_adv_status();
+
+        if(state_machine.state == STATE_IDLE && !link.connected)
+            idle_periods++;
+        else
+            idle_periods = 0U;
+    }
+
+    /* flash writes requested over BLE, not before configurations are read */
+    if(state_machine.state != STATE_INIT)
+    {
+        if(deferred.calibration_pending)
+            calibration_apply_deferred();
+
+        if(deferred.batch_pending)
+            batch_apply_deferred();
+    }
 
     switch( state_machine.state )
     {
@@ -213,13 +884,49 @@ void statemachine_process(void)
                 NRF_LOG_DEBUG("FAILED TO READ CONFIGS - %d", ret);
             }
 
+            if(ret == RET_OK && datalog_recover(&GLOBAL_CONFIGS) != RET_OK)
+            {
+                /* rows after the saved end would be logged over */
+                NRF_LOG_DEBUG("FAILED TO RECOVER DATALOG TAIL");
+            }
+
             (void)app_timer_create(
-                &datalog_timer,
+                &capture_timer,
+                APP_TIMER_MODE_SINGLE_SHOT,
+                capture_timer_handler
+            );
+
+            /* broadcast device status from the start */
+            (void)app_timer_create(
+                &adv_status_timer,
                 APP_TIMER_MODE_REPEATED,
-                datalog_timer_handler
+                adv_status_timer_handler
             );
+            (void)app_timer_start(adv_status_timer, APP_TIMER_TICKS(ADV_STATUS_PERIOD_MS), NULL);
+            its_time_to_update_status = true;
 
-            GLOBAL_CONFIGS.device_metadata.current_dev_configs.datalog_en = false;
+            /* a device that reset while logging goes straight back to it */
+            GLOBAL_CONFIGS.device_metadata.current_dev_configs.datalog_en = boot_datalog_resume();
+            wear_resumed = boot_wear_resume();
+
+            /* readings come off the sensors already calibrated */
+            if(apply_calibration() != RET_OK)
+            {
+                NRF_LOG_DEBUG("NO ACCELEROMETER CALIBRATION IN FLASH");
+            }
+
+            /* keep refining gyroscope bias whenever the device is still */
+            if(GLOBAL_CONFIGS.device_metadata.gyro_bias_header == CONFIGS_FRAME_HEADER)
+            {
+                int16_t gyro_bias[3];
+                (void)memcpy(gyro_bias, (const void*)GLOBAL_CONFIGS.device_metadata.gyro_bias, sizeof(gyro_bias));
+                ret = gyrobias_init(gyro_bias);
+            }
+            else
+            {
+                ret = gyrobias_init(NULL);
+            }
+            NRF_LOG_DEBUG("GYROBIAS_INIT = %d", ret);
 
             state_machine.state = STATE_IDLE;
             break;
@@ -228,16 +935,97 @@ void statemachine_process(void)
 
             if(GLOBAL_CONFIGS.device_metadata.current_dev_configs.datalog_en)
             {
-                NRF_LOG_DEBUG("IDLE -> WAIT_FOR_TRIGGER");
+                NRF_LOG_DEBUG("IDLE -> WAIT_FOR_WEAR");
 
-                (void)datalog_start(&GLOBAL_CONFIGS);
+                /* only the proximity sensor runs until the helmet is on */
+                gyrobias_suspend();
+                (void)wear_watch_from(wear_resumed);
+                wear_resumed = false;
 
-                state_machine.state = STATE_WAIT_FOR_TRIGGER;
+                state_machine.state = STATE_WAIT_FOR_WEAR;
             }
             else if(state_machine.log_download_requested)
             {
-                NRF_LOG_DEBUG("IDLE -> FILE_TRANSFER");
-                state_machine.state = STATE_FILE_TRANSFER;
+                state_machine.log_download_requested = false;
+
+                ret = download_start(&GLOBAL_CONFIGS, &download_request);
+
+                if(ret == RET_OK)
+                {
+                    NRF_LOG_DEBUG("IDLE -> FILE_TRANSFER");
+
+                    /* shortest connection interval while streaming */
+                    (void)network_set_conn_profile(NETWORK_CONN_PROFILE_BULK);
+
+                    state_machine.state = STATE_FILE_TRANSFER;
+                }
+                else
+                {
+                    NRF_LOG_DEBUG("NO DATALOG TO DOWNLOAD - %d", ret);
+                }
+            }
+            else if(state_machine.log_erase_requested)
+            {
+                state_machine.log_erase_requested = false;
+
+                ret = datalog_erase(&GLOBAL_CONFIGS);
+                NRF_LOG_DEBUG("DATALOG ERASE = %d", ret);
+
+                /* app sees from the metadata whether the datalog is gone */
+                uint16_t len = NRF_SDH_BLE_GATT_MAX_MTU_SIZE - 3;
+                (void)network_set_dev_conf_char_response(GLOBAL_CONFIGS.configs_bytes, &len);
+                its_time_to_update_status = true;
+            }
+            else if(gyrobias_persist_due())
+            {
+                /* only erase flash while nothing else is using it */
+                int16_t gyro_bias[3];
+                gyrobias_get(gyro_bias);
+
+                GLOBAL_CONFIGS.device_metadata.gyro_bias_header = CONFIGS_FRAME_HEADER;
+                (void)memcpy((void*)GLOBAL_CONFIGS.device_metadata.gyro_bias, gyro_bias, sizeof(gyro_bias));
+
+                ret = configs_save(&GLOBAL_CONFIGS);
+                NRF_LOG_DEBUG("GYRO BIAS SAVE = %d", ret);
+
+                gyrobias_persisted();
+            }
+            else if(idle_periods >= LOW_POWER_IDLE_PERIODS)
+            {
+                NRF_LOG_DEBUG("IDLE -> LOW_POWER");
+
+                /* gyroscope is put to sleep */
+                gyrobias_suspend();
+
+                state_machine.state = STATE_LOW_POWER;
+            }
+
+            break;
+
+        case STATE_WAIT_FOR_WEAR:
+
+            if(!GLOBAL_CONFIGS.device_metadata.current_dev_configs.datalog_en)
+            {
+                NRF_LOG_DEBUG("WAIT_FOR_WEAR -> IDLE");
+
+                (void)wear_watch(false);
+                (void)gyrobias_resume();
+
+                state_machine.state = STATE_IDLE;
+            }
+            else if(wear_is_worn())
+            {
+                NRF_LOG_DEBUG("WAIT_FOR_WEAR -> WAIT_FOR_TRIGGER");
+
+                /* every time the helmet is put on is a new session */
+                (void)datalog_start(&GLOBAL_CONFIGS);
+                datalog_error = false;
+
+                /* bias keeps being tracked, but the offsets only change between sessions */
+                gyrobias_hold();
+                (void)gyrobias_resume();
+
+                state_machine.state = STATE_WAIT_FOR_TRIGGER;
             }
 
             break;
@@ -249,19 +1037,63 @@ void statemachine_process(void)
                 NRF_LOG_DEBUG("WAIT_FOR_TRIGGER -> IDLE");
 
                 (void)datalog_stop(&GLOBAL_CONFIGS);
+                gyrobias_release();
+                (void)wear_watch(false);
+
+                if(trigger_armed())
+                {
+                    (void)trigger_disarm();
+                    (void)gyrobias_resume();
+                }
 
                 state_machine.state = STATE_IDLE;
             }
+            else if(!wear_is_worn())
+            {
+                NRF_LOG_DEBUG("WAIT_FOR_TRIGGER -> WAIT_FOR_WEAR");
+
+                (void)datalog_stop(&GLOBAL_CONFIGS);
+                gyrobias_release();
+
+                /* gyroscope is already asleep while armed */
+                if(trigger_armed())
+                    (void)trigger_disarm();
+                else
+                    gyrobias_suspend();
+
+                state_machine.state = STATE_WAIT_FOR_WEAR;
+            }
             else if(GLOBAL_CONFIGS.device_metadata.current_dev_configs.datalog_mode == CONFIGS_DATALOG_MODE_CONTINUOUS)
             {
                 NRF_LOG_DEBUG("WAIT_FOR_TRIGGER -> DATALOGGING");
 
-                /* start timer */
-                (void)app_timer_start(
-                    datalog_timer,
-                    configs_sample_rate_ticks[GLOBAL_CONFIGS.device_metadata.current_dev_configs.high_g_sampling_rate],
-                    NULL
-                );
+                datalogging_start();
+
+                state_machine.state = STATE_DATALOGGING;
+            }
+            else if(!trigger_armed())
+            {
+                /* the ADXL372 watches for impacts, gyroscope sleeps until then */
+                ret = trigger_arm(GLOBAL_CONFIGS.device_metadata.current_dev_configs.threshold_resultant);
+
+                if(ret == RET_OK)
+                {
+                    gyrobias_suspend();
+                }
+                else
+                {
+                    NRF_LOG_DEBUG("TRIGGER ARM FAILED - 0x%X", ret);
+                }
+            }
+            else if(trigger_fired())
+            {
+                NRF_LOG_DEBUG("WAIT_FOR_TRIGGER -> DATALOGGING (IMPACT)");
+
+                (void)trigger_disarm();
+                (void)gyrobias_resume();
+
+                datalogging_start();
+                (void)app_timer_start(capture_timer, APP_TIMER_TICKS(TRIGGER_CAPTURE_MS), NULL);
 
                 state_machine.state = STATE_DATALOGGING;
             }
@@ -270,70 +1102,86 @@ void statemachine_process(void)
 
         case STATE_DATALOGGING:
 
-            if(!GLOBAL_CONFIGS.device_metadata.current_dev_configs.datalog_en)
+            if(!GLOBAL_CONFIGS.device_metadata.current_dev_configs.datalog_en || !wear_is_worn())
             {
                 NRF_LOG_DEBUG("DATALOGGING -> WAIT_FOR_TRIGGER");
-                (void)app_timer_stop(datalog_timer);
+
+                datalogging_stop();
+
                 state_machine.state = STATE_WAIT_FOR_TRIGGER;
             }
+            else if(capture_done)
+            {
+                /* impact captured, re-armed in WAIT_FOR_TRIGGER */
+                NRF_LOG_DEBUG("DATALOGGING -> WAIT_FOR_TRIGGER (CAPTURED)");
+
+                datalogging_stop();
 
-            if(its_time_to_log_data)
+                state_machine.state = STATE_WAIT_FOR_TRIGGER;
+            }
+            else
             {
-                datetime_t dt;
-                int16_t gyro[ICM20649_GYRO_AXES] = {0U};
-                int16_t low_g_accel[ICM20649_ACCEL_AXES] = {0U};
-                int16_t high_g_accel[ADXL372_AXES] = {0U};
-
-                /* get sensor readings */
-                sysret_t dt_ret   = datetime_get(&dt);
-                sysret_t icm_ret  = icm20649_read_raw(gyro, low_g_accel);
-                sysret_t adxl_ret = adxl372_read_raw(high_g_accel);
-
-                (void)datalog_log(
-                    dt_ret == RET_OK   ? &dt : NULL,
-                    icm_ret == RET_OK  ? gyro : NULL,
-                    icm_ret == RET_OK  ? low_g_accel : NULL,
-                    adxl_ret == RET_OK ? high_g_accel : NULL
-                );
-
-                its_time_to_log_data = false;
+                /* frames sampled since the last pass, batch gets filtered and logged once full */
+                if(acquisition_process() != RET_OK)
+                    datalog_error = true;
             }
 
             break;
 
         case STATE_LOW_POWER:
-            /* TODO */
+        {
+            network_link_info_t link;
+            network_get_link_info(&link);
+
+            /* the app connecting or datalogging being enabled wakes everything up */
+            if(GLOBAL_CONFIGS.device_metadata.current_dev_configs.datalog_en || link.connected)
+            {
+                NRF_LOG_DEBUG("LOW_POWER -> IDLE");
+
+                (void)gyrobias_resume();
+                idle_periods = 0U;
+
+                state_machine.state = STATE_IDLE;
+            }
+
             break;
+        }
 
         case STATE_FILE_TRANSFER:
-        {
-            uint16_t len = NRF_SDH_BLE_GATT_MAX_MTU_SIZE - 3; // TODO: make this into a better macro
-            uint8_t tx[NRF_SDH_BLE_GATT_MAX_MTU_SIZE - 3] = {0xde, 0xad, 0xbe, 0xef};
-            size_t failed = 0;
-            size_t success = 0;
-            sysret_t ret;
 
-            for(int i = 0 ; i < 256 ; )
+            /* queue as much as the SoftDevice takes, then let the main loop run */
+            ret = download_process();
+
+            /* window bookkeeping and ACK timeouts are polled, keep running */
+            statemachine_kick();
+
+            if(ret != RET_OK)
             {
-                ret = network_transmit_file_packet(tx, len);
-                if(ret == RET_OK)
-                {
-                    i++;
-                    success++;
-                }
-                else
+                NRF_LOG_DEBUG("FILE_TRANSFER FAILED - 0x%X", ret);
+            }
+
+            if(!download_is_active())
+            {
+                NRF_LOG_DEBUG("FILE_TRANSFER -> IDLE");
+
+                /* only a download of the whole datalog catches the app up */
+                if(ret == RET_OK && download_request.offset == 0U && download_request.length == 0U &&
+                   download_request.skip_rows == 0U && download_request.rows == 0U)
                 {
-                    failed++;
+                    GLOBAL_CONFIGS.device_metadata.downloaded_size = GLOBAL_CONFIGS.device_metadata.datalog_size;
+
+                    ret = configs_save(&GLOBAL_CONFIGS);
+                    if(ret != RET_OK)
+                    {
+                        NRF_LOG_DEBUG("DOWNLOAD MARKER NOT SAVED - 0x%X", ret);
+                    }
                 }
-            }
 
-            NRF_LOG_DEBUG("filetx = 0x%X | success = %d | failed = %d", ret, success, failed);
+                (void)network_set_conn_profile(NETWORK_CONN_PROFILE_IDLE);
+                state_machine.state = STATE_IDLE;
+            }
 
-            NRF_LOG_DEBUG("FILE_TRANSFER -> IDLE");
-            state_machine.log_download_requested = false;
-            state_machine.state = STATE_IDLE;
             break;
-        }
 
         case STATE_FW_UPDATE:
             /* TODO */
@@ -342,4 +1190,22 @@ void statemachine_process(void)
         default:
             break;
     }
+
+    /* peripherals follow the state, also puts flash back down after it's been used */
+    ret = power_set_mode(current_power_mode());
+
+    if(ret != RET_OK && state_machine.state != entry_state)
+    {
+        NRF_LOG_DEBUG("POWER MODE FAILED - 0x%X", ret);
+    }
+
+    /* logging picks up again if the device resets before the next pass */
+    boot_datalog_retain(
+        GLOBAL_CONFIGS.device_metadata.current_dev_configs.datalog_en,
+        state_machine.state == STATE_WAIT_FOR_TRIGGER || state_machine.state == STATE_DATALOGGING
+    );
+
+    /* the new state gets to run right away */
+    if(state_machine.state != entry_state)
+        statemachine_kick();
 }
\ No newline at end of file
@@ -0,0 +1,244 @@
+/**
+ * @file telemetry.c
+ * @author UBC Capstone Team 2020/2021
+ * @brief Live sensor data stream over BLE
+ */
+
+#include <string.h>
+#include "telemetry.h"
+#include "network.h"
+#include "nrf_assert.h"
+#include "nrf_log.h"
+
+/**
+ * @brief Most records that fit in a notification at the largest ATT_MTU
+ */
+#define TELEMETRY_MAX_RECORDS \
+    ((NETWORK_BLE_MAX_ATT_PAYLOAD_SIZE - sizeof(telemetry_packet_header_t)) / sizeof(telemetry_record_t))
+
+/**
+ * @brief Requested configuration
+ */
+static telemetry_mode_t telemetry_mode = TELEMETRY_OFF;
+static uint16_t telemetry_rate_hz = TELEMETRY_DEFAULT_RATE_HZ;
+static float telemetry_sample_rate = 0.0f;
+
+/**
+ * @brief Stream state
+ */
+static struct
+{
+    bool     running;
+    uint32_t sample;   /*!< Samples fed in since start */
+    uint32_t phase;    /*!< Samples fed into the current record */
+    telemetry_record_t peak; /*!< Peaks of current window, TELEMETRY_PEAKS only */
+
+    telemetry_packet_header_t header;
+    telemetry_record_t records[TELEMETRY_MAX_RECORDS];
+    telemetry_stats_t stats;
+} stream;
+
+/******************************
+ * Helper functions
+ ******************************/
+
+/**
+ * @notapi
+ * @brief Work out samples between records for the requested rate
+ */
+static void set_interval(void)
+{
+    uint32_t interval = 1U;
+
+    if(telemetry_sample_rate > (float)telemetry_rate_hz)
+        interval = (uint32_t)((telemetry_sample_rate / (float)telemetry_rate_hz) + 0.5f);
+
+    /* interval is sent as 16 bits */
+    if(interval > UINT16_MAX)
+        interval = UINT16_MAX;
+
+    stream.stats.mode = telemetry_mode;
+    stream.stats.interval = interval;
+    stream.phase = 0U;
+    stream.header.count = 0U;
+}
+
+/**
+ * @notapi
+ * @brief Send the records waiting in the packet, dropping them if the
+ *        SoftDevice can't take them right now
+ */
+static void send_packet(void)
+{
+    uint8_t packet[NETWORK_BLE_MAX_ATT_PAYLOAD_SIZE];
+    size_t len = sizeof(stream.header) + stream.header.count * sizeof(telemetry_record_t);
+
+    if(stream.header.count == 0U)
+        return;
+
+    (void)memcpy(packet, &stream.header, sizeof(stream.header));
+    (void)memcpy(packet + sizeof(stream.header), stream.records, len - sizeof(stream.header));
+
+    if(network_transmit_telemetry(packet, (uint16_t)len) == RET_OK)
+        stream.stats.sent_packets++;
+    else
+        stream.stats.dropped_packets++;
+
+    stream.header.seq++;
+    stream.header.count = 0U;
+}
+
+/**
+ * @notapi
+ * @brief Add a record to the packet, sending it once no more fit
+ *
+ * @param record - Record to add
+ * @param first  - Sample number of record
+ */
+static void add_record(const telemetry_record_t* record, uint32_t first)
+{
+    uint16_t max_size = network_file_packet_max_size();
+    size_t max_records = 0U;
+
+    if(max_size > sizeof(telemetry_packet_header_t))
+        max_records = (max_size - sizeof(telemetry_packet_header_t)) / sizeof(telemetry_record_t);
+
+    if(max_records > TELEMETRY_MAX_RECORDS)
+        max_records = TELEMETRY_MAX_RECORDS;
+
+    /* disconnected, or nothing fits */
+    if(max_records == 0U)
+    {
+        stream.header.count = 0U;
+        return;
+    }
+
+    if(stream.header.count == 0U)
+    {
+        stream.header.mode = (uint8_t)stream.stats.mode;
+        stream.header.first = first;
+        stream.header.interval = (uint16_t)stream.stats.interval;
+    }
+
+    stream.records[stream.header.count++] = *record;
+
+    if(stream.header.count >= max_records)
+        send_packet();
+}
+
+/******************************
+ * API
+ ******************************/
+
+/**
+ * @brief Choose what gets streamed, takes effect on the next acquisition
+ *        session or straight away if one is running
+ *
+ * @param mode    - What to stream
+ * @param rate_hz - Records per second, 0 for @ref TELEMETRY_DEFAULT_RATE_HZ
+ * @return sysret_t Module status
+ * @retval NRF_ERROR_INVALID_PARAM if the mode doesn't exist
+ */
+sysret_t telemetry_configure(telemetry_mode_t mode, uint16_t rate_hz)
+{
+    if(mode >= TELEMETRY_MODES_NUM)
+        return NRF_ERROR_INVALID_PARAM;
+
+    /* records already batched were made with the old settings */
+    if(stream.running)
+        send_packet();
+
+    telemetry_mode = mode;
+    telemetry_rate_hz = (rate_hz != 0U) ? rate_hz : TELEMETRY_DEFAULT_RATE_HZ;
+
+    set_interval();
+
+    return RET_OK;
+}
+
+/**
+ * @brief Start a new stream, called when acquisition starts
+ *
+ * @param sample_rate - Rate samples are fed in at, in Hz
+ */
+void telemetry_start(float sample_rate)
+{
+    (void)memset(&stream, 0, sizeof(stream));
+
+    telemetry_sample_rate = sample_rate;
+    set_interval();
+    stream.running = true;
+}
+
+/**
+ * @brief Feed a filtered sample into the stream
+ *
+ * @param channels - One reading per channel, see @ref cfcfilter_channel_t
+ */
+void telemetry_push(const int16_t channels[CFCFILTER_CHANNELS])
+{
+    ASSERT(channels);
+
+    if(!stream.running || stream.stats.mode == TELEMETRY_OFF || !network_telemetry_subscribed())
+    {
+        stream.sample++;
+        stream.phase = 0U;
+        stream.header.count = 0U;
+        return;
+    }
+
+    uint32_t sample = stream.sample++;
+
+    if(stream.stats.mode == TELEMETRY_SAMPLES)
+    {
+        if(stream.phase == 0U)
+        {
+            telemetry_record_t record;
+            (void)memcpy(record.channels, channels, sizeof(record.channels));
+            add_record(&record, sample);
+        }
+    }
+    else
+    {
+        for(size_t ch = 0U ; ch < CFCFILTER_CHANNELS ; ch++)
+        {
+            int32_t val = channels[ch];
+            int32_t peak = stream.peak.channels[ch];
+
+            if(stream.phase == 0U || (val < 0 ? -val : val) > (peak < 0 ? -peak : peak))
+                stream.peak.channels[ch] = channels[ch];
+        }
+
+        if(stream.phase + 1U == stream.stats.interval)
+            add_record(&stream.peak, sample + 1U - stream.stats.interval);
+    }
+
+    stream.phase = (stream.phase + 1U) % stream.stats.interval;
+}
+
+/**
+ * @brief Send whatever records are waiting and end the stream,
+ *        called when acquisition stops
+ */
+void telemetry_stop(void)
+{
+    if(!stream.running)
+        return;
+
+    send_packet();
+    stream.running = false;
+
+    NRF_LOG_DEBUG("TELEMETRY | %u sent | %u dropped", stream.stats.sent_packets, stream.stats.dropped_packets);
+}
+
+/**
+ * @brief Get telemetry counters
+ *
+ * @param stats - Counters will be saved here
+ */
+void telemetry_get_stats(telemetry_stats_t* stats)
+{
+    ASSERT(stats);
+
+    *stats = stream.stats;
+}
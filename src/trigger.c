@@ -0,0 +1,254 @@
+/**
+ * @file trigger.c
+ * @author UBC Capstone Team 2020/2021
+ * @brief Impact trigger, the ADXL372 watches for impacts in instant-on
+ *        mode while everything else sleeps
+ */
+
+#include "trigger.h"
+#include "adxl372.h"
+#include "statemachine.h"
+#include "custom_board.h"
+#include "nrf_log.h"
+
+#ifdef ADXL372_INT1_PIN
+#include "nrf_drv_gpiote.h"
+#else
+#include "app_timer.h"
+#include "eventloop.h"
+#endif
+
+/**
+ * @brief Trigger state
+ */
+static struct
+{
+    bool armed;          /*!< Watching for impacts */
+    volatile bool fired; /*!< Impact seen since armed */
+} trigger;
+
+/******************************
+ * Helper functions
+ ******************************/
+
+/**
+ * @notapi
+ * @brief Latch an impact and have the state machine react to it, safe to
+ *        call from interrupts
+ */
+static void trigger_fire(void)
+{
+    trigger.fired = true;
+    statemachine_kick();
+}
+
+#ifdef ADXL372_INT1_PIN
+
+/**
+ * @notapi
+ * @brief ADXL372 INT1 went high, only the first edge matters
+ */
+static void int1_handler(nrf_drv_gpiote_pin_t pin, nrf_gpiote_polarity_t action)
+{
+    (void)pin;
+    (void)action;
+
+    nrf_drv_gpiote_in_event_disable(ADXL372_INT1_PIN);
+    trigger_fire();
+}
+
+/**
+ * @notapi
+ * @brief Start listening to INT1
+ */
+static sysret_t watch_start(void)
+{
+    nrf_drv_gpiote_in_event_enable(ADXL372_INT1_PIN, true);
+    return RET_OK;
+}
+
+/**
+ * @notapi
+ * @brief Stop listening to INT1
+ */
+static void watch_stop(void)
+{
+    nrf_drv_gpiote_in_event_disable(ADXL372_INT1_PIN);
+}
+
+/**
+ * @notapi
+ * @brief Set INT1 up as a low power input, PORT event rather than a
+ *        GPIOTE channel so the high frequency clock isn't needed
+ */
+static sysret_t watch_init(void)
+{
+    sysret_t ret;
+    nrf_drv_gpiote_in_config_t cfg = GPIOTE_CONFIG_IN_SENSE_LOTOHI(false);
+
+    cfg.pull = NRF_GPIO_PIN_PULLDOWN;
+
+    if(!nrf_drv_gpiote_is_init())
+    {
+        ret = nrf_drv_gpiote_init();
+        SYSRET_CHECK(ret);
+    }
+
+    return nrf_drv_gpiote_in_init(ADXL372_INT1_PIN, &cfg, int1_handler);
+}
+
+#else
+
+/**
+ * @brief Status polling timer handle
+ */
+APP_TIMER_DEF(trigger_poll_timer);
+
+/**
+ * @notapi
+ * @brief Read the ADXL372 status, run in the main loop by the polling timer
+ */
+static void trigger_poll(void)
+{
+    bool impact = false;
+
+    if(!trigger.armed || trigger.fired)
+        return;
+
+    if(adxl372_check_impact(&impact) == RET_OK && impact)
+    {
+        (void)app_timer_stop(trigger_poll_timer);
+        trigger_fire();
+    }
+}
+
+/**
+ * @brief Runs @ref trigger_poll() in the main loop
+ */
+EVENTLOOP_WORK_DEF(trigger_poll_work, trigger_poll);
+
+/**
+ * @notapi
+ * @brief Signify that it's time to poll the ADXL372
+ */
+static void trigger_poll_timer_handler(void* p_ctx)
+{
+    (void)p_ctx;
+    eventloop_post(&trigger_poll_work);
+}
+
+/**
+ * @notapi
+ * @brief Start polling the ADXL372 status
+ */
+static sysret_t watch_start(void)
+{
+    return app_timer_start(trigger_poll_timer, APP_TIMER_TICKS(TRIGGER_POLL_PERIOD_MS), NULL);
+}
+
+/**
+ * @notapi
+ * @brief Stop polling the ADXL372 status
+ */
+static void watch_stop(void)
+{
+    (void)app_timer_stop(trigger_poll_timer);
+}
+
+/**
+ * @notapi
+ * @brief Create the polling timer
+ */
+static sysret_t watch_init(void)
+{
+    return app_timer_create(&trigger_poll_timer, APP_TIMER_MODE_REPEATED, trigger_poll_timer_handler);
+}
+
+#endif /* ADXL372_INT1_PIN */
+
+/******************************
+ * API
+ ******************************/
+
+/**
+ * @brief Initialize the impact trigger, left disarmed
+ *
+ * @return sysret_t Module status
+ */
+sysret_t trigger_init(void)
+{
+    trigger.armed = false;
+    trigger.fired = false;
+
+    return watch_init();
+}
+
+/**
+ * @brief Start watching for impacts, the state machine is kicked when
+ *        one happens
+ *
+ * @param threshold - Resultant acceleration threshold, ADXL372 LSB of 100 mg
+ * @return sysret_t Module status
+ */
+sysret_t trigger_arm(uint16_t threshold)
+{
+    sysret_t ret;
+    adxl372_instant_on_thresh_t thresh = (threshold >= TRIGGER_HIGH_THRESH_MIN) ?
+        ADXL372_INSTANT_ON_THRESH_HIGH : ADXL372_INSTANT_ON_THRESH_LOW;
+
+    trigger.fired = false;
+
+    ret = adxl372_arm_impact(thresh);
+    SYSRET_CHECK(ret);
+
+    ret = watch_start();
+    SYSRET_CHECK(ret);
+
+    NRF_LOG_DEBUG("TRIGGER ARMED - %s THRESHOLD", (thresh == ADXL372_INSTANT_ON_THRESH_HIGH) ? "HIGH" : "LOW");
+
+    trigger.armed = true;
+    return RET_OK;
+}
+
+/**
+ * @brief Stop watching for impacts and clear the ADXL372 interrupt
+ *
+ * @return sysret_t Module status
+ */
+sysret_t trigger_disarm(void)
+{
+    sysret_t ret;
+    bool impact;
+
+    watch_stop();
+    trigger.armed = false;
+
+    ret = adxl372_check_impact(&impact);
+    SYSRET_CHECK(ret);
+
+    ret = adxl372_disarm_impact();
+    SYSRET_CHECK(ret);
+
+    /* the start of an impact stays in the FIFO for acquisition to log */
+    return trigger.fired ? RET_OK : adxl372_onset_stop();
+}
+
+/**
+ * @brief Check if the trigger is armed
+ *
+ * @return true if armed
+ */
+bool trigger_armed(void)
+{
+    return trigger.armed;
+}
+
+/**
+ * @brief Check if an impact happened since the trigger was armed
+ *
+ * @return true if an impact happened
+ */
+bool trigger_fired(void)
+{
+    return trigger.fired;
+}
@@ -0,0 +1,278 @@
+/**
+ * @file wear.c
+ * @author UBC Capstone Team 2020/2021
+ * @brief Wear detection, the VCNL4040 proximity sensor tells whether the
+ *        helmet is on a head
+ */
+
+#include "wear.h"
+#include "vcnl4040.h"
+#include "statemachine.h"
+#include "eventloop.h"
+#include "custom_board.h"
+#include "app_timer.h"
+#include "nrf_log.h"
+
+#ifdef VCNL4040_INT_PIN
+#include "nrf_drv_gpiote.h"
+#endif
+
+/**
+ * @brief Wear detection state
+ */
+static struct
+{
+    bool available;         /*!< VCNL4040 set up with thresholds */
+    volatile bool watching; /*!< Following the VCNL4040 interrupts */
+    volatile bool sync;     /*!< Next poll goes by the proximity reading */
+    volatile bool again;    /*!< Update asked for while a poll was running */
+    volatile bool worn;     /*!< Helmet is being worn */
+} wear;
+
+/**
+ * @brief Timer handle, only the first update after watching starts on
+ *        boards with the INT line, every update on boards without it
+ */
+APP_TIMER_DEF(wear_timer);
+
+/******************************
+ * Helper functions
+ ******************************/
+
+static void wear_update(void);
+
+/**
+ * @brief Runs @ref wear_update() in the main loop
+ */
+EVENTLOOP_WORK_DEF(wear_work, wear_update);
+
+/**
+ * @notapi
+ * @brief Follow the VCNL4040 interrupt flags, runs in the I2C interrupt
+ *        once the poll is done
+ */
+static void poll_done(sysret_t result, const vcnl4040_poll_t* poll)
+{
+    bool worn = wear.worn;
+
+    /* INT may have gone low again after the flags were read */
+    if(wear.again)
+    {
+        wear.again = false;
+        eventloop_post(&wear_work);
+    }
+
+    if(result != RET_OK || !wear.watching)
+        return;
+
+    if(wear.sync)
+    {
+        /* sensor was just powered up, it may already be past a threshold */
+        wear.sync = false;
+        worn = (poll->ps >= WEAR_PS_CLOSE_THRESH);
+    }
+    else if(poll->int_flags & VCNL4040_INT_CLOSE)
+    {
+        worn = true;
+    }
+    else if(poll->int_flags & VCNL4040_INT_AWAY)
+    {
+        worn = false;
+    }
+
+    if(worn != wear.worn)
+    {
+        NRF_LOG_DEBUG("HELMET %s", worn ? "ON" : "OFF");
+
+        wear.worn = worn;
+        statemachine_kick();
+    }
+}
+
+/**
+ * @notapi
+ * @brief Poll the VCNL4040 in the background, run in the main loop
+ */
+static void wear_update(void)
+{
+    if(!wear.watching)
+        return;
+
+    /* set first, the running poll may finish before this one is refused */
+    wear.again = true;
+
+    /* reading the flags also releases the INT line */
+    if(vcnl4040_poll(poll_done) != NRF_ERROR_BUSY)
+        wear.again = false;
+}
+
+/**
+ * @notapi
+ * @brief Signify that it's time to read the VCNL4040
+ */
+static void wear_timer_handler(void* p_ctx)
+{
+    (void)p_ctx;
+    eventloop_post(&wear_work);
+}
+
+#ifdef VCNL4040_INT_PIN
+
+#define WEAR_TIMER_MODE APP_TIMER_MODE_SINGLE_SHOT
+
+/**
+ * @notapi
+ * @brief VCNL4040 INT went low, flags are read in the main loop
+ */
+static void int_handler(nrf_drv_gpiote_pin_t pin, nrf_gpiote_polarity_t action)
+{
+    (void)pin;
+    (void)action;
+
+    eventloop_post(&wear_work);
+}
+
+/**
+ * @notapi
+ * @brief Set INT up as a low power input, it's open drain and active low
+ */
+static sysret_t int_init(void)
+{
+    sysret_t ret;
+    nrf_drv_gpiote_in_config_t cfg = GPIOTE_CONFIG_IN_SENSE_HITOLO(false);
+
+    cfg.pull = NRF_GPIO_PIN_PULLUP;
+
+    if(!nrf_drv_gpiote_is_init())
+    {
+        ret = nrf_drv_gpiote_init();
+        SYSRET_CHECK(ret);
+    }
+
+    return nrf_drv_gpiote_in_init(VCNL4040_INT_PIN, &cfg, int_handler);
+}
+
+/**
+ * @notapi
+ * @brief Start or stop listening to INT
+ */
+static void int_enable(bool en)
+{
+    if(en)
+        nrf_drv_gpiote_in_event_enable(VCNL4040_INT_PIN, true);
+    else
+        nrf_drv_gpiote_in_event_disable(VCNL4040_INT_PIN);
+}
+
+#else
+
+#define WEAR_TIMER_MODE APP_TIMER_MODE_REPEATED
+
+/**
+ * @notapi
+ * @brief No INT line, flags are polled by the timer
+ */
+static sysret_t int_init(void)
+{
+    return RET_OK;
+}
+
+/**
+ * @notapi
+ * @brief No INT line, flags are polled by the timer
+ */
+static void int_enable(bool en)
+{
+    (void)en;
+}
+
+#endif /* VCNL4040_INT_PIN */
+
+/******************************
+ * API
+ ******************************/
+
+/**
+ * @brief Initialize wear detection, not watching until @ref wear_watch()
+ *
+ * @return sysret_t Module status
+ */
+sysret_t wear_init(void)
+{
+    sysret_t ret;
+
+    wear.available = false;
+    wear.watching = false;
+    wear.sync = false;
+    wear.again = false;
+
+    /* until the sensor says otherwise */
+    wear.worn = true;
+
+    ret = app_timer_create(&wear_timer, WEAR_TIMER_MODE, wear_timer_handler);
+    SYSRET_CHECK(ret);
+
+    ret = vcnl4040_set_thresholds(WEAR_PS_AWAY_THRESH, WEAR_PS_CLOSE_THRESH);
+    SYSRET_CHECK(ret);
+
+    ret = int_init();
+    SYSRET_CHECK(ret);
+
+    wear.available = true;
+    wear.worn = false;
+
+    return RET_OK;
+}
+
+/**
+ * @brief Start or stop watching for the helmet being put on or taken off,
+ *        the state machine is kicked on every change
+ *
+ * @param en - if true, start watching
+ * @return sysret_t Module status
+ */
+sysret_t wear_watch(bool en)
+{
+    if(!wear.available || en == wear.watching)
+        return RET_OK;
+
+    if(en)
+        return wear_watch_from(false);
+
+    wear.watching = false;
+    int_enable(false);
+
+    return app_timer_stop(wear_timer);
+}
+
+/**
+ * @brief Start watching from a known wear state, for a device picking
+ *        datalogging up again after a reset
+ *
+ * @param worn - if true, the helmet was on when the device reset
+ * @return sysret_t Module status
+ */
+sysret_t wear_watch_from(bool worn)
+{
+    if(!wear.available || wear.watching)
+        return RET_OK;
+
+    /* first reading once the sensor is powered up */
+    wear.sync = true;
+    wear.worn = worn;
+
+    wear.watching = true;
+    int_enable(true);
+
+    return app_timer_start(wear_timer, APP_TIMER_TICKS(WEAR_POLL_PERIOD_MS), NULL);
+}
+
+/**
+ * @brief Check if the helmet is being worn
+ *
+ * @return true if worn
+ */
+bool wear_is_worn(void)
+{
+    return wear.worn;
+}